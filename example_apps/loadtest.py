@@ -0,0 +1,96 @@
+from __future__ import annotations
+
+import asyncio
+import io
+import logging
+import math
+import os
+import struct
+import wave
+from logging import getLogger
+
+from stackchan_server.app import StackChanApp
+from stackchan_server.ws_proxy import (
+    EmptyTranscriptError,
+    ServoMoveType,
+    ServoWaitType,
+    WsProxy,
+)
+
+# misc/loadgen/stackchan_loadgen.cpp の負荷試験の相手にするサーバー
+# 音声認識と音声合成は固定の待ち時間で結果を返すスタブにして、サーバー自体の処理だけを測る
+
+logger = getLogger(__name__)
+logging.basicConfig(
+    level=os.getenv("STACKCHAN_LOG_LEVEL", "WARNING"),
+    format="%(asctime)s.%(msecs)03d %(levelname)s:%(name)s:%(message)s",
+    datefmt="%H:%M:%S",
+)
+
+_ASR_DELAY_SECONDS = int(os.getenv("STACKCHAN_STUB_ASR_MS", "300")) / 1000
+_TTS_DELAY_SECONDS = int(os.getenv("STACKCHAN_STUB_TTS_MS", "200")) / 1000
+_TTS_SAMPLE_RATE = 24000
+_TTS_SECONDS_PER_CHAR = 0.15
+_SPEECH_LEVEL = 300  # 平均絶対振幅がこれ以下なら無音（空の認識結果）
+
+
+class StubSpeechToText:
+    """音があれば固定の文を、無音なら空文字を返す。"""
+
+    async def transcribe(self, pcm_bytes: bytes) -> str:
+        await asyncio.sleep(_ASR_DELAY_SECONDS)
+        count = len(pcm_bytes) // 2
+        if count == 0:
+            return ""
+        samples = struct.unpack(f"<{count}h", pcm_bytes[: count * 2])
+        level = sum(abs(s) for s in samples) / count
+        return "こんにちは" if level > _SPEECH_LEVEL else ""
+
+
+class StubSpeechSynthesizer:
+    """文字数に比例した長さの小さな正弦波を WAV で返す。"""
+
+    async def synthesize(self, text: str) -> bytes:
+        await asyncio.sleep(_TTS_DELAY_SECONDS)
+        frames = int(_TTS_SAMPLE_RATE * _TTS_SECONDS_PER_CHAR * max(len(text), 1))
+        pcm = struct.pack(
+            f"<{frames}h",
+            *(int(2000 * math.sin(2 * math.pi * 440 * i / _TTS_SAMPLE_RATE)) for i in range(frames)),
+        )
+        buf = io.BytesIO()
+        with wave.open(buf, "wb") as wav:
+            wav.setnchannels(1)
+            wav.setsampwidth(2)
+            wav.setframerate(_TTS_SAMPLE_RATE)
+            wav.writeframes(pcm)
+        return buf.getvalue()
+
+
+app = StackChanApp(
+    speech_recognizer=StubSpeechToText(),
+    speech_synthesizer=StubSpeechSynthesizer(),
+)
+
+
+@app.talk_session
+async def talk_session(proxy: WsProxy):
+    while True:
+        try:
+            text = await proxy.listen()
+        except EmptyTranscriptError:
+            return
+        if not text:
+            return
+        # うなずき（ServoCmd / ServoDoneEvt の往復も負荷に含める）
+        await proxy.move_servo([
+            (ServoMoveType.MOVE_Y, 100, 100),
+            (ServoWaitType.SLEEP, 100),
+            (ServoMoveType.MOVE_Y, 90, 100),
+        ])
+        await proxy.speak(text)
+
+
+if __name__ == "__main__":
+    import uvicorn
+
+    uvicorn.run("example_apps.loadtest:app.fastapi", host="0.0.0.0", port=8000, log_level="warning")
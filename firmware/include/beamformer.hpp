@@ -0,0 +1,44 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// 2 マイクの固定ビームフォーマ（遅延和、固定小数点）
+//  - 一方のチャンネルを整数遅延 + 4 タップ Lagrange 補間の小数遅延で遅らせ、もう一方と平均する
+//  - 狙った方向から来た音は同位相で足し合わさり、拡散ノイズは相関が低いので相対的に下がる（最大 +3 dB）
+//  - 係数は configure() で 1 回だけ求め、process() は整数演算のみ
+class Beamformer
+{
+public:
+  Beamformer() = default;
+
+  // steer_deg: 0 が正面（2 マイクを結ぶ線の垂直方向）。正の角度は右（R）マイク側
+  // mic_spacing_mm: 2 マイクの間隔
+  void configure(int sample_rate, float mic_spacing_mm, float steer_deg);
+
+  // interleaved: L/R 交互の frames フレーム。out にモノラル frames サンプルを書く（out == interleaved も可）
+  void process(const int16_t *interleaved, size_t frames, int16_t *out);
+
+  // 遅延の状態を消す（録音を再開するとき）
+  void reset();
+
+  // 設定した遅延（サンプル、正なら R を遅らせる）
+  float delaySamples() const { return delay_samples_; }
+
+private:
+  static constexpr size_t kTaps = 4;
+  static constexpr int kCoeffShift = 14; // Q14
+  static constexpr size_t kHistory = 16; // 遅延線の長さ（2 のべき乗）。間隔 10 cm @16kHz でも足りる
+  static constexpr size_t kHistoryMask = kHistory - 1;
+
+  float delay_samples_ = 0.0f;
+  bool delay_left_ = false;    // true: L を遅らせる
+  size_t integer_delay_ = 0;   // 補間フィルタの前に入れる整数遅延
+  std::array<int32_t, kTaps> coeffs_{};
+
+  // 遅らせる側の遅延線と、もう一方の 1 サンプル遅延（補間フィルタの群遅延 1 サンプルと揃える）
+  std::array<int16_t, kHistory> history_{};
+  size_t history_pos_ = 0;
+  int16_t other_prev_ = 0;
+};
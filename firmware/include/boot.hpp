@@ -0,0 +1,64 @@
+#pragma once
+
+#include <M5Unified.h>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// 起動シーケンスの計測と並列化
+//  - フェーズごとの開始/終了時刻（millis）を記録し、最初の Idle 到達時にまとめてログに出す
+//  - 重いフェーズ（ESP-SR のモデル読み込み、表示の初回描画）を別タスクで並行に実行する
+//  - 並行フェーズが全て終わるまで Idle に入らないためのゲート
+enum class BootPhase : uint8_t
+{
+  M5Begin,
+  WiFi,
+  LocalInit,
+  SrModel,
+  DisplayFirstFrame,
+  WebSocket,
+};
+
+class BootSequence
+{
+public:
+  static constexpr size_t kPhaseCount = static_cast<size_t>(BootPhase::WebSocket) + 1;
+
+  BootSequence() = default;
+
+  void start(BootPhase phase, uint32_t now);
+  // 2 回目以降の呼び出しは無視する（再接続で上書きしない）
+  void end(BootPhase phase, uint32_t now);
+  bool isDone(BootPhase phase) const;
+
+  // fn を別タスクで実行し、終わったら phase を完了にする。タスクを作れなければその場で実行する
+  void runAsync(BootPhase phase, const char *name, uint32_t stack_size, BaseType_t core, std::function<void()> fn);
+
+  // Idle に入る前に待つ並行フェーズが全て終わったか
+  bool isReady() const;
+
+  // Idle に入った時点で呼び、各フェーズの時間を 1 回だけログに出す
+  void finish(uint32_t now);
+  bool isFinished() const { return finished_; }
+
+private:
+  struct AsyncJob
+  {
+    BootSequence *owner = nullptr;
+    BootPhase phase = BootPhase::M5Begin;
+    std::function<void()> fn;
+  };
+
+  static void taskEntry(void *arg);
+  static void runJob(AsyncJob &job);
+  static uint32_t bit(BootPhase phase) { return 1u << static_cast<uint8_t>(phase); }
+
+  std::array<uint32_t, kPhaseCount> start_ms_{};
+  std::array<uint32_t, kPhaseCount> end_ms_{};
+  // 並行タスクから立てるので atomic にし、end_ms_ の書き込みもこれで公開する
+  std::atomic<uint32_t> done_{0};
+  std::array<AsyncJob, kPhaseCount> jobs_{};
+  bool finished_ = false;
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <FS.h>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "protocols.hpp"
+
+// よく使うフレーズ（あいさつ・相づち・考え中のつなぎ）の TTS 音声を flash に保持する LRU キャッシュ
+//  - LittleFS（パーティション spiffs）の /clips/<clip_id>.pcm に PCM16LE で保存する
+//  - clip_id はサーバーが計算する内容ハッシュ。索引（形式・サイズ・最終使用順）は /clips/index
+//  - 容量を超える分は、最後に再生してから最も時間が経ったクリップから消す
+class ClipCache
+{
+public:
+  struct ClipInfo
+  {
+    uint32_t sample_rate = 0;
+    uint16_t channels = 1;
+    uint32_t bytes = 0;
+  };
+
+  // 保存できるクリップの数。ClipEvt（Inventory・Evicted）の clip_id もこれ以下
+  static constexpr size_t kMaxEntries = 64;
+
+  ClipCache() = default;
+
+  // LittleFS をマウントして索引を読む（setup から 1 回呼ぶ）
+  // 未フォーマットの場合は起動を待たせないよう、最初の保存時にフォーマットする
+  void init();
+
+  // 再生用に開く。見つかれば最終使用順を更新して true
+  bool openForPlayback(uint32_t clip_id, ClipInfo &info);
+
+  // 開いたクリップの続きを最大 len バイト読む。読み終えたら閉じる
+  size_t read(uint8_t *dst, size_t len);
+
+  // ClipData の受信。accept=false（Idle 以外）のときは保存せずに StoreFailed を返す
+  void handleClipData(const WsHeader &hdr, const uint8_t *body, size_t len, bool accept);
+
+  // 受信途中の保存を取り消す（Idle を出た・切断した）
+  void abortStore();
+
+  // 保存済みクリップの一覧をサーバーに伝える（WebSocket 接続時）
+  void reportInventory();
+
+  // 再生で更新した最終使用順を書き出す（Idle に入った時に呼ぶ。再生直前の書き込みを避ける）
+  void flushIndex();
+
+  // ClipEvt の送信先
+  void setResultCallback(std::function<void(ClipStatus status, const uint32_t *clip_ids, size_t count)> cb);
+
+private:
+  struct Entry
+  {
+    uint32_t clip_id = 0;
+    uint32_t sample_rate = 0;
+    uint16_t channels = 1;
+    uint32_t bytes = 0;
+    uint32_t last_used = 0; // 大きいほど最近使った
+  };
+
+  bool ensureMounted();
+  void loadIndex();
+  bool saveIndex();
+  Entry *find(uint32_t clip_id);
+  bool makeRoom(uint32_t bytes, uint32_t replacing_id);
+  void removeEntry(size_t index);
+  void failStore(const char *reason);
+  void report(ClipStatus status, uint32_t clip_id);
+
+  bool mounted_ = false;
+  bool formatted_ = false;
+  std::vector<Entry> entries_{}; // init() で kMaxEntries 分を確保しておく（以後は伸ばさない）
+  uint32_t used_bytes_ = 0;
+  uint32_t use_counter_ = 0;
+  bool index_dirty_ = false;
+
+  File play_file_{};
+  uint32_t play_clip_id_ = 0;
+  bool playing_ = false;
+
+  File store_file_{};
+  Entry store_entry_{};
+  uint32_t store_received_ = 0;
+  bool storing_ = false;
+
+  std::function<void(ClipStatus, const uint32_t *, size_t)> on_result_{};
+};
@@ -5,3 +5,37 @@
 #define SERVER_HOST_H "192.168.1.179"   // 例: サーバのIP
 #define SERVER_PORT_H 8000              // 例: FastAPIのポート
 #define SERVER_PATH_H "/ws/stackchan"      // WebSocketパス
+
+// 会話モード: 再生後、ウェイクワードなしで続きの発話を待つ時間（ms。5000 程度）。0 で無効
+#define FOLLOW_UP_WINDOW_MS_H 0
+
+// ウェイクワード直後のローカルコマンド（止めて / 音量 / 首振り）。1 で有効
+// MultiNet（英語）を含む srmodels.bin が必要。misc/ESP_SR の同梱モデルはウェイクワードのみ
+#define LOCAL_COMMANDS_H 0
+
+// 2 マイク（L/R）で録音し、固定ビームフォーマ（遅延和）でウェイクワードと送信の前に 1 チャンネルにまとめる。1 で有効
+// 0 でも DOA_TRACKING_H を有効にした場合は 2 マイクで録音し、正面向き（MIC_BEAM_STEER_DEG_H=0 と同じ）でまとめる
+// MIC_SPACING_MM_H は実機のマイク間隔、MIC_BEAM_STEER_DEG_H は狙う方向（0 が正面、正は R マイク側）
+#define MIC_BEAMFORMING_H 0
+#define MIC_SPACING_MM_H 46.0f
+#define MIC_BEAM_STEER_DEG_H 0.0f
+
+// 2 マイクの到来方向推定（GCC-PHAT）で、ウェイクワードと Listening 中の発話の方へ首（X 軸）を向ける。1 で有効
+// 首が話者と逆に回る場合は DOA_PAN_INVERT_H を 1 にする
+#define DOA_TRACKING_H 0
+#define DOA_PAN_INVERT_H 0
+
+// 送信前の前処理（直流除去・雑音抑圧・AGC）。小さい声を持ち上げ、大きい声の飽和を抑える。1 で有効（0 は録音したまま送る）
+#define UPLINK_FRONTEND_H 0
+
+// 送信する DATA の長さを自動で変える。サーバーがストリーミング認識中で回線が空いていれば 20 ms ごとに送り、
+// 送信の詰まり・ack の遅れ・電波の悪化（RSSI < -75 dBm）で 125 ms まで伸ばす。1 で有効（0 は 125 ms 固定）
+#define UPLINK_ADAPTIVE_CHUNK_H 0
+
+// PCM（256 kbit/s）の代わりに 80 バンドの対数メル特徴量（64 kbit/s）を送る。1 で有効
+// サーバーの recognizer が特徴量を受け付けるもの（WhisperLogMelSpeechToText など）である必要がある
+#define UPLINK_LOG_MEL_H 0
+
+// WebSocket の送受信（ヘッダ・payload・μs の時刻）を PSRAM に記録し、Idle の間にサーバーへ送る。記録に使う KiB。0 で無効
+// サーバーは capture_dir（STACKCHAN_WS_CAPTURE_DIR）を設定したときだけ保存する。misc/replay で再生できる
+#define WS_CAPTURE_KB_H 0
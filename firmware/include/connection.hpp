@@ -0,0 +1,63 @@
+#pragma once
+
+#include <WiFi.h>
+#include <atomic>
+#include <cstdint>
+#include "ws_client.hpp"
+
+// Wi-Fi と WebSocket の接続管理
+//  - 前回の BSSID/チャンネルを NVS に保存し、次回はスキャンを省いて接続する
+//    IP は毎回 DHCP で取る（前回のリースを固定 IP にすると、期限切れ後に他の機器と衝突しても気づけない）
+//  - Wi-Fi の接続は非同期に開始し、setup の残り（ESP-SR・表示）と並行して進める
+//  - Wi-Fi のイベントで WebSocket の切断・即時再接続を駆動する
+class ConnectionManager
+{
+public:
+  explicit ConnectionManager(WsClient &ws) : ws_(ws) {}
+
+  // Wi-Fi の接続を開始してすぐ戻る（setup から 1 回呼ぶ）
+  void begin(const char *ssid, const char *password);
+
+  // Wi-Fi イベントの処理と高速接続のフォールバック判定（main loop から呼ぶ）
+  void loop(uint32_t now);
+  // Wi-Fi のイベントを待たずに次の loop() が必要になるまでの時間（高速接続のフォールバック判定）
+  uint32_t msUntilNextUpdate(uint32_t now) const;
+
+  // WebSocket の接続・切断の通知。再接続にかかった時間を記録する
+  void onWsConnected();
+  void onWsDisconnected();
+
+  // 最初に IP を取得した時刻（ms）。未取得なら 0
+  uint32_t firstWiFiUpMs() const { return first_wifi_up_ms_; }
+
+private:
+  // NVS に保存する前回の接続先
+  struct LinkCache
+  {
+    uint8_t version;
+    char ssid[33];
+    uint8_t bssid[6];
+    uint8_t channel;
+  };
+
+  void handleWiFiEvent(arduino_event_id_t event, arduino_event_info_t info);
+  bool loadCache(LinkCache &cache);
+  void saveCache();
+  void beginFullConnect();
+
+  WsClient &ws_;
+  const char *ssid_ = nullptr;
+  const char *password_ = nullptr;
+
+  // Wi-Fi イベントは別タスクから届くので、フラグだけ立てて loop() で処理する
+  std::atomic<bool> got_ip_{false};
+  std::atomic<bool> link_lost_{false};
+  std::atomic<uint8_t> disconnect_reason_{0};
+
+  bool fast_connecting_ = false;
+  uint32_t fast_connect_start_ms_ = 0;
+  bool wifi_up_ = false;
+  uint32_t first_wifi_up_ms_ = 0;
+  uint32_t drop_ms_ = 0;
+  bool drop_was_wifi_ = false;
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// 書式化と UART 出力を loop() から外すログ（dlog_e / dlog_w / dlog_i / dlog_d）
+//  - 呼び出し箇所（書式・ファイル・行）へのポインタと引数の生の値だけをキューに積み、
+//    core 0 の低優先度タスクが書式化して log_printf で出す。出力の形式と時刻（積んだ時点）は log_* と同じ
+//  - キューが一杯なら待たずに捨て、件数をあとで 1 行で出す
+//  - 引数は整数・列挙・float・ポインタのみ（各 32 bit）。%s の文字列は出力まで残るもの（リテラルや静的な表）に限る
+//  - 落ちる直前のログは出ないことがあるので、エラーや 1 回きりのログは従来どおり log_* を使う
+//  - DEFERRED_LOG=0 でビルドすると、すべて log_* にそのまま置き換わる
+#ifndef DEFERRED_LOG
+#if defined(ARDUINO)
+#define DEFERRED_LOG 1
+#else
+#define DEFERRED_LOG 0
+#endif
+#endif
+
+namespace deferred_log
+{
+constexpr size_t kMaxArgs = 12;
+using Slot = uintptr_t;
+
+// 呼び出し箇所ごとに 1 つ。書式の代わりにこのアドレスを積む
+struct Site
+{
+  char level; // 'E' / 'W' / 'I' / 'D'
+  const char *format;
+  const char *file;
+  uint16_t line;
+  const char *function;
+};
+
+struct Record
+{
+  const Site *site;
+  uint32_t ms; // 積んだ時刻（millis）
+  uint8_t count;
+  Slot args[kMaxArgs];
+};
+
+// キューと出力タスクを作る。それまでに積まれたログはその場で出す
+void init();
+// 積めずに捨てた件数（起動から）
+uint32_t dropped();
+// 記録を 1 行に書式化する（末尾の改行なし）。書き込んだ長さを返す
+size_t format(const Record &record, char *out, size_t out_len);
+
+void push(const Site &site, const Slot *args, size_t count);
+
+template <typename T>
+Slot toSlot(T value)
+{
+  static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value,
+                "dlog arguments must be integers, enums, floats or pointers");
+  if constexpr (std::is_floating_point<T>::value)
+  {
+    // %f などは float として書式化する
+    union
+    {
+      float f;
+      uint32_t u;
+    } bits{static_cast<float>(value)};
+    return bits.u;
+  }
+  else if constexpr (std::is_pointer<T>::value)
+  {
+    return reinterpret_cast<Slot>(value);
+  }
+  else if constexpr (std::is_enum<T>::value)
+  {
+    return static_cast<Slot>(static_cast<typename std::underlying_type<T>::type>(value));
+  }
+  else if constexpr (std::is_signed<T>::value)
+  {
+    return static_cast<Slot>(static_cast<intptr_t>(value));
+  }
+  else
+  {
+    return static_cast<Slot>(value);
+  }
+}
+
+template <typename... Args>
+void write(const Site &site, Args... args)
+{
+  static_assert(sizeof...(Args) <= kMaxArgs, "too many dlog arguments");
+  const Slot slots[sizeof...(Args) + 1] = {toSlot(args)..., 0};
+  push(site, slots, sizeof...(Args));
+}
+
+// 書式と引数の食い違いをコンパイル時に警告させるためだけの宣言（呼ばれない）
+inline void checkFormat(const char *, ...) __attribute__((format(printf, 1, 2)));
+inline void checkFormat(const char *, ...) {}
+} // namespace deferred_log
+
+#if DEFERRED_LOG
+#define DLOG_AT(level, fmt, ...)                                                                   \
+  do                                                                                               \
+  {                                                                                                \
+    static const deferred_log::Site dlog_site_{level, fmt, __FILE__, __LINE__, __func__};          \
+    if (false)                                                                                     \
+    {                                                                                              \
+      deferred_log::checkFormat(fmt, ##__VA_ARGS__);                                               \
+    }                                                                                              \
+    deferred_log::write(dlog_site_, ##__VA_ARGS__);                                                \
+  } while (0)
+
+#if defined(CORE_DEBUG_LEVEL) && CORE_DEBUG_LEVEL >= 1
+#define dlog_e(fmt, ...) DLOG_AT('E', fmt, ##__VA_ARGS__)
+#else
+#define dlog_e(fmt, ...) ((void)0)
+#endif
+#if defined(CORE_DEBUG_LEVEL) && CORE_DEBUG_LEVEL >= 2
+#define dlog_w(fmt, ...) DLOG_AT('W', fmt, ##__VA_ARGS__)
+#else
+#define dlog_w(fmt, ...) ((void)0)
+#endif
+#if defined(CORE_DEBUG_LEVEL) && CORE_DEBUG_LEVEL >= 3
+#define dlog_i(fmt, ...) DLOG_AT('I', fmt, ##__VA_ARGS__)
+#else
+#define dlog_i(fmt, ...) ((void)0)
+#endif
+#if defined(CORE_DEBUG_LEVEL) && CORE_DEBUG_LEVEL >= 4
+#define dlog_d(fmt, ...) DLOG_AT('D', fmt, ##__VA_ARGS__)
+#else
+#define dlog_d(fmt, ...) ((void)0)
+#endif
+#else
+#define dlog_e log_e
+#define dlog_w log_w
+#define dlog_i log_i
+#define dlog_d log_d
+#endif
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <M5Unified.h>
+#include "mailbox.hpp"
 #include "state_machine.hpp"
 
 class Display
@@ -8,14 +12,85 @@ class Display
 public:
   explicit Display(StateMachine &stateMachine);
 
+  // 初期画面を描画し、描画タスクを別コアで起動する
   void init();
+
+  // 現在のステートと口の開き具合を描画タスクへ渡す（SPI 転送を待たない）
   void loop();
 
+  // 口の開き具合（0-100）。Speaking 中に再生音量から設定する
+  void setMouthLevel(uint8_t level) { mouth_level_ = level; }
+
 private:
-  void drawForState(StateMachine::State state);
-  void drawFace();
+  // 描画タスクに渡す不変の描画コマンド
+  struct RenderCommand
+  {
+    StateMachine::State state = StateMachine::Disconnected;
+    uint8_t mouth_level = 0;
+  };
+
+  struct Rect
+  {
+    int16_t x = 0;
+    int16_t y = 0;
+    int16_t w = 0;
+    int16_t h = 0;
+  };
+
+  // 1 フレームで描画する顔のパラメータ（0-100）
+  struct FaceParams
+  {
+    uint8_t eye_open = 100;
+    uint8_t mouth_open = 0;
+  };
+
+  // フレーム時間のヒストグラム（上限 ms）。最後のバケットはそれ以上
+  static constexpr std::array<uint32_t, 6> kFrameHistogramBoundsMs = {1, 2, 4, 8, 16, 33};
+  struct FrameStats
+  {
+    uint32_t frames = 0;
+    uint32_t total_us = 0;
+    uint32_t max_us = 0;
+    uint32_t spi_bytes = 0;
+    std::array<uint32_t, kFrameHistogramBoundsMs.size() + 1> histogram{};
+  };
+
+  static void taskEntry(void *arg);
+  void taskLoop();
+  void renderFrame(uint32_t now);
+  LovyanGFX &target();
+  void updateAnimation(const RenderCommand &command, uint32_t now);
+  void drawStatusLayer(StateMachine::State state);
+  void drawEyesLayer(uint8_t eye_open);
+  void drawMouthLayer(uint8_t mouth_open);
+  void markDirty(const Rect &rect);
+  size_t flushDirty();
+  void recordFrame(uint32_t elapsed_us, size_t spi_bytes);
+  void logStats(uint32_t now);
 
   StateMachine &state_;
+  M5Canvas canvas_;
+  bool canvas_ready_ = false;
+
+  TaskHandle_t task_ = nullptr;
+  Mailbox<RenderCommand> mailbox_{};
+  RenderCommand command_{};
+  uint8_t mouth_level_ = 0;
+
   bool has_prev_state_ = false;
   StateMachine::State prev_state_ = StateMachine::Idle;
+  FaceParams face_{};
+  FaceParams drawn_face_{};
+
+  static constexpr size_t kMaxDirtyRects = 4;
+  std::array<Rect, kMaxDirtyRects> dirty_{};
+  size_t dirty_count_ = 0;
+
+  uint32_t last_frame_ms_ = 0;
+  uint32_t next_blink_ms_ = 0;
+  uint32_t blink_start_ms_ = 0;
+  bool blinking_ = false;
+
+  FrameStats stats_{};
+  uint32_t last_stats_log_ms_ = 0;
 };
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "fft.hpp"
+
+// 2 マイクの到来方向推定（GCC-PHAT）
+//  - L/R を 1 回の複素 FFT（L + jR）で変換し、振幅で正規化した相互スペクトルを発話区間だけ平滑化する
+//  - 相関のピークは IFFT ではなく、角度の格子ごとに遅延を掛けた相互スペクトルの和（SRP）で探す
+//    マイク間の遅延は ±数サンプルしかないので、この方が小数サンプルの分解能が安く得られる
+//  - 角度の符号は Beamformer と同じ（0 が正面、正は R マイク側）
+class DoaEstimator
+{
+public:
+  struct Estimate
+  {
+    float angle_deg = 0.0f;
+    float confidence = 0.0f; // 0〜1。全帯域の位相が揃うほど 1 に近い
+    uint32_t at_ms = 0;
+  };
+
+  static constexpr size_t kFftSize = 256; // 16kHz で 16 ms
+
+  DoaEstimator() = default;
+
+  void configure(int sample_rate, float mic_spacing_mm);
+
+  // 平滑化した相互スペクトルと推定結果を捨てる（首を動かした後など）
+  void reset();
+
+  // L/R 交互の frames フレームを入れる。kFftSize 溜まるごとに処理する
+  void process(const int16_t *interleaved, size_t frames, uint32_t now_ms);
+
+  // 前回取り出した後に新しい推定があれば true
+  bool take(Estimate &estimate);
+
+private:
+  static constexpr size_t kBins = kFftSize / 2;
+  static constexpr int kAngleStepDeg = 2;
+  static constexpr size_t kAngles = 180 / kAngleStepDeg + 1; // -90〜+90
+
+  void processBlock(uint32_t now_ms);
+  bool isVoiced();
+  void accumulateCrossSpectrum();
+  void estimate(uint32_t now_ms);
+
+  bool configured_ = false;
+  size_t bin_lo_ = 0;
+  size_t bin_hi_ = 0; // [bin_lo_, bin_hi_) を使う。上限は空間エイリアシングが起きない周波数
+
+  ComplexFft<kFftSize> fft_{};
+  std::array<float, kFftSize> window_{};
+  std::array<float, kAngles> angle_step_re_{}; // 角度ごとの 1 ビンあたりの位相回転
+  std::array<float, kAngles> angle_step_im_{};
+  std::array<float, kAngles> angle_start_re_{}; // bin_lo_ での位相
+  std::array<float, kAngles> angle_start_im_{};
+
+  std::array<int16_t, kFftSize * 2> pending_{};
+  size_t pending_frames_ = 0;
+
+  std::array<float, kFftSize> fft_re_{};
+  std::array<float, kFftSize> fft_im_{};
+  std::array<float, kBins> cross_re_{};
+  std::array<float, kBins> cross_im_{};
+
+  float noise_floor_ = 0.0f;
+  uint32_t voiced_blocks_ = 0;
+  Estimate latest_{};
+  bool fresh_ = false;
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+
+// 長さ N（2 のべき乗）の複素 FFT（基数 2、in-place、float）
+//  - ESP32-S3 は単精度 FPU を持つので、固定小数点にするより float の方が速くて簡単
+//  - 回転因子は init() で 1 回だけ求める
+template <size_t N>
+class ComplexFft
+{
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "FFT size must be a power of two");
+
+public:
+  void init()
+  {
+    constexpr float kPi = 3.14159265f;
+    for (size_t i = 0; i < N / 2; ++i)
+    {
+      float phase = 2.0f * kPi * static_cast<float>(i) / static_cast<float>(N);
+      twiddle_re_[i] = std::cos(phase);
+      twiddle_im_[i] = -std::sin(phase);
+    }
+  }
+
+  void forward(float *re, float *im) const { transform(re, im); }
+
+  // 逆変換（1/N のスケーリング込み）。conj(FFT(conj(x))) / N で求める
+  void inverse(float *re, float *im) const
+  {
+    for (size_t i = 0; i < N; ++i)
+    {
+      im[i] = -im[i];
+    }
+    transform(re, im);
+    constexpr float kScale = 1.0f / static_cast<float>(N);
+    for (size_t i = 0; i < N; ++i)
+    {
+      re[i] *= kScale;
+      im[i] *= -kScale;
+    }
+  }
+
+private:
+  void transform(float *re, float *im) const
+  {
+    for (size_t i = 1, j = 0; i < N; ++i)
+    {
+      size_t bit = N >> 1;
+      for (; j & bit; bit >>= 1)
+      {
+        j ^= bit;
+      }
+      j ^= bit;
+      if (i < j)
+      {
+        std::swap(re[i], re[j]);
+        std::swap(im[i], im[j]);
+      }
+    }
+    for (size_t len = 2; len <= N; len <<= 1)
+    {
+      size_t half = len / 2;
+      size_t stride = N / len;
+      for (size_t i = 0; i < N; i += len)
+      {
+        for (size_t k = 0; k < half; ++k)
+        {
+          float wr = twiddle_re_[k * stride];
+          float wi = twiddle_im_[k * stride];
+          size_t a = i + k;
+          size_t b = a + half;
+          float xr = re[b] * wr - im[b] * wi;
+          float xi = re[b] * wi + im[b] * wr;
+          re[b] = re[a] - xr;
+          im[b] = im[a] - xi;
+          re[a] += xr;
+          im[a] += xi;
+        }
+      }
+    }
+  }
+
+  std::array<float, N / 2> twiddle_re_{};
+  std::array<float, N / 2> twiddle_im_{};
+};
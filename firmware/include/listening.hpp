@@ -1,21 +1,40 @@
 #pragma once
 
+#include <array>
 #include <cstddef>
 #include <cstdint>
-#include <WebSocketsClient.h>
+#include <functional>
+#include <utility>
+#include "ws_client.hpp"
+#include "mic_frontend.hpp"
+#include "uplink_frontend.hpp"
+#include "log_mel.hpp"
 #include <M5Unified.h>
+#include "memory_plan.hpp"
 #include "protocols.hpp"
 #include "state_machine.hpp"
 
 class Listening
 {
 public:
-  Listening(WebSocketsClient &ws, StateMachine &sm, int sampleRate);
+  Listening(WsClient &ws, StateMachine &sm, MicFrontEnd &mic, int sampleRate);
+
+  // kMemoryPlan の Listening の予算。スプールは PSRAM、DATA の送信用バッファは内部 RAM
+  static constexpr size_t psramBytes(int sampleRate)
+  {
+    return memory_plan::padded(static_cast<size_t>(sampleRate) * kSpoolSeconds * sizeof(int16_t));
+  }
+  static constexpr size_t internalBytes(int sampleRate)
+  {
+    return memory_plan::padded(maxChunkSamples(sampleRate) * sizeof(int16_t)) +
+           memory_plan::padded(sizeof(WsHeader) + maxChunkSamples(sampleRate) * sizeof(int16_t));
+  }
 
   // allocate buffers / reset counters; call once from setup
   void init();
 
   // Listening ステートに入る/出る際の処理
+  // 送信中に WebSocket が切れた場合、end() は録音を止めずにセッションを保留する
   void begin();
   void end();
 
@@ -25,37 +44,156 @@ public:
   // stop streaming (flush remaining DATA and send END)
   bool stopStreaming();
 
+  // ローカルコマンドで処理したターンの送信を取り消す（未送信分は捨て、END に kWsFlagCancel を付ける）
+  bool cancelStreaming();
+
+  // 送信前の前処理（HPF・雑音抑圧・AGC）を使うか。false なら録音したまま送る
+  void enableUplinkFrontEnd(bool enabled) { uplink_.setBypass(!enabled); }
+
+  // PCM の代わりに対数メル特徴量（AudioLogMel）を送る。init() より前に呼ぶ
+  // サーバー側に特徴量を受け付ける recognizer が必要
+  void enableLogMelUplink(bool enabled);
+
+  // DATA の長さを回線とサーバーに合わせて変えるか。false なら 125 ms 固定
+  // サーバーがストリーミング認識中で回線が空いていれば 20 ms まで縮め、送信の詰まりや電波の悪化で伸ばす
+  void enableAdaptiveChunks(bool enabled) { adaptive_chunks_ = enabled; }
+
+  // 現在の DATA の長さ（ms）
+  uint32_t getChunkMs() const;
+
+  // 録音した PCM を受け取るコールバック（コマンド待ちの間の SR への供給用）
+  void setCaptureCallback(std::function<void(const int16_t *, size_t)> cb) { on_capture_ = std::move(cb); }
+
   // perform recording and periodic DATA sends; handles errors/silence internally
+  // 保留中（Disconnected）も呼び、スプールへの録音を続ける
   void loop();
 
+  // 保留中のセッションを再接続後に再開できるか
+  bool canResume() const;
+
+  // 次の begin() を、発話を検知してから送信を始める待機（会話モード）にする
+  // window_ms 以内に発話が無ければ ListenFinished で Idle に戻る
+  void armFollowUp(uint32_t window_ms);
+
+  // 発話待ちの間、サーバーから Listening 指示が来たら待たずに送信を始める
+  bool isAwaitingSpeech() const { return awaiting_speech_; }
+  bool startAwaitedStream();
+
+  // サーバーからの AudioPcmAck。確認済みの DATA をスプールから解放する
+  void handleAck(const uint8_t *body, size_t bodyLen);
+
   // 最近の平均音量（絶対値平均）を取得
   int32_t getLastLevel() const { return last_level_; }
 
+  // リングバッファが溢れて捨てたサンプル数（送信が録音に追いつかなかった量）
+  uint32_t getOverrunSamples() const { return overrun_samples_; }
+
   // 無音が所定時間続いているか判定
   bool shouldStopForSilence() const;
 
 private:
+  // 送信済みでサーバーの確認を待っている DATA
+  struct SentChunk
+  {
+    uint16_t seq;
+    uint16_t samples;
+  };
+
+  bool openSession(uint8_t flags);
+  bool resumeStreaming();
+  void loopAwaitingSpeech();
+  void abandonSuspended();
+  bool sendChunk(size_t samples);
+  void adaptChunkSize();
+  void setChunkLevel(size_t level, const char *reason);
+  bool retransmitUnacked();
+  void releaseOldestSent();
   void updateLevelStats(const int16_t *samples, size_t sampleCount);
-  bool sendPacket(MessageType type, const int16_t *samples, size_t sampleCount);
+  bool sendPacket(MessageType type, uint16_t seq, uint8_t flags, const void *payload, size_t bytes);
   void ringPush(const int16_t *src, size_t samples);
-  size_t ringPop(int16_t *dst, size_t samples);
+  void ringCopy(size_t pos, int16_t *dst, size_t samples) const;
+  void resetSpool();
 
-  WebSocketsClient &ws_;
+  WsClient &ws_;
   StateMachine &state_;
+  MicFrontEnd &mic_;
+
+  size_t unitsForMs(uint32_t ms) const;
+  // 最も長い DATA（kSlowestChunkLevel の PCM。対数メルの方が小さい）の int16 の数
+  static constexpr size_t maxChunkSamples(int sampleRate)
+  {
+    return static_cast<size_t>(sampleRate) * kChunkMsLevels[kSlowestChunkLevel] / 1000;
+  }
 
   const int sample_rate_;
-  const size_t chunk_samples_;
+  // スプール・DATA・ack の単位は int16。PCM なら 1 サンプル、対数メルなら 1 フレームが kLogMelFrameUnits
+  size_t chunk_samples_;
   const size_t mic_read_samples_ = 256;
   const size_t ring_capacity_samples_;
+  const size_t max_chunk_samples_;
+
+  // DATA の送信用（起動時に memory_plan から切り出す）。スプールから send_buf_ に並べ、packet_ でヘッダを付けて送る
+  int16_t *send_buf_ = nullptr;
+  uint8_t *packet_ = nullptr;
 
+  // スプール（PSRAM）: [確認待ち unacked_samples_][未送信 ring_available_] の順に並ぶ
   int16_t *ring_buffer_ = nullptr;
   size_t ring_write_ = 0;
   size_t ring_read_ = 0;
   size_t ring_available_ = 0;
+  size_t unacked_samples_ = 0;
+  uint32_t overrun_samples_ = 0;
 
+  static constexpr size_t kMaxSentChunks = 256; // 20 ms の DATA でも約 5 秒分
+  std::array<SentChunk, kMaxSentChunks> sent_{};
+  size_t sent_head_ = 0;
+  size_t sent_count_ = 0;
+  uint32_t unacked_dropped_samples_ = 0;
+
+  uint32_t session_id_ = 0;
   uint16_t seq_counter_ = 0;
   bool streaming_ = false;
+  bool suspended_ = false;
+  uint32_t suspended_since_ms_ = 0;
   bool events_registered_ = false;
+  std::function<void(const int16_t *, size_t)> on_capture_{};
+  UplinkFrontEnd uplink_{};
+  bool log_mel_ = false;
+  LogMelExtractor log_mel_extractor_{};
+  static constexpr size_t kLogMelFrameUnits = LogMelExtractor::kFrameBytes / sizeof(int16_t);
+
+  // 切断中も録音を続けるスプールの長さ。再接続までの保留上限より長くとる
+  static constexpr size_t kSpoolSeconds = 10;
+
+  // DATA の長さの自動調整。0 段目がストリーミング認識向けの最短、最後の段が固定のときの長さ
+  static constexpr std::array<uint16_t, 4> kChunkMsLevels = {20, 40, 80, 125};
+  static constexpr size_t kSlowestChunkLevel = kChunkMsLevels.size() - 1;
+  bool adaptive_chunks_ = false;
+  size_t chunk_level_ = kSlowestChunkLevel;
+  uint32_t chunk_changed_ms_ = 0;
+  bool server_streaming_ = true;   // 最後の ack の kPcmAckFlagStreaming。分かるまでは短い DATA で始める
+  bool acked_ = false;             // このセッションで ack を受けたか（ack の遅れを詰まりとみなしてよいか）
+  uint32_t healthy_since_ms_ = 0;
+  uint32_t rssi_checked_ms_ = 0;
+  bool weak_signal_ = false;
+  uint32_t max_send_us_ = 0;       // 前回の調整以降で最も長くかかった sendBIN
+
+  // 送信の統計（stopStreaming でログに出す）
+  uint32_t stat_chunks_ = 0;
+  uint32_t stat_bytes_ = 0;
+  uint64_t stat_send_us_ = 0;
+  uint32_t stat_peak_send_us_ = 0;
+  uint32_t stat_level_changes_ = 0;
+  uint32_t stat_started_ms_ = 0;
+
+  // 会話モードの発話待ち
+  bool follow_up_requested_ = false;
+  uint32_t follow_up_window_ms_ = 0;
+  bool awaiting_speech_ = false;
+  uint32_t awaiting_since_ms_ = 0;
+  uint8_t speech_reads_ = 0;
+  static constexpr int32_t kSpeechOnsetLevel = 400;  // 無音判定より高め（再生の残響で誤検知しない）
+  static constexpr uint8_t kSpeechOnsetReads = 3;     // 連続してこの回数（約 48 ms）超えたら発話とみなす
 
   // 無音判定関連
   int32_t last_level_ = 0;
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ESP_SR_M5Unified.h>
+#include "protocols.hpp"
+
+// ウェイクワード直後に ESP-SR（MultiNet）で認識し、サーバーを介さずに処理するコマンド
+//  - フレーズ表は local_commands.cpp の kLocalCommandPhrases で設定する（command_id = LocalCommand）
+//  - 1 つのコマンドに複数のフレーズを割り当てられる
+
+// MultiNet に登録するフレーズ表
+extern const sr_cmd_t kLocalCommandPhrases[];
+extern const size_t kLocalCommandPhraseCount;
+
+const char *localCommandToString(LocalCommand command);
+
+// コマンドに対応する首振り（ServoCmd と同じ payload 形式）。無ければ false
+bool localCommandGesture(LocalCommand command, const uint8_t *&payload, size_t &payload_len);
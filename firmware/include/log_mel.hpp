@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "fft.hpp"
+
+// 16kHz PCM から 80 バンドの対数メルスペクトルを求める（AudioLogMel の送信用）
+//  - 窓 25 ms（400 サンプル、Hann）、ホップ 10 ms（160 サンプル）、512 点 FFT（ゼロ詰め）
+//  - メルフィルタは Slaney 型（0〜8 kHz、面積で正規化）。Whisper の log_mel_spectrogram と同じ定義
+//  - 1 フレームは 80 バイト。各バンドの値は q = round(4 * log2(パワー))（int16 の振幅のまま、0〜255 に丸める）
+//    Whisper の log10 メルは (q / 4 - 30) * log10(2) で戻せる（-1〜1 に正規化した振幅のパワーは 2^-30 倍）
+class LogMelExtractor
+{
+public:
+  static constexpr size_t kBands = 80;
+  static constexpr size_t kWindowSamples = 400;
+  static constexpr size_t kHopSamples = 160;
+  static constexpr size_t kFrameBytes = kBands;
+
+  LogMelExtractor() = default;
+
+  // 窓・メルフィルタ・FFT の係数を求める（1 回）
+  void init(int sample_rate);
+
+  // 窓の途中のサンプルを捨てる（セッションの開始時）
+  void reset();
+
+  // count サンプルを入れ、できたフレームを out に書く（最大 max_frames）。書いたフレーム数を返す
+  size_t push(const int16_t *samples, size_t count, uint8_t *out, size_t max_frames);
+
+  // 前回のログからのフレーム数と処理時間を 1 行で出す
+  void logStats();
+
+private:
+  static constexpr size_t kFftSize = 512;
+  static constexpr size_t kHalfFft = kFftSize / 2;
+  static constexpr size_t kSpectrumBins = kHalfFft + 1;
+  static constexpr size_t kMaxFilterWeights = 2 * kSpectrumBins; // 1 つのビンは隣り合う 2 バンドにしか入らない
+
+  struct MelBand
+  {
+    uint16_t first_bin;
+    uint16_t bin_count;
+    uint16_t weight_offset;
+  };
+
+  void computeFrame(uint8_t *out);
+
+  bool initialized_ = false;
+
+  // 実信号 512 点を 256 点の複素 FFT で変換する（偶数番目を実部、奇数番目を虚部に詰める）
+  ComplexFft<kHalfFft> fft_{};
+  std::array<float, kHalfFft> split_re_{}; // e^{-j2πk/512}（分解の回転因子）
+  std::array<float, kHalfFft> split_im_{};
+  std::array<float, kWindowSamples> window_{};
+  std::array<MelBand, kBands> bands_{};
+  std::array<float, kMaxFilterWeights> weights_{};
+
+  std::array<int16_t, kWindowSamples> history_{};
+  size_t filled_ = 0;
+
+  std::array<float, kHalfFft> fft_re_{};
+  std::array<float, kHalfFft> fft_im_{};
+  std::array<float, kSpectrumBins> power_{};
+
+  uint32_t stat_frames_ = 0;
+  uint32_t stat_cycles_total_ = 0;
+  uint32_t stat_cycles_max_ = 0;
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+
+// loop() の待機と、それを打ち切る合図
+//  - loop() は次の期限（サーボ・再生・ハートビート・再接続など）まで wait() でブロックする
+//  - 別タスクで起きる出来事は notify() で待機を打ち切る（ESP-SR の認識結果・Wi-Fi のイベント）
+//  - ソケットの受信は WiFiClient にコールバックが無いので、core 0 の監視タスクが select() で待って合図する
+//  - マイクを読むステート（Idle・Listening）は M5.Mic.record が I2S の DMA を待つので、wait() を使わない
+namespace loop_wake
+{
+enum class Source : uint8_t
+{
+  SocketRx,
+  Speech, // ESP-SR のウェイクワード・コマンド
+  WiFi,
+};
+
+// イベントグループとソケットの監視タスクを作る（setup から 1 回呼ぶ）
+void init();
+// どのタスクからも呼べる。init() 前なら何もしない
+void notify(Source source);
+// 合図が来るか timeout_ms が経つまで待つ。socket_fd >= 0 ならその受信（と切断）でも起きる。
+// 起こした合図（1 << Source のビット和）を返す
+uint32_t wait(uint32_t timeout_ms, int socket_fd);
+} // namespace loop_wake
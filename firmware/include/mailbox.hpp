@@ -0,0 +1,42 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// 単一 producer / 単一 consumer の最新値メールボックス（トリプルバッファ）
+// publish() も consume() もブロックせず、consumer は常に最新の値だけを受け取る。
+template <typename T>
+class Mailbox
+{
+public:
+  // producer 側: 値を書き込んで公開する
+  void publish(const T &value)
+  {
+    slots_[write_index_] = value;
+    uint8_t prev = middle_.exchange(static_cast<uint8_t>(write_index_ | kFreshBit), std::memory_order_acq_rel);
+    write_index_ = prev & kIndexMask;
+  }
+
+  // consumer 側: 新しい値があれば out に取り出して true を返す
+  bool consume(T &out)
+  {
+    if ((middle_.load(std::memory_order_acquire) & kFreshBit) == 0)
+    {
+      return false;
+    }
+    uint8_t prev = middle_.exchange(read_index_, std::memory_order_acq_rel);
+    read_index_ = prev & kIndexMask;
+    out = slots_[read_index_];
+    return true;
+  }
+
+private:
+  static constexpr uint8_t kIndexMask = 0x03;
+  static constexpr uint8_t kFreshBit = 0x04;
+
+  std::array<T, 3> slots_{};
+  std::atomic<uint8_t> middle_{1};
+  uint8_t write_index_ = 0;
+  uint8_t read_index_ = 2;
+};
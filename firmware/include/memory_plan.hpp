@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 実行時に使うバッファの配分（起動後はヒープから確保しない）
+//  - 予算はモジュールごと・領域（内部 RAM / PSRAM）ごとに main.cpp の kMemoryPlan で宣言する
+//  - init() で領域ごとに合計を 1 回だけ確保し、各モジュールは init() などの起動処理で take() して切り出す
+//  - 起動が終わったら seal()。以後の take() は失敗する。予算と使用量はそのときに 1 回ログに出す
+//  - 1 KiB 未満で大きさの決まったもの（サーボのステップ、上り通知のパケットなど。loop() 以外からも呼ぶものはスタックに置く）は静的な配列で持つ
+//  - MEMORY_PLAN_TRAP=1 でビルドすると、seal() 後に loop() のタスクで operator new が呼ばれたら止める
+//    （abort のバックトレースで呼び出し元が分かる）。malloc を直接使う C のライブラリ（lwIP・I2S など）は対象外
+#ifndef MEMORY_PLAN_TRAP
+#define MEMORY_PLAN_TRAP 0
+#endif
+
+namespace memory_plan
+{
+enum class Region : uint8_t
+{
+  Internal,
+  Psram,
+};
+constexpr size_t kRegionCount = 2;
+
+enum class Module : uint8_t
+{
+  Listening,
+  Speaking,
+  WsClient,
+  WsCapture,
+  Trace,
+};
+constexpr size_t kModuleCount = 5;
+
+struct Budget
+{
+  Module module;
+  Region region;
+  size_t bytes;
+};
+
+// take() は 1 回ごとにこの境界に揃えて切り出す。予算はこれで切り上げた大きさの合計で書く
+constexpr size_t kAlign = 8;
+constexpr size_t padded(size_t bytes)
+{
+  return (bytes + kAlign - 1) / kAlign * kAlign;
+}
+
+// 計画の合計を領域ごとに確保する。setup() の最初に 1 回呼ぶ。確保できなかった領域からは take() できない
+void init(const Budget *plan, size_t count);
+template <size_t N>
+void init(const Budget (&plan)[N])
+{
+  init(plan, N);
+}
+
+// module の region の予算から bytes を切り出す。init() 前・seal() 後・予算不足なら nullptr（ログに出す）
+void *take(Module module, Region region, size_t bytes);
+
+// 起動の完了。使用量をログに出す（2 回目以降は何もしない）
+void seal();
+bool isSealed();
+
+// 確保した領域を返して init() 前に戻す（ws_replay で繰り返し流すため。端末では呼ばない）
+void release();
+
+// 接続やファイルを開くたびに new するライブラリ（WiFiClient・LittleFS の File）を呼ぶ間だけ、
+// MEMORY_PLAN_TRAP の対象から外す。loop() のタスクから使う
+class HeapScope
+{
+public:
+  HeapScope();
+  ~HeapScope();
+  HeapScope(const HeapScope &) = delete;
+  HeapScope &operator=(const HeapScope &) = delete;
+};
+} // namespace memory_plan
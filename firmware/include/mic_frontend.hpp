@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "beamformer.hpp"
+#include "doa_estimator.hpp"
+
+// マイク入力の前処理。WakeUpWord と Listening はここからモノラル PCM を読む
+//  - stereo=true のときは 2 マイクを L/R で録音し、Beamformer で 1 チャンネルにまとめる
+//  - stereo=false のときは M5.Mic.record をそのまま呼ぶ（従来どおり）
+//  - doa=true のときは同じ L/R から到来方向も推定する（stereo が必要）
+class MicFrontEnd
+{
+public:
+  struct Config
+  {
+    bool stereo = false;
+    int sample_rate = 16000;
+    float mic_spacing_mm = 0.0f;
+    float steer_deg = 0.0f;
+    bool doa = false;
+  };
+
+  MicFrontEnd() = default;
+
+  // setup から 1 回呼ぶ。M5.Mic.config() の stereo も同じ値にしておくこと
+  void init(const Config &config);
+
+  // 録音を再開するとき（M5.Mic.begin() の後）に呼ぶ。遅延線に前回の音が残らないようにする
+  void reset();
+
+  // モノラル samples サンプルを読む（最大 kMaxReadSamples）。M5.Mic.record が失敗したら false
+  bool read(int16_t *out, size_t samples);
+
+  bool isStereo() const { return config_.stereo; }
+
+  // 前回取り出した後に新しい到来方向の推定があれば true
+  bool takeDirection(DoaEstimator::Estimate &estimate) { return doa_.take(estimate); }
+
+  // 首を動かしたので、それまでの音での推定を捨てる
+  void resetDirection() { doa_.reset(); }
+
+  static constexpr size_t kMaxReadSamples = 256;
+
+private:
+  Config config_{};
+  Beamformer beamformer_{};
+  DoaEstimator doa_{};
+
+  // ビームフォーマと方向推定の処理時間（CPU サイクル）。一定間隔でログに出す
+  uint32_t cycles_total_ = 0;
+  uint32_t cycles_max_ = 0;
+  uint32_t doa_cycles_total_ = 0;
+  uint32_t doa_cycles_max_ = 0;
+  uint32_t blocks_ = 0;
+  uint32_t last_log_ms_ = 0;
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <esp_pm.h>
+
+// Idle 中の省電力制御
+//  - esp_pm による動的周波数制御（Idle 以外は最大クロックを保持）
+//  - Wi-Fi モデムスリープ（DTIM 単位で受信。WebSocket のハートビートとは両立する）
+//  - 無操作が続いたときのバックライト減光
+class PowerManager
+{
+public:
+  PowerManager() = default;
+
+  // esp_pm を構成し、最大クロックのロックを取得した状態で開始する（setup から 1 回呼ぶ）
+  void init();
+
+  // Idle ステートに入る/出る際の処理
+  void enterIdle();
+  void exitIdle();
+
+  // ウェイクワード検出時の高速復帰。サーバーからの Listening 指示を待たずにクロックと Wi-Fi を戻す。
+  // 一定時間内に Idle を出なければ loop() が省電力に戻す
+  // 状態は loop() のタスクだけが触るので、ESP-SR のタスクからは呼ばない（detected_us は検出した時刻）
+  void resumeFromWakeWord(uint32_t detected_us);
+
+  // 最初の uplink フレームを送った時点で呼び、ウェイクワードからの復帰時間を記録する
+  void markUplinkStarted();
+
+  // Idle 中の減光とウェイクワード復帰のタイムアウトの判定（main loop から呼ぶ）
+  void loop(uint32_t now);
+
+private:
+  void setActive(bool active);
+  void restoreBacklight();
+
+  esp_pm_lock_handle_t cpu_lock_ = nullptr;
+  bool pm_configured_ = false;
+  bool active_ = false;
+
+  bool idle_ = false;
+  uint32_t idle_since_ms_ = 0; // 減光までの起点（ウェイクワード復帰のタイムアウトで数え直す）
+  bool woken_ = false;         // Idle のままウェイクワードで最大クロックに戻している
+  uint32_t woken_ms_ = 0;
+
+  // Idle に入ってから省電力でいた時間
+  uint32_t idle_entered_ms_ = 0;
+  uint32_t low_power_since_ms_ = 0;
+  uint32_t low_power_ms_ = 0;
+  bool dimmed_ = false;
+  uint8_t normal_brightness_ = 0;
+
+  // ウェイクワード → 最初の uplink フレームまでの計測
+  uint32_t wake_detected_us_ = 0;
+  uint32_t wake_idle_ms_ = 0;
+  uint32_t wake_cpu_mhz_ = 0;
+};
@@ -7,7 +7,7 @@
 // Header layout (little-endian, packed):
 //  - kind: uint8_t   (message kind)
 //  - messageType: uint8_t  (START/DATA/END)
-//  - reserved: uint8_t (0, future flags)
+//  - reserved: uint8_t (flags, see kWsFlag*)
 //  - seq: uint16 (sequence number)
 //  - payloadBytes: uint16 (bytes following the header)
 
@@ -21,6 +21,16 @@ enum class MessageKind : uint8_t
 	SpeakDoneEvt = 6, // speaking completed event (client -> server)
 	ServoCmd = 7, // servo command sequence (server -> client)
 	ServoDoneEvt = 8, // servo sequence completed event (client -> server)
+	AudioCreditEvt = 9, // downlink playback buffer credit (client -> server)
+	AudioPcmAck = 10, // uplink DATA received up to seq (server -> client)
+	LocalCommandEvt = 11, // command recognised and handled on the device (client -> server)
+	ClipCmd = 12, // play a phrase clip from the device cache (server -> client)
+	ClipData = 13, // phrase clip PCM to store in the device cache (server -> client)
+	ClipEvt = 14, // phrase clip cache result/inventory (client -> server)
+	AudioLogMel = 15, // uplink log-mel feature frames, same framing as AudioPcm (client -> server)
+	CaptureData = 16, // WebSocket capture records uploaded while Idle (client -> server)
+	TraceCmd = 17, // request a dump of the trace ring (server -> client)
+	TraceData = 18, // trace ring dump (client -> server)
 };
 
 enum class MessageType : uint8_t
@@ -34,11 +44,171 @@ struct __attribute__((packed)) WsHeader
 {
 	uint8_t kind;        // MessageKind
 	uint8_t messageType; // MessageType
-	uint8_t reserved;    // 0 (flags/reserved)
+	uint8_t reserved;    // flags (kWsFlag*), 0 if none
 	uint16_t seq;        // sequence number
 	uint16_t payloadBytes; // bytes following the header
 };
 
+// WsHeader.reserved flags
+// AudioWav END: this segment is the last one of the utterance
+constexpr uint8_t kWsFlagEndOfUtterance = 0x01;
+// AudioPcm START: resume the session given in the payload after a reconnect
+constexpr uint8_t kWsFlagResume = 0x02;
+// AudioPcm START: follow-up utterance detected after playback without a wake word
+constexpr uint8_t kWsFlagFollowUp = 0x04;
+// AudioPcm END: discard the uplink (the turn was handled by a local command)
+constexpr uint8_t kWsFlagCancel = 0x08;
+
+// payload for kind=AudioPcm, messageType=START
+// <uint32 session_id> (optional): identifies the uplink session for resume/ack
+
+// payload for kind=AudioPcmAck, messageType=DATA
+// <uint32 session_id><uint16 seq><uint8 flags>: the server holds every AudioPcm DATA up to seq
+// flags (optional, kPcmAckFlag*): how the server uses the uplink
+// the server feeds the audio to a streaming recognizer, so shorter DATA lowers latency
+constexpr uint8_t kPcmAckFlagStreaming = 0x01;
+
+// payload for kind=SpeakDoneEvt, messageType=DATA
+// 1 byte: 1 = done, 2 = done and the device is waiting for a follow-up utterance
+constexpr uint8_t kSpeakDone = 1;
+constexpr uint8_t kSpeakDoneFollowUp = 2;
+
+// payload for kind=LocalCommandEvt, messageType=DATA
+// 1 byte: command id (0 is reserved: commands are only recognised while Idle, so there is no playback to stop)
+enum class LocalCommand : uint8_t
+{
+	VolumeUp = 1,
+	VolumeDown = 2,
+	LookAtMe = 3,
+	Nod = 4,
+};
+
+// payload for kind=ClipCmd, messageType=DATA
+// <uint32 clip_id>: play the cached clip; the device answers ClipEvt Hit or Miss
+
+// payload for kind=ClipData (accepted only while Idle)
+//   START: <uint32 clip_id><uint32 sample_rate><uint16 channels><uint32 pcm_bytes>
+//   DATA: PCM16LE bytes
+//   END: none; the device answers ClipEvt Stored or StoreFailed
+
+// payload for kind=ClipEvt, messageType=DATA
+// <uint8 ClipStatus><uint32 clip_id>...: one status for every listed clip
+enum class ClipStatus : uint8_t
+{
+	Miss = 0,        // not cached; the server streams the phrase instead
+	Hit = 1,         // playback started from the cache
+	Stored = 2,      // ClipData saved
+	StoreFailed = 3, // ClipData rejected or aborted
+	Inventory = 4,   // clips cached on the device (sent on connect)
+	Evicted = 5,     // clips removed to make room
+};
+
+// payload for kind=AudioCreditEvt, messageType=DATA
+// <uint32 credit_bytes>: additional AudioWav DATA payload bytes the server may send
+
+// payload for kind=CaptureData (sent only while Idle)
+//   START: WsCaptureFileHeader; the server starts a new capture file
+//   DATA: capture records (WsCaptureRecordHeader + body), split at any byte boundary
+//   END: none; the file ends with the connection (a record cut off by a disconnect is sent again in the next file)
+
+// capture file: WsCaptureFileHeader followed by records until the end of the file
+// written by the firmware (WS_CAPTURE_KB_H) and by the server (capture_dir); replayed by misc/replay
+constexpr uint32_t kWsCaptureMagic = 0x43574353; // "SCWC"
+constexpr uint16_t kWsCaptureVersion = 1;
+
+enum class WsCaptureOrigin : uint8_t
+{
+	Device = 1, // recorded by the firmware: timestamps are esp_timer (us since boot)
+	Server = 2, // recorded by the server: timestamps are unix time (us)
+};
+
+struct __attribute__((packed)) WsCaptureFileHeader
+{
+	uint32_t magic;    // kWsCaptureMagic
+	uint16_t version;  // kWsCaptureVersion
+	uint8_t origin;    // WsCaptureOrigin
+	uint8_t reserved;
+	uint64_t start_us; // recorder clock of the first record; its delta_us is 0
+};
+
+// directions are always seen from the device, whichever side recorded the file
+enum class WsCaptureRecord : uint8_t
+{
+	Rx = 1,      // server -> device binary message: WsHeader + payload
+	Tx = 2,      // device -> server binary message: WsHeader + payload
+	Event = 3,   // 1 byte WsCaptureEvent
+	Dropped = 4, // <uint32 records><uint32 bytes>: lost because the recorder's buffer was full
+};
+
+enum class WsCaptureEvent : uint8_t
+{
+	Connected = 1,
+	Disconnected = 2,
+};
+
+struct __attribute__((packed)) WsCaptureRecordHeader
+{
+	uint8_t type;      // WsCaptureRecord
+	uint32_t delta_us; // time since the previous record in the file (saturates after ~71 minutes)
+	uint32_t bytes;    // body bytes following
+};
+
+// payload for kind=TraceCmd, messageType=DATA
+// <uint8 flags> (optional, kTraceCmdFlag*); the device answers one TraceData dump
+constexpr uint8_t kTraceCmdFlagClear = 0x01; // empty the ring after the dump
+
+// payload for kind=TraceData
+//   START: TraceDumpHeader
+//   DATA: whole TraceRecords, oldest first per core
+//   END: none
+// a firmware built without STACKCHAN_TRACE answers START with records=0 and END
+constexpr uint32_t kTraceMagic = 0x52544353; // "SCTR"
+constexpr uint16_t kTraceVersion = 1;
+
+struct __attribute__((packed)) TraceDumpHeader
+{
+	uint32_t magic;   // kTraceMagic
+	uint16_t version; // kTraceVersion
+	uint8_t cores;    // rings in the dump
+	uint8_t reserved;
+	uint32_t records; // TraceRecords following in DATA
+	uint32_t lost;    // records overwritten since the last clear
+	uint64_t now_us;  // esp_timer when the dump started (extends TraceRecord.time_us to 64 bits)
+};
+
+enum class TracePhase : uint8_t
+{
+	Begin = 1,
+	End = 2,
+	Instant = 3,
+};
+
+// what arg0/arg1 of a TraceRecord carry depends on the point
+enum class TracePoint : uint16_t
+{
+	State = 1,       // Instant: <from state><to state>
+	MicRecord = 2,   // span around M5.Mic.record: <samples><stereo>
+	WsSend = 3,      // span around sendBIN: <kind><bytes>
+	WsMessage = 4,   // span around the handling of a received message: <kind><payload bytes>
+	WsEvent = 5,     // Instant: <WsClient::Event>
+	SpeakerPlay = 6, // Instant at playRaw: <frames><sample_rate>
+	SpeakerDone = 7, // Instant when a segment has played: <segments still in the speaker>
+	SpeakerStop = 8, // Instant when playback is cut off
+	ServoStep = 9,   // span of a servo step: <ServoCommandOp><angle (int8)>
+	Loop = 10,       // span of the busy part of loop(): <state>
+};
+
+struct __attribute__((packed)) TraceRecord
+{
+	uint32_t time_us; // low 32 bits of esp_timer
+	uint16_t point;   // TracePoint
+	uint8_t phase;    // TracePhase
+	uint8_t core;
+	uint32_t arg0;
+	uint32_t arg1;
+};
+static_assert(sizeof(TraceRecord) == 16, "TraceRecord must stay 16 bytes");
+
 // payload for kind=StateCmd, messageType=DATA
 // 1 byte: target state id (matches StateMachine::State)
 enum class RemoteState : uint8_t
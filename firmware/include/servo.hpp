@@ -1,10 +1,10 @@
 #pragma once
 
 #include <ESP32Servo.h>
+#include <array>
 #include <cstddef>
 #include <cstdint>
 #include <functional>
-#include <vector>
 
 #include "protocols.hpp"
 
@@ -15,10 +15,18 @@ public:
 
   void init();
   void loop();
+  // 実行中のシーケンスを打ち切る。サーバーのシーケンス（notify_done=true）なら completion callback を呼ぶ
   void resetSequence();
 
-  bool enqueueSequence(const uint8_t *payload, size_t payload_len);
+  // notify_done=false: 完了しても completion callback を呼ばない（端末内で起こした動作用）
+  bool enqueueSequence(const uint8_t *payload, size_t payload_len, bool notify_done = true);
   bool isBusy() const;
+
+  // 首（X 軸）の現在の角度
+  int16_t currentDegreeX() const { return axis_x_.current_degree; }
+
+  // 次に loop() を呼ぶ必要があるまでの時間（ms）。動作予定が無ければ UINT32_MAX
+  uint32_t msUntilNextUpdate(uint32_t now) const;
   void setCompletionCallback(std::function<void()> cb);
 
 private:
@@ -41,6 +49,8 @@ private:
     int16_t duration_ms = 0;
   };
 
+  // ServoCmd の payload を out に読む（out が nullptr なら形式の確認だけ）
+  static bool parseSteps(const uint8_t *payload, size_t payload_len, Step *out);
   bool ensureAttached();
   void updateAxis(AxisMotion &axis, uint32_t now);
   void startMove(AxisMotion &axis, int8_t degree, int16_t duration_ms);
@@ -52,10 +62,14 @@ private:
   AxisMotion axis_y_{};
   bool attached_ = false;
 
-  std::vector<Step> steps_{};
+  // ServoCmd の command_count は uint8 なので、最大のシーケンスも固定の配列に入る
+  static constexpr size_t kMaxSteps = UINT8_MAX;
+  std::array<Step, kMaxSteps> steps_{};
+  size_t step_count_ = 0;
   size_t current_step_index_ = 0;
   bool sequence_active_ = false;
   bool step_started_ = false;
   uint32_t sleep_deadline_ms_ = 0;
   std::function<void()> on_complete_{};
+  bool notify_on_complete_ = true;
 };
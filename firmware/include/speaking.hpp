@@ -1,9 +1,10 @@
 #pragma once
 
-#include <vector>
+#include <array>
 #include <cstdint>
 #include <functional>
 #include <M5Unified.h>
+#include "memory_plan.hpp"
 #include "protocols.hpp"
 #include "state_machine.hpp"
 
@@ -12,6 +13,15 @@ class Speaking
 public:
   explicit Speaking(StateMachine &sm) : state_(sm) {}
 
+  // 受信したセグメントを置く枠。1 本分（サーバー既定の 2 秒 @24kHz mono）を超える分は次の枠に続ける
+  static constexpr size_t kSegmentSlots = 4;
+  static constexpr size_t kSegmentBytes = 96000;
+  // kMemoryPlan の Speaking の PSRAM 予算
+  static constexpr size_t kPsramBytes = kSegmentSlots * memory_plan::padded(kSegmentBytes);
+
+  // playClip の読み出し元。std::function と違い、渡すたびに確保が起きることがない
+  using ClipReader = size_t (*)(uint8_t *dst, size_t len);
+
   // Initialize internal buffers/state (call once from setup)
   void init();
 
@@ -19,26 +29,118 @@ public:
   void begin();
   void end();
 
+  // AudioWav DATA の payload を受信中セグメントへ直接書き込むための領域を確保する。
+  // 使えない（補間が必要・受信中でない）ときは nullptr
+  uint8_t *reserveWavPayload(const WsHeader &hdr);
+
   // Process one WS audio message of kind AudioWav
   void handleWavMessage(const WsHeader &hdr, const uint8_t *body, size_t bodyLen);
 
+  // flash のフレーズキャッシュから読み出して再生する（SpeakStart で Speaking に入る）
+  // read は続きの PCM を dst に最大 len バイト読み、読めたバイト数を返す。発話の途中なら false
+  bool playClip(uint32_t sample_rate, uint16_t channels, size_t bytes, ClipReader read);
+
   // Called from main loop to progress playback state
   void loop();
 
+  // 次に loop() を呼ぶ必要があるまでの時間（ms）。再生中でなければ UINT32_MAX
+  uint32_t msUntilNextUpdate() const;
+
   // Reset any buffered audio / playback state
   void reset();
 
   void setSpeakFinishedCallback(std::function<void()> cb);
 
+  // 再生完了後に Idle ではなく Listening（続きの発話待ち）へ進む
+  void setFollowUpListening(bool enabled) { follow_up_listening_ = enabled; }
+
+  // 再生バッファの空きをサーバーに知らせるクレジット送信先
+  void setCreditCallback(std::function<void(uint32_t bytes)> cb);
+
+  // WebSocket 接続時に、再生バッファ全体をクレジットとして付与する
+  void grantInitialCredit();
+
+  // 再生中の音声の現在位置付近の音量（0-100）。口パク用
+  uint8_t getMouthLevel() const;
+
 private:
+  // 受信したセグメントは Filling -> Ready -> Submitted(Speaker のキューに投入済み) -> Free と巡回する
+  enum class SlotState : uint8_t
+  {
+    Free,
+    Filling,
+    Ready,
+    Submitted,
+  };
+
+  struct Segment
+  {
+    uint8_t *pcm = nullptr; // kSegmentBytes（起動時に memory_plan から切り出す）
+    size_t pcm_bytes = 0;
+    size_t concealed_bytes = 0; // サーバーから受け取っていないバイト（欠損補間・キャッシュからの再生）
+    SlotState state = SlotState::Free;
+    uint32_t sample_rate = 24000;
+    uint16_t channels = 1;
+    bool fade_in = false;  // 前に積んだ音との間が欠けている（先頭をフェードインする）
+    bool fade_out = false; // 後に続くはずの音が欠けた（末尾をフェードアウトする）
+  };
+
+  static constexpr size_t kNoSlot = kSegmentSlots;
+
+  size_t findFreeSlot() const;
+  void grantCredit(size_t bytes);
+  void dropPendingPayload();
+  void concealGap(uint16_t missing_chunks, const uint8_t *next, size_t next_len);
+  void markDiscontinuity();
+  void finalizeFilling(uint32_t now);
+  bool continueInNextSlot(uint32_t now);
+  void enqueueReady(size_t slot);
+  void fillFromClip(uint32_t now);
+  void beginUtterance();
+  void releasePlayed(uint32_t now);
+  void submitReady(uint32_t now);
+  bool utteranceFinished(uint32_t now) const;
+  void logReceiveStats() const;
+
   StateMachine &state_;
-  std::vector<uint8_t> buffer_[3];
-  uint8_t current_buffer_ = 0;
-  bool playing_ = false;
-  bool mic_was_enabled_ = false;
+  std::array<Segment, kSegmentSlots> segments_{};
+  size_t filling_ = kNoSlot;
+
+  // 再生順のセグメント FIFO。先頭 submitted_count_ 個は Speaker に投入済み
+  std::array<size_t, kSegmentSlots> queue_{};
+  size_t queue_head_ = 0;
+  size_t queue_count_ = 0;
+  size_t submitted_count_ = 0;
+
+  bool utterance_active_ = false;
+  bool end_of_utterance_ = false;
+  bool underrun_ = false;
+  bool seam_gap_ = false; // 受け取れなかった音がある。次に受け取るセグメントの先頭をフェードインする
+  uint32_t underrun_count_ = 0;
+  uint32_t last_end_ms_ = 0;
+  uint32_t drained_ms_ = 0; // Speaker のキューが最後に空になった時刻
+  uint32_t last_data_ms_ = 0;
+  size_t chunk_bytes_ = 0; // 受信中のセグメントで最も長い DATA（START で 0 に戻す）
+  uint32_t concealed_chunks_ = 0;
+  std::array<int16_t, 2> last_frame_{}; // 直前に区切ったセグメントの最後のフレーム（先頭の欠けた chunk の補間に使う）
+  size_t pending_payload_bytes_ = 0; // reserveWavPayload で確保し、まだ handleWavMessage が来ていない分
+
+  // 受信経路のコピー量（1 発話分）。ソケットからの読み出しも 1 回と数える
+  uint32_t rx_audio_bytes_ = 0;
+  uint32_t rx_copied_bytes_ = 0;
+  size_t heap_free_at_start_ = 0;
+  size_t heap_free_min_ = 0;
+  uint32_t play_start_ms_ = 0;
   bool streaming_ = false;
   uint16_t next_seq_ = 0;
   uint32_t sample_rate_ = 24000;
   uint16_t channels_ = 1;
   std::function<void()> on_speak_finished_;
+
+  // キャッシュからの再生。空いたセグメントに順に読み込む
+  ClipReader clip_read_ = nullptr;
+  size_t clip_remaining_ = 0;
+  bool follow_up_listening_ = false;
+  std::function<void(uint32_t bytes)> on_credit_;
+  size_t credit_unused_ = 0; // 付与したクレジットのうち、まだ DATA が届いていない分（発話をまたいで持ち越す）
 };
@@ -1,9 +1,8 @@
 #pragma once
 
 #include <array>
-#include <functional>
+#include <cstddef>
 #include <stdint.h>
-#include <vector>
 
 class StateMachine
 {
@@ -16,10 +15,45 @@ public:
     Speaking = 3,
     Disconnected = 4,
   };
+  static constexpr size_t kStateCount = 5;
+
+  // ステート遷移のきっかけとなるイベント。遷移先は state_machine.cpp の遷移表で決まる
+  enum class Event : uint8_t
+  {
+    Connected = 0,       // WebSocket 接続（保留中の uplink があれば Listening で再開）
+    Disconnected = 1,    // WebSocket 切断
+    RemoteIdle = 2,      // StateCmd(Idle)
+    RemoteListening = 3, // StateCmd(Listening)
+    RemoteThinking = 4,  // StateCmd(Thinking)
+    RemoteSpeaking = 5,  // StateCmd(Speaking)
+    SpeakStart = 6,      // AudioWav START 受信
+    ListenFinished = 7,  // 無音検知や送信失敗による Listening 終了
+    SpeakFinished = 8,   // 再生完了
+    CommTimeout = 9,     // サーバー無応答
+    FollowUpListen = 10, // 再生完了後、ウェイクワードなしで続きの発話を待つ（会話モード）
+  };
+  static constexpr size_t kEventCount = 11;
+
+  // エントリ/エグジット時に呼ばれるハンドラ（キャプチャなしラムダ可）
+  using Handler = void (*)(State prev, State next);
+
+  // 遷移表の guard / action 列から呼ばれる、特定の遷移にだけ必要な判定と処理（キャプチャなしラムダ可）
+  //  - guard が false（未登録も含む）なら、同じイベントで次に書かれた行を試す
+  //  - action は前のステートの exit ハンドラと次のステートの entry ハンドラの間に呼ぶ
+  using Guard = bool (*)();
+  using Action = void (*)();
+  struct TransitionHooks
+  {
+    Guard can_resume_listening = nullptr; // 再接続時、切断中も録音を続けていた uplink を再開できるか
+    Action arm_follow_up = nullptr;       // 再生完了から Listening に入る前に、発話待ちを仕掛ける
+  };
 
   StateMachine() = default;
 
-  void setState(State s);
+  // イベントを遷移表に従って処理する。ハンドラ内から呼ばれた場合は
+  // 現在の遷移が完了してから受け付け順に処理する。遷移表に無い組み合わせは無視する
+  void dispatch(Event event);
+
   State getState() const;
   bool isIdle() const;
   bool isListening() const;
@@ -27,14 +61,33 @@ public:
   bool isSpeaking() const;
   bool isDisconnected() const;
 
-  using Callback = std::function<void(State prev, State next)>;
-  void addStateEntryEvent(State state, Callback cb);
-  void addStateExitEvent(State state, Callback cb);
+  bool addStateEntryEvent(State state, Handler handler);
+  bool addStateExitEvent(State state, Handler handler);
+  void setTransitionHooks(const TransitionHooks &hooks);
+
+  // 遷移表を引き、guard を評価して遷移先を返す。遷移できなければ false
+  bool resolve(State from, Event event, State &to) const;
 
 private:
+  static constexpr size_t kMaxHandlersPerState = 4;
+  static constexpr size_t kEventQueueCapacity = 8;
+  using HandlerList = std::array<Handler, kMaxHandlersPerState>;
+
+  void process(Event event);
+  void transition(State next, Action action);
+  static bool addHandler(HandlerList &list, Handler handler);
+
   State state_ = Disconnected;
-  std::array<std::vector<Callback>, 5> entry_events_{};
-  std::array<std::vector<Callback>, 5> exit_events_{};
+  std::array<HandlerList, kStateCount> entry_events_{};
+  std::array<HandlerList, kStateCount> exit_events_{};
+  TransitionHooks hooks_{};
+
+  // ハンドラ内で発生したイベントの待ち行列
+  std::array<Event, kEventQueueCapacity> pending_{};
+  size_t pending_head_ = 0;
+  size_t pending_count_ = 0;
+  bool dispatching_ = false;
 };
 
 const char *stateToString(StateMachine::State state);
+const char *eventToString(StateMachine::Event event);
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "memory_plan.hpp"
+#include "protocols.hpp"
+
+// 1 ターンの時間がどこで使われているかを見るためのトレース（span / instant）
+//  - 16 バイトの TraceRecord をコアごとのリング（PSRAM）に書く。書き込みはロックを取らない
+//  - TraceCmd を受けたら loop() から TraceData で送る。stackchan_server/trace.py が Perfetto で開ける JSON にする
+//  - STACKCHAN_TRACE=1 でビルドしたときだけ記録する。0 なら TRACE_* は何も生成しない
+#ifndef STACKCHAN_TRACE
+#define STACKCHAN_TRACE 0
+#endif
+#ifndef STACKCHAN_TRACE_KB
+#define STACKCHAN_TRACE_KB 128 // 2 コア合計。ターン数回分（loop() の span だけで 1 秒 100 件）
+#endif
+
+class WsClient;
+
+namespace trace
+{
+// TraceData DATA 1 本の payload（レコード 256 件）。loop() を長く止めない大きさにする
+constexpr size_t kDumpFrameBytes = 4096;
+
+// init(buffer_bytes) が memory_plan の PSRAM から切り出す大きさ（kMemoryPlan 用）
+constexpr size_t psramBytes(size_t buffer_bytes)
+{
+  return STACKCHAN_TRACE && buffer_bytes > 0
+             ? memory_plan::padded(buffer_bytes) + memory_plan::padded(sizeof(WsHeader) + kDumpFrameBytes)
+             : 0;
+}
+
+// リングを memory_plan から切り出して記録を始める。予算が無ければ記録しない
+void init(size_t buffer_bytes);
+// 記録の経路。割り込み禁止も mutex も使わず、スロットは atomic の fetch_add で取る
+void record(TracePoint point, TracePhase phase, uint32_t arg0, uint32_t arg1);
+
+class Scope
+{
+public:
+  Scope(TracePoint point, uint32_t arg0, uint32_t arg1) : point_(point)
+  {
+    record(point_, TracePhase::Begin, arg0, arg1);
+  }
+  ~Scope() { record(point_, TracePhase::End, 0, 0); }
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+
+private:
+  TracePoint point_;
+};
+} // namespace trace
+
+#if STACKCHAN_TRACE
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_BEGIN(point, arg0, arg1) \
+  trace::record(TracePoint::point, TracePhase::Begin, static_cast<uint32_t>(arg0), static_cast<uint32_t>(arg1))
+#define TRACE_END(point) trace::record(TracePoint::point, TracePhase::End, 0, 0)
+#define TRACE_INSTANT(point, arg0, arg1) \
+  trace::record(TracePoint::point, TracePhase::Instant, static_cast<uint32_t>(arg0), static_cast<uint32_t>(arg1))
+// スコープを抜けるまでの span
+#define TRACE_SCOPE(point, arg0, arg1)                                                            \
+  trace::Scope TRACE_CONCAT(trace_scope_, __LINE__)(TracePoint::point, static_cast<uint32_t>(arg0), \
+                                                    static_cast<uint32_t>(arg1))
+#else
+#define TRACE_BEGIN(point, arg0, arg1) ((void)0)
+#define TRACE_END(point) ((void)0)
+#define TRACE_INSTANT(point, arg0, arg1) ((void)0)
+#define TRACE_SCOPE(point, arg0, arg1) ((void)0)
+#endif
+
+// TraceCmd に答えてリングの中身を TraceData で送る
+//  - 送っている間は記録を止める（送信そのものの span でリングを上書きしない）
+//  - ステートによらず loop() から少しずつ送る。途中で切断されたら止め、次の TraceCmd でやり直す
+class TraceDump
+{
+public:
+  explicit TraceDump(WsClient &ws) : ws_(ws) {}
+
+  void handleCommand(const uint8_t *payload, size_t len);
+  // loop() から呼ぶ。要求があれば最大 budget バイト送る
+  void upload(size_t budget);
+  // 送り終えていない要求がある（loop() は待たずに続きを送る）
+  bool isUploading() const { return requested_; }
+
+private:
+  bool sendStart();
+  bool sendRecords(size_t budget);
+  bool sendEnd();
+  void finish();
+  void abort();
+
+  WsClient &ws_;
+  bool requested_ = false;
+  bool started_ = false;
+  bool clear_after_ = false;
+  // 送信中の位置（コアごとに古い順）
+  uint8_t core_ = 0;
+  uint32_t next_[2] = {};
+  uint32_t end_[2] = {};
+  uint16_t seq_ = 0;
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "fft.hpp"
+
+// 送信（AudioPcm）前の音声の前処理。Listening が録音したブロックごとに呼ぶ
+//  1. 直流・低域の除去（1 次 HPF、Q15）
+//  2. 雑音抑圧（256 点 STFT・50% オーバーラップ、決定指向型の Wiener ゲイン）
+//  3. 先読み AGC（1 ブロック遅らせ、次のブロックのピークも見てゲインを決める。サンプルへの適用は Q12）
+// 遅延は 384 サンプル（16kHz で 24 ms）。雑音の推定はセッションをまたいで引き継ぐ
+class UplinkFrontEnd
+{
+public:
+  static constexpr size_t kBlockSamples = 256;
+
+  UplinkFrontEnd() = default;
+
+  // 窓と FFT の係数を求める（Listening::init から 1 回）
+  void init();
+
+  // 前のセッションの音が残らないよう、遅延線を空にする（録音の開始時）
+  void reset();
+
+  // bypass=true のときは in をそのまま out に写す
+  void setBypass(bool bypass) { bypass_ = bypass; }
+  bool isBypassed() const { return bypass_; }
+
+  // kBlockSamples サンプルを処理する（in と out は別のバッファ）
+  void process(const int16_t *in, int16_t *out);
+
+  // 前回のログからの入出力レベル・AGC ゲイン・処理時間を 1 行で出す（セッションの終了時）
+  void logStats();
+
+private:
+  static constexpr size_t kFftSize = 256;
+  static constexpr size_t kHop = kFftSize / 2;
+  static constexpr size_t kBins = kFftSize / 2 + 1;
+
+  void highPass(const int16_t *in, int16_t *out);
+  void suppressNoise(const int16_t *in, int16_t *out);
+  void updateGains(const float *power, float *gain);
+  void applyAgc(const int16_t *in, int16_t *out);
+
+  bool bypass_ = true;
+
+  // HPF
+  int32_t hpf_x1_ = 0;
+  int64_t hpf_y1_ = 0; // Q15
+
+  // 雑音抑圧
+  ComplexFft<kFftSize> fft_{};
+  std::array<float, kFftSize> window_{}; // sqrt-Hann（分析・合成の両方に掛ける）
+  std::array<int16_t, kHop> ns_history_{};
+  std::array<float, kHop> ns_overlap_{};
+  std::array<float, kFftSize> fft_re_{};
+  std::array<float, kFftSize> fft_im_{};
+  std::array<float, kBins> noise_power_{};
+  std::array<float, kBins> smoothed_power_{};
+  std::array<float, kBins> clean_power_{}; // 直前のフレームの推定（決定指向型の事前 SNR 用）
+  std::array<float, kBins> gain1_{};
+  std::array<float, kBins> gain2_{};
+  std::array<float, kBins> power_{};
+  uint32_t noise_frames_ = 0;
+
+  // AGC
+  std::array<int16_t, kBlockSamples> agc_delay_{};
+  int32_t agc_delay_peak_ = 0;
+  int32_t agc_gain_q12_ = 1 << 12;   // 話者のレベルから決めたゲイン
+  int32_t agc_applied_q12_ = 1 << 12; // ピーク制限後、前のブロックの終わりで掛けていたゲイン
+  float agc_level_ = 0.0f;
+  uint32_t agc_quiet_blocks_ = 0;
+
+  // 統計（logStats で出して消す）
+  uint32_t stat_blocks_ = 0;
+  uint64_t stat_in_energy_ = 0;
+  uint64_t stat_out_energy_ = 0;
+  int32_t stat_in_peak_ = 0;
+  int32_t stat_out_peak_ = 0;
+  uint32_t stat_in_clipped_ = 0;
+  int32_t stat_gain_min_q12_ = INT32_MAX;
+  int32_t stat_gain_max_q12_ = 0;
+  uint32_t stat_cycles_total_ = 0;
+  uint32_t stat_cycles_max_ = 0;
+};
@@ -1,15 +1,17 @@
 #pragma once
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
-#include <functional>
 #include <ESP_SR_M5Unified.h>
+#include "mic_frontend.hpp"
+#include "protocols.hpp"
 #include "state_machine.hpp"
 
 class WakeUpWord
 {
 public:
-  WakeUpWord(StateMachine &state, int sampleRate) : state_(state), sample_rate_(sampleRate) {}
+  WakeUpWord(StateMachine &state, MicFrontEnd &mic, int sampleRate) : state_(state), mic_(mic), sample_rate_(sampleRate) {}
 
   // ESP_SR を初期化し、ステートマシンのエントリ/エグジットイベントや SR のイベントハンドラを登録する
   void init();
@@ -24,15 +26,37 @@ public:
   // Idle ステート中の処理（マイク入力→SRへ供給）
   void loop();
 
-  void setWakeWordDetectedCallback(std::function<void()> cb);
+  // 検出したウェイクワードを取り出す（main loop から呼ぶ）。detected_us は ESP-SR が検出した時刻。
+  // SR のイベントは ESP-SR のタスクで届くので、復帰や通知はこれを受けた loop() のタスクで行う
+  bool takeWakeWord(uint32_t &detected_us);
+
+  // ウェイクワードの後、一定時間 MultiNet でローカルコマンドを待つ（init() より前に呼ぶ）
+  // srmodels に MultiNet のモデルが必要
+  void enableLocalCommands(bool enabled) { commands_enabled_ = enabled; }
+
+  // コマンド待ちの間は Listening に移ってもマイク入力を SR に供給する
+  void feedCommandAudio(const int16_t *samples, size_t count);
+
+  // 認識したコマンドを取り出す（main loop から呼ぶ）。コマンド待ちの期限切れもここで処理する
+  bool takeCommand(LocalCommand &command, uint32_t &detected_us);
 
 private:
   static void onSrEventForward(sr_event_t event, int command_id, int phrase_id);
   void handleSrEvent(sr_event_t event, int command_id, int phrase_id);
 
   StateMachine &state_;
+  MicFrontEnd &mic_;
   const int sample_rate_;
-  std::function<void()> on_wake_word_detected_;
+
+  // コマンド待ち。SR のイベントは別タスクから届くので atomic で受け渡す
+  bool commands_enabled_ = false;
+  std::atomic<bool> command_phase_{false};
+  std::atomic<uint32_t> command_phase_since_ms_{0};
+  std::atomic<int> pending_command_{-1};
+  std::atomic<uint32_t> command_detected_us_{0};
+  std::atomic<bool> wake_word_pending_{false};
+  std::atomic<uint32_t> wake_word_detected_us_{0};
+  bool sr_running_outside_idle_ = false;
 
   // Idle 時のログ用カウンタ
   uint32_t loop_count_ = 0;
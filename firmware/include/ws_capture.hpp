@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "memory_plan.hpp"
+#include "protocols.hpp"
+#include "ws_client.hpp"
+
+// WebSocket の送受信をそのままの時刻で記録し、Idle の間にサーバーへ送る（CaptureData）
+//  - 記録は PSRAM のリングに溜める。溢れた分は捨て、Dropped レコードで件数を残す
+//  - ファイル形式は protocols.hpp の WsCaptureFileHeader / WsCaptureRecordHeader。misc/replay で再生できる
+//  - 送受信の経路では memcpy のみ。flash には書かない
+class WsCapture
+{
+public:
+  explicit WsCapture(WsClient &ws) : ws_(ws) {}
+
+  // init(buffer_bytes) が memory_plan の PSRAM から切り出す大きさ（kMemoryPlan 用）
+  static constexpr size_t psramBytes(size_t buffer_bytes)
+  {
+    return buffer_bytes == 0 ? 0
+                             : memory_plan::padded(buffer_bytes) + memory_plan::padded(sizeof(WsHeader) + kUploadFrameBytes);
+  }
+
+  // buffer_bytes のリングを memory_plan から切り出す。0 または予算が無ければ記録しない
+  void init(size_t buffer_bytes);
+  bool isEnabled() const { return ring_ != nullptr; }
+
+  // 受信し終えたメッセージ・送信できたメッセージ（WsHeader から始まる）・接続の変化を記録する
+  void recordRx(const WsHeader &hdr, const uint8_t *body, size_t len);
+  void recordTx(const uint8_t *data, size_t len);
+  void recordEvent(WsCaptureEvent event);
+
+  // Idle の loop() から呼ぶ。溜まった記録を最大 budget バイト送る
+  void upload(size_t budget);
+
+private:
+  // CaptureData DATA 1 本の payload。Idle の loop() を長く止めない大きさにする
+  static constexpr size_t kUploadFrameBytes = 4096;
+
+  // リング内のレコード。時刻は送信時にファイルの差分形式へ直す
+  struct __attribute__((packed)) StoredHeader
+  {
+    uint8_t type;
+    uint64_t at_us;
+    uint32_t bytes;
+  };
+
+  bool reserve(size_t bytes);
+  void append(WsCaptureRecord type, uint64_t at_us, const uint8_t *head, size_t head_len, const uint8_t *body,
+              size_t body_len);
+  void ringWrite(const uint8_t *src, size_t len);
+  void ringRead(size_t pos, uint8_t *dst, size_t len) const;
+  bool sendStart(uint64_t first_us);
+  bool sendData(size_t len);
+
+  WsClient &ws_;
+  uint8_t *ring_ = nullptr;
+  uint8_t *frame_ = nullptr; // 送信用: WsHeader + CaptureData DATA の payload
+  size_t capacity_ = 0;
+  size_t head_ = 0; // 最も古いレコードの位置
+  size_t used_ = 0;
+
+  // 溢れて捨てた分（次に入ったときに Dropped レコードとして残す）
+  uint32_t dropped_records_ = 0;
+  uint32_t dropped_bytes_ = 0;
+  uint32_t total_dropped_records_ = 0;
+
+  // 送信中のファイル。接続ごとに START からやり直す
+  bool file_started_ = false;
+  uint64_t last_sent_us_ = 0;
+  size_t record_sent_ = 0; // 先頭レコードのうち送信済みのバイト数（ファイル形式でのヘッダを含む）
+  uint16_t seq_ = 0;
+  uint32_t uploaded_bytes_ = 0;
+};
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <WiFi.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include "protocols.hpp"
+
+// TCP の connect（名前解決を含む）を専用のタスクで行う。0 なら loop() の中で同期に待つ（ホストのテスト）
+#ifndef WS_CONNECT_TASK
+#if defined(ARDUINO)
+#define WS_CONNECT_TASK 1
+#else
+#define WS_CONNECT_TASK 0
+#endif
+#endif
+
+#if WS_CONNECT_TASK
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
+
+// 本プロトコル専用の軽量 WebSocket クライアント（RFC 6455 のうち使う範囲のみ）
+//  - バイナリメッセージは先頭の WsHeader を読んだ時点で受信先を決め、
+//    payload をソケットから受信先へ直接読み込む（フレーム単位の中間バッファを持たない）
+//  - ping/pong のハートビートと、切断時のジッタ付き指数バックオフによる再接続
+//  - 接続・ハンドシェイクは loop() を止めない。TCP の connect は接続タスクが待ち、loop() は結果だけを受け取る
+//    （切断中も Listening がマイクを読み続けられるように）
+class WsClient
+{
+public:
+  enum class Event : uint8_t
+  {
+    Connected,
+    Disconnected,
+    Text,
+  };
+
+  using EventCallback = std::function<void(Event event)>;
+  // 受信し終えたバイナリメッセージ。body は PayloadSink が返した領域か内部バッファを指す
+  using MessageCallback = std::function<void(const WsHeader &hdr, const uint8_t *body, size_t len)>;
+  // payload の受信先（hdr.payloadBytes バイト書ける領域）を返す。nullptr なら内部バッファで受ける
+  using PayloadSink = std::function<uint8_t *(const WsHeader &hdr)>;
+  // 送信できたバイナリメッセージ（WsHeader から始まる）の写し。通信の記録用
+  using SendTap = std::function<void(const uint8_t *data, size_t len)>;
+
+  WsClient() = default;
+
+  // PayloadSink を使わないメッセージの受信バッファ（WsHeader の payloadBytes の上限）。kMemoryPlan の WsClient の PSRAM 予算
+  static constexpr size_t kRxBufferBytes = UINT16_MAX;
+  // 送信フレームを組み立てる内部 RAM のバッファ。上りの DATA（125 ms の PCM）やトレースの 1 フレーム（4 KiB）は
+  // ヘッダ・マスク済みの payload ごと 1 回の write で送る。これより長いフレームはこの大きさずつ書く
+  static constexpr size_t kTxBufferBytes = 4 * 1024 + 256;
+
+  // 送受信のバッファを memory_plan から切り出し、接続を始める（setup から 1 回呼ぶ）
+  void begin(const char *host, uint16_t port, const char *path);
+  void onEvent(EventCallback cb);
+  void onMessage(MessageCallback cb);
+  void setPayloadSink(PayloadSink sink);
+  void setSendTap(SendTap tap);
+  // 再接続の待ち時間は min_ms から失敗ごとに倍になり max_ms で頭打ち。実際の待ちはその 1/2〜1 倍
+  void setReconnectBackoff(uint32_t min_ms, uint32_t max_ms);
+  // バックオフを打ち切り、次の loop() で接続を試みる（Wi-Fi 再接続時など）
+  void reconnectNow();
+  void enableHeartbeat(uint32_t ping_interval_ms, uint32_t pong_timeout_ms, uint8_t disconnect_count);
+
+  // 受信処理・ハートビート・再接続（main loop から呼ぶ）
+  void loop();
+  // 受信を待たずに次の loop() が必要になるまでの時間（ハートビート・再接続・ハンドシェイクの期限、読み残し）
+  uint32_t msUntilNextUpdate(uint32_t now);
+  // 受信を待つソケット（loop_wake の監視用）。接続中・ハンドシェイク中でなければ -1
+  int socketFd();
+
+  bool isConnected() const;
+  // 送信は loop() と同じタスクから呼ぶ（排他はしない）
+  bool sendBIN(const uint8_t *data, size_t len);
+  void disconnect();
+
+private:
+  enum class Opcode : uint8_t
+  {
+    Continuation = 0x0,
+    Text = 0x1,
+    Binary = 0x2,
+    Close = 0x8,
+    Ping = 0x9,
+    Pong = 0xA,
+  };
+
+  enum class ConnectState : uint8_t
+  {
+    Idle,
+    Pending, // 接続タスクが connect 中。client_ には触れない
+    Succeeded,
+    Failed,
+  };
+
+  void startConnect();
+  void runConnect();
+  void finishConnect();
+#if WS_CONNECT_TASK
+  static void connectTaskEntry(void *arg);
+#endif
+  void sendHandshakeRequest();
+  void pollHandshake(uint32_t now);
+  bool verifyHandshakeResponse();
+  void scheduleReconnect();
+  void closeSocket(bool notify);
+  bool sendFrame(Opcode opcode, const uint8_t *data, size_t len);
+  void heartbeat(uint32_t now);
+
+  // 受信フレームの解析。1 回の loop() で読むのは kMaxReadPerLoop バイトまで
+  bool readFrameHeader();
+  size_t readPayload(size_t budget);
+  size_t readMessageBytes(size_t n);
+  void beginMessageBody();
+  void finishFrame();
+  void handleControlFrame();
+
+  WiFiClient client_;
+  const char *host_ = nullptr;
+  uint16_t port_ = 0;
+  const char *path_ = nullptr;
+  bool started_ = false;
+  bool handshaking_ = false;
+  bool connected_ = false;
+
+  EventCallback on_event_;
+  MessageCallback on_message_;
+  PayloadSink payload_sink_;
+  SendTap send_tap_;
+
+  uint32_t reconnect_min_ms_ = 250;
+  uint32_t reconnect_max_ms_ = 8000;
+  uint8_t reconnect_failures_ = 0;
+  bool attempt_due_ = false;
+  uint32_t next_attempt_ms_ = 0;
+  std::atomic<ConnectState> connect_state_{ConnectState::Idle};
+#if WS_CONNECT_TASK
+  TaskHandle_t connect_task_ = nullptr;
+#endif
+
+  // ハンドシェイク応答の受信
+  std::array<char, 32> handshake_key_{};
+  std::array<char, 1025> response_{};
+  size_t response_len_ = 0;
+  uint32_t handshake_deadline_ms_ = 0;
+
+  uint32_t ping_interval_ms_ = 0;
+  uint32_t pong_timeout_ms_ = 0;
+  uint8_t pong_disconnect_count_ = 0;
+  uint32_t last_ping_ms_ = 0;
+  bool awaiting_pong_ = false;
+  uint8_t missed_pongs_ = 0;
+
+  // 受信中のフレーム
+  std::array<uint8_t, 14> frame_hdr_{};
+  size_t frame_hdr_len_ = 0;
+  bool frame_fin_ = false;
+  Opcode frame_opcode_ = Opcode::Continuation;
+  bool frame_masked_ = false;
+  std::array<uint8_t, 4> frame_mask_{};
+  uint64_t frame_remaining_ = 0;
+  uint64_t frame_offset_ = 0;
+  bool in_payload_ = false;
+
+  // 受信中のメッセージ（継続フレームをまたぐ）
+  bool in_message_ = false;
+  Opcode message_opcode_ = Opcode::Continuation;
+  WsHeader message_hdr_{};
+  size_t message_hdr_len_ = 0;
+  uint8_t *message_body_ = nullptr;
+  size_t message_body_len_ = 0;
+  bool message_discard_ = false;
+
+  uint8_t *rx_buf_ = nullptr;             // PayloadSink を使わないメッセージ用（kRxBufferBytes）
+  uint8_t *tx_buf_ = nullptr;             // 送信フレームの組み立て用（kTxBufferBytes）
+  std::array<uint8_t, 125> control_buf_{}; // 制御フレームの payload は 125 バイトまで
+  size_t control_len_ = 0;
+};
@@ -0,0 +1,67 @@
+#include "beamformer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+constexpr float kSpeedOfSoundMmPerSec = 343000.0f;
+constexpr float kPi = 3.14159265f;
+} // namespace
+
+void Beamformer::configure(int sample_rate, float mic_spacing_mm, float steer_deg)
+{
+  // 右から来た音は R に先に届くので、R を到達時間差の分だけ遅らせて揃える
+  float tdoa_sec = mic_spacing_mm * std::sin(steer_deg * kPi / 180.0f) / kSpeedOfSoundMmPerSec;
+  delay_samples_ = tdoa_sec * static_cast<float>(sample_rate);
+  delay_left_ = delay_samples_ < 0.0f;
+
+  float delay = std::min(std::fabs(delay_samples_), static_cast<float>(kHistory - kTaps - 1));
+  integer_delay_ = static_cast<size_t>(delay);
+  // 3 次 Lagrange 補間は遅延 1〜2 サンプルの範囲で最も平坦。その 1 サンプル分はもう一方にも入れる
+  float frac = 1.0f + (delay - static_cast<float>(integer_delay_));
+  for (size_t i = 0; i < kTaps; ++i)
+  {
+    float h = 1.0f;
+    for (size_t k = 0; k < kTaps; ++k)
+    {
+      if (k != i)
+      {
+        h *= (frac - static_cast<float>(k)) / (static_cast<float>(i) - static_cast<float>(k));
+      }
+    }
+    coeffs_[i] = static_cast<int32_t>(std::lround(h * static_cast<float>(1 << kCoeffShift)));
+  }
+  reset();
+}
+
+void Beamformer::reset()
+{
+  history_.fill(0);
+  history_pos_ = 0;
+  other_prev_ = 0;
+}
+
+void Beamformer::process(const int16_t *interleaved, size_t frames, int16_t *out)
+{
+  for (size_t n = 0; n < frames; ++n)
+  {
+    int16_t left = interleaved[2 * n];
+    int16_t right = interleaved[2 * n + 1];
+
+    history_pos_ = (history_pos_ + 1) & kHistoryMask;
+    history_[history_pos_] = delay_left_ ? left : right;
+
+    size_t base = history_pos_ - integer_delay_;
+    int32_t acc = 1 << (kCoeffShift - 1);
+    for (size_t i = 0; i < kTaps; ++i)
+    {
+      acc += coeffs_[i] * history_[(base - i) & kHistoryMask];
+    }
+    int32_t delayed = acc >> kCoeffShift;
+
+    int32_t mixed = (delayed + other_prev_) >> 1;
+    other_prev_ = delay_left_ ? right : left;
+    out[n] = static_cast<int16_t>(std::max<int32_t>(INT16_MIN, std::min<int32_t>(INT16_MAX, mixed)));
+  }
+}
@@ -0,0 +1,95 @@
+#include "boot.hpp"
+
+#include <utility>
+
+namespace
+{
+// Idle（ウェイクワード待ち・顔の描画）に必要な並行フェーズ
+constexpr uint32_t kReadyMask = (1u << static_cast<uint8_t>(BootPhase::SrModel)) |
+                                (1u << static_cast<uint8_t>(BootPhase::DisplayFirstFrame));
+
+constexpr std::array<const char *, BootSequence::kPhaseCount> kPhaseNames = {
+    "m5_begin", "wifi", "local_init", "sr_model", "display", "websocket",
+};
+} // namespace
+
+void BootSequence::start(BootPhase phase, uint32_t now)
+{
+  start_ms_[static_cast<size_t>(phase)] = now;
+}
+
+void BootSequence::end(BootPhase phase, uint32_t now)
+{
+  if (isDone(phase))
+  {
+    return;
+  }
+  end_ms_[static_cast<size_t>(phase)] = now;
+  done_.fetch_or(bit(phase), std::memory_order_release);
+}
+
+bool BootSequence::isDone(BootPhase phase) const
+{
+  return (done_.load(std::memory_order_acquire) & bit(phase)) != 0;
+}
+
+void BootSequence::runAsync(BootPhase phase, const char *name, uint32_t stack_size, BaseType_t core,
+                            std::function<void()> fn)
+{
+  AsyncJob &job = jobs_[static_cast<size_t>(phase)];
+  job.owner = this;
+  job.phase = phase;
+  job.fn = std::move(fn);
+
+  start(phase, millis());
+  if (xTaskCreatePinnedToCore(taskEntry, name, stack_size, &job, 1, nullptr, core) != pdPASS)
+  {
+    log_w("Failed to start boot task %s; running inline", name);
+    runJob(job);
+  }
+}
+
+void BootSequence::taskEntry(void *arg)
+{
+  runJob(*static_cast<AsyncJob *>(arg));
+  vTaskDelete(nullptr);
+}
+
+void BootSequence::runJob(AsyncJob &job)
+{
+  job.fn();
+  job.fn = nullptr;
+  job.owner->end(job.phase, millis());
+}
+
+bool BootSequence::isReady() const
+{
+  return (done_.load(std::memory_order_acquire) & kReadyMask) == kReadyMask;
+}
+
+void BootSequence::finish(uint32_t now)
+{
+  if (finished_)
+  {
+    return;
+  }
+  finished_ = true;
+
+  uint32_t serial_ms = 0;
+  for (size_t i = 0; i < kPhaseCount; ++i)
+  {
+    if ((done_.load(std::memory_order_acquire) & (1u << i)) == 0)
+    {
+      log_i("boot phase %-10s start=%5lu ms (not finished)", kPhaseNames[i], static_cast<unsigned long>(start_ms_[i]));
+      continue;
+    }
+    uint32_t dur = end_ms_[i] - start_ms_[i];
+    serial_ms += dur;
+    log_i("boot phase %-10s start=%5lu ms dur=%5lu ms", kPhaseNames[i], static_cast<unsigned long>(start_ms_[i]),
+          static_cast<unsigned long>(dur));
+  }
+  // 直列に実行していた場合の目安（各フェーズの合計）と、実際に Idle に入った時刻
+  log_i("boot to Idle: %lu ms (setup entered at %lu ms, phases sum=%lu ms)", static_cast<unsigned long>(now),
+        static_cast<unsigned long>(start_ms_[static_cast<size_t>(BootPhase::M5Begin)]),
+        static_cast<unsigned long>(serial_ms));
+}
@@ -0,0 +1,392 @@
+#include "clip_cache.hpp"
+#include "memory_plan.hpp"
+
+#include <M5Unified.h>
+#include <LittleFS.h>
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+namespace
+{
+constexpr const char *kPartitionLabel = "spiffs";
+constexpr const char *kClipDir = "/clips";
+constexpr const char *kIndexPath = "/clips/index";
+constexpr const char *kStorePath = "/clips/store.tmp";
+constexpr uint32_t kIndexMagic = 0x31504C43; // "CLP1"
+
+// キャッシュ全体の上限（約 40 秒 @24kHz mono）と 1 クリップの上限（約 10 秒）
+constexpr uint32_t kCacheBudgetBytes = 2 * 1024 * 1024;
+constexpr uint32_t kMaxClipBytes = 480000;
+
+struct ClipPath
+{
+  char buf[24];
+};
+
+ClipPath clipPath(uint32_t clip_id)
+{
+  ClipPath path{};
+  snprintf(path.buf, sizeof(path.buf), "%s/%08lx.pcm", kClipDir, static_cast<unsigned long>(clip_id));
+  return path;
+}
+} // namespace
+
+void ClipCache::init()
+{
+  entries_.reserve(kMaxEntries);
+  uint32_t start_ms = millis();
+  mounted_ = LittleFS.begin(false, "/littlefs", 4, kPartitionLabel);
+  if (!mounted_)
+  {
+    log_w("Clip cache: LittleFS not formatted; will format on first store");
+    return;
+  }
+  LittleFS.mkdir(kClipDir);
+  loadIndex();
+  log_i("Clip cache: %u clips %lu bytes (mount %lu ms)", static_cast<unsigned>(entries_.size()),
+        static_cast<unsigned long>(used_bytes_), static_cast<unsigned long>(millis() - start_ms));
+}
+
+bool ClipCache::ensureMounted()
+{
+  if (mounted_)
+  {
+    return true;
+  }
+  if (formatted_)
+  {
+    return false; // フォーマットしてもマウントできなかった
+  }
+  uint32_t start_ms = millis();
+  formatted_ = true;
+  mounted_ = LittleFS.begin(true, "/littlefs", 4, kPartitionLabel);
+  if (!mounted_)
+  {
+    log_e("Clip cache: LittleFS format failed");
+    return false;
+  }
+  LittleFS.mkdir(kClipDir);
+  log_i("Clip cache: formatted in %lu ms", static_cast<unsigned long>(millis() - start_ms));
+  return true;
+}
+
+void ClipCache::loadIndex()
+{
+  entries_.clear();
+  used_bytes_ = 0;
+  use_counter_ = 0;
+
+  File file = LittleFS.open(kIndexPath, FILE_READ);
+  if (!file)
+  {
+    return;
+  }
+  uint32_t header[3] = {};
+  if (file.read(reinterpret_cast<uint8_t *>(header), sizeof(header)) != sizeof(header) ||
+      header[0] != kIndexMagic || header[1] != sizeof(Entry) || header[2] > kMaxEntries)
+  {
+    log_w("Clip cache: index is invalid; starting empty");
+    file.close();
+    return;
+  }
+  entries_.resize(header[2]);
+  size_t bytes = entries_.size() * sizeof(Entry);
+  if (file.read(reinterpret_cast<uint8_t *>(entries_.data()), bytes) != bytes)
+  {
+    log_w("Clip cache: index truncated; starting empty");
+    entries_.clear();
+  }
+  file.close();
+
+  for (const Entry &entry : entries_)
+  {
+    used_bytes_ += entry.bytes;
+    use_counter_ = std::max(use_counter_, entry.last_used);
+  }
+}
+
+bool ClipCache::saveIndex()
+{
+  File file = LittleFS.open(kIndexPath, FILE_WRITE);
+  if (!file)
+  {
+    log_w("Clip cache: failed to write index");
+    return false;
+  }
+  const uint32_t header[3] = {kIndexMagic, sizeof(Entry), static_cast<uint32_t>(entries_.size())};
+  file.write(reinterpret_cast<const uint8_t *>(header), sizeof(header));
+  file.write(reinterpret_cast<const uint8_t *>(entries_.data()), entries_.size() * sizeof(Entry));
+  file.close();
+  index_dirty_ = false;
+  return true;
+}
+
+void ClipCache::flushIndex()
+{
+  if (index_dirty_ && mounted_)
+  {
+    memory_plan::HeapScope heap_scope; // LittleFS の File は開くたびに new する
+    saveIndex();
+  }
+}
+
+ClipCache::Entry *ClipCache::find(uint32_t clip_id)
+{
+  for (Entry &entry : entries_)
+  {
+    if (entry.clip_id == clip_id)
+    {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+bool ClipCache::openForPlayback(uint32_t clip_id, ClipInfo &info)
+{
+  Entry *entry = mounted_ ? find(clip_id) : nullptr;
+  if (entry == nullptr)
+  {
+    return false;
+  }
+
+  memory_plan::HeapScope heap_scope;
+  if (playing_)
+  {
+    play_file_.close();
+    playing_ = false;
+  }
+  play_file_ = LittleFS.open(clipPath(clip_id).buf, FILE_READ);
+  if (!play_file_)
+  {
+    // 索引だけ残っていた。消しておけば次からはサーバーが送り直す
+    log_w("Clip cache: %08lx missing on flash", static_cast<unsigned long>(clip_id));
+    removeEntry(static_cast<size_t>(entry - entries_.data()));
+    saveIndex();
+    report(ClipStatus::Evicted, clip_id);
+    return false;
+  }
+  playing_ = true;
+  play_clip_id_ = clip_id;
+
+  entry->last_used = ++use_counter_;
+  index_dirty_ = true;
+  info.sample_rate = entry->sample_rate;
+  info.channels = entry->channels;
+  info.bytes = entry->bytes;
+  return true;
+}
+
+size_t ClipCache::read(uint8_t *dst, size_t len)
+{
+  if (!playing_)
+  {
+    return 0;
+  }
+  size_t got = play_file_.read(dst, len);
+  if (got < len)
+  {
+    play_file_.close();
+    playing_ = false;
+  }
+  return got;
+}
+
+void ClipCache::removeEntry(size_t index)
+{
+  Entry entry = entries_[index];
+  if (playing_ && play_clip_id_ == entry.clip_id)
+  {
+    play_file_.close();
+    playing_ = false;
+  }
+  LittleFS.remove(clipPath(entry.clip_id).buf);
+  used_bytes_ -= std::min(used_bytes_, entry.bytes);
+  entries_.erase(entries_.begin() + static_cast<std::ptrdiff_t>(index));
+}
+
+bool ClipCache::makeRoom(uint32_t bytes, uint32_t replacing_id)
+{
+  // 同じ clip_id の置き換えは先に消す
+  if (Entry *existing = find(replacing_id))
+  {
+    removeEntry(static_cast<size_t>(existing - entries_.data()));
+  }
+
+  std::array<uint32_t, kMaxEntries> evicted;
+  size_t evicted_count = 0;
+  while (!entries_.empty() && (used_bytes_ + bytes > kCacheBudgetBytes || entries_.size() >= kMaxEntries))
+  {
+    auto lru = std::min_element(entries_.begin(), entries_.end(),
+                                [](const Entry &a, const Entry &b) { return a.last_used < b.last_used; });
+    evicted[evicted_count++] = lru->clip_id;
+    log_i("Clip cache: evict %08lx (%lu bytes)", static_cast<unsigned long>(lru->clip_id),
+          static_cast<unsigned long>(lru->bytes));
+    removeEntry(static_cast<size_t>(lru - entries_.begin()));
+  }
+  if (evicted_count > 0)
+  {
+    saveIndex();
+    if (on_result_)
+    {
+      on_result_(ClipStatus::Evicted, evicted.data(), evicted_count);
+    }
+  }
+  return used_bytes_ + bytes <= kCacheBudgetBytes;
+}
+
+void ClipCache::handleClipData(const WsHeader &hdr, const uint8_t *body, size_t len, bool accept)
+{
+  auto msg_type = static_cast<MessageType>(hdr.messageType);
+  memory_plan::HeapScope heap_scope;
+
+  if (msg_type == MessageType::START)
+  {
+    abortStore();
+    if (body == nullptr || len < 14)
+    {
+      log_w("ClipData START payload too short: %u", static_cast<unsigned>(len));
+      return;
+    }
+    store_entry_ = Entry{};
+    memcpy(&store_entry_.clip_id, body, sizeof(uint32_t));
+    memcpy(&store_entry_.sample_rate, body + 4, sizeof(uint32_t));
+    memcpy(&store_entry_.channels, body + 8, sizeof(uint16_t));
+    memcpy(&store_entry_.bytes, body + 10, sizeof(uint32_t));
+    store_received_ = 0;
+    storing_ = true;
+
+    if (!accept)
+    {
+      failStore("not idle");
+      return;
+    }
+    if (store_entry_.bytes == 0 || store_entry_.bytes > kMaxClipBytes || store_entry_.sample_rate == 0 ||
+        store_entry_.channels == 0)
+    {
+      failStore("invalid format");
+      return;
+    }
+    if (!ensureMounted())
+    {
+      failStore("filesystem unavailable");
+      return;
+    }
+    if (!makeRoom(store_entry_.bytes, store_entry_.clip_id))
+    {
+      failStore("no room");
+      return;
+    }
+    store_file_ = LittleFS.open(kStorePath, FILE_WRITE);
+    if (!store_file_)
+    {
+      failStore("open failed");
+    }
+    return;
+  }
+
+  if (!storing_)
+  {
+    return;
+  }
+  if (!accept)
+  {
+    failStore("left idle");
+    return;
+  }
+
+  if (msg_type == MessageType::DATA)
+  {
+    if (store_received_ + len > store_entry_.bytes)
+    {
+      failStore("more data than announced");
+      return;
+    }
+    if (len > 0 && store_file_.write(body, len) != len)
+    {
+      failStore("write failed (flash full?)");
+      return;
+    }
+    store_received_ += len;
+    return;
+  }
+
+  if (msg_type == MessageType::END)
+  {
+    store_file_.close();
+    if (store_received_ != store_entry_.bytes)
+    {
+      failStore("truncated");
+      return;
+    }
+    if (!LittleFS.rename(kStorePath, clipPath(store_entry_.clip_id).buf))
+    {
+      failStore("rename failed");
+      return;
+    }
+    storing_ = false;
+    store_entry_.last_used = ++use_counter_;
+    entries_.push_back(store_entry_);
+    used_bytes_ += store_entry_.bytes;
+    saveIndex();
+    log_i("Clip cache: stored %08lx (%lu bytes, %u clips %lu bytes total)",
+          static_cast<unsigned long>(store_entry_.clip_id), static_cast<unsigned long>(store_entry_.bytes),
+          static_cast<unsigned>(entries_.size()), static_cast<unsigned long>(used_bytes_));
+    report(ClipStatus::Stored, store_entry_.clip_id);
+  }
+}
+
+void ClipCache::abortStore()
+{
+  if (storing_)
+  {
+    memory_plan::HeapScope heap_scope;
+    failStore("aborted");
+  }
+}
+
+void ClipCache::failStore(const char *reason)
+{
+  log_w("Clip cache: store %08lx failed: %s", static_cast<unsigned long>(store_entry_.clip_id), reason);
+  if (store_file_)
+  {
+    store_file_.close();
+  }
+  if (mounted_)
+  {
+    LittleFS.remove(kStorePath);
+  }
+  storing_ = false;
+  report(ClipStatus::StoreFailed, store_entry_.clip_id);
+}
+
+void ClipCache::reportInventory()
+{
+  std::array<uint32_t, kMaxEntries> ids;
+  size_t count = 0;
+  for (const Entry &entry : entries_)
+  {
+    ids[count++] = entry.clip_id;
+  }
+  // 0 件でも送る。サーバーはこれでキャッシュ対応のファームウェアだと判断する
+  if (on_result_)
+  {
+    on_result_(ClipStatus::Inventory, ids.data(), count);
+  }
+}
+
+void ClipCache::report(ClipStatus status, uint32_t clip_id)
+{
+  if (on_result_)
+  {
+    on_result_(status, &clip_id, 1);
+  }
+}
+
+void ClipCache::setResultCallback(std::function<void(ClipStatus, const uint32_t *, size_t)> cb)
+{
+  on_result_ = std::move(cb);
+}
@@ -0,0 +1,199 @@
+#include "connection.hpp"
+
+#include <M5Unified.h>
+#include <Preferences.h>
+#include <cstring>
+#include "loop_wake.hpp"
+
+namespace
+{
+constexpr const char *kPrefsNamespace = "conn";
+constexpr const char *kPrefsLinkKey = "link";
+constexpr uint8_t kLinkCacheVersion = 2; // 1 は IP も持っていた
+// キャッシュした AP に繋がらなければ、スキャンからの通常接続に切り替える
+constexpr uint32_t kFastConnectTimeoutMs = 3000;
+} // namespace
+
+void ConnectionManager::begin(const char *ssid, const char *password)
+{
+  ssid_ = ssid;
+  password_ = password;
+
+  WiFi.onEvent([this](arduino_event_id_t event, arduino_event_info_t info) {
+    handleWiFiEvent(event, info);
+  });
+  WiFi.persistent(false);
+  WiFi.mode(WIFI_STA);
+  WiFi.setAutoReconnect(true);
+
+  LinkCache cache{};
+  if (!loadCache(cache))
+  {
+    beginFullConnect();
+    return;
+  }
+
+  log_i("WiFi fast connect: ch=%u bssid=%02x:%02x:%02x:%02x:%02x:%02x",
+        static_cast<unsigned>(cache.channel), cache.bssid[0], cache.bssid[1], cache.bssid[2], cache.bssid[3],
+        cache.bssid[4], cache.bssid[5]);
+  WiFi.begin(ssid_, password_, cache.channel, cache.bssid, true);
+  fast_connecting_ = true;
+  fast_connect_start_ms_ = millis();
+}
+
+void ConnectionManager::beginFullConnect()
+{
+  fast_connecting_ = false;
+  WiFi.begin(ssid_, password_);
+}
+
+void ConnectionManager::handleWiFiEvent(arduino_event_id_t event, arduino_event_info_t info)
+{
+  switch (event)
+  {
+  case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+    got_ip_ = true;
+    break;
+  case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+    disconnect_reason_ = info.wifi_sta_disconnected.reason;
+    link_lost_ = true;
+    break;
+  case ARDUINO_EVENT_WIFI_STA_LOST_IP:
+    link_lost_ = true;
+    break;
+  default:
+    return;
+  }
+  loop_wake::notify(loop_wake::Source::WiFi);
+}
+
+void ConnectionManager::loop(uint32_t now)
+{
+  if (link_lost_.exchange(false))
+  {
+    if (fast_connecting_)
+    {
+      log_w("WiFi fast connect failed (reason=%u); falling back to scan",
+            static_cast<unsigned>(disconnect_reason_.load()));
+      Preferences prefs;
+      if (prefs.begin(kPrefsNamespace, false))
+      {
+        prefs.remove(kPrefsLinkKey);
+        prefs.end();
+      }
+      WiFi.disconnect();
+      beginFullConnect();
+    }
+    else if (wifi_up_)
+    {
+      log_w("WiFi link lost (reason=%u)", static_cast<unsigned>(disconnect_reason_.load()));
+      wifi_up_ = false;
+      if (drop_ms_ == 0)
+      {
+        drop_ms_ = now;
+        drop_was_wifi_ = true;
+      }
+      // ソケットのタイムアウトを待たずに切断扱いにする。再接続は Arduino 側の自動再接続に任せる
+      ws_.disconnect();
+    }
+  }
+
+  if (got_ip_.exchange(false))
+  {
+    wifi_up_ = true;
+    if (first_wifi_up_ms_ == 0)
+    {
+      first_wifi_up_ms_ = now;
+    }
+    const IPAddress ip = WiFi.localIP(); // toString() は String を確保するので使わない
+    log_i("WiFi up at %lu ms (%s) ip=%u.%u.%u.%u", static_cast<unsigned long>(now), fast_connecting_ ? "fast" : "scan",
+          static_cast<unsigned>(ip[0]), static_cast<unsigned>(ip[1]), static_cast<unsigned>(ip[2]),
+          static_cast<unsigned>(ip[3]));
+    fast_connecting_ = false;
+    saveCache();
+    ws_.reconnectNow();
+  }
+
+  if (fast_connecting_ && now - fast_connect_start_ms_ >= kFastConnectTimeoutMs)
+  {
+    log_w("WiFi fast connect timed out; falling back to scan");
+    link_lost_ = false;
+    WiFi.disconnect();
+    beginFullConnect();
+  }
+}
+
+uint32_t ConnectionManager::msUntilNextUpdate(uint32_t now) const
+{
+  if (!fast_connecting_)
+  {
+    return UINT32_MAX;
+  }
+  uint32_t elapsed = now - fast_connect_start_ms_;
+  return elapsed >= kFastConnectTimeoutMs ? 0 : kFastConnectTimeoutMs - elapsed;
+}
+
+void ConnectionManager::onWsConnected()
+{
+  // 起動時の接続は BootSequence が計測する。ここでは切断からの復帰だけを記録する
+  if (drop_ms_ != 0)
+  {
+    log_i("reconnected in %lu ms (%s drop)", static_cast<unsigned long>(millis() - drop_ms_),
+          drop_was_wifi_ ? "wifi" : "websocket");
+  }
+  drop_ms_ = 0;
+  drop_was_wifi_ = false;
+}
+
+void ConnectionManager::onWsDisconnected()
+{
+  if (drop_ms_ == 0)
+  {
+    drop_ms_ = millis();
+    drop_was_wifi_ = !wifi_up_;
+  }
+}
+
+bool ConnectionManager::loadCache(LinkCache &cache)
+{
+  Preferences prefs;
+  if (!prefs.begin(kPrefsNamespace, true))
+  {
+    return false;
+  }
+  size_t len = prefs.getBytes(kPrefsLinkKey, &cache, sizeof(cache));
+  prefs.end();
+
+  return len == sizeof(cache) && cache.version == kLinkCacheVersion && cache.channel != 0 &&
+         strncmp(cache.ssid, ssid_, sizeof(cache.ssid)) == 0;
+}
+
+void ConnectionManager::saveCache()
+{
+  LinkCache cache{};
+  cache.version = kLinkCacheVersion;
+  strncpy(cache.ssid, ssid_, sizeof(cache.ssid) - 1);
+  const uint8_t *bssid = WiFi.BSSID();
+  if (bssid == nullptr)
+  {
+    return;
+  }
+  memcpy(cache.bssid, bssid, sizeof(cache.bssid));
+  cache.channel = static_cast<uint8_t>(WiFi.channel());
+
+  // 変わっていなければ書かない（フラッシュの書き込み回数を抑える）
+  LinkCache stored{};
+  if (loadCache(stored) && memcmp(&stored, &cache, sizeof(cache)) == 0)
+  {
+    return;
+  }
+
+  Preferences prefs;
+  if (!prefs.begin(kPrefsNamespace, false))
+  {
+    log_w("NVS open failed; WiFi link not cached");
+    return;
+  }
+  prefs.putBytes(kPrefsLinkKey, &cache, sizeof(cache));
+  prefs.end();
+}
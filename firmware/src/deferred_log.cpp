@@ -0,0 +1,210 @@
+#include "deferred_log.hpp"
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+// 1 件 60 バイト（内部 RAM）。115200 baud では 1 行 80 文字で約 7 ms かかるので、
+// TTS の受信が続いても 1 秒弱は溜められる数にする
+constexpr UBaseType_t kQueueDepth = 128;
+constexpr size_t kLineBytes = 256;
+
+// 表示と同じく core 0 の低優先度タスクで出す（loop() は core 1）
+constexpr BaseType_t kDrainTaskCore = 0;
+constexpr UBaseType_t kDrainTaskPriority = 1;
+constexpr uint32_t kDrainTaskStackSize = 4096;
+
+QueueHandle_t g_queue = nullptr;
+std::atomic<uint32_t> g_dropped{0};
+
+void print(const deferred_log::Record &record)
+{
+  static char line[kLineBytes]; // 出力タスク（と init() 前の呼び出し元）だけが使う
+  deferred_log::format(record, line, sizeof(line));
+  const deferred_log::Site &site = *record.site;
+  log_printf("[%6u][%c][%s:%u] %s(): %s\r\n", static_cast<unsigned>(record.ms), site.level, pathToFileName(site.file),
+             static_cast<unsigned>(site.line), site.function, line);
+}
+
+void drainTask(void *)
+{
+  uint32_t reported_drops = 0;
+  deferred_log::Record record;
+  for (;;)
+  {
+    if (xQueueReceive(g_queue, &record, portMAX_DELAY) == pdTRUE)
+    {
+      print(record);
+    }
+    const uint32_t dropped = g_dropped.load(std::memory_order_relaxed);
+    if (dropped != reported_drops && uxQueueMessagesWaiting(g_queue) == 0)
+    {
+      log_printf("[%6u][W] deferred log: dropped %lu lines (queue full)\r\n", static_cast<unsigned>(millis()),
+                 static_cast<unsigned long>(dropped - reported_drops));
+      reported_drops = dropped;
+    }
+  }
+}
+
+// 変換指定 1 つを書式化する。spec は '%' とフラグ・幅・精度まで（長さ指定は渡す型に合わせてここで付ける）
+int formatOne(char *out, size_t out_len, char *spec, size_t spec_len, char conversion, deferred_log::Slot value)
+{
+  auto finish = [&](const char *length) {
+    for (const char *p = length; *p != '\0'; ++p)
+    {
+      spec[spec_len++] = *p;
+    }
+    spec[spec_len++] = conversion;
+    spec[spec_len] = '\0';
+  };
+  switch (conversion)
+  {
+  case 'd':
+  case 'i':
+    finish("l");
+    return snprintf(out, out_len, spec, static_cast<long>(static_cast<intptr_t>(value)));
+  case 'u':
+  case 'x':
+  case 'X':
+  case 'o':
+    finish("l");
+    return snprintf(out, out_len, spec, static_cast<unsigned long>(value));
+  case 'c':
+    finish("");
+    return snprintf(out, out_len, spec, static_cast<int>(value));
+  case 's':
+    finish("");
+    return snprintf(out, out_len, spec, value != 0 ? reinterpret_cast<const char *>(value) : "(null)");
+  case 'p':
+    finish("");
+    return snprintf(out, out_len, spec, reinterpret_cast<void *>(value));
+  case 'f':
+  case 'F':
+  case 'e':
+  case 'E':
+  case 'g':
+  case 'G':
+  case 'a':
+  case 'A':
+  {
+    const uint32_t bits = static_cast<uint32_t>(value);
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    finish("");
+    return snprintf(out, out_len, spec, static_cast<double>(f));
+  }
+  default:
+    return snprintf(out, out_len, "%%%c", conversion);
+  }
+}
+} // namespace
+
+namespace deferred_log
+{
+void init()
+{
+  if (!DEFERRED_LOG || g_queue != nullptr)
+  {
+    return;
+  }
+  g_queue = xQueueCreate(kQueueDepth, sizeof(Record));
+  if (g_queue == nullptr)
+  {
+    log_e("Deferred log: failed to create queue; logging inline");
+    return;
+  }
+  if (xTaskCreatePinnedToCore(drainTask, "log_drain", kDrainTaskStackSize, nullptr, kDrainTaskPriority, nullptr,
+                              kDrainTaskCore) != pdPASS)
+  {
+    log_e("Deferred log: failed to start task; logging inline");
+    vQueueDelete(g_queue);
+    g_queue = nullptr;
+  }
+}
+
+uint32_t dropped()
+{
+  return g_dropped.load(std::memory_order_relaxed);
+}
+
+void push(const Site &site, const Slot *args, size_t count)
+{
+  Record record;
+  record.site = &site;
+  record.ms = millis();
+  record.count = static_cast<uint8_t>(std::min(count, kMaxArgs));
+  memcpy(record.args, args, record.count * sizeof(Slot));
+  if (g_queue == nullptr)
+  {
+    print(record); // init() 前（起動直後）はその場で出す
+    return;
+  }
+  if (xQueueSend(g_queue, &record, 0) != pdTRUE)
+  {
+    g_dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+size_t format(const Record &record, char *out, size_t out_len)
+{
+  if (out_len == 0)
+  {
+    return 0;
+  }
+  size_t len = 0;
+  size_t arg = 0;
+  const char *p = record.site->format;
+  while (*p != '\0' && len + 1 < out_len)
+  {
+    if (*p != '%')
+    {
+      out[len++] = *p++;
+      continue;
+    }
+    if (p[1] == '%')
+    {
+      out[len++] = '%';
+      p += 2;
+      continue;
+    }
+
+    // %[flags][width][.precision][length]conversion。幅・精度の '*' は使わない前提
+    char spec[24];
+    size_t spec_len = 0;
+    spec[spec_len++] = *p++;
+    while (*p != '\0' && strchr("-+ #0", *p) != nullptr && spec_len < 8)
+    {
+      spec[spec_len++] = *p++;
+    }
+    while (*p != '\0' && (isdigit(static_cast<unsigned char>(*p)) || *p == '.') && spec_len < 20)
+    {
+      spec[spec_len++] = *p++;
+    }
+    while (*p != '\0' && strchr("hlLqjzt", *p) != nullptr)
+    {
+      ++p;
+    }
+    if (*p == '\0')
+    {
+      break;
+    }
+    const char conversion = *p++;
+    const Slot value = arg < record.count ? record.args[arg++] : 0;
+    const int n = formatOne(out + len, out_len - len, spec, spec_len, conversion, value);
+    if (n > 0)
+    {
+      len = std::min(len + static_cast<size_t>(n), out_len - 1);
+    }
+  }
+  out[len] = '\0';
+  return len;
+}
+} // namespace deferred_log
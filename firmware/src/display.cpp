@@ -1,32 +1,202 @@
 #include "display.hpp"
 
-Display::Display(StateMachine &stateMachine) : state_(stateMachine) {}
+#include <algorithm>
+
+namespace
+{
+constexpr int16_t kScreenWidth = 320;
+constexpr int16_t kScreenHeight = 240;
+constexpr uint32_t kFrameIntervalMs = 33; // 30 fps
+constexpr uint32_t kStatsLogIntervalMs = 5000;
+
+// Arduino の loop() は core 1 で動くため、描画は core 0 の低優先度タスクで行う
+constexpr BaseType_t kDisplayTaskCore = 0;
+constexpr UBaseType_t kDisplayTaskPriority = 1;
+constexpr uint32_t kDisplayTaskStackSize = 4096;
+
+constexpr int16_t kStatusBarY = 220;
+constexpr int16_t kStatusBarHeight = kScreenHeight - kStatusBarY;
+
+constexpr int16_t kEyeY = 102;
+constexpr int16_t kBetweenEyes = 135;
+constexpr int16_t kEyeSize = 8;
+constexpr int16_t kMouthCenterY = 159;
+constexpr int16_t kMouthWidth = 85;
+constexpr int16_t kMouthMinHeight = 4;
+constexpr int16_t kMouthMaxHeight = 24;
+
+constexpr uint32_t kBlinkDurationMs = 160;
+constexpr long kBlinkIntervalMinMs = 2500;
+constexpr long kBlinkIntervalMaxMs = 6000;
+
+int16_t eyeCenterX(int index)
+{
+  return index == 0 ? 160 - kBetweenEyes / 2 : 160 + kBetweenEyes / 2;
+}
+
+// 各レイヤーが占有する矩形（描画前にこの範囲を背景色で塗り直す）
+constexpr int16_t kEyeRectSize = kEyeSize * 2 + 2;
+constexpr int16_t kMouthRectX = 160 - kMouthWidth / 2 - 1;
+constexpr int16_t kMouthRectY = kMouthCenterY - kMouthMaxHeight / 2 - 1;
+constexpr int16_t kMouthRectWidth = kMouthWidth + 2;
+constexpr int16_t kMouthRectHeight = kMouthMaxHeight + 2;
+} // namespace
+
+Display::Display(StateMachine &stateMachine) : state_(stateMachine), canvas_(&M5.Display) {}
 
 void Display::init()
 {
   M5.Display.clear();
-  M5.Display.setTextSize(2);
-  drawForState(state_.getState());
-  drawFace();
+
+  // 画面全体のバックバッファを PSRAM に確保し、変更された領域だけを LCD に転送する
+  canvas_.setColorDepth(16);
+  canvas_.setPsram(true);
+  canvas_ready_ = canvas_.createSprite(kScreenWidth, kScreenHeight) != nullptr;
+  if (!canvas_ready_)
+  {
+    log_w("Display canvas allocation failed; drawing directly to LCD");
+  }
+
+  StateMachine::State current = state_.getState();
+  target().fillScreen(TFT_BLACK);
+  markDirty({0, 0, kScreenWidth, kScreenHeight});
+  drawStatusLayer(current);
+  drawEyesLayer(face_.eye_open);
+  drawMouthLayer(face_.mouth_open);
+  flushDirty();
+
   has_prev_state_ = true;
-  prev_state_ = state_.getState();
+  prev_state_ = current;
+  command_.state = current;
+  last_stats_log_ms_ = millis();
+
+  if (xTaskCreatePinnedToCore(taskEntry, "display", kDisplayTaskStackSize, this,
+                              kDisplayTaskPriority, &task_, kDisplayTaskCore) != pdPASS)
+  {
+    task_ = nullptr;
+    log_w("Failed to start display task; rendering from loop()");
+  }
 }
 
 void Display::loop()
 {
-  StateMachine::State current = state_.getState();
+  RenderCommand command{};
+  command.state = state_.getState();
+  command.mouth_level = mouth_level_;
+  mailbox_.publish(command);
+
+  if (task_ != nullptr)
+  {
+    return;
+  }
+
+  // 描画タスクが無い場合のみ loop() 内で描画する
+  uint32_t now = millis();
+  if (now - last_frame_ms_ < kFrameIntervalMs)
+  {
+    return;
+  }
+  last_frame_ms_ = now;
+  mailbox_.consume(command_);
+  renderFrame(now);
+}
+
+void Display::taskEntry(void *arg)
+{
+  static_cast<Display *>(arg)->taskLoop();
+}
+
+void Display::taskLoop()
+{
+  TickType_t last_wake = xTaskGetTickCount();
+  for (;;)
+  {
+    mailbox_.consume(command_);
+    renderFrame(millis());
+    vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(kFrameIntervalMs));
+  }
+}
+
+void Display::renderFrame(uint32_t now)
+{
+  uint32_t start_us = micros();
+  StateMachine::State current = command_.state;
+  updateAnimation(command_, now);
+
+  if (canvas_ready_)
+  {
+    // 前フレームの DMA 転送がバックバッファを読み終えるまで待つ
+    M5.Display.waitDMA();
+  }
+
   if (!has_prev_state_ || current != prev_state_)
   {
-    M5.Display.fillScreen(TFT_BLACK);
-    drawForState(current);
-    drawFace();
+    drawStatusLayer(current);
+  }
+  if (face_.eye_open != drawn_face_.eye_open)
+  {
+    drawEyesLayer(face_.eye_open);
+  }
+  if (face_.mouth_open != drawn_face_.mouth_open)
+  {
+    drawMouthLayer(face_.mouth_open);
   }
 
   prev_state_ = current;
   has_prev_state_ = true;
+
+  if (dirty_count_ > 0)
+  {
+    size_t spi_bytes = flushDirty();
+    recordFrame(micros() - start_us, spi_bytes);
+  }
+  logStats(now);
+}
+
+LovyanGFX &Display::target()
+{
+  if (canvas_ready_)
+  {
+    return canvas_;
+  }
+  return M5.Display;
+}
+
+void Display::updateAnimation(const RenderCommand &command, uint32_t now)
+{
+  if (next_blink_ms_ == 0)
+  {
+    next_blink_ms_ = now + random(kBlinkIntervalMinMs, kBlinkIntervalMaxMs);
+  }
+  if (!blinking_ && static_cast<int32_t>(now - next_blink_ms_) >= 0)
+  {
+    blinking_ = true;
+    blink_start_ms_ = now;
+  }
+
+  uint8_t eye_open = 100;
+  if (blinking_)
+  {
+    uint32_t elapsed = now - blink_start_ms_;
+    if (elapsed >= kBlinkDurationMs)
+    {
+      blinking_ = false;
+      next_blink_ms_ = now + random(kBlinkIntervalMinMs, kBlinkIntervalMaxMs);
+    }
+    else
+    {
+      // 閉じて開く三角波
+      constexpr uint32_t half = kBlinkDurationMs / 2;
+      uint32_t distance = elapsed < half ? half - elapsed : elapsed - half;
+      eye_open = static_cast<uint8_t>(distance * 100 / half);
+    }
+  }
+  face_.eye_open = eye_open;
+
+  face_.mouth_open = command.state == StateMachine::Speaking ? command.mouth_level : 0;
 }
 
-void Display::drawForState(StateMachine::State state)
+void Display::drawStatusLayer(StateMachine::State state)
 {
   uint16_t bg_color;
   uint16_t font_color;
@@ -59,23 +229,140 @@ void Display::drawForState(StateMachine::State state)
     break;
   }
 
-  M5.Display.fillRect(0, 220, 320, 240, bg_color);
-  M5.Display.setFont(&fonts::Font2);
-  M5.Display.setTextSize(1);
-  M5.Display.setTextColor(font_color, bg_color);
-  M5.Display.setCursor(10, 222);
-  M5.Display.printf("%s", stateToString(state));
+  LovyanGFX &gfx = target();
+  gfx.fillRect(0, kStatusBarY, kScreenWidth, kStatusBarHeight, bg_color);
+  gfx.setFont(&fonts::Font2);
+  gfx.setTextSize(1);
+  gfx.setTextColor(font_color, bg_color);
+  gfx.setCursor(10, kStatusBarY + 2);
+  gfx.printf("%s", stateToString(state));
+  markDirty({0, kStatusBarY, kScreenWidth, kStatusBarHeight});
+}
+
+void Display::drawEyesLayer(uint8_t eye_open)
+{
+  LovyanGFX &gfx = target();
+  int16_t radius_y = std::max<int16_t>(1, static_cast<int16_t>(kEyeSize * eye_open / 100));
+  for (int i = 0; i < 2; ++i)
+  {
+    Rect rect{static_cast<int16_t>(eyeCenterX(i) - kEyeRectSize / 2),
+              static_cast<int16_t>(kEyeY - kEyeRectSize / 2),
+              kEyeRectSize,
+              kEyeRectSize};
+    gfx.fillRect(rect.x, rect.y, rect.w, rect.h, TFT_BLACK);
+    gfx.fillEllipse(eyeCenterX(i), kEyeY, kEyeSize, radius_y, TFT_WHITE);
+    markDirty(rect);
+  }
+  drawn_face_.eye_open = eye_open;
+}
+
+void Display::drawMouthLayer(uint8_t mouth_open)
+{
+  LovyanGFX &gfx = target();
+  int16_t height = kMouthMinHeight + static_cast<int16_t>((kMouthMaxHeight - kMouthMinHeight) * mouth_open / 100);
+  gfx.fillRect(kMouthRectX, kMouthRectY, kMouthRectWidth, kMouthRectHeight, TFT_BLACK);
+  gfx.fillRect(160 - kMouthWidth / 2, kMouthCenterY - height / 2, kMouthWidth, height, TFT_WHITE);
+  markDirty({kMouthRectX, kMouthRectY, kMouthRectWidth, kMouthRectHeight});
+  drawn_face_.mouth_open = mouth_open;
+}
+
+void Display::markDirty(const Rect &rect)
+{
+  auto merge = [](Rect &dst, const Rect &src) {
+    int16_t x0 = std::min(dst.x, src.x);
+    int16_t y0 = std::min(dst.y, src.y);
+    int16_t x1 = std::max<int16_t>(dst.x + dst.w, src.x + src.w);
+    int16_t y1 = std::max<int16_t>(dst.y + dst.h, src.y + src.h);
+    dst = {x0, y0, static_cast<int16_t>(x1 - x0), static_cast<int16_t>(y1 - y0)};
+  };
+
+  for (size_t i = 0; i < dirty_count_; ++i)
+  {
+    Rect &r = dirty_[i];
+    bool overlaps = rect.x < r.x + r.w && r.x < rect.x + rect.w &&
+                    rect.y < r.y + r.h && r.y < rect.y + rect.h;
+    if (overlaps)
+    {
+      merge(r, rect);
+      return;
+    }
+  }
+
+  if (dirty_count_ < kMaxDirtyRects)
+  {
+    dirty_[dirty_count_++] = rect;
+    return;
+  }
+
+  // 枠が足りなければ最後の矩形に併合する
+  merge(dirty_[kMaxDirtyRects - 1], rect);
+}
+
+size_t Display::flushDirty()
+{
+  size_t spi_bytes = 0;
+  if (canvas_ready_)
+  {
+    auto *pixels = static_cast<const lgfx::swap565_t *>(canvas_.getBuffer());
+    M5.Display.startWrite();
+    for (size_t i = 0; i < dirty_count_; ++i)
+    {
+      const Rect &r = dirty_[i];
+      // クリップ矩形内だけがバックバッファから転送される
+      M5.Display.setClipRect(r.x, r.y, r.w, r.h);
+      M5.Display.pushImageDMA(0, 0, kScreenWidth, kScreenHeight, pixels);
+    }
+    M5.Display.clearClipRect();
+    M5.Display.endWrite();
+  }
+
+  for (size_t i = 0; i < dirty_count_; ++i)
+  {
+    spi_bytes += static_cast<size_t>(dirty_[i].w) * dirty_[i].h * sizeof(uint16_t);
+  }
+  dirty_count_ = 0;
+  return spi_bytes;
+}
+
+void Display::recordFrame(uint32_t elapsed_us, size_t spi_bytes)
+{
+  stats_.frames++;
+  stats_.total_us += elapsed_us;
+  stats_.max_us = std::max(stats_.max_us, elapsed_us);
+  stats_.spi_bytes += static_cast<uint32_t>(spi_bytes);
+
+  size_t bucket = kFrameHistogramBoundsMs.size();
+  for (size_t i = 0; i < kFrameHistogramBoundsMs.size(); ++i)
+  {
+    if (elapsed_us <= kFrameHistogramBoundsMs[i] * 1000)
+    {
+      bucket = i;
+      break;
+    }
+  }
+  stats_.histogram[bucket]++;
 }
 
-void Display::drawFace()
-{
-  uint32_t eye_y = 102;
-  uint32_t between_eyes = 135;
-  uint32_t eye_size = 8;
-  uint32_t mouth_y = 157;
-  uint32_t mouth_width = 85;
-  uint32_t mouth_height = 4;
-  M5.Display.fillCircle(160 - between_eyes / 2, eye_y, eye_size, TFT_WHITE);
-  M5.Display.fillCircle(160 + between_eyes / 2, eye_y, eye_size, TFT_WHITE);
-  M5.Display.fillRect(160 - mouth_width / 2, mouth_y, mouth_width, mouth_height, TFT_WHITE);
+void Display::logStats(uint32_t now)
+{
+  if (now - last_stats_log_ms_ < kStatsLogIntervalMs)
+  {
+    return;
+  }
+  last_stats_log_ms_ = now;
+
+  if (stats_.frames > 0)
+  {
+    const auto &h = stats_.histogram;
+    log_i("display: frames=%lu avg=%lu us max=%lu us spi=%lu B/frame hist(<=1/2/4/8/16/33/>33ms)=%lu/%lu/%lu/%lu/%lu/%lu/%lu",
+          static_cast<unsigned long>(stats_.frames),
+          static_cast<unsigned long>(stats_.total_us / stats_.frames),
+          static_cast<unsigned long>(stats_.max_us),
+          static_cast<unsigned long>(stats_.spi_bytes / stats_.frames),
+          static_cast<unsigned long>(h[0]), static_cast<unsigned long>(h[1]),
+          static_cast<unsigned long>(h[2]), static_cast<unsigned long>(h[3]),
+          static_cast<unsigned long>(h[4]), static_cast<unsigned long>(h[5]),
+          static_cast<unsigned long>(h[6]));
+  }
+  stats_ = FrameStats{};
 }
@@ -0,0 +1,216 @@
+#include "doa_estimator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+constexpr float kSpeedOfSoundMmPerSec = 343000.0f;
+constexpr float kPi = 3.14159265f;
+
+// 使う帯域の下限。これより下は空調などの低周波ノイズが多く、位相差も小さい
+constexpr float kMinFrequencyHz = 300.0f;
+constexpr float kMaxFrequencyHz = 5000.0f;
+
+// 発話区間の判定: 雑音レベルの追従値より 9 dB 以上大きく、かつ絶対値でも一定以上
+constexpr float kVoicedRatio = 8.0f;
+constexpr float kMinVoicedEnergy = 300.0f * 300.0f;
+constexpr float kNoiseFloorRise = 1.002f; // 1 ブロックあたり（約 +0.5 dB/s）
+constexpr float kNoiseFloorFall = 0.1f;
+
+// 相互スペクトルの平滑化係数と、推定を出す間隔（発話ブロック数）
+constexpr float kCrossSmoothing = 0.2f;
+constexpr uint32_t kMinVoicedBlocks = 4;
+constexpr uint32_t kBlocksPerEstimate = 2;
+} // namespace
+
+void DoaEstimator::configure(int sample_rate, float mic_spacing_mm)
+{
+  const float bin_hz = static_cast<float>(sample_rate) / static_cast<float>(kFftSize);
+  // マイク間隔が半波長を超える周波数では位相差が一意に決まらない
+  const float alias_hz = kSpeedOfSoundMmPerSec / (2.0f * mic_spacing_mm);
+  bin_lo_ = std::max<size_t>(1, static_cast<size_t>(std::ceil(kMinFrequencyHz / bin_hz)));
+  bin_hi_ = std::min(kBins, static_cast<size_t>(std::min(alias_hz, kMaxFrequencyHz) / bin_hz));
+  bin_hi_ = std::max(bin_hi_, bin_lo_ + 1);
+
+  fft_.init();
+  for (size_t i = 0; i < kFftSize; ++i)
+  {
+    float phase = 2.0f * kPi * static_cast<float>(i) / static_cast<float>(kFftSize);
+    window_[i] = 0.5f - 0.5f * std::cos(phase);
+  }
+
+  const float max_delay = mic_spacing_mm / kSpeedOfSoundMmPerSec * static_cast<float>(sample_rate);
+  for (size_t a = 0; a < kAngles; ++a)
+  {
+    float angle = static_cast<float>(static_cast<int>(a) * kAngleStepDeg - 90) * kPi / 180.0f;
+    float delay = max_delay * std::sin(angle);
+    float step = 2.0f * kPi * delay / static_cast<float>(kFftSize);
+    angle_step_re_[a] = std::cos(step);
+    angle_step_im_[a] = std::sin(step);
+    angle_start_re_[a] = std::cos(step * static_cast<float>(bin_lo_));
+    angle_start_im_[a] = std::sin(step * static_cast<float>(bin_lo_));
+  }
+  configured_ = true;
+  reset();
+}
+
+void DoaEstimator::reset()
+{
+  cross_re_.fill(0.0f);
+  cross_im_.fill(0.0f);
+  pending_frames_ = 0;
+  noise_floor_ = kMinVoicedEnergy;
+  voiced_blocks_ = 0;
+  fresh_ = false;
+}
+
+void DoaEstimator::process(const int16_t *interleaved, size_t frames, uint32_t now_ms)
+{
+  if (!configured_)
+  {
+    return;
+  }
+  while (frames > 0)
+  {
+    size_t n = std::min(frames, kFftSize - pending_frames_);
+    memcpy(&pending_[pending_frames_ * 2], interleaved, n * 2 * sizeof(int16_t));
+    pending_frames_ += n;
+    interleaved += n * 2;
+    frames -= n;
+    if (pending_frames_ == kFftSize)
+    {
+      processBlock(now_ms);
+      pending_frames_ = 0;
+    }
+  }
+}
+
+bool DoaEstimator::take(Estimate &estimate)
+{
+  if (!fresh_)
+  {
+    return false;
+  }
+  fresh_ = false;
+  estimate = latest_;
+  return true;
+}
+
+void DoaEstimator::processBlock(uint32_t now_ms)
+{
+  if (!isVoiced())
+  {
+    return;
+  }
+  accumulateCrossSpectrum();
+  voiced_blocks_++;
+  if (voiced_blocks_ >= kMinVoicedBlocks && voiced_blocks_ % kBlocksPerEstimate == 0)
+  {
+    estimate(now_ms);
+  }
+}
+
+bool DoaEstimator::isVoiced()
+{
+  float energy = 0.0f;
+  for (size_t i = 0; i < kFftSize * 2; ++i)
+  {
+    float v = static_cast<float>(pending_[i]);
+    energy += v * v;
+  }
+  energy /= static_cast<float>(kFftSize * 2);
+
+  bool voiced = energy > noise_floor_ * kVoicedRatio && energy > kMinVoicedEnergy;
+  if (energy < noise_floor_)
+  {
+    noise_floor_ += (energy - noise_floor_) * kNoiseFloorFall;
+  }
+  else if (!voiced)
+  {
+    noise_floor_ *= kNoiseFloorRise;
+  }
+  return voiced;
+}
+
+void DoaEstimator::accumulateCrossSpectrum()
+{
+  // 実信号 2 本を 1 回の複素 FFT で変換する: z = L + jR
+  for (size_t i = 0; i < kFftSize; ++i)
+  {
+    fft_re_[i] = static_cast<float>(pending_[2 * i]) * window_[i];
+    fft_im_[i] = static_cast<float>(pending_[2 * i + 1]) * window_[i];
+  }
+  fft_.forward(fft_re_.data(), fft_im_.data());
+
+  for (size_t k = bin_lo_; k < bin_hi_; ++k)
+  {
+    float zr = fft_re_[k];
+    float zi = fft_im_[k];
+    float nr = fft_re_[kFftSize - k];
+    float ni = fft_im_[kFftSize - k];
+    // L = (Z[k] + conj(Z[N-k])) / 2, R = (Z[k] - conj(Z[N-k])) / 2j（共通の 1/2 は正規化で消える）
+    float lr = zr + nr;
+    float li = zi - ni;
+    float rr = zi + ni;
+    float ri = nr - zr;
+    // L * conj(R) を振幅で割る（PHAT）
+    float cr = lr * rr + li * ri;
+    float ci = li * rr - lr * ri;
+    float mag = std::sqrt(cr * cr + ci * ci) + 1e-9f;
+    cross_re_[k] += (cr / mag - cross_re_[k]) * kCrossSmoothing;
+    cross_im_[k] += (ci / mag - cross_im_[k]) * kCrossSmoothing;
+  }
+}
+
+void DoaEstimator::estimate(uint32_t now_ms)
+{
+  std::array<float, kAngles> response{};
+  float norm = 0.0f;
+  for (size_t k = bin_lo_; k < bin_hi_; ++k)
+  {
+    norm += std::sqrt(cross_re_[k] * cross_re_[k] + cross_im_[k] * cross_im_[k]);
+  }
+
+  size_t best = 0;
+  for (size_t a = 0; a < kAngles; ++a)
+  {
+    // Re(Σ G[k] e^{jkω})。R が先に届く（L が遅れる）とき G[k] の位相は -kω になる
+    float pr = angle_start_re_[a];
+    float pi = angle_start_im_[a];
+    const float sr = angle_step_re_[a];
+    const float si = angle_step_im_[a];
+    float sum = 0.0f;
+    for (size_t k = bin_lo_; k < bin_hi_; ++k)
+    {
+      sum += cross_re_[k] * pr - cross_im_[k] * pi;
+      float next_r = pr * sr - pi * si;
+      pi = pr * si + pi * sr;
+      pr = next_r;
+    }
+    response[a] = sum;
+    if (sum > response[best])
+    {
+      best = a;
+    }
+  }
+
+  // 隣の格子点との放物線補間で角度を細かくする
+  float offset = 0.0f;
+  if (best > 0 && best + 1 < kAngles)
+  {
+    float left = response[best - 1];
+    float right = response[best + 1];
+    float denom = left - 2.0f * response[best] + right;
+    if (denom < 0.0f)
+    {
+      offset = std::max(-0.5f, std::min(0.5f, 0.5f * (left - right) / denom));
+    }
+  }
+
+  latest_.angle_deg = (static_cast<float>(best) + offset) * kAngleStepDeg - 90.0f;
+  latest_.confidence = norm > 0.0f ? std::max(0.0f, response[best] / norm) : 0.0f;
+  latest_.at_ms = now_ms;
+  fresh_ = true;
+}
@@ -1,59 +1,219 @@
 #include "listening.hpp"
 #include <algorithm>
 #include <cstring>
-#include <vector>
 #include <cstdlib>
+#include <esp_random.h>
+#include "deferred_log.hpp"
 
-Listening::Listening(WebSocketsClient &ws, StateMachine &sm, int sampleRate)
-    : ws_(ws), state_(sm), sample_rate_(sampleRate),
-      chunk_samples_(static_cast<size_t>(sampleRate) / 8),
-      ring_capacity_samples_(static_cast<size_t>(sampleRate) * 2)
+namespace
 {
+constexpr uint32_t kResumeWindowMs = 8000;
+// 発話待ちの間に残しておく直前の音。検知した時点で語頭は既に始まっているので一緒に送る
+constexpr uint32_t kPreRollMs = 300;
+
+// DATA の長さの自動調整
+// 伸ばすのは詰まりを検知するたび（ただし前の変更から kStepUpIntervalMs 以上あける）、縮めるのは kRecoverMs 詰まらなかったとき
+constexpr uint32_t kStepUpIntervalMs = 300;
+constexpr uint32_t kRecoverMs = 2000;
+constexpr uint32_t kAckLagMs = 600;     // 確認待ちがこれより長いと、サーバーまでの経路が詰まっている
+constexpr uint32_t kRssiCheckMs = 1000;
+constexpr int8_t kWeakRssiDbm = -75;    // これを下回ったら伸ばし、kRecoveredRssiDbm を上回るまで縮めない
+constexpr int8_t kRecoveredRssiDbm = -70;
+// 1 DATA あたりの付加バイト（WsHeader・WebSocket のフレームヘッダとマスク・TCP/IPv4 ヘッダ）。統計の目安用
+constexpr uint32_t kPerChunkOverheadBytes = sizeof(WsHeader) + 8 + 40;
+
+// seq（uint16 で巡回）が a <= b の関係にあるか
+bool seqNotAfter(uint16_t a, uint16_t b)
+{
+  return static_cast<uint16_t>(b - a) < 0x8000;
 }
+} // namespace
 
-void Listening::init()
+Listening::Listening(WsClient &ws, StateMachine &sm, MicFrontEnd &mic, int sampleRate)
+    : ws_(ws), state_(sm), mic_(mic), sample_rate_(sampleRate),
+      chunk_samples_(static_cast<size_t>(sampleRate) * kChunkMsLevels[kSlowestChunkLevel] / 1000),
+      ring_capacity_samples_(static_cast<size_t>(sampleRate) * kSpoolSeconds),
+      max_chunk_samples_(maxChunkSamples(sampleRate))
 {
-  if (ring_buffer_)
-  {
-    heap_caps_free(ring_buffer_);
-    ring_buffer_ = nullptr;
-  }
+}
 
-  if (ring_buffer_)
+void Listening::init()
+{
+  // 領域は memory_plan の初期化で 0 にしてある
+  if (ring_buffer_ == nullptr)
   {
-    heap_caps_free(ring_buffer_);
-    ring_buffer_ = nullptr;
+    ring_buffer_ = static_cast<int16_t *>(memory_plan::take(memory_plan::Module::Listening, memory_plan::Region::Psram,
+                                                            ring_capacity_samples_ * sizeof(int16_t)));
+    send_buf_ = static_cast<int16_t *>(memory_plan::take(memory_plan::Module::Listening, memory_plan::Region::Internal,
+                                                         max_chunk_samples_ * sizeof(int16_t)));
+    packet_ = static_cast<uint8_t *>(memory_plan::take(memory_plan::Module::Listening, memory_plan::Region::Internal,
+                                                       sizeof(WsHeader) + max_chunk_samples_ * sizeof(int16_t)));
   }
-  ring_buffer_ = (int16_t *)heap_caps_malloc(ring_capacity_samples_ * sizeof(int16_t), MALLOC_CAP_8BIT);
-  if (ring_buffer_)
+  if (ring_buffer_ == nullptr)
   {
-    memset(ring_buffer_, 0, ring_capacity_samples_ * sizeof(int16_t));
+    log_e("Listening spool alloc failed (%u bytes)", static_cast<unsigned>(ring_capacity_samples_ * sizeof(int16_t)));
   }
-  ring_write_ = ring_read_ = ring_available_ = 0;
+  resetSpool();
   seq_counter_ = 0;
   streaming_ = false;
+  suspended_ = false;
+  uplink_.init();
+  if (log_mel_)
+  {
+    log_mel_extractor_.init(sample_rate_);
+  }
+}
+
+void Listening::enableLogMelUplink(bool enabled)
+{
+  log_mel_ = enabled;
+  chunk_samples_ = unitsForMs(kChunkMsLevels[chunk_level_]);
+}
+
+uint32_t Listening::getChunkMs() const
+{
+  size_t samples = log_mel_ ? chunk_samples_ / kLogMelFrameUnits * LogMelExtractor::kHopSamples : chunk_samples_;
+  return static_cast<uint32_t>(samples * 1000 / static_cast<size_t>(sample_rate_));
+}
+
+size_t Listening::unitsForMs(uint32_t ms) const
+{
+  if (log_mel_)
+  {
+    return static_cast<size_t>(sample_rate_) * ms / 1000 / LogMelExtractor::kHopSamples * kLogMelFrameUnits;
+  }
+  return static_cast<size_t>(sample_rate_) * ms / 1000;
 }
 
 void Listening::begin()
 {
+  if (suspended_)
+  {
+    // マイクは保留中も動かしたまま
+    if (!resumeStreaming())
+    {
+      log_w("Uplink resume failed");
+    }
+    return;
+  }
   M5.Mic.begin();
+  mic_.reset();
+  uplink_.reset();
+  log_mel_extractor_.reset();
+  if (follow_up_requested_)
+  {
+    // 再生直後。マイクだけ先に動かし、発話を検知してから START を送る
+    follow_up_requested_ = false;
+    resetSpool();
+    last_level_ = 0;
+    speech_reads_ = 0;
+    awaiting_speech_ = true;
+    awaiting_since_ms_ = millis();
+    return;
+  }
   startStreaming();
 }
 
 void Listening::end()
 {
+  if ((streaming_ || suspended_) && !ws_.isConnected())
+  {
+    // 送信途中の切断。録音は続け、再接続後に同じセッションとして再開する
+    streaming_ = false;
+    if (!suspended_)
+    {
+      suspended_ = true;
+      suspended_since_ms_ = millis();
+      log_w("Uplink suspended: session=%08lx seq=%u unacked=%u unsent=%u", static_cast<unsigned long>(session_id_),
+            static_cast<unsigned>(seq_counter_), static_cast<unsigned>(unacked_samples_),
+            static_cast<unsigned>(ring_available_));
+    }
+    return;
+  }
+  suspended_ = false;
+  follow_up_requested_ = false;
+  awaiting_speech_ = false;
   stopStreaming();
   M5.Mic.end();
 }
 
-bool Listening::startStreaming()
+bool Listening::canResume() const
+{
+  return suspended_ && millis() - suspended_since_ms_ < kResumeWindowMs;
+}
+
+void Listening::armFollowUp(uint32_t window_ms)
+{
+  follow_up_requested_ = window_ms > 0;
+  follow_up_window_ms_ = window_ms;
+}
+
+void Listening::resetSpool()
 {
   ring_write_ = ring_read_ = ring_available_ = 0;
+  unacked_samples_ = 0;
+  sent_head_ = sent_count_ = 0;
+  unacked_dropped_samples_ = 0;
+  overrun_samples_ = 0;
+}
+
+bool Listening::startStreaming()
+{
+  resetSpool();
+  return openSession(0);
+}
+
+bool Listening::startAwaitedStream()
+{
+  // スプールに残した語頭（プリロール）はそのまま DATA として送る
+  awaiting_speech_ = false;
+  return openSession(kWsFlagFollowUp);
+}
+
+bool Listening::openSession(uint8_t flags)
+{
   seq_counter_ = 0;
   last_level_ = 0;
   silence_since_ms_ = 0;
+  suspended_ = false;
+  session_id_ = esp_random() | 1; // 0 は「セッション ID なし」
+  streaming_ = true;
+
+  acked_ = false;
+  max_send_us_ = 0;
+  healthy_since_ms_ = millis();
+  stat_chunks_ = stat_bytes_ = stat_peak_send_us_ = stat_level_changes_ = 0;
+  stat_send_us_ = 0;
+  stat_started_ms_ = millis();
+  // 前のセッションで分かったサーバーの認識方式と電波の状態から始める（切り替えないなら 125 ms）
+  setChunkLevel(adaptive_chunks_ && server_streaming_ && !weak_signal_ ? 0 : kSlowestChunkLevel, "session start");
+  return sendPacket(MessageType::START, seq_counter_++, flags, &session_id_, sizeof(session_id_));
+}
+
+bool Listening::resumeStreaming()
+{
+  if (!sendPacket(MessageType::START, seq_counter_++, kWsFlagResume, &session_id_, sizeof(session_id_)))
+  {
+    return false;
+  }
+  uint32_t suspended_ms = millis() - suspended_since_ms_;
+  size_t resent = sent_count_;
+  suspended_ = false;
   streaming_ = true;
-  return sendPacket(MessageType::START, nullptr, 0);
+  // 確認が取れていない DATA は届いていない可能性があるので、元の seq のまま送り直す（重複はサーバーが捨てる）
+  bool ok = retransmitUnacked();
+  log_i("Uplink resumed: session=%08lx after %lu ms resent=%u chunks lost=%lu samples",
+        static_cast<unsigned long>(session_id_), static_cast<unsigned long>(suspended_ms),
+        static_cast<unsigned>(resent), static_cast<unsigned long>(unacked_dropped_samples_ + overrun_samples_));
+  return ok;
+}
+
+void Listening::abandonSuspended()
+{
+  log_w("Uplink resume window expired; dropping session=%08lx", static_cast<unsigned long>(session_id_));
+  suspended_ = false;
+  resetSpool();
+  M5.Mic.end();
 }
 
 bool Listening::stopStreaming()
@@ -63,65 +223,129 @@ bool Listening::stopStreaming()
     return true;
   }
 
-  // flush remaining samples before END
+  // flush remaining samples before END（録り終えた分なので、DATA の長さは最長でまとめて送る）
   bool ok = true;
-  if (ring_available_ > 0)
+  size_t flush_samples = std::max(chunk_samples_, unitsForMs(kChunkMsLevels[kSlowestChunkLevel]));
+  while (ring_available_ > 0)
   {
-    const size_t tail_capacity = chunk_samples_;
-    std::vector<int16_t> tail_buf(tail_capacity);
-    size_t to_send = ring_available_;
-    while (to_send > 0)
+    if (!sendChunk(std::min(flush_samples, ring_available_)))
     {
-      size_t chunk = std::min({chunk_samples_, to_send, tail_capacity});
-      size_t sent = ringPop(tail_buf.data(), chunk);
-      if (!sendPacket(MessageType::DATA, tail_buf.data(), sent))
-      {
-        ok = false;
-        break;
-      }
-      to_send -= sent;
+      ok = false;
+      break;
     }
   }
+  if (suspended_)
+  {
+    // 送信の失敗で切れ、切断イベントの end() が保留にした。スプールは再接続後に送り直すので残し、END も送らない
+    return false;
+  }
 
   streaming_ = false;
-  ok = sendPacket(MessageType::END, nullptr, 0) && ok;
+  ok = sendPacket(MessageType::END, seq_counter_++, 0, nullptr, 0) && ok;
+  dlog_i("Listening stream stopped: seq=%u overrun_samples=%lu",
+         static_cast<unsigned>(seq_counter_), static_cast<unsigned long>(overrun_samples_));
+  if (stat_chunks_ > 0)
+  {
+    uint32_t elapsed_ms = std::max<uint32_t>(1, millis() - stat_started_ms_);
+    dlog_i("Uplink DATA: %lu chunks in %lu ms (%lu.%lu/s) send avg=%lu peak=%lu us overhead=%lu.%lu%% "
+           "chunk=%lu ms changes=%lu",
+           static_cast<unsigned long>(stat_chunks_), static_cast<unsigned long>(elapsed_ms),
+           static_cast<unsigned long>(stat_chunks_ * 1000ULL / elapsed_ms),
+           static_cast<unsigned long>(stat_chunks_ * 10000ULL / elapsed_ms % 10),
+           static_cast<unsigned long>(stat_send_us_ / stat_chunks_), static_cast<unsigned long>(stat_peak_send_us_),
+           static_cast<unsigned long>(stat_chunks_ * kPerChunkOverheadBytes * 100ULL / stat_bytes_),
+           static_cast<unsigned long>(stat_chunks_ * kPerChunkOverheadBytes * 1000ULL / stat_bytes_ % 10),
+           static_cast<unsigned long>(getChunkMs()), static_cast<unsigned long>(stat_level_changes_));
+  }
+  uplink_.logStats();
+  if (log_mel_)
+  {
+    log_mel_extractor_.logStats();
+  }
+  resetSpool();
+  return ok;
+}
+
+bool Listening::cancelStreaming()
+{
+  awaiting_speech_ = false;
+  bool ok = true;
+  if (streaming_)
+  {
+    streaming_ = false;
+    ok = sendPacket(MessageType::END, seq_counter_++, kWsFlagCancel, nullptr, 0);
+    log_i("Listening stream cancelled: seq=%u", static_cast<unsigned>(seq_counter_));
+  }
+  else if (suspended_)
+  {
+    // 切断中に取り消した場合は再開せずに捨てる（サーバー側はセッションごと破棄される）
+    suspended_ = false;
+    M5.Mic.end();
+  }
+  resetSpool();
   return ok;
 }
 
 void Listening::loop()
 {
-  if (!streaming_)
+  if (!streaming_ && !suspended_ && !awaiting_speech_)
   {
     return;
   }
 
-  static int16_t mic_buf[256];
+  static int16_t mic_buf[MicFrontEnd::kMaxReadSamples];
+  static int16_t uplink_buf[UplinkFrontEnd::kBlockSamples];
+  static_assert(MicFrontEnd::kMaxReadSamples == UplinkFrontEnd::kBlockSamples, "uplink front end expects whole mic reads");
   if (M5.Mic.isEnabled())
   {
-    if (M5.Mic.record(mic_buf, mic_read_samples_, sample_rate_))
+    if (mic_.read(mic_buf, mic_read_samples_))
     {
-      ringPush(mic_buf, mic_read_samples_);
+      // 無音判定と SR への供給は録音したままの音で行う（閾値は前処理前のレベルで決めている）
+      uplink_.process(mic_buf, uplink_buf);
+      if (log_mel_)
+      {
+        // 256 サンプルで 1〜2 フレーム。フレームのバイト列を int16 の単位としてスプールに入れる
+        static uint16_t mel_buf[2 * kLogMelFrameUnits];
+        size_t frames = log_mel_extractor_.push(uplink_buf, mic_read_samples_, reinterpret_cast<uint8_t *>(mel_buf), 2);
+        ringPush(reinterpret_cast<const int16_t *>(mel_buf), frames * kLogMelFrameUnits);
+      }
+      else
+      {
+        ringPush(uplink_buf, mic_read_samples_);
+      }
       updateLevelStats(mic_buf, mic_read_samples_);
+      if (on_capture_)
+      {
+        on_capture_(mic_buf, mic_read_samples_);
+      }
     }
   }
 
-  while (ring_available_ >= chunk_samples_)
+  if (awaiting_speech_)
+  {
+    loopAwaitingSpeech();
+    return;
+  }
+
+  if (suspended_)
   {
-    static std::vector<int16_t> send_buf;
-    if (send_buf.size() < chunk_samples_)
+    if (!canResume())
     {
-      send_buf.resize(chunk_samples_);
+      abandonSuspended();
     }
+    return;
+  }
 
-    size_t got = ringPop(send_buf.data(), chunk_samples_);
-    if (!sendPacket(MessageType::DATA, send_buf.data(), got))
+  while (ring_available_ >= chunk_samples_)
+  {
+    if (!sendChunk(chunk_samples_))
     {
-      streaming_ = false;
+      // 未送信分はスプールに残る。切断イベントで保留に移り、再接続後に送る
       log_i("WS send failed (data)");
-      state_.setState(StateMachine::Idle);
       return;
     }
   }
+  adaptChunkSize();
 
   // 無音が3秒続いたら終了
   if (shouldStopForSilence())
@@ -131,13 +355,202 @@ void Listening::loop()
     {
       log_i("WS send failed (tail/end)");
     }
-    state_.setState(StateMachine::Idle);
+    state_.dispatch(StateMachine::Event::ListenFinished);
 
     // 終了直後のTTS再生でMic/Speakerが競合しないよう、少し待つ
     delay(20);
   }
 }
 
+void Listening::loopAwaitingSpeech()
+{
+  // 発話前の音は直近の kPreRollMs だけ残す
+  size_t pre_roll = unitsForMs(kPreRollMs);
+  if (ring_available_ > pre_roll)
+  {
+    size_t drop = ring_available_ - pre_roll;
+    ring_read_ = (ring_read_ + drop) % ring_capacity_samples_;
+    ring_available_ -= drop;
+  }
+
+  speech_reads_ = last_level_ > kSpeechOnsetLevel ? speech_reads_ + 1 : 0;
+  uint32_t waited = millis() - awaiting_since_ms_;
+  if (speech_reads_ >= kSpeechOnsetReads)
+  {
+    log_i("Follow-up speech after %lu ms (level=%ld)", static_cast<unsigned long>(waited),
+          static_cast<long>(last_level_));
+    if (!startAwaitedStream())
+    {
+      log_i("WS send failed (follow-up start)");
+    }
+    return;
+  }
+
+  if (waited >= follow_up_window_ms_)
+  {
+    log_i("Follow-up window closed after %lu ms without speech", static_cast<unsigned long>(waited));
+    awaiting_speech_ = false;
+    state_.dispatch(StateMachine::Event::ListenFinished);
+  }
+}
+
+void Listening::handleAck(const uint8_t *body, size_t bodyLen)
+{
+  // payload: <uint32 session_id><uint16 seq>
+  uint32_t session_id = 0;
+  uint16_t seq = 0;
+  if (body == nullptr || bodyLen < sizeof(session_id) + sizeof(seq))
+  {
+    return;
+  }
+  memcpy(&session_id, body, sizeof(session_id));
+  memcpy(&seq, body + sizeof(session_id), sizeof(seq));
+  if (session_id != session_id_)
+  {
+    return;
+  }
+  acked_ = true;
+  // flags の無い ack（古いサーバー）はストリーミング認識かどうか分からないので、従来の長さで送る
+  server_streaming_ = bodyLen > sizeof(session_id) + sizeof(seq) &&
+                      (body[sizeof(session_id) + sizeof(seq)] & kPcmAckFlagStreaming) != 0;
+
+  while (sent_count_ > 0 && seqNotAfter(sent_[sent_head_].seq, seq))
+  {
+    releaseOldestSent();
+  }
+}
+
+bool Listening::sendChunk(size_t samples)
+{
+  if (send_buf_ == nullptr || samples > max_chunk_samples_)
+  {
+    return false;
+  }
+  ringCopy(ring_read_, send_buf_, samples);
+
+  uint16_t seq = seq_counter_;
+  uint32_t start_us = micros();
+  if (!sendPacket(MessageType::DATA, seq, 0, send_buf_, samples * sizeof(int16_t)))
+  {
+    return false;
+  }
+  uint32_t send_us = micros() - start_us;
+  seq_counter_++;
+  max_send_us_ = std::max(max_send_us_, send_us);
+  stat_chunks_++;
+  stat_bytes_ += static_cast<uint32_t>(samples * sizeof(int16_t));
+  stat_send_us_ += send_us;
+  stat_peak_send_us_ = std::max(stat_peak_send_us_, send_us);
+
+  // 送信済みの分は確認が来るまでスプールに残す
+  if (sent_count_ == kMaxSentChunks)
+  {
+    releaseOldestSent();
+  }
+  sent_[(sent_head_ + sent_count_) % kMaxSentChunks] = SentChunk{seq, static_cast<uint16_t>(samples)};
+  sent_count_++;
+  ring_read_ = (ring_read_ + samples) % ring_capacity_samples_;
+  ring_available_ -= samples;
+  unacked_samples_ += samples;
+  return true;
+}
+
+void Listening::adaptChunkSize()
+{
+  if (!adaptive_chunks_)
+  {
+    return;
+  }
+
+  // 詰まりの兆候: sendBIN が DATA の長さの半分以上待たされた（TCP の送信窓が埋まっている）・ack が遅れている・電波が弱い
+  uint32_t now = millis();
+  const char *congestion = nullptr;
+  if (max_send_us_ * 2 > getChunkMs() * 1000)
+  {
+    congestion = "send blocked";
+  }
+  else if (acked_ && unacked_samples_ > unitsForMs(kAckLagMs))
+  {
+    congestion = "ack lag";
+  }
+  max_send_us_ = 0;
+  if (now - rssi_checked_ms_ >= kRssiCheckMs)
+  {
+    rssi_checked_ms_ = now;
+    int8_t rssi = WiFi.RSSI();
+    weak_signal_ = rssi < (weak_signal_ ? kRecoveredRssiDbm : kWeakRssiDbm);
+    if (weak_signal_ && congestion == nullptr)
+    {
+      congestion = "weak signal";
+    }
+  }
+
+  if (congestion != nullptr)
+  {
+    healthy_since_ms_ = now;
+    if (chunk_level_ < kSlowestChunkLevel && now - chunk_changed_ms_ >= kStepUpIntervalMs)
+    {
+      setChunkLevel(chunk_level_ + 1, congestion);
+    }
+    return;
+  }
+
+  // バッチ認識のサーバーは END まで認識しないので、短くしてもオーバーヘッドが増えるだけ
+  size_t fastest = server_streaming_ ? 0 : kSlowestChunkLevel;
+  if (chunk_level_ < fastest)
+  {
+    setChunkLevel(fastest, "server not streaming");
+  }
+  else if (chunk_level_ > fastest && !weak_signal_ && now - healthy_since_ms_ >= kRecoverMs)
+  {
+    healthy_since_ms_ = now;
+    setChunkLevel(chunk_level_ - 1, "link healthy");
+  }
+}
+
+void Listening::setChunkLevel(size_t level, const char *reason)
+{
+  if (level == chunk_level_)
+  {
+    return;
+  }
+  uint32_t before_ms = getChunkMs();
+  chunk_level_ = level;
+  chunk_samples_ = unitsForMs(kChunkMsLevels[level]);
+  chunk_changed_ms_ = millis();
+  stat_level_changes_++;
+  dlog_i("Uplink chunk %lu -> %lu ms (%s)", static_cast<unsigned long>(before_ms),
+         static_cast<unsigned long>(getChunkMs()), reason);
+}
+
+bool Listening::retransmitUnacked()
+{
+  if (send_buf_ == nullptr)
+  {
+    return false;
+  }
+  size_t pos = (ring_read_ + ring_capacity_samples_ - unacked_samples_) % ring_capacity_samples_;
+  for (size_t i = 0; i < sent_count_; ++i)
+  {
+    const SentChunk &chunk = sent_[(sent_head_ + i) % kMaxSentChunks];
+    ringCopy(pos, send_buf_, chunk.samples);
+    if (!sendPacket(MessageType::DATA, chunk.seq, 0, send_buf_, chunk.samples * sizeof(int16_t)))
+    {
+      return false;
+    }
+    pos = (pos + chunk.samples) % ring_capacity_samples_;
+  }
+  return true;
+}
+
+void Listening::releaseOldestSent()
+{
+  const SentChunk &chunk = sent_[sent_head_];
+  unacked_samples_ -= std::min<size_t>(unacked_samples_, chunk.samples);
+  sent_head_ = (sent_head_ + 1) % kMaxSentChunks;
+  sent_count_--;
+}
+
 void Listening::updateLevelStats(const int16_t *samples, size_t sampleCount)
 {
   if (sampleCount == 0)
@@ -182,35 +595,34 @@ bool Listening::shouldStopForSilence() const
   return elapsed >= kSilenceDurationMs;
 }
 
-bool Listening::sendPacket(MessageType type, const int16_t *samples, size_t sampleCount)
+bool Listening::sendPacket(MessageType type, uint16_t seq, uint8_t flags, const void *payload, size_t bytes)
 {
-  if ((WiFi.status() != WL_CONNECTED) || !ws_.isConnected())
+  if ((WiFi.status() != WL_CONNECTED) || !ws_.isConnected() || packet_ == nullptr ||
+      bytes > max_chunk_samples_ * sizeof(int16_t))
   {
     return false;
   }
 
   WsHeader header{};
-  header.kind = static_cast<uint8_t>(MessageKind::AudioPcm);
+  header.kind = static_cast<uint8_t>(log_mel_ ? MessageKind::AudioLogMel : MessageKind::AudioPcm);
   header.messageType = static_cast<uint8_t>(type);
-  header.reserved = 0;
-  header.seq = seq_counter_++;
-  header.payloadBytes = static_cast<uint16_t>(sampleCount * sizeof(int16_t));
+  header.reserved = flags;
+  header.seq = seq;
+  header.payloadBytes = static_cast<uint16_t>(bytes);
 
-  std::vector<uint8_t> packet;
-  packet.resize(sizeof(WsHeader) + header.payloadBytes);
-  memcpy(packet.data(), &header, sizeof(WsHeader));
-  if (header.payloadBytes > 0 && samples != nullptr)
+  // 短い DATA を頻繁に送るので、送信バッファは使い回す
+  memcpy(packet_, &header, sizeof(WsHeader));
+  if (header.payloadBytes > 0 && payload != nullptr)
   {
-    memcpy(packet.data() + sizeof(WsHeader), samples, header.payloadBytes);
+    memcpy(packet_ + sizeof(WsHeader), payload, header.payloadBytes);
   }
 
-  ws_.sendBIN(packet.data(), packet.size());
-  return true;
+  return ws_.sendBIN(packet_, sizeof(WsHeader) + header.payloadBytes);
 }
 
 void Listening::ringPush(const int16_t *src, size_t samples)
 {
-  if (samples == 0)
+  if (samples == 0 || ring_buffer_ == nullptr)
   {
     return;
   }
@@ -221,9 +633,17 @@ void Listening::ringPush(const int16_t *src, size_t samples)
     samples = ring_capacity_samples_;
   }
 
-  size_t overflow = (ring_available_ + samples > ring_capacity_samples_) ? (ring_available_ + samples - ring_capacity_samples_) : 0;
+  // 溢れる分は、まず確認待ちの古い DATA を手放し、それでも足りなければ未送信の先頭を捨てる
+  while (sent_count_ > 0 && unacked_samples_ + ring_available_ + samples > ring_capacity_samples_)
+  {
+    unacked_dropped_samples_ += sent_[sent_head_].samples;
+    releaseOldestSent();
+  }
+  size_t used = unacked_samples_ + ring_available_;
+  size_t overflow = (used + samples > ring_capacity_samples_) ? (used + samples - ring_capacity_samples_) : 0;
   if (overflow > 0)
   {
+    overrun_samples_ += static_cast<uint32_t>(overflow);
     ring_read_ = (ring_read_ + overflow) % ring_capacity_samples_;
     ring_available_ -= overflow;
   }
@@ -239,22 +659,13 @@ void Listening::ringPush(const int16_t *src, size_t samples)
   ring_available_ += samples;
 }
 
-size_t Listening::ringPop(int16_t *dst, size_t samples)
+void Listening::ringCopy(size_t pos, int16_t *dst, size_t samples) const
 {
-  size_t to_read = std::min(samples, ring_available_);
-  if (to_read == 0)
-  {
-    return 0;
-  }
-
-  size_t first = std::min(to_read, ring_capacity_samples_ - ring_read_);
-  memcpy(dst, ring_buffer_ + ring_read_, first * sizeof(int16_t));
-  size_t remain = to_read - first;
+  size_t first = std::min(samples, ring_capacity_samples_ - pos);
+  memcpy(dst, ring_buffer_ + pos, first * sizeof(int16_t));
+  size_t remain = samples - first;
   if (remain > 0)
   {
     memcpy(dst + first, ring_buffer_, remain * sizeof(int16_t));
   }
-  ring_read_ = (ring_read_ + to_read) % ring_capacity_samples_;
-  ring_available_ -= to_read;
-  return to_read;
 }
@@ -0,0 +1,68 @@
+#include "local_commands.hpp"
+
+// phoneme は ESP-SR MultiNet5 英語モデルの表記。フレーズを追加する場合は
+// ESP-SR の g2p ツールで生成する（MultiNet6 以降は str のみで認識する）
+const sr_cmd_t kLocalCommandPhrases[] = {
+    {static_cast<int>(LocalCommand::VolumeUp), "turn it up", "TkN gT cP"},
+    {static_cast<int>(LocalCommand::VolumeDown), "quieter", "KWicTk"},
+    {static_cast<int>(LocalCommand::VolumeDown), "softer", "SnFTk"},
+    {static_cast<int>(LocalCommand::LookAtMe), "watch me", "Wnp Mm"},
+    {static_cast<int>(LocalCommand::Nod), "nod", "NnD"},
+};
+const size_t kLocalCommandPhraseCount = sizeof(kLocalCommandPhrases) / sizeof(kLocalCommandPhrases[0]);
+
+namespace
+{
+constexpr uint8_t kMoveX = static_cast<uint8_t>(ServoCommandOp::MoveX);
+constexpr uint8_t kMoveY = static_cast<uint8_t>(ServoCommandOp::MoveY);
+
+// 正面を向く: <count> <op><angle><duration_ms(le16)>...
+constexpr uint8_t kLookAtMeGesture[] = {
+    2,
+    kMoveX, 90, 0x2C, 0x01, // 300 ms
+    kMoveY, 85, 0x2C, 0x01,
+};
+
+// うなずく
+constexpr uint8_t kNodGesture[] = {
+    4,
+    kMoveY, 100, 0x96, 0x00, // 150 ms
+    kMoveY, 85, 0x96, 0x00,
+    kMoveY, 100, 0x96, 0x00,
+    kMoveY, 90, 0x96, 0x00,
+};
+} // namespace
+
+const char *localCommandToString(LocalCommand command)
+{
+  switch (command)
+  {
+  case LocalCommand::VolumeUp:
+    return "VolumeUp";
+  case LocalCommand::VolumeDown:
+    return "VolumeDown";
+  case LocalCommand::LookAtMe:
+    return "LookAtMe";
+  case LocalCommand::Nod:
+    return "Nod";
+  default:
+    return "Unknown";
+  }
+}
+
+bool localCommandGesture(LocalCommand command, const uint8_t *&payload, size_t &payload_len)
+{
+  switch (command)
+  {
+  case LocalCommand::LookAtMe:
+    payload = kLookAtMeGesture;
+    payload_len = sizeof(kLookAtMeGesture);
+    return true;
+  case LocalCommand::Nod:
+    payload = kNodGesture;
+    payload_len = sizeof(kNodGesture);
+    return true;
+  default:
+    return false;
+  }
+}
@@ -0,0 +1,192 @@
+#include "log_mel.hpp"
+
+#include <M5Unified.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+constexpr float kPi = 3.14159265f;
+
+// Slaney のメル尺度（1 kHz までは線形、それより上は対数）
+constexpr float kMelLinearHzPerMel = 200.0f / 3.0f;
+constexpr float kMelLogStartHz = 1000.0f;
+constexpr float kMelLogStartMel = kMelLogStartHz / kMelLinearHzPerMel;
+const float kMelLogStep = std::log(6.4f) / 27.0f;
+
+float hzToMel(float hz)
+{
+  if (hz < kMelLogStartHz)
+  {
+    return hz / kMelLinearHzPerMel;
+  }
+  return kMelLogStartMel + std::log(hz / kMelLogStartHz) / kMelLogStep;
+}
+
+float melToHz(float mel)
+{
+  if (mel < kMelLogStartMel)
+  {
+    return mel * kMelLinearHzPerMel;
+  }
+  return kMelLogStartHz * std::exp(kMelLogStep * (mel - kMelLogStartMel));
+}
+} // namespace
+
+void LogMelExtractor::init(int sample_rate)
+{
+  fft_.init();
+  for (size_t k = 0; k < kHalfFft; ++k)
+  {
+    float phase = 2.0f * kPi * static_cast<float>(k) / static_cast<float>(kFftSize);
+    split_re_[k] = std::cos(phase);
+    split_im_[k] = -std::sin(phase);
+  }
+  for (size_t i = 0; i < kWindowSamples; ++i)
+  {
+    // 周期的な Hann（torch.hann_window と同じ）
+    window_[i] = 0.5f - 0.5f * std::cos(2.0f * kPi * static_cast<float>(i) / static_cast<float>(kWindowSamples));
+  }
+
+  // バンド b は mel[b]〜mel[b+2] の三角形。面積が揃うよう 2 / (上端 - 下端) を掛ける
+  const float bin_hz = static_cast<float>(sample_rate) / static_cast<float>(kFftSize);
+  const float max_mel = hzToMel(static_cast<float>(sample_rate) / 2.0f);
+  size_t offset = 0;
+  for (size_t b = 0; b < kBands; ++b)
+  {
+    float lower = melToHz(max_mel * static_cast<float>(b) / static_cast<float>(kBands + 1));
+    float center = melToHz(max_mel * static_cast<float>(b + 1) / static_cast<float>(kBands + 1));
+    float upper = melToHz(max_mel * static_cast<float>(b + 2) / static_cast<float>(kBands + 1));
+    float norm = 2.0f / (upper - lower);
+
+    MelBand &band = bands_[b];
+    band.first_bin = 0;
+    band.bin_count = 0;
+    band.weight_offset = static_cast<uint16_t>(offset);
+    for (size_t k = 0; k < kSpectrumBins; ++k)
+    {
+      float hz = static_cast<float>(k) * bin_hz;
+      float w = std::max(0.0f, std::min((hz - lower) / (center - lower), (upper - hz) / (upper - center)));
+      if (w <= 0.0f)
+      {
+        if (band.bin_count > 0)
+        {
+          break;
+        }
+        continue;
+      }
+      if (band.bin_count == 0)
+      {
+        band.first_bin = static_cast<uint16_t>(k);
+      }
+      if (offset >= kMaxFilterWeights)
+      {
+        log_e("Log-mel filter table overflow");
+        return;
+      }
+      weights_[offset++] = w * norm;
+      band.bin_count++;
+    }
+  }
+  initialized_ = true;
+  reset();
+}
+
+void LogMelExtractor::reset()
+{
+  filled_ = 0;
+}
+
+size_t LogMelExtractor::push(const int16_t *samples, size_t count, uint8_t *out, size_t max_frames)
+{
+  size_t frames = 0;
+  while (count > 0 && initialized_)
+  {
+    size_t n = std::min(count, kWindowSamples - filled_);
+    memcpy(&history_[filled_], samples, n * sizeof(int16_t));
+    filled_ += n;
+    samples += n;
+    count -= n;
+    if (filled_ < kWindowSamples)
+    {
+      break;
+    }
+    if (frames < max_frames)
+    {
+      computeFrame(out + frames * kFrameBytes);
+      frames++;
+    }
+    // 次の窓は 1 ホップ先から
+    memmove(history_.data(), history_.data() + kHopSamples, (kWindowSamples - kHopSamples) * sizeof(int16_t));
+    filled_ = kWindowSamples - kHopSamples;
+  }
+  return frames;
+}
+
+void LogMelExtractor::computeFrame(uint8_t *out)
+{
+  uint32_t start = ESP.getCycleCount();
+
+  // x[2n] + j x[2n+1]（窓の外の 400〜511 はゼロ）
+  for (size_t n = 0; n < kHalfFft; ++n)
+  {
+    size_t even = 2 * n;
+    size_t odd = even + 1;
+    fft_re_[n] = even < kWindowSamples ? static_cast<float>(history_[even]) * window_[even] : 0.0f;
+    fft_im_[n] = odd < kWindowSamples ? static_cast<float>(history_[odd]) * window_[odd] : 0.0f;
+  }
+  fft_.forward(fft_re_.data(), fft_im_.data());
+
+  // X[k] = E[k] + W^k O[k]。E = (Z[k] + conj(Z[N/2-k])) / 2, O = (Z[k] - conj(Z[N/2-k])) / 2j
+  for (size_t k = 0; k <= kHalfFft; ++k)
+  {
+    size_t a = k % kHalfFft;
+    size_t b = (kHalfFft - k) % kHalfFft;
+    float zr = fft_re_[a];
+    float zi = fft_im_[a];
+    float nr = fft_re_[b];
+    float ni = fft_im_[b];
+    float er = 0.5f * (zr + nr);
+    float ei = 0.5f * (zi - ni);
+    float or_ = 0.5f * (zi + ni);
+    float oi = 0.5f * (nr - zr);
+    float wr = k < kHalfFft ? split_re_[k] : -1.0f;
+    float wi = k < kHalfFft ? split_im_[k] : 0.0f;
+    float xr = er + wr * or_ - wi * oi;
+    float xi = ei + wr * oi + wi * or_;
+    power_[k] = xr * xr + xi * xi;
+  }
+
+  for (size_t b = 0; b < kBands; ++b)
+  {
+    const MelBand &band = bands_[b];
+    float mel = 0.0f;
+    for (size_t i = 0; i < band.bin_count; ++i)
+    {
+      mel += power_[band.first_bin + i] * weights_[band.weight_offset + i];
+    }
+    float q = mel > 1.0f ? std::round(4.0f * std::log2(mel)) : 0.0f;
+    out[b] = static_cast<uint8_t>(std::min(255.0f, q));
+  }
+
+  uint32_t cycles = ESP.getCycleCount() - start;
+  stat_frames_++;
+  stat_cycles_total_ += cycles;
+  stat_cycles_max_ = std::max(stat_cycles_max_, cycles);
+}
+
+void LogMelExtractor::logStats()
+{
+  if (stat_frames_ == 0)
+  {
+    return;
+  }
+  log_i("Log-mel uplink: %lu frames (%lu bytes vs %lu bytes PCM), avg=%lu max=%lu cycles/frame",
+        static_cast<unsigned long>(stat_frames_), static_cast<unsigned long>(stat_frames_ * kFrameBytes),
+        static_cast<unsigned long>(stat_frames_ * kHopSamples * sizeof(int16_t)),
+        static_cast<unsigned long>(stat_cycles_total_ / stat_frames_), static_cast<unsigned long>(stat_cycles_max_));
+  stat_frames_ = 0;
+  stat_cycles_total_ = 0;
+  stat_cycles_max_ = 0;
+}
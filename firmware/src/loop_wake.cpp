@@ -0,0 +1,102 @@
+#include "loop_wake.hpp"
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+#include <freertos/task.h>
+#include <sys/select.h>
+#include <atomic>
+
+namespace
+{
+// lwIP と同じ core 0 で、受信の有無を見るだけの小さなタスク
+constexpr BaseType_t kWatchTaskCore = 0;
+constexpr UBaseType_t kWatchTaskPriority = 2;
+constexpr uint32_t kWatchTaskStackSize = 2560;
+
+constexpr EventBits_t bitOf(loop_wake::Source source)
+{
+  return static_cast<EventBits_t>(1) << static_cast<uint8_t>(source);
+}
+constexpr EventBits_t kAllBits = bitOf(loop_wake::Source::SocketRx) | bitOf(loop_wake::Source::Speech) |
+                                 bitOf(loop_wake::Source::WiFi);
+
+EventGroupHandle_t g_events = nullptr;
+TaskHandle_t g_watch_task = nullptr;
+// 監視の依頼。wait() が書いてから監視タスクに通知する
+std::atomic<int> g_watch_fd{-1};
+std::atomic<uint32_t> g_watch_timeout_ms{0};
+
+// wait() の依頼ごとに 1 回だけ select() する。読み残しがあっても次の依頼までは合図しないので空回りしない
+void watchTask(void *)
+{
+  for (;;)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    int fd = g_watch_fd.load();
+    if (fd < 0)
+    {
+      continue;
+    }
+    uint32_t timeout_ms = g_watch_timeout_ms.load();
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(fd, &readable);
+    timeval tv{};
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    // 受信・切断（読める扱いになる）・ソケットのエラーのどれでも loop() を起こす
+    if (select(fd + 1, &readable, nullptr, nullptr, &tv) != 0)
+    {
+      xEventGroupSetBits(g_events, bitOf(loop_wake::Source::SocketRx));
+    }
+  }
+}
+} // namespace
+
+namespace loop_wake
+{
+void init()
+{
+  if (g_events != nullptr)
+  {
+    return;
+  }
+  g_events = xEventGroupCreate();
+  if (g_events == nullptr)
+  {
+    log_e("loop_wake: event group alloc failed");
+    return;
+  }
+  if (xTaskCreatePinnedToCore(watchTask, "loop_wake", kWatchTaskStackSize, nullptr, kWatchTaskPriority,
+                              &g_watch_task, kWatchTaskCore) != pdPASS)
+  {
+    g_watch_task = nullptr;
+    log_e("loop_wake: socket watch task create failed; socket RX waits for the next deadline");
+  }
+}
+
+void notify(Source source)
+{
+  if (g_events != nullptr)
+  {
+    xEventGroupSetBits(g_events, bitOf(source));
+  }
+}
+
+uint32_t wait(uint32_t timeout_ms, int socket_fd)
+{
+  if (g_events == nullptr)
+  {
+    vTaskDelay(pdMS_TO_TICKS(timeout_ms));
+    return 0;
+  }
+  if (socket_fd >= 0 && g_watch_task != nullptr)
+  {
+    g_watch_fd = socket_fd;
+    g_watch_timeout_ms = timeout_ms;
+    xTaskNotifyGive(g_watch_task);
+  }
+  return xEventGroupWaitBits(g_events, kAllBits, pdTRUE, pdFALSE, pdMS_TO_TICKS(timeout_ms)) & kAllBits;
+}
+} // namespace loop_wake
@@ -1,12 +1,11 @@
-// Arduino IDE: board = ESP32S3系, ライブラリ: M5Unified, Links2004/WebSocketsClient
+// Arduino IDE: board = ESP32S3系, ライブラリ: M5Unified
 // 事前に: Tools→PSRAM有効（SEはPSRAM無しでも動くよう小さめバッファ）
 
 #include <M5Unified.h>
 #include <WiFi.h>
-#include <WebSocketsClient.h>
 #include <algorithm>
+#include <cmath>
 #include <cstring>
-#include <vector>
 #include "config.h"
 #include "../include/protocols.hpp"
 #include "../include/state_machine.hpp"
@@ -15,6 +14,52 @@
 #include "../include/wake_up_word.hpp"
 #include "../include/display.hpp"
 #include "../include/servo.hpp"
+#include "../include/power.hpp"
+#include "../include/ws_client.hpp"
+#include "../include/connection.hpp"
+#include "../include/boot.hpp"
+#include "../include/local_commands.hpp"
+#include "../include/clip_cache.hpp"
+#include "../include/mic_frontend.hpp"
+#include "../include/ws_capture.hpp"
+#include "../include/trace.hpp"
+#include "../include/deferred_log.hpp"
+#include "../include/loop_wake.hpp"
+#include "../include/memory_plan.hpp"
+
+#ifndef FOLLOW_UP_WINDOW_MS_H
+#define FOLLOW_UP_WINDOW_MS_H 0 // 古い config.h では会話モードを無効にする
+#endif
+#ifndef LOCAL_COMMANDS_H
+#define LOCAL_COMMANDS_H 0 // MultiNet を含む srmodels が必要
+#endif
+#ifndef MIC_BEAMFORMING_H
+#define MIC_BEAMFORMING_H 0 // 古い config.h では従来どおりモノラルで録音する
+#endif
+#ifndef MIC_SPACING_MM_H
+#define MIC_SPACING_MM_H 46.0f
+#endif
+#ifndef MIC_BEAM_STEER_DEG_H
+#define MIC_BEAM_STEER_DEG_H 0.0f
+#endif
+#ifndef UPLINK_FRONTEND_H
+#define UPLINK_FRONTEND_H 0 // 古い config.h では録音したまま送る
+#endif
+#ifndef UPLINK_ADAPTIVE_CHUNK_H
+#define UPLINK_ADAPTIVE_CHUNK_H 0 // 古い config.h では 125 ms 固定
+#endif
+#ifndef UPLINK_LOG_MEL_H
+#define UPLINK_LOG_MEL_H 0 // サーバーに特徴量を受け付ける recognizer が必要
+#endif
+#ifndef DOA_TRACKING_H
+#define DOA_TRACKING_H 0
+#endif
+#ifndef DOA_PAN_INVERT_H
+#define DOA_PAN_INVERT_H 0
+#endif
+#ifndef WS_CAPTURE_KB_H
+#define WS_CAPTURE_KB_H 0
+#endif
 
 //////////////////// 設定 ////////////////////
 const char *WIFI_SSID = WIFI_SSID_H;
@@ -23,16 +68,45 @@ const char *SERVER_HOST = SERVER_HOST_H;
 const int SERVER_PORT = SERVER_PORT_H;
 const char *SERVER_PATH = SERVER_PATH_H; // WebSocket エンドポイント
 const int SAMPLE_RATE = 16000;           // 16kHz モノラル
+const uint32_t FOLLOW_UP_WINDOW_MS = FOLLOW_UP_WINDOW_MS_H; // 再生後に続きの発話を待つ時間（0 で無効）
+const bool LOCAL_COMMANDS = LOCAL_COMMANDS_H != 0;           // ウェイクワード後のローカルコマンド認識
+const bool MIC_BEAMFORMING = MIC_BEAMFORMING_H != 0;         // 2 マイクのビームフォーミング
+const bool DOA_TRACKING = DOA_TRACKING_H != 0;               // 話者の方向へ首を向ける
+const bool UPLINK_FRONTEND = UPLINK_FRONTEND_H != 0;         // 送信前の HPF・雑音抑圧・AGC
+const bool UPLINK_LOG_MEL = UPLINK_LOG_MEL_H != 0;           // PCM の代わりに対数メル特徴量を送る
+const bool UPLINK_ADAPTIVE_CHUNK = UPLINK_ADAPTIVE_CHUNK_H != 0; // DATA の長さを回線とサーバーに合わせて変える
+const size_t WS_CAPTURE_KB = WS_CAPTURE_KB_H;                 // 送受信の記録に使う PSRAM（0 で無効）
 /////////////////////////////////////////////
 
+// 起動時に確保する実行時バッファの予算。seal() 後はどのモジュールもヒープから確保しない
+// （予算と使用量は最初に接続したときの seal() でログに出る）
+using memory_plan::Module;
+using memory_plan::Region;
+constexpr memory_plan::Budget kMemoryPlan[] = {
+    {Module::Listening, Region::Psram, Listening::psramBytes(SAMPLE_RATE)},
+    {Module::Listening, Region::Internal, Listening::internalBytes(SAMPLE_RATE)},
+    {Module::Speaking, Region::Psram, Speaking::kPsramBytes},
+    {Module::WsClient, Region::Psram, memory_plan::padded(WsClient::kRxBufferBytes)},
+    {Module::WsClient, Region::Internal, memory_plan::padded(WsClient::kTxBufferBytes)},
+    {Module::WsCapture, Region::Psram, WsCapture::psramBytes(WS_CAPTURE_KB * 1024)},
+    {Module::Trace, Region::Psram, trace::psramBytes(STACKCHAN_TRACE_KB * 1024)},
+};
+
 StateMachine stateMachine;
 
-static WebSocketsClient wsClient;
+static WsClient wsClient;
 static Speaking speaking(stateMachine);
-static Listening listening(wsClient, stateMachine, SAMPLE_RATE);
-static WakeUpWord wakeUpWord(stateMachine, SAMPLE_RATE);
+static MicFrontEnd micFrontEnd;
+static Listening listening(wsClient, stateMachine, micFrontEnd, SAMPLE_RATE);
+static WakeUpWord wakeUpWord(stateMachine, micFrontEnd, SAMPLE_RATE);
 static Display display(stateMachine);
 static BodyServo servo;
+static PowerManager power;
+static ConnectionManager connection(wsClient);
+static BootSequence boot;
+static ClipCache clipCache;
+static WsCapture wsCapture(wsClient);
+static TraceDump traceDump(wsClient);
 
 // Protocol types are defined in include/protocols.hpp
 namespace
@@ -40,6 +114,46 @@ namespace
 uint16_t g_uplink_seq = 0;
 uint32_t g_last_comm_ms = 0;
 constexpr uint32_t kCommTimeoutMs = 60000;
+// 上りイベントの payload の上限（ClipEvt: 状態 1 バイト + clip_id 最大 kMaxEntries 件）
+constexpr size_t kMaxUplinkEventBytes = 1 + ClipCache::kMaxEntries * sizeof(uint32_t);
+
+// loop() の待機の上限。期限の無いときもこの間隔で回る（受信・ESP-SR・Wi-Fi のイベントは loop_wake が待機を打ち切る）
+constexpr uint32_t kMaxLoopWaitMs = 1000;
+// 起動中は並行フェーズの完了（Idle へのゲート）を細かく確認する
+constexpr uint32_t kBootPollMs = 5;
+
+// ESP-SR のモデル読み込みは Wi-Fi と同じ core 0、表示の初回描画は loop() と同じ core 1 で行う
+constexpr BaseType_t kSrLoadCore = 0;
+constexpr uint32_t kSrLoadStackSize = 8192;
+constexpr BaseType_t kDisplayInitCore = 1;
+constexpr uint32_t kDisplayInitStackSize = 4096;
+
+// Idle の loop() 1 回で送る送受信の記録の上限
+constexpr size_t kCaptureUploadBytesPerLoop = 8192;
+// loop() 1 回で送るトレースの上限（STACKCHAN_TRACE）
+constexpr size_t kTraceDumpBytesPerLoop = 8192;
+
+// ローカルコマンドの音量操作の刻み（0-255）
+constexpr int kVolumeStep = 32;
+
+// 話者の方向へ首を向ける（DOA_TRACKING）
+constexpr float kDoaMinConfidence = 0.4f;
+constexpr uint32_t kDoaMaxAgeMs = 1500;   // ウェイクワードの発話で出した推定を Listening の開始時に使う
+constexpr int16_t kDoaMinTurnDeg = 8;     // これより小さいずれでは動かない
+constexpr int16_t kPanCenterDeg = 90;
+constexpr int16_t kPanRangeDeg = 35;      // 正面から左右にこれ以上は回さない（MoveX の角度は int8）
+constexpr uint16_t kDoaTurnDurationMs = 400;
+
+// ステートごとの loop() 稼働率（CPU busy %）と 1 回の最長処理時間の計測
+constexpr uint32_t kLoopStatsLogIntervalMs = 10000;
+struct LoopStats
+{
+  uint64_t busy_us[StateMachine::kStateCount] = {};
+  uint64_t total_us[StateMachine::kStateCount] = {};
+  uint32_t max_busy_us[StateMachine::kStateCount] = {};
+  uint32_t last_log_ms = 0;
+};
+LoopStats g_loop_stats;
 
 void markCommunicationActive()
 {
@@ -59,11 +173,12 @@ void handleCommunicationTimeout()
       (current == StateMachine::Thinking || current == StateMachine::Speaking))
   {
     log_w("Communication timeout in state=%u; forcing Idle", static_cast<unsigned>(current));
-    stateMachine.setState(StateMachine::Idle);
+    stateMachine.dispatch(StateMachine::Event::CommTimeout);
     markCommunicationActive();
   }
 }
 
+// WsClient の送信は loop() のタスクだけから呼ぶ（ESP-SR などのタスクの出来事は loop() で受けてから送る）
 bool sendUplinkPacket(MessageKind kind, MessageType msgType, const uint8_t *payload, size_t payload_len)
 {
   if ((WiFi.status() != WL_CONNECTED) || !wsClient.isConnected())
@@ -78,14 +193,18 @@ bool sendUplinkPacket(MessageKind kind, MessageType msgType, const uint8_t *payl
   header.seq = g_uplink_seq++;
   header.payloadBytes = static_cast<uint16_t>(payload_len);
 
-  std::vector<uint8_t> packet;
-  packet.resize(sizeof(WsHeader) + payload_len);
-  memcpy(packet.data(), &header, sizeof(WsHeader));
+  uint8_t packet[sizeof(WsHeader) + kMaxUplinkEventBytes];
+  if (payload_len > kMaxUplinkEventBytes)
+  {
+    log_e("Uplink event kind=%u too large: %u bytes", static_cast<unsigned>(kind), static_cast<unsigned>(payload_len));
+    return false;
+  }
+  memcpy(packet, &header, sizeof(WsHeader));
   if (payload_len > 0 && payload != nullptr)
   {
-    memcpy(packet.data() + sizeof(WsHeader), payload, payload_len);
+    memcpy(packet + sizeof(WsHeader), payload, payload_len);
   }
-  wsClient.sendBIN(packet.data(), packet.size());
+  wsClient.sendBIN(packet, sizeof(WsHeader) + payload_len);
   markCommunicationActive();
   return true;
 }
@@ -110,13 +229,24 @@ void notifyCurrentState(StateMachine::State state)
 
 void notifySpeakDone()
 {
-  const uint8_t payload = 1; // done
+  // 会話モードでは、この後 Listening で続きの発話を待つことをサーバーに伝える
+  const uint8_t payload = FOLLOW_UP_WINDOW_MS > 0 ? kSpeakDoneFollowUp : kSpeakDone;
   if (!sendUplinkPacket(MessageKind::SpeakDoneEvt, MessageType::DATA, &payload, sizeof(payload)))
   {
     log_w("Failed to send SpeakDoneEvt");
   }
 }
 
+void notifyAudioCredit(uint32_t bytes)
+{
+  uint8_t payload[sizeof(uint32_t)];
+  memcpy(payload, &bytes, sizeof(payload));
+  if (!sendUplinkPacket(MessageKind::AudioCreditEvt, MessageType::DATA, payload, sizeof(payload)))
+  {
+    log_w("Failed to send AudioCreditEvt bytes=%lu", static_cast<unsigned long>(bytes));
+  }
+}
+
 void notifyServoDone()
 {
   const uint8_t payload = 1; // done
@@ -126,6 +256,127 @@ void notifyServoDone()
   }
 }
 
+void notifyClipEvent(ClipStatus status, const uint32_t *clip_ids, size_t count)
+{
+  uint8_t payload[kMaxUplinkEventBytes];
+  count = std::min(count, ClipCache::kMaxEntries);
+  payload[0] = static_cast<uint8_t>(status);
+  if (count > 0)
+  {
+    memcpy(payload + 1, clip_ids, count * sizeof(uint32_t));
+  }
+  if (!sendUplinkPacket(MessageKind::ClipEvt, MessageType::DATA, payload, 1 + count * sizeof(uint32_t)))
+  {
+    log_w("Failed to send ClipEvt status=%u", static_cast<unsigned>(status));
+  }
+}
+
+// キャッシュにあれば flash から再生し、無ければ Miss を返してサーバーのストリーミングに任せる
+void playCachedClip(const uint8_t *body, size_t bodyLen)
+{
+  if (body == nullptr || bodyLen < sizeof(uint32_t))
+  {
+    log_w("ClipCmd payload too short: %u", static_cast<unsigned>(bodyLen));
+    return;
+  }
+  uint32_t start_us = micros();
+  uint32_t clip_id = 0;
+  memcpy(&clip_id, body, sizeof(clip_id));
+
+  ClipCache::ClipInfo info;
+  bool hit = clipCache.openForPlayback(clip_id, info) &&
+             speaking.playClip(info.sample_rate, info.channels, info.bytes, [](uint8_t *dst, size_t len) {
+               return clipCache.read(dst, len);
+             });
+  notifyClipEvent(hit ? ClipStatus::Hit : ClipStatus::Miss, &clip_id, 1);
+  log_i("Clip %08lx %s (%lu us to first audio)", static_cast<unsigned long>(clip_id), hit ? "hit" : "miss",
+        static_cast<unsigned long>(micros() - start_us));
+}
+
+void notifyLocalCommand(LocalCommand command)
+{
+  const uint8_t payload = static_cast<uint8_t>(command);
+  if (!sendUplinkPacket(MessageKind::LocalCommandEvt, MessageType::DATA, &payload, sizeof(payload)))
+  {
+    log_w("Failed to send LocalCommandEvt command=%s", localCommandToString(command));
+  }
+}
+
+// 認識したコマンドをサーバーの応答を待たずに処理する。サーバーには結果だけを伝える
+void handleLocalCommand(LocalCommand command, uint32_t detected_us)
+{
+  notifyLocalCommand(command);
+  if (stateMachine.getState() == StateMachine::Listening)
+  {
+    // ウェイクワードに続くコマンドでターンが終わるので、送りかけた発話は破棄させる
+    listening.cancelStreaming();
+    stateMachine.dispatch(StateMachine::Event::ListenFinished);
+  }
+
+  const uint8_t *gesture = nullptr;
+  size_t gesture_len = 0;
+  switch (command)
+  {
+  case LocalCommand::VolumeUp:
+  case LocalCommand::VolumeDown:
+  {
+    int step = command == LocalCommand::VolumeUp ? kVolumeStep : -kVolumeStep;
+    int volume = std::max(0, std::min(255, static_cast<int>(M5.Speaker.getVolume()) + step));
+    M5.Speaker.setVolume(static_cast<uint8_t>(volume));
+    log_i("Speaker volume=%d", volume);
+    break;
+  }
+  default:
+    if (localCommandGesture(command, gesture, gesture_len))
+    {
+      // 首振り自体の ServoDoneEvt は送らない（置き換えたサーバーのシーケンスの分は BodyServo が送る）
+      servo.enqueueSequence(gesture, gesture_len, false);
+    }
+    break;
+  }
+  log_i("Local command %s handled in %lu ms", localCommandToString(command),
+        static_cast<unsigned long>((micros() - detected_us) / 1000));
+}
+
+// Listening 中に新しい到来方向の推定があれば、サーバーを介さずに首をそちらへ向ける
+void trackTalker(uint32_t now)
+{
+  DoaEstimator::Estimate doa;
+  if (!micFrontEnd.takeDirection(doa))
+  {
+    return;
+  }
+  if (servo.isBusy() || doa.confidence < kDoaMinConfidence || now - doa.at_ms > kDoaMaxAgeMs)
+  {
+    // サーバーのシーケンスや前回の首振りの途中。動いている間の音での推定は捨てる
+    return;
+  }
+
+  // 推定はマイク（頭）から見た角度なので、今の向きに足す
+  int16_t offset = static_cast<int16_t>(std::lround(DOA_PAN_INVERT_H ? -doa.angle_deg : doa.angle_deg));
+  int16_t current = servo.currentDegreeX();
+  int16_t target = std::max<int16_t>(kPanCenterDeg - kPanRangeDeg,
+                                     std::min<int16_t>(kPanCenterDeg + kPanRangeDeg, current + offset));
+  if (std::abs(target - current) < kDoaMinTurnDeg)
+  {
+    return;
+  }
+
+  const uint8_t payload[] = {
+      1,
+      static_cast<uint8_t>(ServoCommandOp::MoveX),
+      static_cast<uint8_t>(target),
+      static_cast<uint8_t>(kDoaTurnDurationMs & 0xFF),
+      static_cast<uint8_t>(kDoaTurnDurationMs >> 8),
+  };
+  // 端末内で起こした動作なので ServoDoneEvt は送らない
+  if (servo.enqueueSequence(payload, sizeof(payload), false))
+  {
+    micFrontEnd.resetDirection();
+    log_i("Turn toward talker: doa=%.1f deg conf=%.2f pan %d -> %d", doa.angle_deg, doa.confidence, current, target);
+  }
+}
+
 bool applyRemoteStateCommand(const uint8_t *body, size_t bodyLen)
 {
   if (body == nullptr || bodyLen < 1)
@@ -138,16 +389,22 @@ bool applyRemoteStateCommand(const uint8_t *body, size_t bodyLen)
   switch (target)
   {
   case RemoteState::Idle:
-    stateMachine.setState(StateMachine::Idle);
+    stateMachine.dispatch(StateMachine::Event::RemoteIdle);
     return true;
   case RemoteState::Listening:
-    stateMachine.setState(StateMachine::Listening);
+    if (listening.isAwaitingSpeech())
+    {
+      // 会話モードの発話待ち中。既に Listening なので、発話を待たずに送信を始める
+      listening.startAwaitedStream();
+      return true;
+    }
+    stateMachine.dispatch(StateMachine::Event::RemoteListening);
     return true;
   case RemoteState::Thinking:
-    stateMachine.setState(StateMachine::Thinking);
+    stateMachine.dispatch(StateMachine::Event::RemoteThinking);
     return true;
   case RemoteState::Speaking:
-    stateMachine.setState(StateMachine::Speaking);
+    stateMachine.dispatch(StateMachine::Event::RemoteSpeaking);
     return true;
   default:
     log_w("Unknown remote state: %u", static_cast<unsigned>(body[0]));
@@ -155,6 +412,81 @@ bool applyRemoteStateCommand(const uint8_t *body, size_t bodyLen)
   }
 }
 
+// 次にやるべき処理までの待ち時間を各モジュールの期限から求める
+uint32_t loopWaitMs(StateMachine::State state, uint32_t now)
+{
+  switch (state)
+  {
+  case StateMachine::Idle:
+  case StateMachine::Listening:
+    // M5.Mic.record が I2S の DMA 完了を待ってブロックするため、ここでは待たない
+    return 0;
+  case StateMachine::Disconnected:
+    if (listening.canResume())
+    {
+      return 0; // 保留中の uplink の録音を続ける
+    }
+    break;
+  default:
+    break;
+  }
+
+  if (traceDump.isUploading())
+  {
+    return 0;
+  }
+
+  uint32_t wait = kMaxLoopWaitMs;
+  if (!boot.isFinished())
+  {
+    wait = std::min(wait, kBootPollMs);
+  }
+  wait = std::min(wait, wsClient.msUntilNextUpdate(now));
+  wait = std::min(wait, connection.msUntilNextUpdate(now));
+  wait = std::min(wait, servo.msUntilNextUpdate(now));
+  if (state == StateMachine::Speaking)
+  {
+    wait = std::min(wait, speaking.msUntilNextUpdate());
+  }
+  if (g_last_comm_ms != 0 && (state == StateMachine::Thinking || state == StateMachine::Speaking))
+  {
+    uint32_t elapsed = now - g_last_comm_ms;
+    wait = std::min(wait, elapsed >= kCommTimeoutMs ? 0U : kCommTimeoutMs - elapsed);
+  }
+  return wait;
+}
+
+void recordLoopStats(StateMachine::State state, uint32_t busy_us, uint32_t total_us)
+{
+  size_t index = static_cast<size_t>(state);
+  g_loop_stats.busy_us[index] += busy_us;
+  g_loop_stats.total_us[index] += total_us;
+  g_loop_stats.max_busy_us[index] = std::max(g_loop_stats.max_busy_us[index], busy_us);
+
+  uint32_t now = millis();
+  if (now - g_loop_stats.last_log_ms < kLoopStatsLogIntervalMs)
+  {
+    return;
+  }
+  g_loop_stats.last_log_ms = now;
+
+  for (size_t i = 0; i < StateMachine::kStateCount; ++i)
+  {
+    if (g_loop_stats.total_us[i] == 0)
+    {
+      continue;
+    }
+    dlog_i("loop busy: state=%s busy=%u%% max=%lu us window=%lu ms",
+           stateToString(static_cast<StateMachine::State>(i)),
+           static_cast<unsigned>(g_loop_stats.busy_us[i] * 100 / g_loop_stats.total_us[i]),
+           static_cast<unsigned long>(g_loop_stats.max_busy_us[i]),
+           static_cast<unsigned long>(g_loop_stats.total_us[i] / 1000));
+    g_loop_stats.busy_us[i] = 0;
+    g_loop_stats.total_us[i] = 0;
+    g_loop_stats.max_busy_us[i] = 0;
+  }
+}
+
 bool applyServoCommand(const uint8_t *body, size_t bodyLen)
 {
   if (!servo.enqueueSequence(body, bodyLen))
@@ -166,148 +498,254 @@ bool applyServoCommand(const uint8_t *body, size_t bodyLen)
 }
 } // namespace
 
-void connectWiFi()
+// WebSocket の接続完了後、Idle（または保留中の uplink の再開）に入る
+void enterConnected()
+{
+  // 送信途中で切れた uplink があれば、遷移表の guard で Idle を経ずにそのまま再開する
+  stateMachine.dispatch(StateMachine::Event::Connected);
+  boot.finish(millis());
+  // 非同期の起動フェーズ（ESP-SR・表示）も終わったので、ここから先はヒープを使わない
+  memory_plan::seal();
+  markCommunicationActive();
+  notifyCurrentState(stateMachine.getState());
+  speaking.grantInitialCredit();
+  clipCache.reportInventory();
+}
+
+// 起動中の各フェーズの完了を記録し、並行フェーズが揃ってから最初の Idle に入る
+void pollBoot()
 {
-  WiFi.mode(WIFI_STA);
-  WiFi.begin(WIFI_SSID, WIFI_PASS);
-  while (WiFi.status() != WL_CONNECTED)
+  if (connection.firstWiFiUpMs() != 0)
+  {
+    boot.end(BootPhase::WiFi, connection.firstWiFiUpMs());
+  }
+  if (boot.isReady() && wsClient.isConnected())
   {
-    delay(300);
+    enterConnected();
   }
 }
 
-void handleWsEvent(WStype_t type, uint8_t *payload, size_t length)
+void handleWsEvent(WsClient::Event event)
 {
-  switch (type)
+  TRACE_INSTANT(WsEvent, event, 0);
+  switch (event)
   {
-  case WStype_DISCONNECTED:
+  case WsClient::Event::Disconnected:
     // M5.Display.println("WS: disconnected");
     log_i("WS disconnected");
-    stateMachine.setState(StateMachine::Disconnected);
+    wsCapture.recordEvent(WsCaptureEvent::Disconnected);
+    connection.onWsDisconnected();
+    stateMachine.dispatch(StateMachine::Event::Disconnected);
     break;
-  case WStype_CONNECTED:
+  case WsClient::Event::Connected:
     // M5.Display.printf("WS: connected %s\n", SERVER_PATH);
     log_i("WS connected to %s", SERVER_PATH);
-    if (stateMachine.getState() == StateMachine::Disconnected)
+    wsCapture.recordEvent(WsCaptureEvent::Connected);
+    connection.onWsConnected();
+    boot.end(BootPhase::WebSocket, millis());
+    if (!boot.isReady())
     {
-      stateMachine.setState(StateMachine::Idle);
+      // ESP-SR や表示の準備が済むまで Disconnected に留まり、pollBoot() で Idle に入る
+      log_i("WS connected; waiting for boot tasks");
+      break;
     }
-    markCommunicationActive();
-    notifyCurrentState(stateMachine.getState());
+    enterConnected();
     break;
-  case WStype_TEXT:
-    //  M5.Display.printf("WS msg: %.*s\n", (int)length, payload);
+  case WsClient::Event::Text:
     markCommunicationActive();
     break;
-  case WStype_BIN:
+  default:
+    break;
+  }
+}
+
+// 受信中のバイナリメッセージの payload をどこに直接読み込むか。TTS の PCM は再生用セグメントへ
+uint8_t *selectWsPayloadSink(const WsHeader &rx)
+{
+  if (static_cast<MessageKind>(rx.kind) == MessageKind::AudioWav)
   {
-    markCommunicationActive();
-    if (length < sizeof(WsHeader))
+    return speaking.reserveWavPayload(rx);
+  }
+  return nullptr;
+}
+
+void handleWsMessage(const WsHeader &rx, const uint8_t *body, size_t rx_payload_len)
+{
+  TRACE_SCOPE(WsMessage, rx.kind, rx_payload_len);
+  markCommunicationActive();
+  wsCapture.recordRx(rx, body, rx_payload_len);
+  dlog_i("WS bin kind=%u len=%u", (unsigned)rx.kind, (unsigned)(sizeof(WsHeader) + rx_payload_len));
+
+  switch (static_cast<MessageKind>(rx.kind))
+  {
+  case MessageKind::AudioWav:
+    speaking.handleWavMessage(rx, body, rx_payload_len);
+    break;
+  case MessageKind::AudioPcmAck:
+    listening.handleAck(body, rx_payload_len);
+    break;
+  case MessageKind::StateCmd:
+    if (static_cast<MessageType>(rx.messageType) == MessageType::DATA)
     {
-      // M5.Display.println("WS bin too short");
-      log_i("WS bin too short: %d", (int)length);
-      break;
+      applyRemoteStateCommand(body, rx_payload_len);
     }
-
-    WsHeader rx{};
-    memcpy(&rx, payload, sizeof(WsHeader));
-    size_t rx_payload_len = length - sizeof(WsHeader);
-    if (rx_payload_len != rx.payloadBytes)
+    else
     {
-      // M5.Display.println("WS payload len mismatch");
-      log_i("WS payload len mismatch: expected=%u got=%u", (unsigned)rx.payloadBytes, (unsigned)rx_payload_len);
-      break;
+      log_w("StateCmd unsupported msgType=%u", static_cast<unsigned>(rx.messageType));
     }
-
-    const uint8_t *body = payload + sizeof(WsHeader);
-    log_i("WS bin kind=%u len=%d", (unsigned)rx.kind, (int)length);
-
-    switch (static_cast<MessageKind>(rx.kind))
+    break;
+  case MessageKind::ClipCmd:
+    if (static_cast<MessageType>(rx.messageType) == MessageType::DATA)
     {
-    case MessageKind::AudioWav:
-      speaking.handleWavMessage(rx, body, rx_payload_len);
-      break;
-    case MessageKind::StateCmd:
-      if (static_cast<MessageType>(rx.messageType) == MessageType::DATA)
-      {
-        applyRemoteStateCommand(body, rx_payload_len);
-      }
-      else
-      {
-        log_w("StateCmd unsupported msgType=%u", static_cast<unsigned>(rx.messageType));
-      }
-      break;
-    case MessageKind::ServoCmd:
-      if (static_cast<MessageType>(rx.messageType) == MessageType::DATA)
-      {
-        applyServoCommand(body, rx_payload_len);
-      }
-      else
-      {
-        log_w("ServoCmd unsupported msgType=%u", static_cast<unsigned>(rx.messageType));
-      }
-      break;
-    default:
-      // M5.Display.printf("WS bin kind=%u len=%d\n", (unsigned)rx.kind, (int)length);
-      break;
+      playCachedClip(body, rx_payload_len);
+    }
+    break;
+  case MessageKind::ClipData:
+    // flash への書き込みは Idle の間だけ受け付ける（再生・録音の loop() を止めない）
+    clipCache.handleClipData(rx, body, rx_payload_len, stateMachine.getState() == StateMachine::Idle);
+    break;
+  case MessageKind::ServoCmd:
+    if (static_cast<MessageType>(rx.messageType) == MessageType::DATA)
+    {
+      applyServoCommand(body, rx_payload_len);
+    }
+    else
+    {
+      log_w("ServoCmd unsupported msgType=%u", static_cast<unsigned>(rx.messageType));
+    }
+    break;
+  case MessageKind::TraceCmd:
+    if (static_cast<MessageType>(rx.messageType) == MessageType::DATA)
+    {
+      traceDump.handleCommand(body, rx_payload_len);
     }
-
     break;
-  }
   default:
+    // M5.Display.printf("WS bin kind=%u len=%d\n", (unsigned)rx.kind, (int)length);
     break;
   }
 }
 
 void setup()
 {
+  // 実行時のバッファはまとめて最初に確保し、各モジュールの init() で切り出す
+  memory_plan::init(kMemoryPlan);
+  // 起動の各フェーズも残るよう最初に確保する（STACKCHAN_TRACE=0 なら何もしない）
+  trace::init(STACKCHAN_TRACE_KB * 1024);
+  // 音声の loop() で出すログは出力タスクに任せる（DEFERRED_LOG=0 ならその場で出す）
+  deferred_log::init();
+  // Wi-Fi のイベントより先に、loop() の待機を起こす仕組みを用意する
+  loop_wake::init();
+  boot.start(BootPhase::M5Begin, millis());
   auto cfg = M5.config();
   M5.begin(cfg);
   auto mic_cfg = M5.Mic.config();
   mic_cfg.sample_rate = SAMPLE_RATE;
   mic_cfg.dma_buf_len = 256;
-  mic_cfg.stereo = false;
+  mic_cfg.stereo = MIC_BEAMFORMING || DOA_TRACKING;
   // mic_cfg.over_sampling = 4;
   M5.Mic.config(mic_cfg);
+  MicFrontEnd::Config front_cfg;
+  front_cfg.stereo = MIC_BEAMFORMING || DOA_TRACKING;
+  front_cfg.sample_rate = SAMPLE_RATE;
+  front_cfg.mic_spacing_mm = MIC_SPACING_MM_H;
+  front_cfg.steer_deg = MIC_BEAM_STEER_DEG_H;
+  front_cfg.doa = DOA_TRACKING;
+  micFrontEnd.init(front_cfg);
+  boot.end(BootPhase::M5Begin, millis());
+
+  // Wi-Fi の接続は待たずに進め、ESP-SR や表示の初期化と並行させる
+  boot.start(BootPhase::WiFi, millis());
+  connection.begin(WIFI_SSID, WIFI_PASS);
+
+  // 描画タスクより先にバックライトの初期値を読んでおく
+  power.init();
+
+  // 重いフェーズを別タスクで開始する。完了は pollBoot() で待ち合わせる
+  wakeUpWord.enableLocalCommands(LOCAL_COMMANDS);
+  boot.runAsync(BootPhase::SrModel, "boot_sr", kSrLoadStackSize, kSrLoadCore, []() {
+    wakeUpWord.init();
+  });
+  boot.runAsync(BootPhase::DisplayFirstFrame, "boot_display", kDisplayInitStackSize, kDisplayInitCore, []() {
+    display.init();
+  });
 
+  boot.start(BootPhase::LocalInit, millis());
+  listening.enableLogMelUplink(UPLINK_LOG_MEL);
   listening.init();
+  listening.enableUplinkFrontEnd(UPLINK_FRONTEND);
+  listening.enableAdaptiveChunks(UPLINK_ADAPTIVE_CHUNK);
+  if (LOCAL_COMMANDS)
+  {
+    // ウェイクワード直後は Listening に移るので、その録音でコマンドの認識を続ける
+    listening.setCaptureCallback([](const int16_t *samples, size_t count) {
+      wakeUpWord.feedCommandAudio(samples, count);
+    });
+  }
   speaking.init();
   speaking.setSpeakFinishedCallback([]() {
     notifySpeakDone();
   });
+  speaking.setFollowUpListening(FOLLOW_UP_WINDOW_MS > 0);
+  speaking.setCreditCallback([](uint32_t bytes) {
+    notifyAudioCredit(bytes);
+  });
   servo.init();
   servo.setCompletionCallback([]() {
     notifyServoDone();
   });
-  wakeUpWord.init();
-  wakeUpWord.setWakeWordDetectedCallback([]() {
-    notifyWakeWordDetected();
+  clipCache.init();
+  clipCache.setResultCallback([](ClipStatus status, const uint32_t *clip_ids, size_t count) {
+    notifyClipEvent(status, clip_ids, count);
   });
-  display.init();
-
-  connectWiFi();
 
   // Mic/Speaking setup
   M5.Speaker.setVolume(200); // 0-255
+  boot.end(BootPhase::LocalInit, millis());
 
+  boot.start(BootPhase::WebSocket, millis());
   wsClient.begin(SERVER_HOST, SERVER_PORT, SERVER_PATH);
   markCommunicationActive();
   wsClient.onEvent(handleWsEvent);
-  wsClient.setReconnectInterval(2000);
+  wsClient.onMessage(handleWsMessage);
+  wsClient.setPayloadSink(selectWsPayloadSink);
+  wsCapture.init(WS_CAPTURE_KB * 1024);
+  if (wsCapture.isEnabled())
+  {
+    wsClient.setSendTap([](const uint8_t *data, size_t len) {
+      wsCapture.recordTx(data, len);
+    });
+  }
+  wsClient.setReconnectBackoff(250, 8000);
   wsClient.enableHeartbeat(15000, 3000, 2);
 
+  // Transition guards/actions
+  StateMachine::TransitionHooks transitionHooks;
+  transitionHooks.can_resume_listening = []() {
+    return listening.canResume();
+  };
+  transitionHooks.arm_follow_up = []() {
+    listening.armFollowUp(FOLLOW_UP_WINDOW_MS);
+  };
+  stateMachine.setTransitionHooks(transitionHooks);
+
   // State entry/exit hooks
   stateMachine.addStateEntryEvent(StateMachine::Idle, [](StateMachine::State, StateMachine::State) {
     notifyCurrentState(StateMachine::Idle);
     wakeUpWord.begin();
+    power.enterIdle();
+    clipCache.flushIndex();
   });
   stateMachine.addStateExitEvent(StateMachine::Idle, [](StateMachine::State, StateMachine::State) {
+    clipCache.abortStore();
+    power.exitIdle();
     wakeUpWord.end();
   });
 
   stateMachine.addStateEntryEvent(StateMachine::Listening, [](StateMachine::State, StateMachine::State) {
     notifyCurrentState(StateMachine::Listening);
     listening.begin();
+    power.markUplinkStarted();
   });
   stateMachine.addStateExitEvent(StateMachine::Listening, [](StateMachine::State, StateMachine::State) {
     listening.end();
@@ -328,9 +766,28 @@ void setup()
 
 void loop()
 {
+  uint32_t start_us = micros();
+  TRACE_BEGIN(Loop, stateMachine.getState(), 0);
   M5.update();
+  connection.loop(millis());
   wsClient.loop();
+  if (!boot.isFinished())
+  {
+    pollBoot();
+  }
   handleCommunicationTimeout();
+  uint32_t wake_word_us = 0;
+  if (wakeUpWord.takeWakeWord(wake_word_us))
+  {
+    power.resumeFromWakeWord(wake_word_us);
+    notifyWakeWordDetected();
+  }
+  LocalCommand local_command;
+  uint32_t local_command_us = 0;
+  if (wakeUpWord.takeCommand(local_command, local_command_us))
+  {
+    handleLocalCommand(local_command, local_command_us);
+  }
   servo.loop();
 
   StateMachine::State current = stateMachine.getState();
@@ -338,22 +795,47 @@ void loop()
   {
   case StateMachine::Idle:
     wakeUpWord.loop();
+    power.loop(millis());
+    wsCapture.upload(kCaptureUploadBytesPerLoop);
     break;
   case StateMachine::Listening:
     listening.loop();
+    if (DOA_TRACKING)
+    {
+      trackTalker(millis());
+    }
     break;
   case StateMachine::Thinking:
     // Wait for server side command / audio stream.
     break;
   case StateMachine::Speaking:
     speaking.loop();
+    display.setMouthLevel(speaking.getMouthLevel());
     break;
   case StateMachine::Disconnected:
-    // Wait for WS reconnect.
+    // Wait for WS reconnect. 送信途中で切れた uplink はスプールへの録音を続ける
+    listening.loop();
     break;
   default:
     break;
   }
 
-  display.loop();
+  // TraceCmd への応答はステートによらず送る
+  traceDump.upload(kTraceDumpBytesPerLoop);
+
+  // 初回描画が終わるまでは描画タスクが無く、loop() から描画すると競合する
+  if (boot.isDone(BootPhase::DisplayFirstFrame))
+  {
+    display.loop();
+  }
+
+  // 次の期限か、ソケットの受信・ウェイクワード・Wi-Fi のイベントまでブロックし、その間 CPU を idle タスクに明け渡す
+  uint32_t busy_us = micros() - start_us;
+  TRACE_END(Loop);
+  uint32_t wait_ms = loopWaitMs(stateMachine.getState(), millis());
+  if (wait_ms > 0)
+  {
+    loop_wake::wait(wait_ms, wsClient.socketFd());
+  }
+  recordLoopStats(current, busy_us, micros() - start_us);
 }
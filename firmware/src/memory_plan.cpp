@@ -0,0 +1,229 @@
+#include "memory_plan.hpp"
+
+#include <M5Unified.h>
+#include <esp_heap_caps.h>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#if MEMORY_PLAN_TRAP
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <new>
+#endif
+
+namespace
+{
+using memory_plan::Budget;
+using memory_plan::Module;
+using memory_plan::Region;
+
+constexpr size_t kMaxBudgets = 16;
+constexpr const char *kModuleNames[memory_plan::kModuleCount] = {
+    "Listening", "Speaking", "WsClient", "WsCapture", "Trace",
+};
+constexpr const char *kRegionNames[memory_plan::kRegionCount] = {"internal", "psram"};
+constexpr uint32_t kRegionCaps[memory_plan::kRegionCount] = {
+    MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT,
+    MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT,
+};
+
+// 予算 1 件。領域の中で offset から bytes までがこのモジュールの分
+struct Slice
+{
+  Budget budget;
+  size_t offset;
+  size_t used;
+};
+
+struct Arena
+{
+  void *raw = nullptr;     // heap_caps_free に渡す先頭
+  uint8_t *base = nullptr; // kAlign に揃えた先頭
+  size_t bytes = 0;
+};
+
+Slice g_slices[kMaxBudgets];
+size_t g_slice_count = 0;
+Arena g_arenas[memory_plan::kRegionCount];
+std::atomic<bool> g_sealed{false};
+
+#if MEMORY_PLAN_TRAP
+TaskHandle_t g_loop_task = nullptr; // seal() を呼んだタスク（loop()）
+int g_heap_scopes = 0;
+#endif
+
+Slice *findSlice(Module module, Region region)
+{
+  for (size_t i = 0; i < g_slice_count; ++i)
+  {
+    if (g_slices[i].budget.module == module && g_slices[i].budget.region == region)
+    {
+      return &g_slices[i];
+    }
+  }
+  return nullptr;
+}
+
+void logUsage()
+{
+  size_t used[memory_plan::kRegionCount] = {};
+  for (size_t i = 0; i < g_slice_count; ++i)
+  {
+    used[static_cast<size_t>(g_slices[i].budget.region)] += g_slices[i].used;
+  }
+  log_i("Memory plan: internal %u/%u B, psram %u/%u B reserved at boot", static_cast<unsigned>(used[0]),
+        static_cast<unsigned>(g_arenas[0].bytes), static_cast<unsigned>(used[1]),
+        static_cast<unsigned>(g_arenas[1].bytes));
+  for (size_t m = 0; m < memory_plan::kModuleCount; ++m)
+  {
+    const Slice *internal = findSlice(static_cast<Module>(m), Region::Internal);
+    const Slice *psram = findSlice(static_cast<Module>(m), Region::Psram);
+    if (internal == nullptr && psram == nullptr)
+    {
+      continue;
+    }
+    log_i("  %-10s internal %6u/%6u B  psram %7u/%7u B", kModuleNames[m],
+          static_cast<unsigned>(internal ? internal->used : 0), static_cast<unsigned>(internal ? internal->budget.bytes : 0),
+          static_cast<unsigned>(psram ? psram->used : 0), static_cast<unsigned>(psram ? psram->budget.bytes : 0));
+  }
+  for (size_t r = 0; r < memory_plan::kRegionCount; ++r)
+  {
+    log_i("  heap %-8s free=%u B largest=%u B", kRegionNames[r],
+          static_cast<unsigned>(heap_caps_get_free_size(kRegionCaps[r])),
+          static_cast<unsigned>(heap_caps_get_largest_free_block(kRegionCaps[r])));
+  }
+}
+} // namespace
+
+namespace memory_plan
+{
+void init(const Budget *plan, size_t count)
+{
+  release();
+  size_t totals[kRegionCount] = {};
+  for (size_t i = 0; i < count; ++i)
+  {
+    if (plan[i].bytes == 0)
+    {
+      continue;
+    }
+    if (g_slice_count == kMaxBudgets)
+    {
+      log_e("Memory plan: more than %u budgets", static_cast<unsigned>(kMaxBudgets));
+      break;
+    }
+    const size_t region = static_cast<size_t>(plan[i].region);
+    g_slices[g_slice_count++] = Slice{plan[i], totals[region], 0};
+    totals[region] += padded(plan[i].bytes);
+  }
+
+  for (size_t r = 0; r < kRegionCount; ++r)
+  {
+    if (totals[r] == 0)
+    {
+      continue;
+    }
+    Arena &arena = g_arenas[r];
+    arena.raw = heap_caps_malloc(totals[r] + kAlign, kRegionCaps[r]);
+    if (arena.raw == nullptr)
+    {
+      log_e("Memory plan: failed to reserve %u bytes of %s", static_cast<unsigned>(totals[r]), kRegionNames[r]);
+      continue;
+    }
+    const uintptr_t aligned = (reinterpret_cast<uintptr_t>(arena.raw) + kAlign - 1) / kAlign * kAlign;
+    arena.base = reinterpret_cast<uint8_t *>(aligned);
+    arena.bytes = totals[r];
+    memset(arena.base, 0, arena.bytes);
+  }
+}
+
+void *take(Module module, Region region, size_t bytes)
+{
+  const char *name = kModuleNames[static_cast<size_t>(module)];
+  if (g_sealed.load(std::memory_order_relaxed))
+  {
+    log_e("Memory plan: %s asked for %u bytes after boot", name, static_cast<unsigned>(bytes));
+    return nullptr;
+  }
+  Slice *slice = findSlice(module, region);
+  const Arena &arena = g_arenas[static_cast<size_t>(region)];
+  if (slice == nullptr || arena.base == nullptr || slice->used + padded(bytes) > slice->budget.bytes)
+  {
+    log_e("Memory plan: %s needs %u bytes of %s beyond its budget", name, static_cast<unsigned>(bytes),
+          kRegionNames[static_cast<size_t>(region)]);
+    return nullptr;
+  }
+  void *ptr = arena.base + slice->offset + slice->used;
+  slice->used += padded(bytes);
+  return ptr;
+}
+
+void seal()
+{
+  if (g_sealed.exchange(true))
+  {
+    return;
+  }
+#if MEMORY_PLAN_TRAP
+  g_loop_task = xTaskGetCurrentTaskHandle();
+#endif
+  logUsage();
+}
+
+bool isSealed()
+{
+  return g_sealed.load(std::memory_order_relaxed);
+}
+
+void release()
+{
+  for (Arena &arena : g_arenas)
+  {
+    heap_caps_free(arena.raw);
+    arena = Arena{};
+  }
+  g_slice_count = 0;
+  g_sealed.store(false);
+#if MEMORY_PLAN_TRAP
+  g_loop_task = nullptr;
+#endif
+}
+
+HeapScope::HeapScope()
+{
+#if MEMORY_PLAN_TRAP
+  g_heap_scopes++;
+#endif
+}
+
+HeapScope::~HeapScope()
+{
+#if MEMORY_PLAN_TRAP
+  g_heap_scopes--;
+#endif
+}
+} // namespace memory_plan
+
+#if MEMORY_PLAN_TRAP
+// new[] と nothrow 版は libstdc++ の既定の実装がこれを呼ぶ
+void *operator new(size_t bytes)
+{
+  if (g_loop_task != nullptr && g_heap_scopes == 0 && xTaskGetCurrentTaskHandle() == g_loop_task)
+  {
+    // 止まったら、バックトレースの呼び出し元のバッファを kMemoryPlan か静的な配列に移す
+    log_e("Memory plan: heap allocation of %u bytes after boot from %p", static_cast<unsigned>(bytes),
+          __builtin_return_address(0));
+    abort();
+  }
+  void *ptr = malloc(bytes);
+  if (ptr == nullptr)
+  {
+#if __cpp_exceptions
+    throw std::bad_alloc();
+#else
+    abort();
+#endif
+  }
+  return ptr;
+}
+#endif
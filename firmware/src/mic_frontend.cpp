@@ -0,0 +1,85 @@
+#include "mic_frontend.hpp"
+
+#include <M5Unified.h>
+#include <algorithm>
+#include "trace.hpp"
+#include "deferred_log.hpp"
+
+namespace
+{
+constexpr uint32_t kStatsLogIntervalMs = 10000;
+
+// L/R 交互の録音バッファ（I2S の DMA から書かれるので static に置く）
+int16_t g_stereo_buf[MicFrontEnd::kMaxReadSamples * 2];
+} // namespace
+
+void MicFrontEnd::init(const Config &config)
+{
+  config_ = config;
+  if (config_.stereo)
+  {
+    beamformer_.configure(config_.sample_rate, config_.mic_spacing_mm, config_.steer_deg);
+    log_i("Mic beamforming: spacing=%.1f mm steer=%.1f deg delay=%.3f samples", config_.mic_spacing_mm,
+          config_.steer_deg, beamformer_.delaySamples());
+  }
+  config_.doa = config_.doa && config_.stereo;
+  if (config_.doa)
+  {
+    doa_.configure(config_.sample_rate, config_.mic_spacing_mm);
+  }
+}
+
+void MicFrontEnd::reset()
+{
+  // 方向推定は残す。ウェイクワードで出した推定を Listening に入ってから使う
+  beamformer_.reset();
+}
+
+bool MicFrontEnd::read(int16_t *out, size_t samples)
+{
+  samples = std::min(samples, kMaxReadSamples);
+  if (!config_.stereo)
+  {
+    TRACE_SCOPE(MicRecord, samples, 0);
+    return M5.Mic.record(out, samples, config_.sample_rate);
+  }
+
+  TRACE_BEGIN(MicRecord, samples, 1);
+  bool recorded = M5.Mic.record(g_stereo_buf, samples * 2, config_.sample_rate, true);
+  TRACE_END(MicRecord);
+  if (!recorded)
+  {
+    return false;
+  }
+  uint32_t start = ESP.getCycleCount();
+  beamformer_.process(g_stereo_buf, samples, out);
+  uint32_t cycles = ESP.getCycleCount() - start;
+  cycles_total_ += cycles;
+  cycles_max_ = std::max(cycles_max_, cycles);
+
+  uint32_t now = millis();
+  if (config_.doa)
+  {
+    start = ESP.getCycleCount();
+    doa_.process(g_stereo_buf, samples, now);
+    cycles = ESP.getCycleCount() - start;
+    doa_cycles_total_ += cycles;
+    doa_cycles_max_ = std::max(doa_cycles_max_, cycles);
+  }
+
+  blocks_++;
+  if (now - last_log_ms_ >= kStatsLogIntervalMs)
+  {
+    dlog_i("Mic front end: %lu blocks (%u samples), beamforming avg=%lu max=%lu, doa avg=%lu max=%lu cycles/block",
+           static_cast<unsigned long>(blocks_), static_cast<unsigned>(samples),
+           static_cast<unsigned long>(cycles_total_ / blocks_), static_cast<unsigned long>(cycles_max_),
+           static_cast<unsigned long>(doa_cycles_total_ / blocks_), static_cast<unsigned long>(doa_cycles_max_));
+    cycles_total_ = 0;
+    cycles_max_ = 0;
+    doa_cycles_total_ = 0;
+    doa_cycles_max_ = 0;
+    blocks_ = 0;
+    last_log_ms_ = now;
+  }
+  return true;
+}
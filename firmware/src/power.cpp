@@ -0,0 +1,163 @@
+#include "power.hpp"
+
+#include <M5Unified.h>
+#include <WiFi.h>
+
+namespace
+{
+constexpr int kMaxCpuFreqMhz = 240;
+// WakeNet をリアルタイムに回せる下限。80MHz では取りこぼしが出る
+constexpr int kIdleCpuFreqMhz = 160;
+
+constexpr uint32_t kDimAfterMs = 30000;
+constexpr uint8_t kDimBrightness = 16;
+// ウェイクワードで戻したのに Idle を出ない（サーバーが Listening を返さない）とき、省電力に戻すまでの時間
+constexpr uint32_t kWakeResumeTimeoutMs = 5000;
+} // namespace
+
+void PowerManager::init()
+{
+  normal_brightness_ = M5.Display.getBrightness();
+
+#if CONFIG_PM_ENABLE
+  esp_pm_config_t pm_cfg{};
+  pm_cfg.max_freq_mhz = kMaxCpuFreqMhz;
+  pm_cfg.min_freq_mhz = kIdleCpuFreqMhz;
+  pm_cfg.light_sleep_enable = false;
+  esp_err_t err = esp_pm_configure(&pm_cfg);
+  if (err == ESP_OK)
+  {
+    err = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "active", &cpu_lock_);
+  }
+  pm_configured_ = err == ESP_OK;
+  if (!pm_configured_)
+  {
+    log_w("esp_pm setup failed: %s", esp_err_to_name(err));
+  }
+#else
+  log_w("CONFIG_PM_ENABLE is off; CPU frequency stays fixed");
+#endif
+
+  setActive(true);
+}
+
+void PowerManager::enterIdle()
+{
+  idle_ = true;
+  woken_ = false;
+  idle_since_ms_ = idle_entered_ms_ = millis();
+  low_power_ms_ = 0;
+  setActive(false);
+}
+
+void PowerManager::exitIdle()
+{
+  idle_ = false;
+  woken_ = false;
+  setActive(true);
+  restoreBacklight();
+  // Idle の間に省電力（最低クロック + モデムスリープ）でいた割合。待機電流の見積もりに使う
+  uint32_t idle_ms = millis() - idle_entered_ms_;
+  log_i("idle: %lu ms, low power %lu%%", static_cast<unsigned long>(idle_ms),
+        static_cast<unsigned long>(idle_ms > 0 ? low_power_ms_ * 100ULL / idle_ms : 100));
+}
+
+void PowerManager::resumeFromWakeWord(uint32_t detected_us)
+{
+  wake_detected_us_ = detected_us;
+  wake_idle_ms_ = millis() - idle_since_ms_;
+  wake_cpu_mhz_ = getCpuFrequencyMhz();
+  if (idle_)
+  {
+    woken_ = true;
+    woken_ms_ = millis();
+  }
+  setActive(true);
+  restoreBacklight();
+}
+
+void PowerManager::markUplinkStarted()
+{
+  if (wake_detected_us_ == 0)
+  {
+    return;
+  }
+
+  log_i("wake resume: latency=%lu ms idle_for=%lu ms cpu_at_wake=%lu MHz",
+        static_cast<unsigned long>((micros() - wake_detected_us_) / 1000),
+        static_cast<unsigned long>(wake_idle_ms_),
+        static_cast<unsigned long>(wake_cpu_mhz_));
+  wake_detected_us_ = 0;
+}
+
+void PowerManager::loop(uint32_t now)
+{
+  if (!idle_)
+  {
+    return;
+  }
+
+  if (woken_)
+  {
+    if (now - woken_ms_ < kWakeResumeTimeoutMs)
+    {
+      return;
+    }
+    // 誤検出か、サーバーに届かなかった。Idle の続きとして省電力に戻し、減光までの時間も数え直す
+    log_w("wake resume: no Listening within %lu ms; back to low power",
+          static_cast<unsigned long>(kWakeResumeTimeoutMs));
+    woken_ = false;
+    wake_detected_us_ = 0;
+    idle_since_ms_ = now;
+    setActive(false);
+  }
+
+  if (!dimmed_ && now - idle_since_ms_ >= kDimAfterMs)
+  {
+    M5.Display.setBrightness(kDimBrightness);
+    dimmed_ = true;
+  }
+}
+
+void PowerManager::setActive(bool active)
+{
+  if (active == active_)
+  {
+    return;
+  }
+  active_ = active;
+  if (active)
+  {
+    low_power_ms_ += millis() - low_power_since_ms_;
+  }
+  else
+  {
+    low_power_since_ms_ = millis();
+  }
+
+  if (pm_configured_)
+  {
+    if (active)
+    {
+      esp_pm_lock_acquire(cpu_lock_);
+    }
+    else
+    {
+      esp_pm_lock_release(cpu_lock_);
+    }
+  }
+
+  // モデムスリープ中も AP の DTIM ごとに受信するため、
+  // enableHeartbeat(15000, 3000, 2) の ping/pong は間に合う
+  WiFi.setSleep(active ? WIFI_PS_NONE : WIFI_PS_MIN_MODEM);
+}
+
+void PowerManager::restoreBacklight()
+{
+  if (!dimmed_)
+  {
+    return;
+  }
+  M5.Display.setBrightness(normal_brightness_);
+  dimmed_ = false;
+}
@@ -4,7 +4,9 @@
 
 #include <algorithm>
 #include <cstring>
+#include <initializer_list>
 #include <utility>
+#include "trace.hpp"
 
 namespace
 {
@@ -56,7 +58,7 @@ void BodyServo::loop()
   updateAxis(axis_x_, now);
   updateAxis(axis_y_, now);
 
-  if (!sequence_active_ || current_step_index_ >= steps_.size())
+  if (!sequence_active_ || current_step_index_ >= step_count_)
   {
     return;
   }
@@ -66,7 +68,7 @@ void BodyServo::loop()
     startCurrentStep(now);
   }
 
-  if (!sequence_active_ || current_step_index_ >= steps_.size())
+  if (!sequence_active_ || current_step_index_ >= step_count_)
   {
     return;
   }
@@ -98,16 +100,27 @@ void BodyServo::loop()
 
 void BodyServo::resetSequence()
 {
-  steps_.clear();
+  if (step_started_)
+  {
+    TRACE_END(ServoStep);
+  }
+  // サーバーは ServoCmd ごとに ServoDoneEvt を数えて待つので、途中で打ち切ったシーケンスも完了として通知する
+  bool notify = sequence_active_ && notify_on_complete_;
+  step_count_ = 0;
   current_step_index_ = 0;
   sequence_active_ = false;
   step_started_ = false;
   sleep_deadline_ms_ = 0;
   axis_x_.moving = false;
   axis_y_.moving = false;
+  if (notify && on_complete_)
+  {
+    log_i("Servo sequence replaced before completion");
+    on_complete_();
+  }
 }
 
-bool BodyServo::enqueueSequence(const uint8_t *payload, size_t payload_len)
+bool BodyServo::enqueueSequence(const uint8_t *payload, size_t payload_len, bool notify_done)
 {
   if (!ensureAttached())
   {
@@ -119,11 +132,34 @@ bool BodyServo::enqueueSequence(const uint8_t *payload, size_t payload_len)
     return false;
   }
 
+  // 形式を確かめてから、動作中のシーケンスを置き換える
+  if (!parseSteps(payload, payload_len, nullptr))
+  {
+    return false;
+  }
   const uint8_t command_count = payload[0];
-  size_t offset = 1;
-  std::vector<Step> parsed_steps;
-  parsed_steps.reserve(command_count);
+  resetSequence();
+  parseSteps(payload, payload_len, steps_.data());
+  step_count_ = command_count;
+  notify_on_complete_ = notify_done;
+
+  if (step_count_ == 0)
+  {
+    completeSequence();
+    return true;
+  }
 
+  current_step_index_ = 0;
+  sequence_active_ = true;
+  step_started_ = false;
+  log_i("Accepted servo sequence commands=%u", static_cast<unsigned>(command_count));
+  return true;
+}
+
+bool BodyServo::parseSteps(const uint8_t *payload, size_t payload_len, Step *out)
+{
+  const uint8_t command_count = payload[0];
+  size_t offset = 1;
   for (uint8_t i = 0; i < command_count; ++i)
   {
     if (offset >= payload_len)
@@ -164,7 +200,10 @@ bool BodyServo::enqueueSequence(const uint8_t *payload, size_t payload_len)
       return false;
     }
 
-    parsed_steps.push_back(step);
+    if (out != nullptr)
+    {
+      out[i] = step;
+    }
   }
 
   if (offset != payload_len)
@@ -172,20 +211,6 @@ bool BodyServo::enqueueSequence(const uint8_t *payload, size_t payload_len)
     log_w("ServoCmd payload has %u trailing bytes", static_cast<unsigned>(payload_len - offset));
     return false;
   }
-
-  resetSequence();
-  steps_ = std::move(parsed_steps);
-
-  if (steps_.empty())
-  {
-    completeSequence();
-    return true;
-  }
-
-  current_step_index_ = 0;
-  sequence_active_ = true;
-  step_started_ = false;
-  log_i("Accepted servo sequence commands=%u", static_cast<unsigned>(command_count));
   return true;
 }
 
@@ -194,6 +219,39 @@ bool BodyServo::isBusy() const
   return sequence_active_ || axis_x_.moving || axis_y_.moving;
 }
 
+uint32_t BodyServo::msUntilNextUpdate(uint32_t now) const
+{
+  if (!attached_)
+  {
+    return UINT32_MAX;
+  }
+
+  uint32_t wait = UINT32_MAX;
+  for (const AxisMotion *axis : {&axis_x_, &axis_y_})
+  {
+    if (!axis->moving)
+    {
+      continue;
+    }
+    uint32_t since = now - axis->last_update_ms;
+    wait = std::min(wait, since >= kEasingDivisionMs ? 0U : kEasingDivisionMs - since);
+  }
+
+  if (sequence_active_ && current_step_index_ < step_count_)
+  {
+    if (!step_started_)
+    {
+      return 0;
+    }
+    if (steps_[current_step_index_].op == ServoCommandOp::Sleep)
+    {
+      int32_t remaining = static_cast<int32_t>(sleep_deadline_ms_ - now);
+      wait = std::min(wait, remaining <= 0 ? 0U : static_cast<uint32_t>(remaining));
+    }
+  }
+  return wait;
+}
+
 void BodyServo::setCompletionCallback(std::function<void()> cb)
 {
   on_complete_ = std::move(cb);
@@ -264,13 +322,14 @@ void BodyServo::startMove(AxisMotion &axis, int8_t degree, int16_t duration_ms)
 
 void BodyServo::startCurrentStep(uint32_t now)
 {
-  if (!sequence_active_ || current_step_index_ >= steps_.size())
+  if (!sequence_active_ || current_step_index_ >= step_count_)
   {
     return;
   }
 
   const Step &step = steps_[current_step_index_];
   step_started_ = true;
+  TRACE_BEGIN(ServoStep, step.op, step.angle);
   switch (step.op)
   {
   case ServoCommandOp::Sleep:
@@ -295,9 +354,13 @@ void BodyServo::advanceStep()
     return;
   }
 
+  if (step_started_)
+  {
+    TRACE_END(ServoStep);
+  }
   ++current_step_index_;
   step_started_ = false;
-  if (current_step_index_ >= steps_.size())
+  if (current_step_index_ >= step_count_)
   {
     completeSequence();
   }
@@ -305,13 +368,13 @@ void BodyServo::advanceStep()
 
 void BodyServo::completeSequence()
 {
-  steps_.clear();
+  step_count_ = 0;
   current_step_index_ = 0;
   sequence_active_ = false;
   step_started_ = false;
   sleep_deadline_ms_ = 0;
   log_i("Servo sequence completed");
-  if (on_complete_)
+  if (on_complete_ && notify_on_complete_)
   {
     on_complete_();
   }
@@ -1,23 +1,95 @@
 #include "speaking.hpp"
+#include <esp_heap_caps.h>
+#include <algorithm>
+#include <cstdlib>
 #include <cstring>
 #include <utility>
+#include "trace.hpp"
+#include "deferred_log.hpp"
+
+namespace
+{
+constexpr size_t kMouthWindowSamples = 480;   // 約 20 ms @24kHz
+constexpr int32_t kMouthFullScaleLevel = 6000; // この平均絶対値で口を全開にする
+constexpr uint32_t kPlaybackPollMs = 10;        // 再生完了を確認する間隔
+constexpr uint8_t kSpeakerChannel = 0;
+constexpr size_t kSeamRampFrames = 48;          // 約 2 ms @24kHz。途切れた継ぎ目のフェード長
+constexpr uint32_t kLegacyUtteranceGapMs = 1000; // 発話終了フラグを送らないサーバー向けの終了判定
+constexpr uint32_t kSegmentEndTimeoutMs = 500;  // 次に鳴らすものが無いとき、最後の DATA から END を待つ上限
+constexpr uint16_t kMaxConcealChunks = 8;       // これを超える欠損は補間せず詰める
+constexpr uint32_t kConcealRampMs = 5;          // 補間区間の前後のフェード長
+// 受信済み未再生の PCM に使ってよい上限（約 4 秒 @24kHz mono）。サーバーはこの範囲でしか先送りしない
+constexpr uint32_t kDownlinkBudgetBytes = 192 * 1024;
+// キャッシュから 1 回に読む量（約 0.5 秒 @24kHz mono）。flash の読み出しで loop() を長く止めない
+constexpr size_t kClipSegmentBytes = 24000;
+static_assert(kClipSegmentBytes <= Speaking::kSegmentBytes, "clip reads must fit in a segment");
+
+// 継ぎ目のクリックを抑えるため、先頭（fade_in）または末尾をリニアにフェードする
+void applySeamRamp(int16_t *samples, size_t sample_count, uint16_t channels, bool fade_in)
+{
+  size_t frames = sample_count / channels;
+  size_t ramp = std::min(kSeamRampFrames, frames);
+  for (size_t i = 0; i < ramp; ++i)
+  {
+    size_t frame = fade_in ? i : frames - 1 - i;
+    for (uint16_t ch = 0; ch < channels; ++ch)
+    {
+      int16_t &s = samples[frame * channels + ch];
+      s = static_cast<int16_t>(static_cast<int32_t>(s) * static_cast<int32_t>(i) / static_cast<int32_t>(ramp));
+    }
+  }
+}
+} // namespace
 
 void Speaking::reset()
 {
-  buffer_[0].clear();
-  buffer_[1].clear();
-  buffer_[2].clear();
-  current_buffer_ = 0;
-  playing_ = false;
-  mic_was_enabled_ = false;
+  size_t discarded = 0;
+  for (Segment &seg : segments_)
+  {
+    discarded += seg.pcm_bytes - seg.concealed_bytes;
+    seg.pcm_bytes = 0;
+    seg.concealed_bytes = 0;
+    seg.state = SlotState::Free;
+  }
+  filling_ = kNoSlot;
+  pending_payload_bytes_ = 0;
+  queue_head_ = 0;
+  queue_count_ = 0;
+  submitted_count_ = 0;
+  utterance_active_ = false;
+  end_of_utterance_ = false;
+  underrun_ = false;
+  underrun_count_ = 0;
+  seam_gap_ = false;
+  last_end_ms_ = 0;
+  drained_ms_ = 0;
+  last_data_ms_ = 0;
+  chunk_bytes_ = 0;
+  concealed_chunks_ = 0;
+  last_frame_ = {};
+  play_start_ms_ = 0;
   streaming_ = false;
   next_seq_ = 0;
   sample_rate_ = 24000; // default fallback
   channels_ = 1;
+  clip_read_ = nullptr;
+  clip_remaining_ = 0;
+
+  // 破棄した分のバッファは空いたのでクレジットとして返す
+  grantCredit(discarded);
 }
 
 void Speaking::init()
 {
+  // 起動時に計画から切り出し、以後は同じ領域を使い回す
+  for (Segment &seg : segments_)
+  {
+    if (seg.pcm == nullptr)
+    {
+      seg.pcm = static_cast<uint8_t *>(
+          memory_plan::take(memory_plan::Module::Speaking, memory_plan::Region::Psram, kSegmentBytes));
+    }
+  }
   reset();
 }
 
@@ -31,25 +103,70 @@ void Speaking::end()
 {
   if (M5.Speaker.isPlaying())
   {
+    TRACE_INSTANT(SpeakerStop, 0, 0);
     M5.Speaker.stop();
   }
   M5.Speaker.end();
   reset();
 }
 
+uint8_t *Speaking::reserveWavPayload(const WsHeader &hdr)
+{
+  dropPendingPayload();
+
+  // seq が飛んだ chunk は補間を先に詰める必要があるので、従来どおりコピーで受ける
+  if (static_cast<MessageType>(hdr.messageType) != MessageType::DATA || !streaming_ || filling_ == kNoSlot ||
+      hdr.seq != next_seq_ || hdr.payloadBytes == 0)
+  {
+    return nullptr;
+  }
+
+  Segment &seg = segments_[filling_];
+  if (seg.pcm_bytes + hdr.payloadBytes > kSegmentBytes)
+  {
+    // 入りきらない chunk はコピーで受け、handleWavMessage で次のセグメントに続ける
+    return nullptr;
+  }
+  uint8_t *dst = seg.pcm + seg.pcm_bytes;
+  seg.pcm_bytes += hdr.payloadBytes;
+  pending_payload_bytes_ = hdr.payloadBytes;
+  return dst;
+}
+
+void Speaking::dropPendingPayload()
+{
+  // 確保したまま届かなかった（途中で切断・破棄された）payload を取り消す
+  if (pending_payload_bytes_ == 0 || filling_ == kNoSlot)
+  {
+    pending_payload_bytes_ = 0;
+    return;
+  }
+  Segment &seg = segments_[filling_];
+  seg.pcm_bytes -= std::min(seg.pcm_bytes, pending_payload_bytes_);
+  pending_payload_bytes_ = 0;
+}
+
 void Speaking::handleWavMessage(const WsHeader &hdr, const uint8_t *body, size_t bodyLen)
 {
+  // reserveWavPayload の領域に直接受信済みなら、追記のコピーは要らない
+  bool in_place = pending_payload_bytes_ != 0 && filling_ != kNoSlot && bodyLen == pending_payload_bytes_ &&
+                  body == segments_[filling_].pcm + segments_[filling_].pcm_bytes - bodyLen;
+  if (!in_place)
+  {
+    dropPendingPayload();
+  }
+  pending_payload_bytes_ = 0;
+
   auto msgType = static_cast<MessageType>(hdr.messageType);
 
   if (msgType == MessageType::START)
   {
-    current_buffer_ = (current_buffer_ + 1) % 3;
-    std::vector<uint8_t> &buf = buffer_[current_buffer_];
-    buf.clear();
-    playing_ = false;
-    streaming_ = true;
-    next_seq_ = hdr.seq + 1;
-    state_.setState(StateMachine::Speaking);
+    if (filling_ != kNoSlot)
+    {
+      // 前のセグメントの END が欠けた。受信済みの分は再生に回す
+      log_w("TTS START before END; finalising partial segment");
+      finalizeFilling(millis());
+    }
 
     // START payload (optional): <uint32 sample_rate><uint16 channels>
     if (body && bodyLen >= 6)
@@ -72,74 +189,544 @@ void Speaking::handleWavMessage(const WsHeader &hdr, const uint8_t *body, size_t
     {
       log_w("TTS START without meta, fallback sr=%u ch=%u", (unsigned)sample_rate_, (unsigned)channels_);
     }
+
+    size_t slot = findFreeSlot();
+    streaming_ = slot != kNoSlot;
+    next_seq_ = hdr.seq + 1;
+    // 欠損の補間量は、このセグメントの DATA の長さから見積もり直す
+    chunk_bytes_ = 0;
+    if (!streaming_)
+    {
+      log_w("TTS no free segment slot; dropping segment seq=%u", (unsigned)hdr.seq);
+      markDiscontinuity();
+      return;
+    }
+
+    Segment &seg = segments_[slot];
+    seg.pcm_bytes = 0;
+    seg.concealed_bytes = 0;
+    seg.state = SlotState::Filling;
+    seg.sample_rate = sample_rate_;
+    seg.channels = channels_;
+    seg.fade_in = seam_gap_;
+    seg.fade_out = false;
+    seam_gap_ = false;
+    filling_ = slot;
+
+    if (!utterance_active_)
+    {
+      beginUtterance();
+    }
+    last_data_ms_ = millis();
+    state_.dispatch(StateMachine::Event::SpeakStart);
     log_i("TTS stream start seq=%u", (unsigned)hdr.seq);
     return;
   }
 
   if (msgType == MessageType::DATA)
   {
-    if (!streaming_)
+    credit_unused_ -= std::min(credit_unused_, bodyLen);
+    if (!streaming_ || filling_ == kNoSlot)
     {
+      // 受け取らなかった分のクレジットは返す
+      markDiscontinuity();
+      grantCredit(bodyLen);
       return;
     }
 
-    std::vector<uint8_t> &buf = buffer_[current_buffer_];
+    rx_audio_bytes_ += bodyLen;
+    heap_free_min_ = std::min(heap_free_min_, heap_caps_get_free_size(MALLOC_CAP_DEFAULT));
 
-    if (hdr.seq != next_seq_)
+    if (in_place)
     {
-      log_w("TTS seq gap: got=%u expected=%u", (unsigned)hdr.seq, (unsigned)next_seq_);
-      // TCP 前提で再送しない。検知だけして次を受ける。
+      // ソケットからの読み出し 1 回のみ
+      rx_copied_bytes_ += bodyLen;
       next_seq_ = hdr.seq + 1;
+      last_data_ms_ = millis();
+      chunk_bytes_ = std::max(chunk_bytes_, bodyLen);
+      dlog_d("TTS chunk size=%u recv=%u (in place)", (unsigned)bodyLen, (unsigned)segments_[filling_].pcm_bytes);
+      return;
     }
-    else
+
+    // セグメントの先頭 chunk が欠けていても、届いた chunk の長さで欠損分を見積もれる
+    chunk_bytes_ = std::max(chunk_bytes_, bodyLen);
+    if (hdr.seq != next_seq_)
     {
-      next_seq_++;
+      dlog_w("TTS seq gap: got=%u expected=%u", (unsigned)hdr.seq, (unsigned)next_seq_);
+      // 再送はしない。欠けた chunk の分を補間で埋めて再生位置のずれとクリックを防ぐ
+      concealGap(static_cast<uint16_t>(hdr.seq - next_seq_), body, bodyLen);
     }
+    next_seq_ = hdr.seq + 1;
+    last_data_ms_ = millis();
 
-    buf.insert(buf.end(), body, body + bodyLen);
-    log_d("TTS chunk size=%u recv=%u", (unsigned)bodyLen, (unsigned)buf.size());
+    if (segments_[filling_].pcm_bytes + bodyLen > kSegmentBytes && !continueInNextSlot(last_data_ms_))
+    {
+      log_w("TTS segment over %u bytes and no free slot; dropping chunk seq=%u", (unsigned)kSegmentBytes,
+            (unsigned)hdr.seq);
+      markDiscontinuity();
+      grantCredit(bodyLen);
+      return;
+    }
+
+    // ソケットから受信バッファへの読み出しと、ここでの追記の 2 回
+    Segment &seg = segments_[filling_];
+    rx_copied_bytes_ += 2 * bodyLen;
+    memcpy(seg.pcm + seg.pcm_bytes, body, bodyLen);
+    seg.pcm_bytes += bodyLen;
+    dlog_d("TTS chunk size=%u recv=%u", (unsigned)bodyLen, (unsigned)seg.pcm_bytes);
     return;
   }
 
   if (msgType == MessageType::END)
   {
-    if (!streaming_)
+    // 発話の最終セグメントには END に発話終了フラグが付く
+    if (hdr.reserved & kWsFlagEndOfUtterance)
+    {
+      end_of_utterance_ = true;
+    }
+
+    if (!streaming_ || filling_ == kNoSlot)
     {
       return;
     }
 
-    std::vector<uint8_t> &buf = buffer_[current_buffer_];
-    streaming_ = false;
-    next_seq_ = 0;
+    if (hdr.seq != next_seq_)
+    {
+      log_w("TTS seq gap before END: got=%u expected=%u", (unsigned)hdr.seq, (unsigned)next_seq_);
+      concealGap(static_cast<uint16_t>(hdr.seq - next_seq_), nullptr, 0);
+    }
+    finalizeFilling(millis());
+    return;
+  }
+}
+
+void Speaking::beginUtterance()
+{
+  utterance_active_ = true;
+  end_of_utterance_ = false;
+  underrun_ = false;
+  underrun_count_ = 0;
+  seam_gap_ = false;
+  concealed_chunks_ = 0;
+  last_frame_ = {};
+  rx_audio_bytes_ = 0;
+  rx_copied_bytes_ = 0;
+  heap_free_at_start_ = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+  heap_free_min_ = heap_free_at_start_;
+}
+
+bool Speaking::playClip(uint32_t sample_rate, uint16_t channels, size_t bytes, ClipReader read)
+{
+  if (utterance_active_ || bytes == 0 || read == nullptr)
+  {
+    return false;
+  }
+  beginUtterance();
+  sample_rate_ = sample_rate;
+  channels_ = channels;
+  clip_read_ = read;
+  clip_remaining_ = bytes;
+  last_data_ms_ = millis();
+  fillFromClip(last_data_ms_);
+  state_.dispatch(StateMachine::Event::SpeakStart);
+  log_i("TTS clip start bytes=%u sample_rate=%u", static_cast<unsigned>(bytes), static_cast<unsigned>(sample_rate));
+  return true;
+}
+
+void Speaking::fillFromClip(uint32_t now)
+{
+  const size_t frame_bytes = sizeof(int16_t) * channels_;
+  while (clip_remaining_ > 0)
+  {
+    size_t slot = findFreeSlot();
+    if (slot == kNoSlot)
+    {
+      break;
+    }
+    Segment &seg = segments_[slot];
+    size_t want = std::min(kClipSegmentBytes, clip_remaining_);
+    size_t got = clip_read_(seg.pcm, want);
+    got -= got % frame_bytes;
+    seg.pcm_bytes = got;
+    // サーバーから受け取った分ではないので、解放してもクレジットは返さない
+    seg.concealed_bytes = got;
+    seg.sample_rate = sample_rate_;
+    seg.channels = channels_;
+    seg.fade_in = false;
+    seg.fade_out = false;
+    clip_remaining_ = got < want ? 0 : clip_remaining_ - got;
+    if (got == 0)
+    {
+      seg.state = SlotState::Free;
+      break;
+    }
+    seg.state = SlotState::Ready;
+    enqueueReady(slot);
+    // 末尾のフェードアウトのため、最後のセグメントは投入前に発話終了とする
+    end_of_utterance_ = clip_remaining_ == 0;
+    // 最初のセグメントを読んだ時点で再生を始める
+    submitReady(now);
+  }
+  if (clip_remaining_ == 0)
+  {
+    clip_read_ = nullptr;
+    end_of_utterance_ = true;
+    last_end_ms_ = now;
+  }
+}
+
+void Speaking::concealGap(uint16_t missing_chunks, const uint8_t *next, size_t next_len)
+{
+  if (filling_ == kNoSlot || missing_chunks == 0 || chunk_bytes_ == 0)
+  {
+    return;
+  }
+  if (missing_chunks > kMaxConcealChunks)
+  {
+    log_w("TTS gap of %u chunks too large to conceal", (unsigned)missing_chunks);
+    return;
+  }
+
+  Segment &seg = segments_[filling_];
+  const size_t channels = seg.channels;
+  const size_t frame_bytes = sizeof(int16_t) * channels;
+  // セグメントの残りに収まる分だけ埋める
+  const size_t frames = std::min(missing_chunks * chunk_bytes_, kSegmentBytes - seg.pcm_bytes) / frame_bytes;
+  const size_t ramp = std::min(frames / 2, static_cast<size_t>(seg.sample_rate * kConcealRampMs / 1000));
 
-    if (!buf.empty())
+  // 直前のサンプルから 0 へフェードアウトし、無音を挟んで次の chunk の先頭へフェードインする。
+  // セグメントの先頭が欠けた場合、直前のサンプルは前のセグメントの最後
+  int16_t prev[2] = {last_frame_[0], last_frame_[1]};
+  int16_t following[2] = {0, 0};
+  for (size_t ch = 0; ch < std::min<size_t>(channels, 2); ++ch)
+  {
+    if (seg.pcm_bytes >= frame_bytes)
+    {
+      memcpy(&prev[ch], seg.pcm + seg.pcm_bytes - frame_bytes + ch * sizeof(int16_t), sizeof(int16_t));
+    }
+    if (next != nullptr && next_len >= frame_bytes)
     {
-      playing_ = true;
+      memcpy(&following[ch], next + ch * sizeof(int16_t), sizeof(int16_t));
+    }
+  }
 
-      const int16_t *samples = reinterpret_cast<const int16_t *>(buf.data());
-      size_t sample_len = buf.size() / sizeof(int16_t);
-      bool stereo = channels_ > 1;
-      M5.Speaker.playRaw(samples, sample_len, sample_rate_, stereo, 1, 0);
+  int16_t *fill = reinterpret_cast<int16_t *>(seg.pcm + seg.pcm_bytes);
+  seg.pcm_bytes += frames * frame_bytes;
+  for (size_t i = 0; i < frames; ++i)
+  {
+    for (size_t ch = 0; ch < channels; ++ch)
+    {
+      int32_t value = 0;
+      size_t c = std::min<size_t>(ch, 1);
+      if (i < ramp)
+      {
+        value = static_cast<int32_t>(prev[c]) * static_cast<int32_t>(ramp - i) / static_cast<int32_t>(ramp);
+      }
+      else if (i >= frames - ramp)
+      {
+        value = static_cast<int32_t>(following[c]) * static_cast<int32_t>(i - (frames - ramp) + 1) / static_cast<int32_t>(ramp);
+      }
+      fill[i * channels + ch] = static_cast<int16_t>(value);
     }
+  }
+  seg.concealed_bytes += frames * frame_bytes;
+  concealed_chunks_ += missing_chunks;
+}
+
+// ここで音が欠ける。まだ Speaker に積んでいない直前のセグメントの末尾と、次に受け取るセグメントの先頭をフェードする
+void Speaking::markDiscontinuity()
+{
+  if (filling_ != kNoSlot)
+  {
+    segments_[filling_].fade_out = true;
+  }
+  else if (queue_count_ > submitted_count_)
+  {
+    segments_[queue_[(queue_head_ + queue_count_ - 1) % kSegmentSlots]].fade_out = true;
+  }
+  seam_gap_ = true;
+}
+
+void Speaking::finalizeFilling(uint32_t now)
+{
+  if (filling_ == kNoSlot)
+  {
+    return;
+  }
+
+  Segment &seg = segments_[filling_];
+  streaming_ = false;
+  next_seq_ = 0;
+  filling_ = kNoSlot;
+  last_end_ms_ = now;
+
+  if (seg.pcm_bytes == 0)
+  {
+    seg.state = SlotState::Free;
     return;
   }
+
+  const size_t frame_bytes = sizeof(int16_t) * seg.channels;
+  if (seg.pcm_bytes >= frame_bytes)
+  {
+    memcpy(last_frame_.data(), seg.pcm + seg.pcm_bytes - frame_bytes,
+           std::min<size_t>(seg.channels, last_frame_.size()) * sizeof(int16_t));
+  }
+
+  seg.state = SlotState::Ready;
+  enqueueReady(static_cast<size_t>(&seg - segments_.data()));
+  submitReady(now);
+}
+
+bool Speaking::continueInNextSlot(uint32_t now)
+{
+  // 受信済みの分を再生に回し、同じセグメントの続きを次の空き枠で受ける
+  size_t slot = findFreeSlot();
+  if (slot == kNoSlot)
+  {
+    return false;
+  }
+  const uint16_t next_seq = next_seq_;
+  finalizeFilling(now);
+
+  Segment &seg = segments_[slot];
+  seg.pcm_bytes = 0;
+  seg.concealed_bytes = 0;
+  seg.state = SlotState::Filling;
+  seg.sample_rate = sample_rate_;
+  seg.channels = channels_;
+  seg.fade_in = seam_gap_;
+  seg.fade_out = false;
+  seam_gap_ = false;
+  filling_ = slot;
+  streaming_ = true;
+  next_seq_ = next_seq;
+  return true;
+}
+
+void Speaking::enqueueReady(size_t slot)
+{
+  queue_[(queue_head_ + queue_count_) % kSegmentSlots] = slot;
+  queue_count_++;
 }
 
 void Speaking::loop()
 {
-  if (playing_ && !M5.Speaker.isPlaying())
+  if (!utterance_active_)
+  {
+    return;
+  }
+
+  uint32_t now = millis();
+  releasePlayed(now);
+  if (clip_remaining_ > 0)
+  {
+    fillFromClip(now);
+  }
+
+  // 次に鳴らすものが無いのに END が来ない場合は、受信済みの分で区切って再生を続ける。
+  // サーバーがクレジットを使い切って止まっているだけなら、再生が尽きるまで待つ。
+  // 送れるのに止まっているなら END が欠けたので、鳴っている音に続けて鳴らす
+  bool can_send = on_credit_ && credit_unused_ >= std::max<size_t>(chunk_bytes_, 1);
+  if (filling_ != kNoSlot && submitted_count_ == queue_count_ &&
+      (can_send ? M5.Speaker.isPlaying(kSpeakerChannel) < 2 : queue_count_ == 0) &&
+      pending_payload_bytes_ == 0 && now - last_data_ms_ >= kSegmentEndTimeoutMs)
+  {
+    log_w("TTS END missing; finalising segment after %lu ms", static_cast<unsigned long>(now - last_data_ms_));
+    finalizeFilling(now);
+  }
+
+  submitReady(now);
+
+  if (utteranceFinished(now))
   {
-    log_i("TTS play done");
+    dlog_i("TTS play done underruns=%lu concealed_chunks=%lu",
+           static_cast<unsigned long>(underrun_count_), static_cast<unsigned long>(concealed_chunks_));
+    logReceiveStats();
+    utterance_active_ = false;
     if (on_speak_finished_)
     {
       on_speak_finished_();
     }
-    delay(10);
-    state_.setState(StateMachine::Idle);
+    state_.dispatch(follow_up_listening_ ? StateMachine::Event::FollowUpListen : StateMachine::Event::SpeakFinished);
+  }
+}
+
+void Speaking::logReceiveStats() const
+{
+  uint32_t bytes_per_second = sample_rate_ * channels_ * sizeof(int16_t);
+  if (rx_audio_bytes_ == 0 || bytes_per_second == 0)
+  {
+    return;
+  }
+  // 受信 1 バイトあたりのコピー回数が 1.0 なら、ソケットから再生メモリへの 1 回だけ
+  dlog_i("TTS rx: audio=%lu ms copied=%lu B/s-audio (x%.2f) heap_peak_use=%lu B",
+         static_cast<unsigned long>(static_cast<uint64_t>(rx_audio_bytes_) * 1000 / bytes_per_second),
+         static_cast<unsigned long>(static_cast<uint64_t>(rx_copied_bytes_) * bytes_per_second / rx_audio_bytes_),
+         static_cast<double>(rx_copied_bytes_) / rx_audio_bytes_,
+         static_cast<unsigned long>(heap_free_at_start_ - std::min(heap_free_at_start_, heap_free_min_)));
+}
+
+uint32_t Speaking::msUntilNextUpdate() const
+{
+  return utterance_active_ ? kPlaybackPollMs : UINT32_MAX;
+}
+
+size_t Speaking::findFreeSlot() const
+{
+  for (size_t i = 0; i < kSegmentSlots; ++i)
+  {
+    if (segments_[i].state == SlotState::Free && segments_[i].pcm != nullptr)
+    {
+      return i;
+    }
+  }
+  return kNoSlot;
+}
+
+void Speaking::releasePlayed(uint32_t now)
+{
+  // Speaker のチャンネルには「再生中」と「次」の 2 本まで入る。減った分が再生済み
+  size_t in_speaker = M5.Speaker.isPlaying(kSpeakerChannel);
+  bool released = false;
+  while (submitted_count_ > in_speaker)
+  {
+    Segment &seg = segments_[queue_[queue_head_]];
+    grantCredit(seg.pcm_bytes - seg.concealed_bytes);
+    seg.pcm_bytes = 0;
+    seg.concealed_bytes = 0;
+    seg.state = SlotState::Free;
+    queue_head_ = (queue_head_ + 1) % kSegmentSlots;
+    queue_count_--;
+    submitted_count_--;
+    released = true;
+    TRACE_INSTANT(SpeakerDone, submitted_count_, 0);
+  }
+
+  if (released)
+  {
+    play_start_ms_ = now;
+    if (submitted_count_ == 0)
+    {
+      // 鳴り終わった。発話の続きが来たら、無音の後なので頭をフェードインする
+      drained_ms_ = now;
+      underrun_ = true;
+      if (queue_count_ > 0 || filling_ != kNoSlot)
+      {
+        // 次のセグメントが間に合わず無音が挟まった
+        underrun_count_++;
+        dlog_w("TTS underrun between segments");
+      }
+    }
+  }
+}
+
+void Speaking::submitReady(uint32_t now)
+{
+  while (submitted_count_ < queue_count_)
+  {
+    size_t in_speaker = M5.Speaker.isPlaying(kSpeakerChannel);
+    if (in_speaker >= 2)
+    {
+      return;
+    }
+
+    size_t index = queue_[(queue_head_ + submitted_count_) % kSegmentSlots];
+    Segment &seg = segments_[index];
+    int16_t *samples = reinterpret_cast<int16_t *>(seg.pcm);
+    size_t sample_len = seg.pcm_bytes / sizeof(int16_t);
+
+    // 前の音の続きでない先頭（途切れた後・欠けた後）と、続きの無い末尾だけをフェードする。
+    // サーバーの 2 秒ごとの区切りや枠の継ぎ足しは同じ PCM の続きで、Speaker が隙間なくつなぐので手を加えない
+    if (seg.fade_in || (underrun_ && in_speaker == 0))
+    {
+      applySeamRamp(samples, sample_len, seg.channels, true);
+    }
+    underrun_ = false;
+    bool last = end_of_utterance_ && filling_ == kNoSlot && submitted_count_ + 1 == queue_count_;
+    if (last || seg.fade_out)
+    {
+      applySeamRamp(samples, sample_len, seg.channels, false);
+    }
+
+    // 同じチャンネルに積むことで、前のセグメントの直後から途切れずに再生される
+    bool stereo = seg.channels > 1;
+    TRACE_INSTANT(SpeakerPlay, sample_len / (stereo ? 2 : 1), seg.sample_rate);
+    M5.Speaker.playRaw(samples, sample_len, seg.sample_rate, stereo, 1, kSpeakerChannel, false);
+    seg.state = SlotState::Submitted;
+    if (in_speaker == 0)
+    {
+      play_start_ms_ = now;
+    }
+    submitted_count_++;
+  }
+}
+
+bool Speaking::utteranceFinished(uint32_t now) const
+{
+  if (queue_count_ > 0 || filling_ != kNoSlot || M5.Speaker.isPlaying(kSpeakerChannel) != 0)
+  {
+    return false;
   }
+  // 発話終了フラグが無ければ、END を受けてから・鳴り終わってからの遅い方から測る（遅れたセグメントで打ち切らない）
+  uint32_t quiet_since = static_cast<int32_t>(drained_ms_ - last_end_ms_) > 0 ? drained_ms_ : last_end_ms_;
+  return end_of_utterance_ || now - quiet_since >= kLegacyUtteranceGapMs;
 }
 
 void Speaking::setSpeakFinishedCallback(std::function<void()> cb)
 {
   on_speak_finished_ = std::move(cb);
 }
+
+void Speaking::setCreditCallback(std::function<void(uint32_t bytes)> cb)
+{
+  on_credit_ = std::move(cb);
+}
+
+void Speaking::grantInitialCredit()
+{
+  // 新しい接続ではサーバー側のクレジットも 0 から数え直す
+  credit_unused_ = 0;
+  grantCredit(kDownlinkBudgetBytes);
+}
+
+void Speaking::grantCredit(size_t bytes)
+{
+  if (bytes == 0 || !on_credit_)
+  {
+    return;
+  }
+  if (filling_ != kNoSlot && credit_unused_ < std::max<size_t>(chunk_bytes_, 1))
+  {
+    // クレジット待ちで止まっていたサーバーは、ここから続きを送る。END の待ち時間もここから測る
+    last_data_ms_ = millis();
+  }
+  credit_unused_ += bytes;
+  on_credit_(static_cast<uint32_t>(bytes));
+}
+
+uint8_t Speaking::getMouthLevel() const
+{
+  if (submitted_count_ == 0)
+  {
+    return 0;
+  }
+
+  const Segment &seg = segments_[queue_[queue_head_]];
+  const int16_t *samples = reinterpret_cast<const int16_t *>(seg.pcm);
+  size_t total = seg.pcm_bytes / sizeof(int16_t);
+  size_t pos = static_cast<size_t>(millis() - play_start_ms_) * seg.sample_rate / 1000 * seg.channels;
+  if (pos >= total)
+  {
+    return 0;
+  }
+
+  size_t count = std::min(kMouthWindowSamples, total - pos);
+  int64_t sum = 0;
+  for (size_t i = 0; i < count; ++i)
+  {
+    sum += std::abs(samples[pos + i]);
+  }
+  int32_t level = static_cast<int32_t>(sum / static_cast<int64_t>(count));
+  return static_cast<uint8_t>(std::min<int32_t>(100, level * 100 / kMouthFullScaleLevel));
+}
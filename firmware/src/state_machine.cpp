@@ -1,5 +1,144 @@
 #include <M5Unified.h>
 #include "state_machine.hpp"
+#include "trace.hpp"
+#include "deferred_log.hpp"
+
+namespace
+{
+using State = StateMachine::State;
+using Event = StateMachine::Event;
+using Hooks = StateMachine::TransitionHooks;
+
+constexpr uint8_t bit(State s)
+{
+	return static_cast<uint8_t>(1u << static_cast<uint8_t>(s));
+}
+
+constexpr uint8_t kConnectedMask = bit(State::Idle) | bit(State::Listening) | bit(State::Thinking) | bit(State::Speaking);
+constexpr uint8_t kNoTransition = 0xFF;
+
+// 許可する遷移: event が from_mask のいずれかのステートで発生し、guard が通れば to へ遷移する
+// guard / action は TransitionHooks の欄を指す（nullptr なら guard は常に通り、action は無い）
+struct Transition
+{
+	Event event;
+	uint8_t from_mask;
+	State to;
+	StateMachine::Guard Hooks::*guard;
+	StateMachine::Action Hooks::*action;
+};
+
+constexpr Transition kTransitions[] = {
+	{Event::Connected, bit(State::Disconnected), State::Listening, &Hooks::can_resume_listening, nullptr},
+	{Event::Connected, bit(State::Disconnected), State::Idle, nullptr, nullptr},
+	{Event::Disconnected, kConnectedMask, State::Disconnected, nullptr, nullptr},
+	{Event::RemoteIdle, bit(State::Listening) | bit(State::Thinking) | bit(State::Speaking), State::Idle, nullptr, nullptr},
+	{Event::RemoteListening, bit(State::Idle) | bit(State::Thinking) | bit(State::Speaking), State::Listening, nullptr, nullptr},
+	{Event::RemoteThinking, bit(State::Idle) | bit(State::Listening) | bit(State::Speaking), State::Thinking, nullptr, nullptr},
+	{Event::RemoteSpeaking, bit(State::Idle) | bit(State::Listening) | bit(State::Thinking), State::Speaking, nullptr, nullptr},
+	{Event::SpeakStart, bit(State::Idle) | bit(State::Listening) | bit(State::Thinking), State::Speaking, nullptr, nullptr},
+	{Event::ListenFinished, bit(State::Listening), State::Idle, nullptr, nullptr},
+	{Event::SpeakFinished, bit(State::Speaking), State::Idle, nullptr, nullptr},
+	{Event::CommTimeout, bit(State::Thinking) | bit(State::Speaking), State::Idle, nullptr, nullptr},
+	{Event::FollowUpListen, bit(State::Speaking), State::Listening, nullptr, &Hooks::arm_follow_up},
+};
+constexpr size_t kTransitionCount = sizeof(kTransitions) / sizeof(kTransitions[0]);
+
+using TransitionTable = std::array<std::array<uint8_t, StateMachine::kStateCount>, StateMachine::kEventCount>;
+
+// 遷移表を [event][state] -> 最初に試す行の直接参照表に展開する
+constexpr TransitionTable buildTable()
+{
+	TransitionTable table{};
+	for (auto &row : table)
+	{
+		for (auto &cell : row)
+		{
+			cell = kNoTransition;
+		}
+	}
+	for (size_t i = kTransitionCount; i-- > 0;)
+	{
+		const Transition &t = kTransitions[i];
+		for (size_t s = 0; s < StateMachine::kStateCount; ++s)
+		{
+			if (t.from_mask & (1u << s))
+			{
+				table[static_cast<size_t>(t.event)][s] = static_cast<uint8_t>(i);
+			}
+		}
+	}
+	return table;
+}
+
+// 自己遷移を含まず、同じ (event, state) の組が複数行に現れるなら、後ろの行を除いて guard を持つこと
+constexpr bool transitionsAreUnambiguous()
+{
+	for (size_t i = 0; i < kTransitionCount; ++i)
+	{
+		if (kTransitions[i].from_mask & bit(kTransitions[i].to))
+		{
+			return false;
+		}
+		for (size_t j = i + 1; j < kTransitionCount; ++j)
+		{
+			if (kTransitions[i].event == kTransitions[j].event &&
+						(kTransitions[i].from_mask & kTransitions[j].from_mask) != 0 && kTransitions[i].guard == nullptr)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// Disconnected から抜けられるのは接続時のイベント（Connected）だけ
+constexpr bool onlyConnectEventsLeaveDisconnected()
+{
+	for (const Transition &t : kTransitions)
+	{
+		if ((t.from_mask & bit(State::Disconnected)) && t.event != Event::Connected)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static_assert(transitionsAreUnambiguous(), "state transition table has self edges or unguarded overlapping rows");
+static_assert(onlyConnectEventsLeaveDisconnected(), "only Connected may leave Disconnected");
+
+constexpr TransitionTable kTable = buildTable();
+
+// (from, event) に当てはまる行を書かれた順に試し、guard が通った最初の行を返す
+const Transition *findTransition(const Hooks &hooks, State from, Event event)
+{
+	size_t e = static_cast<size_t>(event);
+	size_t s = static_cast<size_t>(from);
+	if (e >= StateMachine::kEventCount || s >= StateMachine::kStateCount || kTable[e][s] == kNoTransition)
+	{
+		return nullptr;
+	}
+	for (size_t i = kTable[e][s]; i < kTransitionCount; ++i)
+	{
+		const Transition &t = kTransitions[i];
+		if (t.event != event || (t.from_mask & bit(from)) == 0)
+		{
+			continue;
+		}
+		if (t.guard == nullptr)
+		{
+			return &t;
+		}
+		StateMachine::Guard guard = hooks.*t.guard;
+		if (guard != nullptr && guard())
+		{
+			return &t;
+		}
+	}
+	return nullptr;
+}
+} // namespace
 
 const char *stateToString(StateMachine::State s)
 {
@@ -20,24 +159,109 @@ const char *stateToString(StateMachine::State s)
 	}
 }
 
-void StateMachine::setState(State s)
+const char *eventToString(StateMachine::Event e)
+{
+	switch (e)
+	{
+	case StateMachine::Event::Connected:
+		return "Connected";
+	case StateMachine::Event::Disconnected:
+		return "Disconnected";
+	case StateMachine::Event::RemoteIdle:
+		return "RemoteIdle";
+	case StateMachine::Event::RemoteListening:
+		return "RemoteListening";
+	case StateMachine::Event::RemoteThinking:
+		return "RemoteThinking";
+	case StateMachine::Event::RemoteSpeaking:
+		return "RemoteSpeaking";
+	case StateMachine::Event::SpeakStart:
+		return "SpeakStart";
+	case StateMachine::Event::ListenFinished:
+		return "ListenFinished";
+	case StateMachine::Event::SpeakFinished:
+		return "SpeakFinished";
+	case StateMachine::Event::CommTimeout:
+		return "CommTimeout";
+	case StateMachine::Event::FollowUpListen:
+		return "FollowUpListen";
+	default:
+		return "Unknown";
+	}
+}
+
+bool StateMachine::resolve(State from, Event event, State &to) const
 {
-	if (state_ == s)
+	const Transition *t = findTransition(hooks_, from, event);
+	if (t == nullptr)
 	{
+		return false;
+	}
+	to = t->to;
+	return true;
+}
+
+void StateMachine::dispatch(Event event)
+{
+	if (dispatching_)
+	{
+		if (pending_count_ >= kEventQueueCapacity)
+		{
+			log_w("State event queue full; dropping %s", eventToString(event));
+			return;
+		}
+		pending_[(pending_head_ + pending_count_) % kEventQueueCapacity] = event;
+		pending_count_++;
 		return;
 	}
 
-	log_i("State change: %s -> %s", stateToString(state_), stateToString(s));
+	dispatching_ = true;
+	process(event);
+	while (pending_count_ > 0)
+	{
+		Event next = pending_[pending_head_];
+		pending_head_ = (pending_head_ + 1) % kEventQueueCapacity;
+		pending_count_--;
+		process(next);
+	}
+	dispatching_ = false;
+}
+
+void StateMachine::process(Event event)
+{
+	const Transition *t = findTransition(hooks_, state_, event);
+	if (t == nullptr)
+	{
+		dlog_d("State event %s ignored in %s", eventToString(event), stateToString(state_));
+		return;
+	}
+	transition(t->to, t->action != nullptr ? hooks_.*t->action : nullptr);
+}
+
+void StateMachine::transition(State s, Action action)
+{
+	dlog_i("State change: %s -> %s", stateToString(state_), stateToString(s));
+	TRACE_INSTANT(State, state_, s);
 
 	State prev = state_;
-	for (auto &cb : exit_events_[static_cast<size_t>(prev)])
+	for (Handler handler : exit_events_[static_cast<size_t>(prev)])
+	{
+		if (handler)
+		{
+			handler(prev, s);
+		}
+	}
+	if (action)
 	{
-		cb(prev, s);
+		action();
 	}
 	state_ = s;
-	for (auto &cb : entry_events_[static_cast<size_t>(state_)])
+	for (Handler handler : entry_events_[static_cast<size_t>(state_)])
 	{
-		cb(prev, state_);
+		if (handler)
+		{
+			handler(prev, state_);
+		}
 	}
 }
 
@@ -71,12 +295,31 @@ bool StateMachine::isDisconnected() const
 	return state_ == Disconnected;
 }
 
-void StateMachine::addStateEntryEvent(State state, Callback cb)
+bool StateMachine::addStateEntryEvent(State state, Handler handler)
 {
-	entry_events_[static_cast<size_t>(state)].push_back(std::move(cb));
+	return addHandler(entry_events_[static_cast<size_t>(state)], handler);
 }
 
-void StateMachine::addStateExitEvent(State state, Callback cb)
+bool StateMachine::addStateExitEvent(State state, Handler handler)
 {
-	exit_events_[static_cast<size_t>(state)].push_back(std::move(cb));
+	return addHandler(exit_events_[static_cast<size_t>(state)], handler);
+}
+
+void StateMachine::setTransitionHooks(const TransitionHooks &hooks)
+{
+	hooks_ = hooks;
+}
+
+bool StateMachine::addHandler(HandlerList &list, Handler handler)
+{
+	for (Handler &slot : list)
+	{
+		if (slot == nullptr)
+		{
+			slot = handler;
+			return true;
+		}
+	}
+	log_e("Too many state handlers (max %u)", static_cast<unsigned>(kMaxHandlersPerState));
+	return false;
 }
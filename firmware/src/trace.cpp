@@ -0,0 +1,230 @@
+#include "trace.hpp"
+
+#include <M5Unified.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include "ws_client.hpp"
+
+namespace
+{
+constexpr uint8_t kCores = 2; // ESP32-S3
+constexpr size_t kDumpFrameRecords = trace::kDumpFrameBytes / sizeof(TraceRecord);
+
+// レコードは PSRAM、head は内部 RAM に置く（PSRAM 上では atomic 命令が使えない）
+struct Ring
+{
+  TraceRecord *records = nullptr;
+  uint32_t capacity = 0; // 2 のべき乗
+  std::atomic<uint32_t> head{0}; // 次に書くスロット（単調増加、capacity で折り返して使う）
+};
+
+Ring g_rings[kCores];
+std::atomic<bool> g_enabled{false};
+bool g_allocated = false;
+uint8_t *g_frame = nullptr; // 送信用: WsHeader + TraceData DATA の payload
+
+uint32_t floorPow2(uint32_t value)
+{
+  uint32_t result = 1;
+  while (result * 2 <= value)
+  {
+    result *= 2;
+  }
+  return result;
+}
+} // namespace
+
+namespace trace
+{
+void init(size_t buffer_bytes)
+{
+  if (!STACKCHAN_TRACE || buffer_bytes == 0)
+  {
+    return;
+  }
+  const uint32_t per_core = floorPow2(static_cast<uint32_t>(buffer_bytes / kCores / sizeof(TraceRecord)));
+  using memory_plan::Module;
+  using memory_plan::Region;
+  g_frame = static_cast<uint8_t *>(memory_plan::take(Module::Trace, Region::Psram, sizeof(WsHeader) + kDumpFrameBytes));
+  bool ok = g_frame != nullptr;
+  for (Ring &ring : g_rings)
+  {
+    ring.records = static_cast<TraceRecord *>(memory_plan::take(Module::Trace, Region::Psram, per_core * sizeof(TraceRecord)));
+    ring.capacity = per_core;
+    ok = ok && ring.records != nullptr;
+  }
+  if (!ok)
+  {
+    log_e("Trace: no budget for %u bytes", static_cast<unsigned>(buffer_bytes));
+    g_frame = nullptr;
+    for (Ring &ring : g_rings)
+    {
+      ring.records = nullptr;
+      ring.capacity = 0;
+    }
+    return;
+  }
+  g_allocated = true;
+  g_enabled.store(true, std::memory_order_release);
+  log_i("Trace: recording %lu records per core", static_cast<unsigned long>(per_core));
+}
+
+void record(TracePoint point, TracePhase phase, uint32_t arg0, uint32_t arg1)
+{
+  if (!g_enabled.load(std::memory_order_relaxed))
+  {
+    return;
+  }
+  // 同じコアのタスクに割り込まれても、fetch_add で取ったスロットは重ならない
+  const uint8_t core = static_cast<uint8_t>(xPortGetCoreID());
+  Ring &ring = g_rings[core];
+  const uint32_t index = ring.head.fetch_add(1, std::memory_order_relaxed);
+  TraceRecord &rec = ring.records[index & (ring.capacity - 1)];
+  rec.time_us = static_cast<uint32_t>(esp_timer_get_time());
+  rec.point = static_cast<uint16_t>(point);
+  rec.phase = static_cast<uint8_t>(phase);
+  rec.core = core;
+  rec.arg0 = arg0;
+  rec.arg1 = arg1;
+}
+} // namespace trace
+
+void TraceDump::handleCommand(const uint8_t *payload, size_t len)
+{
+  if (requested_)
+  {
+    log_w("Trace: dump already in progress");
+    return;
+  }
+  const uint8_t flags = len >= 1 ? payload[0] : 0;
+  requested_ = true;
+  started_ = false;
+  clear_after_ = (flags & kTraceCmdFlagClear) != 0;
+}
+
+void TraceDump::upload(size_t budget)
+{
+  if (!requested_)
+  {
+    return;
+  }
+  if (!ws_.isConnected())
+  {
+    abort();
+    return;
+  }
+  if (!started_ && !sendStart())
+  {
+    abort();
+    return;
+  }
+  if (!sendRecords(budget))
+  {
+    abort();
+    return;
+  }
+  if (core_ < kCores)
+  {
+    return; // 続きは次の loop()
+  }
+  if (!sendEnd())
+  {
+    abort();
+    return;
+  }
+  finish();
+}
+
+bool TraceDump::sendStart()
+{
+  // 送り終えるまで記録を止め、送る範囲をここで決める
+  g_enabled.store(false, std::memory_order_release);
+  TraceDumpHeader dump{kTraceMagic, kTraceVersion, kCores, 0, 0, 0, static_cast<uint64_t>(esp_timer_get_time())};
+  for (uint8_t core = 0; core < kCores; ++core)
+  {
+    const uint32_t head = g_rings[core].head.load(std::memory_order_acquire);
+    const uint32_t count = std::min(head, g_rings[core].capacity);
+    next_[core] = head - count;
+    end_[core] = head;
+    dump.records += count;
+    dump.lost += head - count;
+  }
+  core_ = 0;
+
+  WsHeader hdr{static_cast<uint8_t>(MessageKind::TraceData), static_cast<uint8_t>(MessageType::START), 0, seq_++,
+               static_cast<uint16_t>(sizeof(dump))};
+  uint8_t packet[sizeof(WsHeader) + sizeof(TraceDumpHeader)];
+  memcpy(packet, &hdr, sizeof(hdr));
+  memcpy(packet + sizeof(hdr), &dump, sizeof(dump));
+  if (!ws_.sendBIN(packet, sizeof(packet)))
+  {
+    return false;
+  }
+  started_ = true;
+  log_i("Trace: dumping %lu records (%lu lost)", static_cast<unsigned long>(dump.records),
+        static_cast<unsigned long>(dump.lost));
+  return true;
+}
+
+bool TraceDump::sendRecords(size_t budget)
+{
+  size_t sent = 0;
+  while (core_ < kCores && sent < budget)
+  {
+    const Ring &ring = g_rings[core_];
+    const uint32_t n = std::min<uint32_t>(end_[core_] - next_[core_], kDumpFrameRecords);
+    if (n == 0)
+    {
+      core_++;
+      continue;
+    }
+    TraceRecord *out = reinterpret_cast<TraceRecord *>(g_frame + sizeof(WsHeader));
+    for (uint32_t i = 0; i < n; ++i)
+    {
+      out[i] = ring.records[(next_[core_] + i) & (ring.capacity - 1)];
+    }
+    const size_t bytes = n * sizeof(TraceRecord);
+    WsHeader hdr{static_cast<uint8_t>(MessageKind::TraceData), static_cast<uint8_t>(MessageType::DATA), 0, seq_++,
+                 static_cast<uint16_t>(bytes)};
+    memcpy(g_frame, &hdr, sizeof(hdr));
+    if (!ws_.sendBIN(g_frame, sizeof(WsHeader) + bytes))
+    {
+      return false;
+    }
+    next_[core_] += n;
+    sent += bytes;
+  }
+  return true;
+}
+
+bool TraceDump::sendEnd()
+{
+  WsHeader hdr{static_cast<uint8_t>(MessageKind::TraceData), static_cast<uint8_t>(MessageType::END), 0, seq_++, 0};
+  return ws_.sendBIN(reinterpret_cast<const uint8_t *>(&hdr), sizeof(hdr));
+}
+
+void TraceDump::finish()
+{
+  if (clear_after_)
+  {
+    for (Ring &ring : g_rings)
+    {
+      ring.head.store(0, std::memory_order_relaxed);
+    }
+  }
+  requested_ = false;
+  started_ = false;
+  g_enabled.store(g_allocated, std::memory_order_release);
+}
+
+void TraceDump::abort()
+{
+  // 記録は残したまま再開する。サーバーは END が来なければタイムアウトする
+  log_w("Trace: dump aborted");
+  requested_ = false;
+  started_ = false;
+  g_enabled.store(g_allocated, std::memory_order_release);
+}
@@ -0,0 +1,280 @@
+#include "uplink_frontend.hpp"
+
+#include <M5Unified.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "deferred_log.hpp"
+
+namespace
+{
+constexpr float kPi = 3.14159265f;
+
+// HPF の極（Q15）。16kHz で約 50 Hz
+constexpr int32_t kHpfPoleQ15 = 32113;
+
+// 雑音抑圧
+constexpr float kPowerSmoothing = 0.2f;     // 雑音推定に使うパワーの平滑化
+constexpr float kNoiseRise = 1.003f;        // 最小値追従の上昇（1 フレームあたり、約 +1.6 dB/s）
+constexpr float kNoiseRiseWarmup = 1.02f;   // 起動直後は雑音レベルにすばやく追いつかせる（約 +10 dB/s）
+constexpr uint32_t kWarmupFrames = 250;     // 約 2 秒
+constexpr float kNoiseBias = 1.5f;          // 最小値追従は雑音を低めに見積もるので補正する
+constexpr float kPriorSnrSmoothing = 0.96f; // 決定指向型の事前 SNR の平滑化
+constexpr float kMinGain = 0.2f;            // 抑圧は最大 -14 dB（ASR は抑圧しすぎると語を落とす）
+constexpr float kInitialNoisePower = 30.0f * 30.0f * 128.0f; // 実効値 30 の白色雑音相当
+
+// AGC
+constexpr float kAgcTargetRms = 3000.0f;  // 約 -21 dBFS
+constexpr float kAgcSpeechRms = 100.0f;   // これより小さいブロックではゲインを上げない（雑音を持ち上げない）
+constexpr uint32_t kAgcHoldBlocks = 30;   // 発話が途切れてからゲインを保つ時間（約 0.5 秒）。その後は 1 倍へ戻していく
+constexpr float kAgcLevelSmoothing = 0.2f;
+constexpr int32_t kAgcMinGainQ12 = 1 << 11; // -6 dB
+constexpr int32_t kAgcMaxGainQ12 = 1 << 15; // +18 dB
+constexpr int32_t kAgcPeakLimit = 32000;
+
+int16_t saturate16(int32_t value)
+{
+  return static_cast<int16_t>(std::max<int32_t>(INT16_MIN, std::min<int32_t>(INT16_MAX, value)));
+}
+
+int32_t blockPeak(const int16_t *samples, size_t count)
+{
+  int32_t peak = 0;
+  for (size_t i = 0; i < count; ++i)
+  {
+    peak = std::max(peak, std::abs(static_cast<int32_t>(samples[i])));
+  }
+  return peak;
+}
+
+uint64_t blockEnergy(const int16_t *samples, size_t count)
+{
+  uint64_t energy = 0;
+  for (size_t i = 0; i < count; ++i)
+  {
+    energy += static_cast<uint64_t>(static_cast<int32_t>(samples[i]) * samples[i]);
+  }
+  return energy;
+}
+} // namespace
+
+void UplinkFrontEnd::init()
+{
+  fft_.init();
+  for (size_t i = 0; i < kFftSize; ++i)
+  {
+    // 周期的な Hann の平方根。ホップ N/2 で分析・合成に掛けると和が 1 になる
+    window_[i] = std::sqrt(0.5f - 0.5f * std::cos(2.0f * kPi * static_cast<float>(i) / static_cast<float>(kFftSize)));
+  }
+  noise_power_.fill(kInitialNoisePower);
+  smoothed_power_.fill(kInitialNoisePower);
+  clean_power_.fill(0.0f);
+  reset();
+}
+
+void UplinkFrontEnd::reset()
+{
+  hpf_x1_ = 0;
+  hpf_y1_ = 0;
+  ns_history_.fill(0);
+  ns_overlap_.fill(0.0f);
+  agc_delay_.fill(0);
+  agc_delay_peak_ = 0;
+  agc_applied_q12_ = agc_gain_q12_;
+}
+
+void UplinkFrontEnd::process(const int16_t *in, int16_t *out)
+{
+  uint32_t start = ESP.getCycleCount();
+  if (bypass_)
+  {
+    memcpy(out, in, kBlockSamples * sizeof(int16_t));
+  }
+  else
+  {
+    highPass(in, out);
+    suppressNoise(out, out);
+    applyAgc(out, out);
+  }
+  uint32_t cycles = ESP.getCycleCount() - start;
+
+  stat_blocks_++;
+  stat_cycles_total_ += cycles;
+  stat_cycles_max_ = std::max(stat_cycles_max_, cycles);
+  stat_in_energy_ += blockEnergy(in, kBlockSamples);
+  stat_out_energy_ += blockEnergy(out, kBlockSamples);
+  int32_t in_peak = blockPeak(in, kBlockSamples);
+  stat_in_peak_ = std::max(stat_in_peak_, in_peak);
+  stat_out_peak_ = std::max(stat_out_peak_, blockPeak(out, kBlockSamples));
+  if (in_peak >= INT16_MAX)
+  {
+    for (size_t i = 0; i < kBlockSamples; ++i)
+    {
+      stat_in_clipped_ += (in[i] >= INT16_MAX || in[i] <= INT16_MIN) ? 1 : 0;
+    }
+  }
+  stat_gain_min_q12_ = std::min(stat_gain_min_q12_, agc_applied_q12_);
+  stat_gain_max_q12_ = std::max(stat_gain_max_q12_, agc_applied_q12_);
+}
+
+void UplinkFrontEnd::logStats()
+{
+  if (stat_blocks_ == 0)
+  {
+    return;
+  }
+  const float samples = static_cast<float>(stat_blocks_ * kBlockSamples);
+  dlog_i("Uplink front end%s: %lu blocks, rms in=%.0f out=%.0f, peak in=%ld out=%ld, clipped in=%lu, "
+         "agc gain %.2f..%.2f, avg=%lu max=%lu cycles/block",
+         bypass_ ? " (bypass)" : "", static_cast<unsigned long>(stat_blocks_),
+         std::sqrt(static_cast<float>(stat_in_energy_) / samples), std::sqrt(static_cast<float>(stat_out_energy_) / samples),
+         static_cast<long>(stat_in_peak_), static_cast<long>(stat_out_peak_), static_cast<unsigned long>(stat_in_clipped_),
+         static_cast<float>(stat_gain_min_q12_) / 4096.0f, static_cast<float>(stat_gain_max_q12_) / 4096.0f,
+         static_cast<unsigned long>(stat_cycles_total_ / stat_blocks_), static_cast<unsigned long>(stat_cycles_max_));
+  stat_blocks_ = 0;
+  stat_in_energy_ = 0;
+  stat_out_energy_ = 0;
+  stat_in_peak_ = 0;
+  stat_out_peak_ = 0;
+  stat_in_clipped_ = 0;
+  stat_gain_min_q12_ = INT32_MAX;
+  stat_gain_max_q12_ = 0;
+  stat_cycles_total_ = 0;
+  stat_cycles_max_ = 0;
+}
+
+void UplinkFrontEnd::highPass(const int16_t *in, int16_t *out)
+{
+  // y[n] = x[n] - x[n-1] + a * y[n-1]
+  for (size_t i = 0; i < kBlockSamples; ++i)
+  {
+    int32_t x = in[i];
+    hpf_y1_ = (static_cast<int64_t>(x - hpf_x1_) << 15) + ((hpf_y1_ * kHpfPoleQ15) >> 15);
+    hpf_x1_ = x;
+    out[i] = saturate16(static_cast<int32_t>((hpf_y1_ + (1 << 14)) >> 15));
+  }
+}
+
+void UplinkFrontEnd::suppressNoise(const int16_t *in, int16_t *out)
+{
+  // 1 ブロックに 2 フレーム（前のブロックの後半から始まるものと、このブロック全体）があり、
+  // 実信号 2 本として 1 回の複素 FFT で変換する: z = frame1 + j frame2
+  for (size_t i = 0; i < kFftSize; ++i)
+  {
+    int16_t first = i < kHop ? ns_history_[i] : in[i - kHop];
+    fft_re_[i] = static_cast<float>(first) * window_[i];
+    fft_im_[i] = static_cast<float>(in[i]) * window_[i];
+  }
+  memcpy(ns_history_.data(), in + kHop, kHop * sizeof(int16_t));
+  fft_.forward(fft_re_.data(), fft_im_.data());
+
+  // frame1 = (Z[k] + conj(Z[N-k])) / 2, frame2 = (Z[k] - conj(Z[N-k])) / 2j
+  for (size_t k = 0; k < kBins; ++k)
+  {
+    size_t m = (kFftSize - k) & (kFftSize - 1);
+    float re = 0.5f * (fft_re_[k] + fft_re_[m]);
+    float im = 0.5f * (fft_im_[k] - fft_im_[m]);
+    power_[k] = re * re + im * im;
+  }
+  updateGains(power_.data(), gain1_.data());
+  for (size_t k = 0; k < kBins; ++k)
+  {
+    size_t m = (kFftSize - k) & (kFftSize - 1);
+    float re = 0.5f * (fft_im_[k] + fft_im_[m]);
+    float im = 0.5f * (fft_re_[m] - fft_re_[k]);
+    power_[k] = re * re + im * im;
+  }
+  updateGains(power_.data(), gain2_.data());
+
+  // Y = G1 X1 + j G2 X2 = (G1+G2)/2 Z[k] + (G1-G2)/2 conj(Z[N-k])
+  for (size_t k = 0; k < kBins; ++k)
+  {
+    size_t m = (kFftSize - k) & (kFftSize - 1);
+    float a = 0.5f * (gain1_[k] + gain2_[k]);
+    float b = 0.5f * (gain1_[k] - gain2_[k]);
+    float zr = fft_re_[k];
+    float zi = fft_im_[k];
+    float nr = fft_re_[m];
+    float ni = fft_im_[m];
+    fft_re_[k] = a * zr + b * nr;
+    fft_im_[k] = a * zi - b * ni;
+    if (m != k)
+    {
+      fft_re_[m] = a * nr + b * zr;
+      fft_im_[m] = a * ni - b * zi;
+    }
+  }
+  fft_.inverse(fft_re_.data(), fft_im_.data());
+
+  // 合成窓を掛けて重ね合わせる。出力は kHop サンプル遅れる
+  for (size_t i = 0; i < kHop; ++i)
+  {
+    out[i] = saturate16(static_cast<int32_t>(std::lround(ns_overlap_[i] + fft_re_[i] * window_[i])));
+  }
+  for (size_t i = 0; i < kHop; ++i)
+  {
+    out[kHop + i] = saturate16(
+        static_cast<int32_t>(std::lround(fft_re_[kHop + i] * window_[kHop + i] + fft_im_[i] * window_[i])));
+    ns_overlap_[i] = fft_im_[kHop + i] * window_[kHop + i];
+  }
+}
+
+void UplinkFrontEnd::updateGains(const float *power, float *gain)
+{
+  const float rise = noise_frames_ < kWarmupFrames ? kNoiseRiseWarmup : kNoiseRise;
+  noise_frames_++;
+  for (size_t k = 0; k < kBins; ++k)
+  {
+    smoothed_power_[k] += (power[k] - smoothed_power_[k]) * kPowerSmoothing;
+    noise_power_[k] = smoothed_power_[k] < noise_power_[k] ? smoothed_power_[k] : noise_power_[k] * rise;
+
+    float noise = noise_power_[k] * kNoiseBias + 1.0f;
+    float post_snr = power[k] / noise;
+    float prior_snr = kPriorSnrSmoothing * clean_power_[k] / noise +
+                      (1.0f - kPriorSnrSmoothing) * std::max(post_snr - 1.0f, 0.0f);
+    float g = std::max(kMinGain, prior_snr / (1.0f + prior_snr));
+    clean_power_[k] = g * g * power[k];
+    gain[k] = g;
+  }
+}
+
+void UplinkFrontEnd::applyAgc(const int16_t *in, int16_t *out)
+{
+  // in は先読みのブロック。出力するのは 1 つ前のブロック（agc_delay_）
+  uint64_t energy = blockEnergy(in, kBlockSamples);
+  float rms = std::sqrt(static_cast<float>(energy) / static_cast<float>(kBlockSamples));
+  int32_t peak = blockPeak(in, kBlockSamples);
+
+  if (rms > kAgcSpeechRms)
+  {
+    agc_level_ = agc_level_ <= 0.0f ? rms : agc_level_ + (rms - agc_level_) * kAgcLevelSmoothing;
+    int32_t desired = static_cast<int32_t>(kAgcTargetRms / agc_level_ * 4096.0f);
+    desired = std::max(kAgcMinGainQ12, std::min(kAgcMaxGainQ12, desired));
+    // 下げるのはすぐ、上げるのはゆっくり（1 ブロックで約 +0.27 dB、約 17 dB/s）
+    agc_gain_q12_ = desired < agc_gain_q12_ ? desired : std::min(desired, agc_gain_q12_ + agc_gain_q12_ / 32);
+    agc_quiet_blocks_ = 0;
+  }
+  else if (++agc_quiet_blocks_ > kAgcHoldBlocks && agc_gain_q12_ > (1 << 12))
+  {
+    // 話し終えた後の雑音を持ち上げたままにしない（1 ブロックで約 -0.07 dB）
+    agc_gain_q12_ = std::max<int32_t>(1 << 12, agc_gain_q12_ - agc_gain_q12_ / 128);
+  }
+
+  // このブロックと次のブロックのピークが飽和しないところまでに抑える
+  int32_t lookahead_peak = std::max(std::max(agc_delay_peak_, peak), static_cast<int32_t>(1));
+  int32_t limit = static_cast<int32_t>((static_cast<int64_t>(kAgcPeakLimit) << 12) / lookahead_peak);
+  int32_t target = std::min(agc_gain_q12_, limit);
+
+  // ブロック内でゲインを直線的に移す（ステップ状に変えるとクリック音になる）
+  int32_t from = agc_applied_q12_;
+  for (size_t i = 0; i < kBlockSamples; ++i)
+  {
+    int32_t g = from + static_cast<int32_t>((static_cast<int64_t>(target - from) * static_cast<int64_t>(i + 1)) /
+                                            static_cast<int64_t>(kBlockSamples));
+    int32_t x = agc_delay_[i];
+    agc_delay_[i] = in[i];
+    out[i] = saturate16((x * g + (1 << 11)) >> 12);
+  }
+  agc_applied_q12_ = target;
+  agc_delay_peak_ = peak;
+}
@@ -1,11 +1,15 @@
 #include <M5Unified.h>
 #include <ESP_SR_M5Unified.h>
-#include <utility>
 #include "wake_up_word.hpp"
+#include "local_commands.hpp"
+#include "loop_wake.hpp"
 
 namespace
 {
 WakeUpWord *g_wuw = nullptr;
+
+// ウェイクワードからコマンドを言い終えるまでの猶予
+constexpr uint32_t kCommandWindowMs = 4000;
 }
 
 void WakeUpWord::init()
@@ -13,23 +17,77 @@ void WakeUpWord::init()
   g_wuw = this;
 
   ESP_SR_M5.onEvent(onSrEventForward);
-  bool success = ESP_SR_M5.begin();
-  log_i("ESP_SR_M5.begin() = %d", success);
+  bool success = commands_enabled_ ? ESP_SR_M5.begin(kLocalCommandPhrases, kLocalCommandPhraseCount)
+                                   : ESP_SR_M5.begin();
+  log_i("ESP_SR_M5.begin() = %d (local commands=%u)", success,
+        static_cast<unsigned>(commands_enabled_ ? kLocalCommandPhraseCount : 0));
 }
 
 void WakeUpWord::begin()
 {
   M5.Mic.begin();
-  ESP_SR_M5.setMode(SR_MODE_WAKEWORD);
+  mic_.reset();
+  sr_running_outside_idle_ = false;
+  if (!command_phase_)
+  {
+    ESP_SR_M5.setMode(SR_MODE_WAKEWORD);
+  }
   ESP_SR_M5.resume();
 }
 
 void WakeUpWord::end()
 {
   M5.Mic.end();
+  if (command_phase_)
+  {
+    // コマンド待ちの途中。Listening の録音を feedCommandAudio() で受けて認識を続ける
+    sr_running_outside_idle_ = true;
+    return;
+  }
   ESP_SR_M5.pause();
 }
 
+void WakeUpWord::feedCommandAudio(const int16_t *samples, size_t count)
+{
+  if (sr_running_outside_idle_ && command_phase_)
+  {
+    ESP_SR_M5.feedAudio(samples, count);
+  }
+}
+
+bool WakeUpWord::takeCommand(LocalCommand &command, uint32_t &detected_us)
+{
+  if (command_phase_ && millis() - command_phase_since_ms_ >= kCommandWindowMs)
+  {
+    command_phase_ = false;
+    ESP_SR_M5.setMode(SR_MODE_WAKEWORD);
+  }
+  if (!command_phase_ && sr_running_outside_idle_)
+  {
+    sr_running_outside_idle_ = false;
+    ESP_SR_M5.pause();
+  }
+
+  int id = pending_command_.exchange(-1);
+  if (id < 0)
+  {
+    return false;
+  }
+  command = static_cast<LocalCommand>(id);
+  detected_us = command_detected_us_;
+  return true;
+}
+
+bool WakeUpWord::takeWakeWord(uint32_t &detected_us)
+{
+  if (!wake_word_pending_.exchange(false))
+  {
+    return false;
+  }
+  detected_us = wake_word_detected_us_;
+  return true;
+}
+
 void WakeUpWord::feedAudio(const int16_t *samples, size_t count)
 {
   ESP_SR_M5.feedAudio(samples, count);
@@ -45,7 +103,7 @@ void WakeUpWord::loop()
   constexpr size_t kAudioSampleSize = 256;
   static int16_t audio_buf[kAudioSampleSize];
 
-  bool success = M5.Mic.record(audio_buf, kAudioSampleSize, sample_rate_);
+  bool success = mic_.read(audio_buf, kAudioSampleSize);
   if (success)
   {
     feedAudio(audio_buf, kAudioSampleSize);
@@ -77,11 +135,6 @@ void WakeUpWord::loop()
   }
 }
 
-void WakeUpWord::setWakeWordDetectedCallback(std::function<void()> cb)
-{
-  on_wake_word_detected_ = std::move(cb);
-}
-
 void WakeUpWord::onSrEventForward(sr_event_t event, int command_id, int phrase_id)
 {
   if (g_wuw)
@@ -96,10 +149,27 @@ void WakeUpWord::handleSrEvent(sr_event_t event, int command_id, int phrase_id)
   {
   case SR_EVENT_WAKEWORD:
     log_i("WakeWord Detected!");
-    if (on_wake_word_detected_)
+    if (commands_enabled_)
     {
-      on_wake_word_detected_();
+      command_phase_since_ms_ = millis();
+      command_phase_ = true;
+      ESP_SR_M5.setMode(SR_MODE_COMMAND);
     }
+    wake_word_detected_us_ = micros();
+    wake_word_pending_ = true;
+    loop_wake::notify(loop_wake::Source::Speech);
+    break;
+  case SR_EVENT_COMMAND:
+    log_i("Command Detected: id=%d phrase=%d", command_id, phrase_id);
+    command_detected_us_ = micros();
+    pending_command_ = command_id;
+    command_phase_ = false;
+    ESP_SR_M5.setMode(SR_MODE_WAKEWORD);
+    loop_wake::notify(loop_wake::Source::Speech);
+    break;
+  case SR_EVENT_TIMEOUT:
+    command_phase_ = false;
+    ESP_SR_M5.setMode(SR_MODE_WAKEWORD);
     break;
   default:
     log_i("Unknown Event: %d", event);
@@ -0,0 +1,235 @@
+#include "ws_capture.hpp"
+
+#include <M5Unified.h>
+#include <esp_timer.h>
+#include <algorithm>
+#include <cstring>
+#include "deferred_log.hpp"
+
+namespace
+{
+uint32_t deltaUs(uint64_t at_us, uint64_t since_us)
+{
+  uint64_t delta = at_us > since_us ? at_us - since_us : 0;
+  return static_cast<uint32_t>(std::min<uint64_t>(delta, UINT32_MAX));
+}
+} // namespace
+
+void WsCapture::init(size_t buffer_bytes)
+{
+  if (buffer_bytes == 0)
+  {
+    return;
+  }
+  using memory_plan::Module;
+  using memory_plan::Region;
+  uint8_t *frame = static_cast<uint8_t *>(memory_plan::take(Module::WsCapture, Region::Psram, sizeof(WsHeader) + kUploadFrameBytes));
+  uint8_t *ring = static_cast<uint8_t *>(memory_plan::take(Module::WsCapture, Region::Psram, buffer_bytes));
+  if (ring == nullptr || frame == nullptr)
+  {
+    log_e("WS capture: no budget for %u bytes", static_cast<unsigned>(buffer_bytes));
+    return;
+  }
+  ring_ = ring;
+  frame_ = frame;
+  capacity_ = buffer_bytes;
+  log_i("WS capture: recording into %u KiB", static_cast<unsigned>(buffer_bytes / 1024));
+}
+
+void WsCapture::recordRx(const WsHeader &hdr, const uint8_t *body, size_t len)
+{
+  if (!isEnabled())
+  {
+    return;
+  }
+  append(WsCaptureRecord::Rx, esp_timer_get_time(), reinterpret_cast<const uint8_t *>(&hdr), sizeof(hdr), body, len);
+}
+
+void WsCapture::recordTx(const uint8_t *data, size_t len)
+{
+  if (!isEnabled() || len < sizeof(WsHeader))
+  {
+    return;
+  }
+  if (static_cast<MessageKind>(data[0]) == MessageKind::CaptureData)
+  {
+    return; // 記録の送信そのものは記録しない
+  }
+  append(WsCaptureRecord::Tx, esp_timer_get_time(), data, len, nullptr, 0);
+}
+
+void WsCapture::recordEvent(WsCaptureEvent event)
+{
+  // 接続が変わったら、次の送信は新しいファイルの START から（途中まで送ったレコードも送り直す）
+  file_started_ = false;
+  record_sent_ = 0;
+  if (!isEnabled())
+  {
+    return;
+  }
+  const uint8_t value = static_cast<uint8_t>(event);
+  append(WsCaptureRecord::Event, esp_timer_get_time(), &value, sizeof(value), nullptr, 0);
+}
+
+bool WsCapture::reserve(size_t bytes)
+{
+  return capacity_ - used_ >= bytes;
+}
+
+void WsCapture::append(WsCaptureRecord type, uint64_t at_us, const uint8_t *head, size_t head_len,
+                       const uint8_t *body, size_t body_len)
+{
+  const size_t record_bytes = sizeof(StoredHeader) + head_len + body_len;
+  const size_t dropped_bytes = dropped_records_ > 0 ? sizeof(StoredHeader) + 2 * sizeof(uint32_t) : 0;
+  if (!reserve(record_bytes + dropped_bytes))
+  {
+    // 古い記録（障害の始まり）を残し、新しい方を捨てる。送信途中のレコードを上書きしないため
+    if (dropped_records_ == 0)
+    {
+      log_w("WS capture: buffer full; dropping records until the next upload");
+    }
+    dropped_records_++;
+    dropped_bytes_ += static_cast<uint32_t>(head_len + body_len);
+    total_dropped_records_++;
+    return;
+  }
+
+  if (dropped_records_ > 0)
+  {
+    StoredHeader gap{static_cast<uint8_t>(WsCaptureRecord::Dropped), at_us, 2 * sizeof(uint32_t)};
+    ringWrite(reinterpret_cast<const uint8_t *>(&gap), sizeof(gap));
+    ringWrite(reinterpret_cast<const uint8_t *>(&dropped_records_), sizeof(dropped_records_));
+    ringWrite(reinterpret_cast<const uint8_t *>(&dropped_bytes_), sizeof(dropped_bytes_));
+    dropped_records_ = 0;
+    dropped_bytes_ = 0;
+  }
+
+  StoredHeader stored{static_cast<uint8_t>(type), at_us, static_cast<uint32_t>(head_len + body_len)};
+  ringWrite(reinterpret_cast<const uint8_t *>(&stored), sizeof(stored));
+  ringWrite(head, head_len);
+  if (body_len > 0 && body != nullptr)
+  {
+    ringWrite(body, body_len);
+  }
+}
+
+void WsCapture::ringWrite(const uint8_t *src, size_t len)
+{
+  size_t tail = (head_ + used_) % capacity_;
+  size_t first = std::min(len, capacity_ - tail);
+  memcpy(ring_ + tail, src, first);
+  memcpy(ring_, src + first, len - first);
+  used_ += len;
+}
+
+void WsCapture::ringRead(size_t pos, uint8_t *dst, size_t len) const
+{
+  pos %= capacity_;
+  size_t first = std::min(len, capacity_ - pos);
+  memcpy(dst, ring_ + pos, first);
+  memcpy(dst + first, ring_, len - first);
+}
+
+void WsCapture::upload(size_t budget)
+{
+  if (!isEnabled() || used_ == 0 || !ws_.isConnected())
+  {
+    return;
+  }
+
+  StoredHeader stored{};
+  if (!file_started_)
+  {
+    ringRead(head_, reinterpret_cast<uint8_t *>(&stored), sizeof(stored));
+    if (!sendStart(stored.at_us))
+    {
+      return;
+    }
+  }
+
+  uint8_t *frame = frame_ + sizeof(WsHeader); // 先頭は sendData で WsHeader を書く
+  size_t sent = 0;
+  while (used_ > 0 && sent < budget)
+  {
+    // 1 フレームに入るだけレコードを詰める。リングから外すのは送れてから
+    size_t frame_len = 0;
+    size_t pos = head_;
+    size_t remaining = used_;
+    size_t offset = record_sent_;
+    uint64_t last_us = last_sent_us_;
+    while (remaining > 0 && frame_len < kUploadFrameBytes)
+    {
+      ringRead(pos, reinterpret_cast<uint8_t *>(&stored), sizeof(stored));
+      WsCaptureRecordHeader out{stored.type, deltaUs(stored.at_us, last_us), stored.bytes};
+      const size_t record_len = sizeof(out) + stored.bytes;
+      const size_t n = std::min(record_len - offset, kUploadFrameBytes - frame_len);
+
+      size_t copied = 0;
+      if (offset < sizeof(out))
+      {
+        copied = std::min(sizeof(out) - offset, n);
+        memcpy(frame + frame_len, reinterpret_cast<const uint8_t *>(&out) + offset, copied);
+      }
+      if (copied < n)
+      {
+        size_t body_offset = offset + copied - sizeof(out);
+        ringRead(pos + sizeof(stored) + body_offset, frame + frame_len + copied, n - copied);
+      }
+      frame_len += n;
+      offset += n;
+      if (offset < record_len)
+      {
+        break; // 続きは次のフレーム
+      }
+
+      const size_t stored_len = sizeof(stored) + stored.bytes;
+      pos = (pos + stored_len) % capacity_;
+      remaining -= stored_len;
+      last_us = stored.at_us;
+      offset = 0;
+    }
+
+    if (!sendData(frame_len))
+    {
+      return; // 切れた。次の接続で先頭のレコードから送り直す
+    }
+    head_ = pos;
+    used_ = remaining;
+    record_sent_ = offset;
+    last_sent_us_ = last_us;
+    sent += frame_len;
+  }
+
+  uploaded_bytes_ += static_cast<uint32_t>(sent);
+  if (used_ == 0)
+  {
+    dlog_d("WS capture: uploaded %lu bytes (dropped %lu records so far)", static_cast<unsigned long>(uploaded_bytes_),
+           static_cast<unsigned long>(total_dropped_records_));
+  }
+}
+
+bool WsCapture::sendStart(uint64_t first_us)
+{
+  WsCaptureFileHeader file{kWsCaptureMagic, kWsCaptureVersion, static_cast<uint8_t>(WsCaptureOrigin::Device), 0, first_us};
+  WsHeader hdr{static_cast<uint8_t>(MessageKind::CaptureData), static_cast<uint8_t>(MessageType::START), 0, seq_++,
+               static_cast<uint16_t>(sizeof(file))};
+  uint8_t packet[sizeof(WsHeader) + sizeof(WsCaptureFileHeader)];
+  memcpy(packet, &hdr, sizeof(hdr));
+  memcpy(packet + sizeof(hdr), &file, sizeof(file));
+  if (!ws_.sendBIN(packet, sizeof(packet)))
+  {
+    return false;
+  }
+  file_started_ = true;
+  last_sent_us_ = first_us;
+  record_sent_ = 0;
+  return true;
+}
+
+bool WsCapture::sendData(size_t len)
+{
+  WsHeader hdr{static_cast<uint8_t>(MessageKind::CaptureData), static_cast<uint8_t>(MessageType::DATA), 0, seq_++,
+               static_cast<uint16_t>(len)};
+  memcpy(frame_, &hdr, sizeof(hdr));
+  return ws_.sendBIN(frame_, sizeof(WsHeader) + len);
+}
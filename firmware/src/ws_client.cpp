@@ -0,0 +1,822 @@
+#include "ws_client.hpp"
+
+#include <M5Unified.h>
+#include <esp_random.h>
+#include <mbedtls/base64.h>
+#include <mbedtls/sha1.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <strings.h>
+#include "memory_plan.hpp"
+#include "trace.hpp"
+#if WS_CONNECT_TASK
+#include "loop_wake.hpp"
+#endif
+
+namespace
+{
+// TCP の connect の待ち時間（接続タスクで待つ）。同一 LAN のサーバー前提なので短くする
+constexpr uint32_t kConnectTimeoutMs = 1000;
+#if WS_CONNECT_TASK
+// Wi-Fi・lwIP と同じ core 0。名前解決（hostByName）の分もスタックを取る
+constexpr BaseType_t kConnectTaskCore = 0;
+constexpr UBaseType_t kConnectTaskPriority = 2;
+constexpr uint32_t kConnectTaskStackSize = 4096;
+#endif
+constexpr uint32_t kHandshakeTimeoutMs = 3000;
+// 1 回の loop() で読む上限。TTS のバーストで他の処理を止めないため
+constexpr size_t kMaxReadPerLoop = 16 * 1024;
+// 送信バッファを切り出せなかったとき（memory_plan の予算不足）にスタックで組み立てる大きさ
+constexpr size_t kFallbackTxBytes = 256;
+constexpr const char *kWsGuid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+void applyMask(uint8_t *data, size_t len, const std::array<uint8_t, 4> &mask, uint64_t offset)
+{
+  for (size_t i = 0; i < len; ++i)
+  {
+    data[i] ^= mask[(offset + i) & 3];
+  }
+}
+} // namespace
+
+void WsClient::begin(const char *host, uint16_t port, const char *path)
+{
+  host_ = host;
+  port_ = port;
+  path_ = path;
+  if (rx_buf_ == nullptr)
+  {
+    rx_buf_ = static_cast<uint8_t *>(memory_plan::take(memory_plan::Module::WsClient, memory_plan::Region::Psram, kRxBufferBytes));
+    tx_buf_ = static_cast<uint8_t *>(memory_plan::take(memory_plan::Module::WsClient, memory_plan::Region::Internal, kTxBufferBytes));
+  }
+#if WS_CONNECT_TASK
+  if (connect_task_ == nullptr &&
+      xTaskCreatePinnedToCore(connectTaskEntry, "ws_connect", kConnectTaskStackSize, this, kConnectTaskPriority,
+                              &connect_task_, kConnectTaskCore) != pdPASS)
+  {
+    connect_task_ = nullptr;
+    log_w("WS connect task create failed; connecting from loop()");
+  }
+#endif
+  started_ = true;
+  reconnectNow();
+}
+
+void WsClient::onEvent(EventCallback cb)
+{
+  on_event_ = std::move(cb);
+}
+
+void WsClient::onMessage(MessageCallback cb)
+{
+  on_message_ = std::move(cb);
+}
+
+void WsClient::setPayloadSink(PayloadSink sink)
+{
+  payload_sink_ = std::move(sink);
+}
+
+void WsClient::setSendTap(SendTap tap)
+{
+  send_tap_ = std::move(tap);
+}
+
+void WsClient::setReconnectBackoff(uint32_t min_ms, uint32_t max_ms)
+{
+  reconnect_min_ms_ = std::max<uint32_t>(min_ms, 1);
+  reconnect_max_ms_ = std::max(max_ms, reconnect_min_ms_);
+}
+
+void WsClient::reconnectNow()
+{
+  reconnect_failures_ = 0;
+  attempt_due_ = true;
+}
+
+void WsClient::enableHeartbeat(uint32_t ping_interval_ms, uint32_t pong_timeout_ms, uint8_t disconnect_count)
+{
+  ping_interval_ms_ = ping_interval_ms;
+  pong_timeout_ms_ = pong_timeout_ms;
+  pong_disconnect_count_ = disconnect_count;
+}
+
+bool WsClient::isConnected() const
+{
+  return connected_;
+}
+
+void WsClient::disconnect()
+{
+  if (connect_state_ != ConnectState::Idle)
+  {
+    return; // 接続タスクの結果を待ってから、ハンドシェイクの失敗として扱う
+  }
+  if (connected_)
+  {
+    sendFrame(Opcode::Close, nullptr, 0);
+  }
+  closeSocket(true);
+}
+
+void WsClient::loop()
+{
+  if (!started_)
+  {
+    return;
+  }
+
+  uint32_t now = millis();
+  if (handshaking_)
+  {
+    pollHandshake(now);
+    return;
+  }
+  if (!connected_)
+  {
+    ConnectState state = connect_state_;
+    if (state == ConnectState::Succeeded || state == ConnectState::Failed)
+    {
+      finishConnect();
+    }
+    else if (state == ConnectState::Idle && WiFi.status() == WL_CONNECTED &&
+             (attempt_due_ || static_cast<int32_t>(now - next_attempt_ms_) >= 0))
+    {
+      startConnect();
+    }
+    return;
+  }
+
+  if (!client_.connected())
+  {
+    log_w("WS connection lost");
+    closeSocket(true);
+    return;
+  }
+
+  size_t budget = kMaxReadPerLoop;
+  while (connected_ && budget > 0 && client_.available() > 0)
+  {
+    if (!in_payload_)
+    {
+      if (!readFrameHeader())
+      {
+        break;
+      }
+      continue;
+    }
+
+    size_t consumed = readPayload(budget);
+    if (consumed == 0)
+    {
+      break;
+    }
+    budget -= std::min(budget, consumed);
+  }
+
+  if (connected_)
+  {
+    heartbeat(now);
+  }
+}
+
+uint32_t WsClient::msUntilNextUpdate(uint32_t now)
+{
+  auto until = [now](uint32_t deadline) {
+    int32_t remaining = static_cast<int32_t>(deadline - now);
+    return remaining > 0 ? static_cast<uint32_t>(remaining) : 0U;
+  };
+
+  if (!started_)
+  {
+    return UINT32_MAX;
+  }
+  if (handshaking_)
+  {
+    return until(handshake_deadline_ms_);
+  }
+  if (!connected_)
+  {
+    ConnectState state = connect_state_;
+    if (state == ConnectState::Pending)
+    {
+      return UINT32_MAX; // 接続タスクが終わると loop_wake で起こす
+    }
+    if (state != ConnectState::Idle)
+    {
+      return 0;
+    }
+    // Wi-Fi が戻るまでは ConnectionManager のイベントを待つ
+    if (WiFi.status() != WL_CONNECTED)
+    {
+      return UINT32_MAX;
+    }
+    return attempt_due_ ? 0 : until(next_attempt_ms_);
+  }
+  if (client_.available() > 0)
+  {
+    return 0; // kMaxReadPerLoop で読み残した分
+  }
+  if (ping_interval_ms_ == 0)
+  {
+    return UINT32_MAX;
+  }
+  return until(last_ping_ms_ + (awaiting_pong_ ? pong_timeout_ms_ : ping_interval_ms_));
+}
+
+int WsClient::socketFd()
+{
+  return (connected_ || handshaking_) ? client_.fd() : -1;
+}
+
+void WsClient::startConnect()
+{
+  attempt_due_ = false;
+  connect_state_ = ConnectState::Pending;
+#if WS_CONNECT_TASK
+  if (connect_task_ != nullptr)
+  {
+    xTaskNotifyGive(connect_task_);
+    return;
+  }
+#endif
+  {
+    // WiFiClient は接続のたびにソケットのハンドルと受信バッファを new する（接続タスクは MEMORY_PLAN_TRAP の対象外）
+    memory_plan::HeapScope heap_scope;
+    runConnect();
+  }
+  finishConnect();
+}
+
+// 接続タスク（WS_CONNECT_TASK=0 なら loop()）で動く。Pending の間は loop() が client_ に触れない
+void WsClient::runConnect()
+{
+  bool ok = client_.connect(host_, port_, kConnectTimeoutMs) != 0;
+  if (ok)
+  {
+    client_.setNoDelay(true);
+  }
+  connect_state_ = ok ? ConnectState::Succeeded : ConnectState::Failed;
+}
+
+void WsClient::finishConnect()
+{
+  bool ok = connect_state_ == ConnectState::Succeeded;
+  connect_state_ = ConnectState::Idle;
+  if (!ok)
+  {
+    log_w("WS connect to %s:%u failed", host_, static_cast<unsigned>(port_));
+    scheduleReconnect();
+    return;
+  }
+  sendHandshakeRequest();
+}
+
+#if WS_CONNECT_TASK
+void WsClient::connectTaskEntry(void *arg)
+{
+  WsClient *self = static_cast<WsClient *>(arg);
+  for (;;)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    self->runConnect();
+    loop_wake::notify(loop_wake::Source::SocketRx);
+  }
+}
+#endif
+
+void WsClient::sendHandshakeRequest()
+{
+  uint8_t nonce[16];
+  esp_fill_random(nonce, sizeof(nonce));
+  size_t key_len = 0;
+  handshake_key_.fill('\0');
+  mbedtls_base64_encode(reinterpret_cast<unsigned char *>(handshake_key_.data()), handshake_key_.size() - 1, &key_len,
+                        nonce, sizeof(nonce));
+
+  char request[384];
+  int request_len = snprintf(request, sizeof(request),
+                             "GET %s HTTP/1.1\r\n"
+                             "Host: %s:%u\r\n"
+                             "Upgrade: websocket\r\n"
+                             "Connection: Upgrade\r\n"
+                             "Sec-WebSocket-Key: %s\r\n"
+                             "Sec-WebSocket-Version: 13\r\n"
+                             "\r\n",
+                             path_, host_, static_cast<unsigned>(port_), handshake_key_.data());
+  if (request_len <= 0 || static_cast<size_t>(request_len) >= sizeof(request))
+  {
+    log_e("WS handshake request too long");
+    client_.stop();
+    scheduleReconnect();
+    return;
+  }
+  client_.write(reinterpret_cast<const uint8_t *>(request), static_cast<size_t>(request_len));
+
+  handshaking_ = true;
+  response_len_ = 0;
+  handshake_deadline_ms_ = millis() + kHandshakeTimeoutMs;
+}
+
+void WsClient::pollHandshake(uint32_t now)
+{
+  // 応答ヘッダを空行まで、届いた分だけ読む
+  bool complete = false;
+  while (!complete && response_len_ < response_.size() - 1 && client_.available() > 0)
+  {
+    response_[response_len_++] = static_cast<char>(client_.read());
+    complete = response_len_ >= 4 && memcmp(response_.data() + response_len_ - 4, "\r\n\r\n", 4) == 0;
+  }
+
+  if (!complete)
+  {
+    if (response_len_ >= response_.size() - 1 || static_cast<int32_t>(now - handshake_deadline_ms_) >= 0 ||
+        !client_.connected())
+    {
+      log_w("WS handshake timed out");
+      handshaking_ = false;
+      client_.stop();
+      scheduleReconnect();
+    }
+    return;
+  }
+
+  handshaking_ = false;
+  response_[response_len_] = '\0';
+  if (!verifyHandshakeResponse())
+  {
+    client_.stop();
+    scheduleReconnect();
+    return;
+  }
+
+  connected_ = true;
+  reconnect_failures_ = 0;
+  frame_hdr_len_ = 0;
+  in_payload_ = false;
+  in_message_ = false;
+  awaiting_pong_ = false;
+  missed_pongs_ = 0;
+  last_ping_ms_ = now;
+  if (on_event_)
+  {
+    on_event_(Event::Connected);
+  }
+}
+
+bool WsClient::verifyHandshakeResponse()
+{
+  const char *response = response_.data();
+  if (strncmp(response, "HTTP/1.1 101", 12) != 0)
+  {
+    log_w("WS handshake rejected: %.*s", static_cast<int>(strcspn(response, "\r\n")), response);
+    return false;
+  }
+
+  char accept_src[96];
+  snprintf(accept_src, sizeof(accept_src), "%s%s", handshake_key_.data(), kWsGuid);
+  uint8_t digest[20];
+  mbedtls_sha1(reinterpret_cast<const unsigned char *>(accept_src), strlen(accept_src), digest);
+  char expected[32] = {};
+  size_t expected_len = 0;
+  mbedtls_base64_encode(reinterpret_cast<unsigned char *>(expected), sizeof(expected) - 1, &expected_len, digest, sizeof(digest));
+
+  const char *line = response;
+  while ((line = strstr(line, "\r\n")) != nullptr)
+  {
+    line += 2;
+    constexpr const char kAcceptHeader[] = "Sec-WebSocket-Accept:";
+    if (strncasecmp(line, kAcceptHeader, sizeof(kAcceptHeader) - 1) == 0)
+    {
+      const char *value = line + sizeof(kAcceptHeader) - 1;
+      while (*value == ' ')
+      {
+        value++;
+      }
+      if (strncmp(value, expected, expected_len) == 0)
+      {
+        return true;
+      }
+      break;
+    }
+  }
+  log_w("WS handshake: Sec-WebSocket-Accept mismatch");
+  return false;
+}
+
+void WsClient::scheduleReconnect()
+{
+  // サーバー再起動などで一斉に再接続が集中しないよう、待ち時間をランダムに縮める
+  uint32_t backoff = reconnect_min_ms_;
+  for (uint8_t i = 0; i < reconnect_failures_ && backoff < reconnect_max_ms_; ++i)
+  {
+    backoff *= 2;
+  }
+  backoff = std::min(backoff, reconnect_max_ms_);
+  uint32_t wait = backoff / 2 + esp_random() % (backoff / 2 + 1);
+  if (reconnect_failures_ < UINT8_MAX)
+  {
+    reconnect_failures_++;
+  }
+  next_attempt_ms_ = millis() + wait;
+  log_d("WS reconnect in %lu ms (attempt %u)", static_cast<unsigned long>(wait), static_cast<unsigned>(reconnect_failures_));
+}
+
+void WsClient::closeSocket(bool notify)
+{
+  bool was_connected = connected_;
+  connected_ = false;
+  handshaking_ = false;
+  in_payload_ = false;
+  in_message_ = false;
+  frame_hdr_len_ = 0;
+  client_.stop();
+  scheduleReconnect();
+  if (notify && was_connected && on_event_)
+  {
+    on_event_(Event::Disconnected);
+  }
+}
+
+bool WsClient::sendBIN(const uint8_t *data, size_t len)
+{
+  TRACE_SCOPE(WsSend, len > 0 ? data[0] : 0, len);
+  if (!sendFrame(Opcode::Binary, data, len))
+  {
+    return false;
+  }
+  if (send_tap_)
+  {
+    send_tap_(data, len);
+  }
+  return true;
+}
+
+bool WsClient::sendFrame(Opcode opcode, const uint8_t *data, size_t len)
+{
+  if (!connected_)
+  {
+    return false;
+  }
+
+  // クライアントからのフレームはマスク必須
+  uint8_t header[14];
+  size_t header_len = 0;
+  header[header_len++] = 0x80 | static_cast<uint8_t>(opcode);
+  if (len < 126)
+  {
+    header[header_len++] = 0x80 | static_cast<uint8_t>(len);
+  }
+  else if (len <= 0xFFFF)
+  {
+    header[header_len++] = 0x80 | 126;
+    header[header_len++] = static_cast<uint8_t>(len >> 8);
+    header[header_len++] = static_cast<uint8_t>(len);
+  }
+  else
+  {
+    header[header_len++] = 0x80 | 127;
+    for (int shift = 56; shift >= 0; shift -= 8)
+    {
+      header[header_len++] = static_cast<uint8_t>(static_cast<uint64_t>(len) >> shift);
+    }
+  }
+  std::array<uint8_t, 4> mask{};
+  esp_fill_random(mask.data(), mask.size());
+  memcpy(header + header_len, mask.data(), mask.size());
+  header_len += mask.size();
+
+  // setNoDelay なので write ごとに TCP のセグメントが出る。ヘッダとマスク済みの payload を並べてからまとめて書く
+  uint8_t fallback[kFallbackTxBytes];
+  uint8_t *buf = tx_buf_ != nullptr ? tx_buf_ : fallback;
+  size_t capacity = tx_buf_ != nullptr ? kTxBufferBytes : sizeof(fallback);
+  memcpy(buf, header, header_len);
+  size_t used = header_len;
+  size_t offset = 0;
+  bool ok = true;
+  while (ok)
+  {
+    size_t n = std::min(capacity - used, len - offset);
+    memcpy(buf + used, data + offset, n);
+    applyMask(buf + used, n, mask, offset);
+    used += n;
+    offset += n;
+    ok = client_.write(buf, used) == used;
+    used = 0;
+    if (offset >= len)
+    {
+      break;
+    }
+  }
+
+  if (!ok)
+  {
+    log_w("WS send failed; closing");
+    closeSocket(true);
+  }
+  return ok;
+}
+
+void WsClient::heartbeat(uint32_t now)
+{
+  if (ping_interval_ms_ == 0)
+  {
+    return;
+  }
+
+  if (awaiting_pong_ && now - last_ping_ms_ >= pong_timeout_ms_)
+  {
+    awaiting_pong_ = false;
+    missed_pongs_++;
+    log_w("WS pong timeout (%u/%u)", static_cast<unsigned>(missed_pongs_), static_cast<unsigned>(pong_disconnect_count_));
+    if (pong_disconnect_count_ > 0 && missed_pongs_ >= pong_disconnect_count_)
+    {
+      closeSocket(true);
+      return;
+    }
+  }
+
+  if (!awaiting_pong_ && now - last_ping_ms_ >= ping_interval_ms_)
+  {
+    last_ping_ms_ = now;
+    awaiting_pong_ = sendFrame(Opcode::Ping, nullptr, 0);
+  }
+}
+
+bool WsClient::readFrameHeader()
+{
+  // 2 バイト目まで読めば、残りのヘッダ長（拡張長 + マスク）が決まる。
+  // payload の無いフレーム（8A 00 の pong など）は後続のバイトを待たずに、この呼び出しで終える
+  while (true)
+  {
+    size_t needed = 2;
+    if (frame_hdr_len_ >= 2)
+    {
+      uint8_t len7 = frame_hdr_[1] & 0x7F;
+      needed += (len7 == 126) ? 2 : (len7 == 127) ? 8 : 0;
+      needed += (frame_hdr_[1] & 0x80) ? 4 : 0;
+    }
+    if (frame_hdr_len_ >= needed)
+    {
+      break;
+    }
+    int n = client_.read(frame_hdr_.data() + frame_hdr_len_, needed - frame_hdr_len_);
+    if (n <= 0)
+    {
+      return false;
+    }
+    frame_hdr_len_ += static_cast<size_t>(n);
+  }
+
+  frame_fin_ = (frame_hdr_[0] & 0x80) != 0;
+  frame_opcode_ = static_cast<Opcode>(frame_hdr_[0] & 0x0F);
+  frame_masked_ = (frame_hdr_[1] & 0x80) != 0;
+  uint8_t len7 = frame_hdr_[1] & 0x7F;
+  size_t pos = 2;
+  if (len7 == 126)
+  {
+    frame_remaining_ = (static_cast<uint64_t>(frame_hdr_[2]) << 8) | frame_hdr_[3];
+    pos += 2;
+  }
+  else if (len7 == 127)
+  {
+    frame_remaining_ = 0;
+    for (size_t i = 0; i < 8; ++i)
+    {
+      frame_remaining_ = (frame_remaining_ << 8) | frame_hdr_[2 + i];
+    }
+    pos += 8;
+  }
+  else
+  {
+    frame_remaining_ = len7;
+  }
+  if (frame_masked_)
+  {
+    memcpy(frame_mask_.data(), frame_hdr_.data() + pos, frame_mask_.size());
+  }
+  frame_hdr_len_ = 0;
+  frame_offset_ = 0;
+  in_payload_ = true;
+
+  bool is_control = (static_cast<uint8_t>(frame_opcode_) & 0x08) != 0;
+  if (is_control)
+  {
+    if (frame_remaining_ > control_buf_.size() || !frame_fin_)
+    {
+      log_w("WS invalid control frame; closing");
+      closeSocket(true);
+      return false;
+    }
+    control_len_ = 0;
+  }
+  else if (frame_opcode_ == Opcode::Continuation)
+  {
+    if (!in_message_)
+    {
+      log_w("WS continuation without a message; closing");
+      closeSocket(true);
+      return false;
+    }
+  }
+  else
+  {
+    if (in_message_)
+    {
+      log_w("WS new message before FIN; dropping previous");
+    }
+    in_message_ = true;
+    message_opcode_ = frame_opcode_;
+    message_hdr_len_ = 0;
+    message_body_ = nullptr;
+    message_body_len_ = 0;
+    message_discard_ = message_opcode_ != Opcode::Binary;
+  }
+
+  if (frame_remaining_ == 0)
+  {
+    finishFrame();
+  }
+  return true;
+}
+
+size_t WsClient::readPayload(size_t budget)
+{
+  size_t want = static_cast<size_t>(std::min<uint64_t>(frame_remaining_, budget));
+  size_t consumed = 0;
+
+  if ((static_cast<uint8_t>(frame_opcode_) & 0x08) != 0)
+  {
+    int n = client_.read(control_buf_.data() + control_len_, want);
+    if (n > 0)
+    {
+      if (frame_masked_)
+      {
+        applyMask(control_buf_.data() + control_len_, static_cast<size_t>(n), frame_mask_, frame_offset_);
+      }
+      control_len_ += static_cast<size_t>(n);
+      consumed = static_cast<size_t>(n);
+    }
+  }
+  else
+  {
+    consumed = readMessageBytes(want);
+  }
+
+  frame_remaining_ -= consumed;
+  frame_offset_ += consumed;
+  if (frame_remaining_ == 0)
+  {
+    finishFrame();
+  }
+  return consumed;
+}
+
+size_t WsClient::readMessageBytes(size_t n)
+{
+  size_t total = 0;
+  while (total < n)
+  {
+    uint8_t *dst = nullptr;
+    size_t room = 0;
+    uint8_t discard[128];
+
+    if (message_discard_)
+    {
+      dst = discard;
+      room = sizeof(discard);
+    }
+    else if (message_hdr_len_ < sizeof(WsHeader))
+    {
+      dst = reinterpret_cast<uint8_t *>(&message_hdr_) + message_hdr_len_;
+      room = sizeof(WsHeader) - message_hdr_len_;
+    }
+    else if (message_body_len_ < message_hdr_.payloadBytes)
+    {
+      dst = message_body_ + message_body_len_;
+      room = message_hdr_.payloadBytes - message_body_len_;
+    }
+    else
+    {
+      log_w("WS bin longer than payloadBytes=%u; dropping", static_cast<unsigned>(message_hdr_.payloadBytes));
+      message_discard_ = true;
+      continue;
+    }
+
+    int got = client_.read(dst, std::min(room, n - total));
+    if (got <= 0)
+    {
+      break;
+    }
+    if (frame_masked_)
+    {
+      applyMask(dst, static_cast<size_t>(got), frame_mask_, frame_offset_ + total);
+    }
+    total += static_cast<size_t>(got);
+
+    if (message_discard_)
+    {
+      continue;
+    }
+    if (message_hdr_len_ < sizeof(WsHeader))
+    {
+      message_hdr_len_ += static_cast<size_t>(got);
+      if (message_hdr_len_ == sizeof(WsHeader))
+      {
+        beginMessageBody();
+      }
+    }
+    else
+    {
+      message_body_len_ += static_cast<size_t>(got);
+    }
+  }
+  return total;
+}
+
+void WsClient::beginMessageBody()
+{
+  // 単一フレームのメッセージなら、この時点で長さの整合を確認できる
+  if (frame_fin_ && frame_opcode_ == Opcode::Binary &&
+      frame_offset_ + frame_remaining_ != sizeof(WsHeader) + message_hdr_.payloadBytes)
+  {
+    log_i("WS payload len mismatch: expected=%u got=%u", static_cast<unsigned>(message_hdr_.payloadBytes),
+          static_cast<unsigned>(frame_offset_ + frame_remaining_ - sizeof(WsHeader)));
+    message_discard_ = true;
+    return;
+  }
+
+  message_body_ = payload_sink_ ? payload_sink_(message_hdr_) : nullptr;
+  if (message_body_ == nullptr)
+  {
+    // payloadBytes は uint16 なので、受信バッファがあれば必ず入る
+    message_body_ = rx_buf_;
+    message_discard_ = rx_buf_ == nullptr;
+  }
+}
+
+void WsClient::finishFrame()
+{
+  in_payload_ = false;
+
+  if ((static_cast<uint8_t>(frame_opcode_) & 0x08) != 0)
+  {
+    handleControlFrame();
+    return;
+  }
+  if (!frame_fin_)
+  {
+    return;
+  }
+
+  in_message_ = false;
+  if (message_opcode_ == Opcode::Text)
+  {
+    if (on_event_)
+    {
+      on_event_(Event::Text);
+    }
+    return;
+  }
+  if (message_discard_)
+  {
+    return;
+  }
+  if (message_hdr_len_ < sizeof(WsHeader))
+  {
+    log_i("WS bin too short: %u", static_cast<unsigned>(message_hdr_len_));
+    return;
+  }
+  if (message_body_len_ != message_hdr_.payloadBytes)
+  {
+    log_i("WS payload len mismatch: expected=%u got=%u", static_cast<unsigned>(message_hdr_.payloadBytes),
+          static_cast<unsigned>(message_body_len_));
+    return;
+  }
+  if (on_message_)
+  {
+    on_message_(message_hdr_, message_body_, message_body_len_);
+  }
+}
+
+void WsClient::handleControlFrame()
+{
+  switch (frame_opcode_)
+  {
+  case Opcode::Ping:
+    sendFrame(Opcode::Pong, control_buf_.data(), control_len_);
+    break;
+  case Opcode::Pong:
+    awaiting_pong_ = false;
+    missed_pongs_ = 0;
+    break;
+  case Opcode::Close:
+    log_i("WS close received");
+    sendFrame(Opcode::Close, control_buf_.data(), std::min<size_t>(control_len_, 2));
+    closeSocket(true);
+    break;
+  default:
+    break;
+  }
+}
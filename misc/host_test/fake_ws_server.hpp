@@ -0,0 +1,135 @@
+#pragma once
+
+// WsClient の相手をするサーバー側の操作（misc/replay/host/WiFi.h の偽のソケットを使う）
+//  - frame()/message() でサーバーが送るフレームを作り、replay_host::socket.rx に積む
+//  - takeSent() でクライアントが書いたバイトをフレームに分け、マスクを外す
+//  - answerHandshake() はクライアントの Upgrade 要求に 101 を返す
+
+#include "protocols.hpp"
+
+#include <mbedtls/base64.h>
+#include <mbedtls/sha1.h>
+#include <WiFi.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace fake_ws_server
+{
+// クライアントが送ったフレーム（マスクを外したもの）
+struct SentFrame
+{
+  uint8_t opcode = 0;
+  bool fin = false;
+  bool masked = false;
+  std::vector<uint8_t> payload;
+};
+
+inline std::string acceptFor(const std::string &key)
+{
+  std::string src = key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+  unsigned char digest[20];
+  mbedtls_sha1(reinterpret_cast<const unsigned char *>(src.data()), src.size(), digest);
+  unsigned char out[32];
+  size_t len = 0;
+  mbedtls_base64_encode(out, sizeof(out), &len, digest, sizeof(digest));
+  return std::string(reinterpret_cast<char *>(out), len);
+}
+
+inline std::vector<uint8_t> frame(uint8_t opcode, const std::vector<uint8_t> &payload, bool fin = true)
+{
+  std::vector<uint8_t> out;
+  out.push_back(static_cast<uint8_t>((fin ? 0x80 : 0x00) | opcode));
+  if (payload.size() < 126)
+  {
+    out.push_back(static_cast<uint8_t>(payload.size()));
+  }
+  else
+  {
+    out.push_back(126);
+    out.push_back(static_cast<uint8_t>(payload.size() >> 8));
+    out.push_back(static_cast<uint8_t>(payload.size()));
+  }
+  out.insert(out.end(), payload.begin(), payload.end());
+  return out;
+}
+
+inline std::vector<uint8_t> message(uint8_t kind, uint16_t seq, const std::vector<uint8_t> &body)
+{
+  WsHeader hdr{};
+  hdr.kind = kind;
+  hdr.messageType = static_cast<uint8_t>(MessageType::DATA);
+  hdr.seq = seq;
+  hdr.payloadBytes = static_cast<uint16_t>(body.size());
+  std::vector<uint8_t> out(reinterpret_cast<const uint8_t *>(&hdr), reinterpret_cast<const uint8_t *>(&hdr) + sizeof(hdr));
+  out.insert(out.end(), body.begin(), body.end());
+  return out;
+}
+
+inline void push(const std::vector<uint8_t> &bytes)
+{
+  replay_host::socket.push(bytes.data(), bytes.size());
+}
+
+// 送られてきた Upgrade 要求に応答する。要求がまだ無ければ false
+inline bool answerHandshake()
+{
+  std::string request(replay_host::socket.tx.begin(), replay_host::socket.tx.end());
+  const std::string kKey = "Sec-WebSocket-Key: ";
+  size_t pos = request.find(kKey);
+  if (pos == std::string::npos || request.find("\r\n\r\n") == std::string::npos)
+  {
+    return false;
+  }
+  replay_host::socket.tx.clear();
+  std::string key = request.substr(pos + kKey.size(), request.find("\r\n", pos) - pos - kKey.size());
+  std::string response = "HTTP/1.1 101 Switching Protocols\r\n"
+                         "Upgrade: websocket\r\n"
+                         "Connection: Upgrade\r\n"
+                         "Sec-WebSocket-Accept: " +
+                         acceptFor(key) + "\r\n\r\n";
+  replay_host::socket.push(reinterpret_cast<const uint8_t *>(response.data()), response.size());
+  return true;
+}
+
+// クライアントが書いたバイトをフレームに分け、マスクを外す
+inline std::vector<SentFrame> takeSent()
+{
+  std::vector<SentFrame> out;
+  const std::vector<uint8_t> &tx = replay_host::socket.tx;
+  size_t pos = 0;
+  while (pos + 2 <= tx.size())
+  {
+    SentFrame f;
+    f.fin = (tx[pos] & 0x80) != 0;
+    f.opcode = tx[pos] & 0x0F;
+    f.masked = (tx[pos + 1] & 0x80) != 0;
+    uint64_t len = tx[pos + 1] & 0x7F;
+    pos += 2;
+    size_t ext = len == 126 ? 2 : len == 127 ? 8 : 0;
+    if (ext > 0)
+    {
+      len = 0;
+      for (size_t i = 0; i < ext; ++i)
+      {
+        len = (len << 8) | tx[pos + i];
+      }
+      pos += ext;
+    }
+    uint8_t mask[4] = {};
+    if (f.masked)
+    {
+      memcpy(mask, &tx[pos], 4);
+      pos += 4;
+    }
+    for (uint64_t i = 0; i < len && pos < tx.size(); ++i)
+    {
+      f.payload.push_back(tx[pos++] ^ mask[i & 3]);
+    }
+    out.push_back(std::move(f));
+  }
+  replay_host::socket.tx.clear();
+  return out;
+}
+} // namespace fake_ws_server
@@ -0,0 +1,61 @@
+"""test_log_mel.cpp が突き合わせる、サーバーの参照実装（stackchan_server/log_mel.py）の出力を生成する。
+
+    uv run python misc/host_test/gen_log_mel_golden.py > misc/host_test/log_mel_golden.hpp
+
+入力の PCM は test_log_mel.cpp の testPcm() と同じ整数演算で作る（両方を同時に直すこと）。
+"""
+
+from __future__ import annotations
+
+import sys
+from pathlib import Path
+
+sys.path.insert(0, str(Path(__file__).resolve().parents[2]))
+
+from stackchan_server.log_mel import LOG_MEL_FRAME_BYTES, reference_log_mel  # noqa: E402
+
+SILENCE_SAMPLES = 1600
+TONE_SAMPLES = 8000
+
+
+def _triangle(n: int, period: int, amplitude: int) -> int:
+    phase = n % period
+    half = period // 2
+    rising = phase if phase < half else period - phase
+    return (4 * amplitude * rising) // period - amplitude
+
+
+def test_pcm() -> list[int]:
+    """無音 0.1 秒、444 Hz の三角波、1778 Hz の三角波 + 雑音（各 0.5 秒）。"""
+    samples = [0] * SILENCE_SAMPLES
+    state = 12345
+    for n in range(2 * TONE_SAMPLES):
+        state = (state * 1103515245 + 12345) & 0x7FFFFFFF
+        noise = ((state >> 16) & 0x7FFF) - 16384
+        if n < TONE_SAMPLES:
+            samples.append(_triangle(n, 36, 6000) + (noise >> 5))
+        else:
+            samples.append(_triangle(n, 9, 3000) + (noise >> 3))
+    return samples
+
+
+def main() -> None:
+    pcm = b"".join(s.to_bytes(2, "little", signed=True) for s in test_pcm())
+    data = reference_log_mel(pcm).data
+    print("#pragma once")
+    print()
+    print("// misc/host_test/gen_log_mel_golden.py が生成（手で直さない）")
+    print(f"// stackchan_server/log_mel.py の reference_log_mel の出力。{len(data) // LOG_MEL_FRAME_BYTES} フレーム")
+    print()
+    print("#include <cstdint>")
+    print()
+    print("constexpr uint8_t kLogMelGolden[] = {")
+    for i in range(0, len(data), LOG_MEL_FRAME_BYTES):
+        row = data[i : i + LOG_MEL_FRAME_BYTES]
+        for j in range(0, len(row), 20):
+            print("    " + ", ".join(str(v) for v in row[j : j + 20]) + ",")
+    print("};")
+
+
+if __name__ == "__main__":
+    main()
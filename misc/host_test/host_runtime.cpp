@@ -0,0 +1,83 @@
+// misc/host_test の各テストに共通でリンクする、ファームウェアから見えるホスト側の実装
+//  - misc/replay/host/*.h の宣言（仮想時計・ログ・heap_caps）を ws_replay と同じ形で実装する
+
+#include "host_test.hpp"
+
+#include <M5Unified.h>
+#include <esp_heap_caps.h>
+
+#include <cstdarg>
+#include <cstdlib>
+
+uint64_t replay_host::now_us = 0;
+M5Unified M5;
+
+namespace host_test
+{
+int g_checks = 0;
+int g_failures = 0;
+bool g_verbose = false;
+LogCounts g_logs;
+
+void init(int argc, char **argv)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    if (strcmp(argv[i], "--verbose") == 0)
+    {
+      g_verbose = true;
+    }
+  }
+}
+
+int finish(const char *name)
+{
+  printf("%s: %d checks, %d failed\n", name, g_checks, g_failures);
+  return g_failures == 0 ? 0 : 1;
+}
+} // namespace host_test
+
+void replay_host::log(char level, const char *fmt, ...)
+{
+  if (level == 'W')
+  {
+    host_test::g_logs.warnings++;
+  }
+  else if (level == 'E')
+  {
+    host_test::g_logs.errors++;
+  }
+  if (!host_test::g_verbose)
+  {
+    return;
+  }
+  char line[256];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+  printf("  [%10.3f] %c %s\n", static_cast<double>(now_us) / 1e6, level, line);
+}
+
+// ホストでは領域の区別なく malloc する。空きは ESP32-S3 の PSRAM 程度を返す
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+  (void)caps;
+  return malloc(size);
+}
+
+void heap_caps_free(void *ptr)
+{
+  free(ptr);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+  (void)caps;
+  return 8 * 1024 * 1024;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+  return heap_caps_get_free_size(caps);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+// misc/host_test の各テストで使う最小限のチェックと計測
+//  - CHECK* は失敗しても続け、最後に finish() が件数を出して終了コードを返す
+//  - ファームウェアのログ（log_* / dlog_*）は host_runtime.cpp が数える。--verbose で出力もする
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+namespace host_test
+{
+extern int g_checks;
+extern int g_failures;
+extern bool g_verbose;
+
+// ファームウェアが出した警告・エラーの件数（reset で 0 に戻す）
+struct LogCounts
+{
+  uint32_t warnings = 0;
+  uint32_t errors = 0;
+};
+extern LogCounts g_logs;
+
+// 引数を読み、--verbose ならファームウェアのログも出す
+void init(int argc, char **argv);
+// 結果を 1 行出し、失敗があれば 1 を返す
+int finish(const char *name);
+
+inline bool check(bool ok, const char *expr, const char *file, int line)
+{
+  g_checks++;
+  if (!ok)
+  {
+    g_failures++;
+    printf("  FAIL %s:%d: %s\n", file, line, expr);
+  }
+  return ok;
+}
+
+// fn を n 回呼んだ 1 回あたりのホスト時間（ns）
+template <typename F>
+double nsPerCall(uint64_t n, F &&fn)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < n; ++i)
+  {
+    fn();
+  }
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  return static_cast<double>(ns) / static_cast<double>(n);
+}
+} // namespace host_test
+
+#define CHECK(cond) host_test::check((cond), #cond, __FILE__, __LINE__)
+#define CHECK_EQ(a, b)                                                                                    \
+  do                                                                                                      \
+  {                                                                                                       \
+    auto check_a_ = (a);                                                                                  \
+    auto check_b_ = (b);                                                                                  \
+    if (!host_test::check(check_a_ == check_b_, #a " == " #b, __FILE__, __LINE__))                        \
+    {                                                                                                     \
+      printf("       got %lld vs %lld\n", static_cast<long long>(check_a_), static_cast<long long>(check_b_)); \
+    }                                                                                                     \
+  } while (0)
+#define CHECK_NEAR(a, b, tol)                                                                             \
+  do                                                                                                      \
+  {                                                                                                       \
+    double check_a_ = (a);                                                                                \
+    double check_b_ = (b);                                                                                \
+    if (!host_test::check(std::fabs(check_a_ - check_b_) <= (tol), #a " ~= " #b, __FILE__, __LINE__))    \
+    {                                                                                                     \
+      printf("       got %g vs %g (tol %g)\n", check_a_, check_b_, static_cast<double>(tol));            \
+    }                                                                                                     \
+  } while (0)
@@ -0,0 +1,441 @@
+#pragma once
+
+// misc/host_test/gen_log_mel_golden.py が生成（手で直さない）
+// stackchan_server/log_mel.py の reference_log_mel の出力。108 フレーム
+
+#include <cstdint>
+
+constexpr uint8_t kLogMelGolden[] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    70, 73, 75, 77, 81, 84, 88, 91, 93, 96, 97, 97, 97, 96, 95, 94, 91, 89, 87, 85,
+    84, 83, 82, 81, 80, 79, 78, 77, 76, 75, 73, 75, 75, 78, 79, 79, 78, 77, 76, 75,
+    75, 74, 74, 72, 70, 69, 71, 72, 71, 70, 70, 70, 69, 68, 67, 67, 68, 66, 65, 62,
+    62, 66, 69, 67, 64, 65, 64, 64, 62, 62, 62, 66, 65, 62, 60, 61, 61, 61, 60, 57,
+    72, 75, 85, 89, 91, 94, 97, 100, 104, 116, 124, 127, 124, 116, 108, 105, 102, 100, 98, 96,
+    95, 94, 92, 90, 92, 92, 86, 87, 88, 85, 84, 79, 86, 100, 101, 94, 90, 88, 86, 85,
+    87, 85, 87, 86, 79, 80, 84, 90, 82, 81, 80, 82, 81, 80, 82, 79, 82, 77, 78, 75,
+    75, 82, 85, 80, 75, 79, 77, 78, 75, 77, 75, 81, 78, 77, 76, 77, 80, 80, 74, 71,
+    71, 74, 66, 72, 80, 75, 71, 82, 83, 110, 126, 130, 125, 109, 77, 80, 72, 73, 64, 72,
+    76, 67, 71, 76, 74, 77, 79, 80, 75, 75, 77, 69, 91, 103, 100, 82, 68, 67, 66, 67,
+    72, 69, 74, 73, 72, 75, 87, 90, 72, 80, 77, 74, 75, 71, 82, 86, 80, 70, 74, 72,
+    73, 81, 83, 77, 73, 68, 68, 79, 77, 78, 73, 79, 73, 70, 67, 78, 78, 76, 78, 77,
+    73, 70, 67, 73, 68, 72, 81, 81, 90, 110, 126, 130, 125, 108, 83, 78, 61, 66, 74, 79,
+    79, 72, 77, 76, 67, 59, 57, 65, 76, 76, 70, 77, 91, 104, 101, 85, 75, 76, 73, 70,
+    78, 71, 72, 65, 72, 71, 89, 92, 72, 75, 75, 75, 78, 79, 79, 83, 81, 76, 70, 73,
+    69, 72, 82, 69, 70, 75, 78, 76, 73, 75, 73, 77, 71, 75, 77, 77, 75, 68, 73, 79,
+    67, 69, 65, 75, 75, 70, 68, 67, 88, 110, 126, 130, 125, 109, 83, 75, 70, 72, 66, 70,
+    76, 74, 65, 70, 73, 77, 73, 71, 76, 75, 69, 69, 91, 104, 101, 85, 67, 77, 75, 72,
+    73, 71, 73, 75, 75, 73, 88, 91, 79, 74, 77, 70, 73, 68, 73, 82, 82, 78, 74, 73,
+    80, 76, 76, 76, 75, 77, 79, 77, 77, 74, 75, 75, 71, 73, 76, 75, 72, 72, 80, 79,
+    64, 72, 75, 75, 74, 61, 63, 78, 83, 110, 126, 130, 125, 109, 81, 70, 71, 62, 64, 69,
+    67, 67, 64, 63, 67, 76, 75, 68, 76, 81, 80, 75, 91, 104, 101, 86, 74, 65, 67, 63,
+    71, 69, 62, 63, 65, 65, 88, 92, 69, 67, 70, 75, 73, 78, 75, 84, 83, 76, 75, 69,
+    78, 80, 86, 75, 69, 74, 71, 78, 73, 72, 70, 77, 78, 76, 73, 71, 76, 76, 79, 77,
+    73, 73, 71, 72, 75, 61, 64, 78, 84, 110, 126, 130, 125, 108, 83, 76, 79, 78, 77, 70,
+    73, 73, 72, 77, 80, 81, 73, 69, 71, 78, 78, 73, 90, 104, 101, 84, 66, 69, 77, 77,
+    73, 73, 71, 77, 76, 67, 87, 90, 73, 72, 71, 64, 74, 76, 77, 82, 80, 73, 72, 78,
+    78, 77, 79, 73, 74, 74, 74, 77, 74, 73, 75, 78, 75, 70, 75, 79, 74, 76, 76, 78,
+    70, 76, 80, 79, 74, 72, 57, 68, 88, 110, 126, 130, 125, 109, 77, 76, 66, 61, 72, 72,
+    67, 71, 72, 80, 82, 80, 75, 77, 79, 74, 79, 79, 92, 104, 101, 85, 72, 69, 66, 72,
+    75, 74, 74, 73, 76, 71, 89, 91, 74, 71, 70, 75, 66, 73, 75, 81, 84, 75, 73, 78,
+    74, 79, 85, 77, 74, 76, 69, 76, 78, 77, 77, 75, 76, 78, 76, 75, 75, 70, 73, 74,
+    75, 72, 76, 74, 74, 77, 77, 75, 89, 110, 126, 130, 125, 108, 79, 75, 72, 67, 62, 58,
+    60, 69, 68, 68, 64, 65, 72, 76, 72, 75, 76, 71, 91, 104, 102, 86, 77, 67, 67, 68,
+    79, 81, 79, 70, 69, 65, 89, 91, 80, 73, 70, 74, 68, 70, 74, 86, 84, 67, 67, 74,
+    71, 71, 81, 76, 76, 80, 76, 81, 79, 75, 77, 74, 78, 77, 78, 77, 75, 73, 72, 73,
+    73, 73, 73, 74, 73, 72, 75, 74, 87, 110, 126, 130, 125, 109, 74, 71, 69, 57, 68, 72,
+    77, 77, 74, 71, 74, 75, 69, 68, 73, 69, 73, 75, 91, 104, 101, 84, 73, 68, 67, 77,
+    78, 72, 80, 78, 66, 62, 86, 90, 75, 73, 80, 81, 73, 72, 75, 81, 79, 73, 73, 73,
+    74, 78, 78, 72, 73, 76, 72, 78, 79, 78, 73, 77, 76, 73, 70, 72, 72, 77, 76, 73,
+    72, 74, 76, 74, 77, 77, 76, 74, 85, 110, 126, 130, 125, 109, 77, 77, 53, 62, 66, 62,
+    63, 67, 64, 66, 66, 67, 73, 78, 77, 76, 77, 69, 91, 104, 100, 82, 65, 68, 73, 76,
+    76, 79, 70, 71, 65, 71, 88, 91, 78, 70, 75, 80, 68, 76, 76, 81, 82, 79, 76, 71,
+    71, 76, 83, 73, 75, 72, 70, 81, 78, 78, 77, 79, 75, 75, 76, 75, 75, 78, 77, 76,
+    63, 70, 74, 76, 77, 75, 68, 79, 85, 110, 126, 130, 125, 108, 80, 72, 76, 68, 68, 78,
+    81, 75, 64, 64, 59, 73, 78, 77, 69, 75, 81, 80, 92, 105, 102, 85, 68, 72, 69, 77,
+    71, 73, 70, 67, 66, 75, 87, 89, 80, 73, 77, 77, 79, 78, 70, 79, 82, 71, 77, 76,
+    72, 73, 82, 78, 73, 78, 75, 72, 73, 77, 73, 74, 72, 73, 74, 77, 74, 74, 76, 78,
+    62, 69, 66, 59, 66, 63, 62, 72, 86, 110, 126, 130, 125, 109, 75, 72, 73, 74, 75, 75,
+    79, 77, 68, 75, 78, 75, 71, 73, 73, 74, 71, 76, 91, 104, 101, 85, 73, 68, 67, 71,
+    71, 73, 76, 67, 63, 64, 85, 89, 80, 70, 72, 79, 77, 80, 73, 81, 79, 67, 75, 74,
+    70, 70, 74, 80, 77, 73, 74, 75, 71, 74, 73, 74, 78, 77, 77, 73, 75, 78, 78, 79,
+    69, 74, 74, 73, 74, 65, 61, 76, 86, 110, 126, 130, 125, 108, 80, 73, 75, 72, 72, 66,
+    74, 77, 71, 78, 79, 72, 65, 72, 75, 77, 73, 71, 90, 104, 101, 85, 68, 77, 77, 72,
+    76, 73, 76, 72, 72, 69, 85, 88, 73, 75, 66, 67, 70, 78, 75, 82, 83, 74, 75, 69,
+    73, 74, 82, 77, 77, 73, 71, 76, 75, 74, 76, 73, 76, 73, 76, 76, 68, 68, 73, 74,
+    79, 77, 71, 71, 76, 79, 72, 67, 86, 110, 126, 130, 125, 109, 77, 70, 77, 70, 66, 75,
+    79, 75, 75, 72, 69, 64, 73, 81, 84, 82, 76, 74, 91, 104, 101, 83, 76, 78, 70, 65,
+    63, 63, 68, 75, 74, 76, 88, 90, 72, 73, 74, 72, 72, 75, 73, 85, 81, 78, 76, 75,
+    73, 66, 77, 76, 71, 73, 66, 73, 80, 76, 76, 76, 73, 74, 71, 74, 72, 74, 73, 71,
+    74, 69, 65, 61, 59, 67, 75, 80, 87, 110, 126, 130, 125, 109, 76, 74, 71, 70, 66, 69,
+    77, 77, 75, 71, 69, 76, 73, 62, 79, 81, 68, 78, 91, 105, 102, 85, 78, 80, 81, 74,
+    71, 68, 76, 73, 72, 74, 89, 93, 71, 67, 72, 77, 72, 73, 75, 87, 84, 78, 73, 79,
+    77, 77, 83, 76, 72, 71, 70, 76, 70, 75, 79, 82, 71, 74, 77, 79, 76, 72, 73, 72,
+    74, 73, 69, 70, 67, 69, 70, 74, 85, 110, 126, 130, 125, 108, 77, 79, 73, 76, 70, 69,
+    67, 73, 80, 79, 74, 74, 75, 72, 74, 78, 76, 76, 91, 105, 102, 84, 71, 72, 71, 79,
+    72, 71, 77, 75, 67, 70, 90, 92, 77, 74, 69, 77, 78, 73, 73, 84, 83, 71, 75, 76,
+    74, 78, 78, 78, 80, 74, 68, 79, 77, 73, 70, 77, 76, 71, 72, 75, 71, 71, 74, 73,
+    72, 77, 75, 74, 71, 71, 74, 72, 87, 110, 126, 130, 125, 109, 81, 74, 71, 73, 72, 75,
+    78, 76, 80, 82, 77, 71, 72, 68, 72, 77, 79, 73, 93, 105, 101, 85, 75, 74, 73, 80,
+    82, 78, 73, 78, 77, 73, 88, 91, 78, 77, 69, 68, 75, 70, 72, 85, 82, 72, 78, 74,
+    77, 74, 81, 77, 69, 72, 75, 75, 73, 74, 73, 74, 77, 74, 74, 75, 78, 72, 76, 81,
+    76, 76, 70, 65, 73, 79, 76, 73, 87, 110, 126, 130, 125, 109, 81, 75, 76, 76, 71, 70,
+    72, 77, 71, 70, 71, 67, 74, 75, 70, 80, 81, 76, 91, 104, 102, 86, 60, 75, 79, 76,
+    79, 81, 74, 70, 71, 69, 86, 89, 68, 68, 70, 71, 75, 71, 74, 80, 77, 70, 78, 72,
+    66, 73, 79, 82, 73, 68, 71, 79, 72, 70, 75, 74, 75, 76, 78, 78, 76, 73, 74, 79,
+    80, 74, 66, 72, 80, 78, 75, 69, 89, 110, 126, 130, 125, 109, 80, 74, 75, 79, 70, 74,
+    78, 71, 73, 71, 69, 76, 80, 80, 76, 72, 65, 67, 89, 103, 100, 81, 67, 61, 60, 73,
+    79, 72, 68, 76, 79, 72, 89, 91, 73, 71, 72, 77, 76, 76, 77, 84, 80, 74, 71, 71,
+    69, 77, 82, 75, 69, 77, 75, 75, 72, 73, 73, 78, 76, 68, 74, 75, 76, 79, 75, 73,
+    69, 73, 78, 75, 75, 78, 73, 71, 88, 110, 126, 130, 125, 109, 74, 75, 78, 82, 79, 69,
+    76, 71, 66, 73, 76, 78, 73, 73, 71, 72, 75, 72, 90, 104, 101, 84, 70, 70, 69, 76,
+    83, 75, 75, 81, 81, 69, 88, 91, 70, 76, 75, 70, 75, 70, 75, 83, 83, 72, 67, 74,
+    78, 78, 84, 73, 71, 77, 78, 73, 69, 74, 70, 75, 77, 74, 77, 77, 75, 79, 74, 75,
+    63, 72, 75, 69, 73, 74, 74, 60, 90, 110, 126, 130, 125, 109, 83, 70, 75, 70, 66, 73,
+    70, 64, 64, 65, 63, 68, 76, 74, 71, 78, 81, 79, 91, 104, 101, 84, 64, 63, 66, 67,
+    77, 76, 77, 73, 77, 72, 90, 94, 80, 78, 75, 65, 75, 74, 69, 84, 80, 68, 75, 78,
+    76, 77, 84, 75, 73, 74, 76, 74, 76, 73, 74, 76, 77, 73, 75, 77, 76, 76, 73, 71,
+    58, 65, 71, 74, 75, 83, 85, 85, 89, 110, 126, 130, 125, 108, 82, 72, 67, 67, 75, 74,
+    69, 63, 68, 70, 68, 62, 69, 69, 68, 67, 72, 70, 92, 104, 102, 85, 77, 77, 69, 73,
+    77, 69, 71, 72, 76, 69, 89, 92, 72, 72, 69, 72, 76, 71, 70, 85, 84, 73, 72, 72,
+    70, 74, 74, 73, 72, 77, 73, 77, 76, 77, 78, 76, 73, 77, 76, 72, 75, 80, 77, 73,
+    76, 72, 72, 73, 71, 71, 71, 73, 85, 110, 126, 130, 125, 108, 81, 73, 70, 77, 80, 76,
+    73, 70, 64, 69, 70, 76, 76, 68, 68, 77, 73, 70, 90, 104, 101, 84, 76, 75, 71, 67,
+    70, 71, 67, 78, 76, 74, 88, 91, 74, 68, 75, 70, 70, 69, 75, 83, 80, 77, 75, 74,
+    74, 72, 76, 79, 81, 79, 74, 81, 77, 74, 70, 70, 73, 75, 78, 74, 76, 78, 69, 73,
+    76, 73, 70, 69, 62, 71, 74, 81, 83, 110, 126, 130, 125, 109, 77, 70, 75, 65, 70, 74,
+    75, 73, 72, 75, 79, 74, 77, 81, 79, 72, 71, 63, 91, 104, 102, 84, 74, 74, 62, 60,
+    75, 74, 79, 79, 76, 76, 91, 93, 76, 79, 72, 75, 73, 75, 72, 81, 79, 75, 77, 77,
+    78, 73, 75, 75, 79, 78, 73, 81, 75, 71, 74, 73, 77, 78, 74, 75, 75, 72, 73, 73,
+    65, 70, 74, 73, 75, 80, 80, 81, 85, 110, 126, 130, 125, 108, 80, 76, 78, 61, 56, 59,
+    71, 80, 80, 76, 68, 79, 78, 66, 74, 77, 78, 80, 93, 105, 102, 85, 70, 64, 71, 72,
+    69, 81, 77, 75, 77, 78, 89, 92, 75, 68, 69, 72, 83, 78, 74, 77, 74, 72, 76, 73,
+    70, 74, 79, 69, 72, 74, 73, 75, 74, 78, 76, 76, 79, 78, 73, 74, 76, 69, 75, 76,
+    67, 69, 69, 74, 72, 70, 74, 71, 87, 110, 126, 130, 125, 108, 78, 81, 82, 75, 71, 80,
+    85, 79, 71, 69, 67, 75, 80, 79, 79, 78, 71, 73, 90, 104, 101, 84, 78, 75, 77, 75,
+    78, 79, 78, 70, 62, 74, 88, 91, 74, 75, 77, 73, 70, 72, 73, 81, 78, 70, 75, 74,
+    77, 73, 83, 77, 75, 73, 79, 78, 73, 69, 66, 76, 78, 69, 72, 74, 75, 77, 72, 79,
+    60, 72, 77, 76, 71, 61, 69, 76, 84, 110, 126, 130, 125, 109, 78, 79, 63, 72, 80, 79,
+    77, 84, 79, 62, 59, 66, 74, 74, 72, 69, 75, 78, 91, 104, 101, 83, 76, 68, 68, 77,
+    79, 76, 72, 65, 60, 72, 88, 90, 75, 78, 75, 79, 79, 76, 78, 82, 80, 80, 72, 69,
+    73, 72, 78, 75, 70, 73, 77, 81, 75, 75, 73, 73, 73, 72, 73, 71, 73, 77, 73, 73,
+    77, 70, 68, 74, 75, 62, 61, 78, 81, 111, 126, 130, 125, 108, 78, 77, 75, 76, 80, 77,
+    77, 82, 80, 70, 48, 63, 72, 75, 75, 68, 56, 67, 91, 105, 102, 85, 68, 81, 80, 75,
+    73, 68, 73, 68, 68, 72, 88, 93, 78, 67, 74, 68, 70, 69, 78, 80, 81, 73, 79, 81,
+    72, 77, 81, 77, 72, 77, 74, 77, 72, 72, 73, 75, 77, 77, 76, 74, 73, 71, 73, 76,
+    76, 79, 79, 78, 74, 72, 74, 82, 85, 110, 126, 130, 125, 109, 83, 75, 77, 76, 75, 77,
+    73, 71, 72, 69, 77, 81, 79, 74, 73, 72, 70, 79, 90, 104, 103, 87, 77, 80, 80, 73,
+    72, 67, 69, 72, 73, 72, 88, 89, 74, 66, 66, 74, 80, 79, 75, 85, 82, 72, 73, 77,
+    76, 78, 80, 75, 75, 76, 71, 70, 71, 73, 77, 77, 76, 74, 75, 76, 72, 70, 77, 79,
+    71, 75, 77, 74, 76, 74, 76, 83, 87, 110, 126, 130, 125, 109, 83, 71, 73, 70, 73, 68,
+    74, 71, 68, 72, 67, 74, 72, 77, 82, 80, 74, 70, 92, 104, 100, 82, 71, 72, 64, 77,
+    75, 76, 76, 71, 74, 75, 86, 88, 72, 72, 73, 75, 74, 75, 73, 83, 81, 69, 68, 72,
+    80, 76, 76, 75, 75, 72, 71, 75, 74, 76, 74, 74, 76, 73, 71, 70, 74, 74, 78, 74,
+    64, 72, 69, 64, 71, 77, 73, 67, 87, 110, 126, 130, 125, 109, 79, 76, 82, 77, 71, 72,
+    71, 72, 80, 79, 72, 66, 73, 74, 67, 57, 63, 63, 91, 104, 102, 87, 69, 72, 77, 77,
+    74, 74, 72, 73, 70, 72, 85, 87, 66, 78, 79, 79, 82, 76, 71, 78, 78, 78, 76, 78,
+    73, 74, 77, 77, 77, 69, 74, 76, 72, 71, 76, 78, 77, 74, 74, 80, 74, 75, 74, 74,
+    66, 72, 73, 69, 70, 75, 67, 79, 84, 110, 126, 130, 125, 109, 77, 76, 71, 76, 79, 72,
+    73, 79, 80, 74, 68, 73, 77, 77, 75, 69, 70, 73, 91, 104, 101, 85, 79, 74, 68, 75,
+    72, 72, 72, 82, 80, 76, 88, 92, 75, 69, 66, 76, 77, 77, 75, 83, 81, 74, 81, 80,
+    72, 74, 79, 77, 78, 74, 70, 73, 75, 72, 69, 80, 76, 69, 71, 74, 73, 68, 73, 78,
+    65, 68, 67, 72, 79, 78, 79, 85, 87, 110, 126, 130, 125, 109, 75, 73, 71, 72, 75, 74,
+    73, 74, 73, 70, 75, 70, 72, 73, 76, 72, 71, 81, 90, 104, 101, 84, 78, 76, 72, 76,
+    73, 74, 69, 75, 75, 69, 86, 89, 75, 76, 70, 72, 74, 73, 74, 81, 80, 79, 78, 73,
+    69, 73, 80, 75, 70, 76, 76, 75, 71, 73, 75, 72, 76, 78, 78, 78, 70, 72, 74, 75,
+    64, 60, 64, 74, 81, 83, 83, 78, 89, 110, 126, 130, 125, 108, 78, 74, 79, 71, 71, 75,
+    80, 78, 71, 70, 70, 76, 79, 73, 73, 76, 69, 77, 93, 105, 102, 86, 67, 69, 77, 71,
+    72, 69, 75, 76, 78, 74, 88, 90, 77, 76, 71, 74, 83, 80, 76, 82, 83, 78, 71, 72,
+    76, 75, 82, 73, 71, 76, 78, 79, 75, 70, 74, 76, 80, 71, 73, 73, 73, 76, 73, 75,
+    78, 73, 70, 73, 78, 85, 83, 79, 88, 110, 126, 130, 125, 109, 82, 76, 74, 73, 72, 74,
+    76, 62, 64, 73, 77, 74, 79, 76, 73, 77, 79, 82, 90, 104, 101, 84, 69, 72, 77, 74,
+    77, 75, 73, 77, 73, 73, 87, 89, 72, 72, 74, 74, 77, 75, 75, 84, 83, 75, 76, 72,
+    71, 73, 80, 70, 72, 74, 75, 81, 71, 71, 78, 78, 78, 75, 75, 76, 77, 77, 76, 75,
+    71, 69, 70, 63, 74, 80, 72, 71, 87, 110, 126, 130, 125, 108, 84, 76, 76, 63, 63, 63,
+    73, 77, 70, 66, 70, 69, 73, 83, 84, 79, 73, 78, 90, 104, 101, 84, 69, 72, 75, 77,
+    77, 75, 78, 74, 72, 64, 88, 92, 76, 76, 73, 75, 73, 73, 68, 85, 82, 77, 80, 78,
+    75, 77, 81, 74, 79, 75, 71, 78, 71, 73, 74, 74, 74, 74, 73, 78, 75, 72, 74, 74,
+    70, 70, 78, 83, 84, 73, 69, 78, 86, 110, 126, 130, 125, 109, 76, 74, 72, 76, 78, 76,
+    77, 80, 77, 70, 73, 76, 77, 72, 70, 68, 70, 71, 91, 104, 100, 84, 79, 74, 62, 75,
+    80, 76, 74, 73, 78, 77, 91, 92, 74, 75, 75, 74, 72, 79, 74, 82, 80, 76, 80, 80,
+    78, 73, 79, 81, 79, 71, 73, 73, 73, 68, 66, 74, 69, 70, 69, 74, 76, 74, 80, 77,
+    73, 70, 66, 71, 70, 79, 79, 77, 86, 110, 126, 130, 125, 108, 83, 75, 78, 70, 77, 77,
+    72, 69, 73, 71, 69, 70, 62, 67, 67, 68, 68, 66, 90, 104, 101, 83, 80, 81, 80, 80,
+    66, 72, 74, 73, 73, 71, 87, 90, 71, 61, 77, 73, 73, 78, 73, 80, 76, 69, 79, 78,
+    78, 75, 76, 75, 77, 71, 73, 72, 76, 73, 73, 74, 74, 72, 70, 78, 73, 78, 74, 75,
+    74, 81, 80, 72, 70, 72, 73, 77, 89, 110, 126, 130, 125, 109, 79, 81, 63, 65, 58, 66,
+    72, 61, 58, 59, 61, 71, 68, 72, 77, 74, 69, 63, 91, 104, 101, 85, 72, 77, 76, 77,
+    74, 68, 65, 71, 73, 72, 86, 89, 75, 74, 78, 75, 70, 73, 73, 82, 79, 78, 76, 77,
+    73, 74, 83, 78, 78, 74, 73, 80, 70, 71, 70, 76, 78, 76, 72, 77, 73, 74, 73, 74,
+    77, 82, 82, 77, 74, 74, 69, 76, 87, 110, 126, 130, 125, 109, 77, 72, 79, 77, 81, 80,
+    74, 73, 71, 65, 62, 69, 77, 81, 80, 77, 71, 69, 91, 103, 100, 81, 73, 73, 71, 79,
+    73, 70, 69, 74, 78, 77, 91, 93, 78, 69, 67, 67, 68, 72, 78, 83, 83, 68, 74, 76,
+    74, 76, 79, 76, 74, 71, 66, 75, 70, 67, 72, 74, 74, 75, 69, 68, 71, 78, 80, 76,
+    83, 81, 79, 77, 73, 67, 70, 73, 88, 110, 126, 130, 125, 108, 81, 82, 70, 72, 71, 76,
+    76, 61, 59, 58, 61, 70, 73, 70, 65, 71, 75, 72, 89, 103, 101, 84, 71, 75, 72, 74,
+    75, 68, 74, 71, 73, 73, 87, 91, 72, 67, 69, 71, 74, 78, 75, 84, 81, 63, 72, 65,
+    75, 73, 77, 76, 81, 75, 74, 70, 69, 70, 77, 80, 77, 72, 74, 74, 74, 74, 79, 77,
+    84, 82, 67, 64, 75, 78, 77, 80, 88, 110, 126, 130, 125, 109, 79, 69, 75, 69, 53, 53,
+    64, 66, 59, 68, 73, 70, 65, 76, 78, 74, 64, 72, 90, 104, 101, 84, 69, 67, 75, 82,
+    81, 77, 71, 72, 75, 76, 91, 93, 76, 74, 75, 72, 77, 81, 74, 78, 77, 67, 75, 78,
+    72, 67, 75, 75, 75, 72, 70, 76, 75, 75, 73, 75, 75, 76, 74, 72, 73, 75, 75, 70,
+    78, 71, 72, 75, 69, 66, 55, 74, 87, 110, 126, 130, 125, 108, 81, 71, 77, 66, 67, 69,
+    70, 71, 65, 71, 79, 79, 71, 72, 74, 67, 68, 70, 90, 104, 101, 84, 72, 66, 68, 77,
+    77, 75, 73, 72, 71, 74, 87, 91, 80, 81, 75, 74, 78, 75, 73, 85, 81, 74, 75, 77,
+    73, 70, 81, 77, 76, 73, 71, 77, 76, 71, 72, 78, 73, 72, 75, 71, 73, 69, 74, 76,
+    77, 73, 70, 71, 74, 72, 76, 74, 88, 110, 126, 130, 125, 109, 84, 78, 81, 75, 67, 70,
+    66, 76, 75, 71, 76, 75, 74, 69, 74, 76, 72, 79, 93, 105, 101, 84, 76, 73, 70, 69,
+    74, 76, 79, 75, 75, 79, 87, 89, 76, 72, 73, 70, 70, 70, 74, 81, 79, 74, 74, 72,
+    74, 75, 78, 75, 73, 74, 74, 74, 74, 71, 74, 72, 76, 73, 79, 77, 74, 73, 73, 71,
+    71, 64, 73, 78, 81, 76, 77, 81, 87, 110, 126, 130, 125, 109, 87, 86, 85, 79, 75, 78,
+    74, 72, 78, 76, 73, 66, 72, 75, 74, 73, 64, 69, 92, 105, 102, 86, 72, 80, 79, 68,
+    77, 74, 65, 69, 75, 71, 88, 91, 75, 78, 77, 77, 76, 75, 70, 82, 80, 76, 75, 73,
+    70, 76, 82, 71, 71, 77, 80, 78, 74, 69, 77, 74, 72, 77, 76, 72, 74, 73, 74, 76,
+    58, 61, 70, 75, 77, 70, 66, 78, 86, 110, 126, 130, 125, 108, 85, 77, 72, 70, 62, 71,
+    74, 75, 75, 77, 78, 73, 75, 73, 71, 66, 63, 71, 91, 104, 101, 83, 74, 76, 73, 63,
+    75, 76, 75, 76, 69, 75, 88, 91, 73, 73, 75, 72, 74, 74, 78, 85, 78, 73, 77, 71,
+    72, 71, 77, 76, 76, 76, 73, 81, 80, 72, 67, 75, 75, 80, 74, 72, 78, 73, 72, 76,
+    67, 71, 77, 79, 77, 69, 76, 75, 87, 110, 126, 130, 125, 109, 78, 81, 67, 68, 70, 66,
+    65, 66, 68, 73, 76, 80, 75, 75, 81, 76, 68, 68, 89, 103, 101, 83, 72, 74, 67, 68,
+    73, 70, 63, 65, 67, 80, 91, 92, 75, 74, 69, 69, 71, 68, 77, 88, 84, 71, 74, 76,
+    75, 76, 80, 75, 74, 75, 71, 79, 74, 77, 74, 74, 78, 75, 73, 77, 79, 77, 74, 77,
+    71, 75, 74, 72, 68, 74, 77, 82, 86, 110, 126, 130, 125, 109, 77, 78, 84, 80, 77, 74,
+    73, 75, 76, 76, 76, 80, 80, 72, 77, 76, 74, 76, 93, 104, 101, 83, 73, 77, 81, 79,
+    68, 72, 79, 79, 70, 73, 87, 91, 78, 68, 72, 68, 70, 71, 78, 86, 85, 76, 75, 78,
+    78, 79, 78, 77, 77, 72, 71, 78, 73, 73, 76, 76, 78, 74, 77, 77, 73, 76, 74, 75,
+    71, 75, 78, 79, 74, 73, 79, 78, 87, 110, 126, 130, 125, 109, 74, 72, 80, 74, 74, 71,
+    66, 65, 72, 70, 67, 69, 71, 78, 75, 72, 69, 74, 88, 104, 102, 85, 71, 71, 77, 76,
+    65, 70, 76, 78, 71, 74, 89, 91, 74, 77, 75, 72, 71, 72, 78, 83, 78, 70, 75, 77,
+    74, 79, 78, 76, 73, 76, 78, 79, 70, 73, 75, 81, 78, 75, 76, 74, 73, 74, 76, 74,
+    84, 88, 91, 90, 88, 91, 89, 90, 98, 112, 126, 130, 125, 111, 92, 91, 85, 85, 83, 75,
+    82, 79, 68, 69, 75, 79, 74, 80, 76, 74, 72, 78, 94, 105, 101, 89, 86, 85, 89, 87,
+    92, 89, 88, 84, 79, 78, 90, 90, 71, 72, 70, 79, 77, 81, 75, 79, 80, 80, 77, 79,
+    71, 71, 77, 69, 68, 73, 76, 75, 73, 76, 77, 78, 77, 80, 78, 78, 75, 76, 77, 74,
+    99, 102, 103, 104, 103, 96, 100, 103, 107, 113, 117, 118, 117, 112, 104, 99, 98, 98, 96, 95,
+    98, 93, 79, 69, 78, 87, 92, 95, 91, 82, 83, 86, 97, 100, 94, 97, 96, 93, 100, 105,
+    115, 118, 109, 94, 90, 82, 84, 83, 80, 79, 89, 87, 91, 94, 91, 88, 88, 87, 86, 90,
+    95, 90, 89, 93, 89, 85, 82, 91, 94, 97, 97, 90, 88, 89, 91, 88, 91, 97, 93, 84,
+    94, 91, 90, 91, 99, 97, 86, 78, 85, 89, 88, 84, 82, 83, 84, 85, 88, 89, 86, 87,
+    94, 96, 95, 90, 85, 87, 88, 83, 90, 94, 94, 92, 86, 83, 86, 93, 91, 97, 93, 88,
+    116, 121, 108, 94, 85, 80, 82, 83, 84, 90, 94, 93, 91, 92, 87, 88, 95, 90, 94, 95,
+    86, 92, 91, 91, 89, 83, 93, 98, 93, 100, 98, 89, 87, 89, 91, 89, 86, 92, 92, 91,
+    95, 95, 94, 98, 98, 88, 88, 94, 98, 98, 94, 90, 86, 77, 82, 87, 80, 79, 78, 69,
+    72, 83, 84, 90, 93, 90, 87, 90, 87, 85, 82, 88, 85, 91, 86, 90, 89, 89, 97, 95,
+    116, 122, 109, 97, 95, 90, 93, 93, 90, 89, 98, 95, 92, 86, 87, 91, 92, 87, 92, 95,
+    92, 86, 91, 94, 93, 94, 86, 94, 90, 99, 98, 86, 88, 92, 91, 88, 86, 94, 90, 89,
+    100, 95, 93, 95, 95, 92, 86, 88, 82, 89, 86, 87, 86, 84, 89, 93, 90, 84, 74, 74,
+    82, 83, 87, 92, 88, 85, 87, 81, 84, 82, 84, 80, 80, 93, 93, 91, 93, 84, 94, 97,
+    116, 122, 108, 91, 84, 87, 89, 89, 90, 81, 85, 95, 99, 94, 84, 88, 91, 88, 83, 95,
+    94, 91, 94, 92, 94, 88, 82, 89, 84, 99, 99, 94, 96, 87, 89, 92, 90, 92, 88, 93,
+    76, 87, 94, 96, 96, 91, 87, 87, 80, 80, 74, 83, 88, 88, 90, 91, 84, 78, 86, 90,
+    92, 90, 88, 93, 92, 89, 91, 90, 85, 82, 89, 93, 87, 85, 96, 98, 94, 84, 86, 89,
+    115, 122, 108, 77, 92, 98, 89, 90, 95, 87, 78, 90, 96, 88, 86, 86, 90, 93, 91, 90,
+    94, 92, 94, 89, 90, 90, 89, 88, 88, 99, 97, 95, 93, 85, 89, 93, 90, 93, 92, 86,
+    93, 90, 88, 85, 85, 79, 80, 82, 92, 95, 92, 91, 88, 88, 88, 93, 91, 84, 78, 74,
+    88, 91, 88, 84, 92, 89, 79, 78, 83, 92, 88, 89, 88, 82, 82, 87, 95, 95, 87, 88,
+    116, 121, 107, 83, 83, 91, 92, 94, 94, 92, 91, 92, 89, 88, 90, 92, 89, 90, 91, 96,
+    93, 89, 90, 97, 90, 92, 93, 89, 91, 93, 93, 90, 81, 82, 90, 90, 92, 96, 93, 88,
+    93, 87, 95, 98, 97, 96, 95, 92, 93, 91, 87, 96, 99, 96, 91, 84, 83, 89, 94, 96,
+    93, 89, 94, 98, 95, 87, 88, 88, 91, 90, 95, 91, 89, 88, 80, 91, 100, 96, 84, 88,
+    115, 122, 109, 89, 86, 87, 83, 91, 93, 86, 89, 93, 97, 91, 93, 95, 83, 90, 94, 96,
+    89, 89, 84, 88, 90, 88, 92, 88, 92, 95, 95, 91, 88, 87, 87, 89, 89, 88, 92, 92,
+    96, 91, 94, 93, 89, 90, 84, 87, 86, 85, 91, 92, 93, 88, 89, 95, 93, 88, 89, 84,
+    86, 83, 85, 93, 91, 88, 87, 80, 90, 92, 92, 89, 90, 91, 85, 86, 96, 96, 93, 87,
+    116, 122, 108, 94, 83, 83, 91, 94, 84, 92, 91, 87, 92, 90, 91, 88, 86, 91, 89, 89,
+    89, 93, 95, 92, 88, 85, 92, 92, 91, 99, 96, 93, 90, 92, 91, 90, 90, 94, 87, 91,
+    83, 90, 91, 94, 97, 99, 96, 90, 86, 97, 97, 86, 90, 91, 91, 83, 91, 92, 88, 87,
+    87, 92, 89, 89, 92, 88, 90, 93, 90, 87, 89, 88, 96, 97, 89, 94, 95, 91, 97, 95,
+    116, 122, 108, 89, 93, 92, 89, 91, 96, 99, 93, 89, 93, 91, 90, 92, 86, 90, 94, 82,
+    88, 91, 92, 92, 90, 88, 88, 91, 88, 97, 96, 91, 88, 87, 87, 90, 94, 95, 90, 86,
+    91, 88, 85, 85, 87, 82, 75, 79, 86, 93, 90, 85, 84, 79, 80, 85, 84, 80, 86, 94,
+    98, 95, 90, 95, 95, 90, 89, 92, 95, 91, 88, 94, 92, 95, 97, 91, 88, 86, 91, 91,
+    117, 122, 108, 88, 90, 85, 84, 83, 93, 100, 90, 94, 92, 87, 80, 87, 90, 95, 90, 84,
+    87, 88, 87, 89, 86, 90, 87, 86, 88, 98, 96, 88, 93, 92, 88, 93, 94, 94, 94, 93,
+    76, 87, 91, 87, 83, 82, 82, 78, 84, 84, 76, 79, 85, 89, 90, 86, 86, 89, 85, 95,
+    98, 94, 91, 88, 95, 91, 86, 92, 93, 88, 79, 78, 83, 90, 95, 87, 88, 102, 103, 94,
+    117, 123, 110, 82, 91, 93, 87, 91, 90, 90, 92, 95, 88, 90, 81, 90, 87, 92, 92, 88,
+    88, 91, 90, 91, 92, 89, 89, 89, 86, 91, 90, 93, 89, 93, 93, 93, 90, 95, 91, 89,
+    96, 97, 96, 90, 85, 97, 100, 98, 93, 86, 79, 86, 86, 87, 94, 92, 89, 89, 89, 88,
+    87, 88, 85, 87, 98, 102, 95, 87, 83, 85, 92, 99, 98, 93, 84, 89, 86, 94, 92, 95,
+    116, 122, 108, 90, 87, 83, 83, 82, 90, 90, 93, 90, 94, 88, 89, 91, 85, 86, 85, 90,
+    92, 92, 93, 90, 91, 90, 91, 92, 90, 95, 94, 89, 94, 95, 89, 91, 94, 94, 89, 88,
+    92, 84, 89, 95, 92, 90, 88, 87, 91, 88, 87, 88, 93, 94, 85, 76, 74, 82, 85, 84,
+    88, 90, 86, 83, 88, 95, 96, 87, 87, 92, 94, 97, 89, 81, 88, 88, 83, 86, 88, 95,
+    116, 122, 109, 91, 88, 88, 90, 82, 78, 88, 89, 88, 83, 79, 92, 96, 89, 91, 96, 95,
+    89, 89, 89, 90, 87, 95, 94, 91, 95, 98, 99, 86, 89, 92, 92, 94, 89, 95, 92, 91,
+    97, 82, 86, 89, 91, 87, 74, 81, 86, 86, 88, 91, 88, 92, 101, 103, 102, 98, 88, 77,
+    81, 82, 89, 93, 91, 84, 90, 88, 77, 76, 79, 82, 83, 91, 90, 94, 94, 86, 86, 91,
+    115, 121, 107, 94, 89, 88, 86, 87, 85, 92, 91, 90, 94, 94, 88, 91, 81, 83, 89, 98,
+    91, 87, 90, 87, 92, 98, 94, 90, 91, 99, 97, 95, 85, 85, 89, 88, 91, 90, 92, 89,
+    103, 96, 89, 87, 90, 89, 83, 86, 91, 92, 96, 100, 99, 92, 92, 97, 94, 86, 89, 93,
+    94, 88, 93, 95, 89, 89, 88, 93, 93, 90, 88, 88, 83, 86, 90, 94, 90, 89, 92, 91,
+    116, 122, 109, 86, 90, 90, 91, 91, 93, 90, 89, 85, 82, 88, 88, 91, 90, 92, 94, 96,
+    92, 90, 86, 85, 84, 89, 87, 85, 95, 98, 96, 90, 88, 86, 84, 91, 93, 90, 92, 92,
+    96, 96, 95, 90, 79, 78, 86, 88, 88, 87, 88, 91, 91, 85, 83, 89, 94, 97, 98, 96,
+    93, 88, 92, 95, 88, 93, 96, 89, 90, 90, 85, 95, 93, 89, 88, 93, 92, 83, 90, 93,
+    115, 121, 107, 87, 90, 87, 88, 88, 91, 88, 94, 96, 87, 94, 92, 91, 86, 92, 92, 96,
+    84, 89, 90, 90, 87, 87, 87, 89, 86, 99, 98, 88, 92, 91, 86, 91, 94, 97, 93, 91,
+    90, 85, 90, 93, 93, 91, 84, 80, 84, 81, 84, 88, 89, 84, 87, 89, 81, 82, 91, 94,
+    94, 92, 86, 89, 92, 92, 93, 91, 89, 95, 97, 94, 84, 88, 96, 94, 90, 86, 92, 89,
+    116, 122, 107, 90, 82, 83, 91, 94, 86, 84, 97, 95, 92, 94, 89, 88, 89, 88, 92, 97,
+    93, 93, 89, 82, 83, 88, 91, 88, 90, 99, 98, 86, 95, 91, 89, 91, 91, 93, 93, 89,
+    94, 96, 94, 91, 93, 92, 82, 87, 84, 85, 88, 86, 82, 90, 94, 90, 82, 85, 91, 89,
+    80, 85, 88, 85, 85, 81, 77, 86, 89, 88, 86, 88, 93, 90, 91, 86, 84, 85, 86, 89,
+    116, 122, 109, 86, 84, 78, 88, 93, 73, 84, 91, 92, 86, 85, 94, 88, 92, 94, 96, 97,
+    96, 95, 88, 87, 88, 92, 95, 92, 92, 94, 93, 89, 90, 91, 94, 93, 95, 97, 95, 89,
+    96, 93, 87, 85, 91, 88, 80, 81, 86, 82, 79, 89, 91, 85, 83, 82, 73, 84, 92, 92,
+    90, 91, 89, 81, 88, 95, 91, 89, 91, 92, 93, 91, 81, 87, 92, 87, 84, 93, 91, 91,
+    115, 122, 109, 91, 83, 84, 86, 92, 97, 95, 95, 87, 87, 86, 85, 87, 88, 89, 97, 100,
+    94, 92, 91, 91, 95, 92, 95, 88, 91, 96, 95, 89, 90, 91, 90, 92, 88, 94, 92, 90,
+    90, 79, 84, 90, 94, 95, 96, 95, 90, 90, 88, 93, 93, 84, 89, 90, 90, 93, 93, 89,
+    90, 92, 88, 82, 90, 95, 90, 90, 95, 89, 77, 80, 80, 89, 90, 87, 87, 90, 84, 90,
+    117, 122, 109, 94, 86, 94, 89, 90, 90, 88, 85, 90, 84, 85, 86, 84, 91, 89, 89, 95,
+    85, 87, 90, 96, 95, 86, 89, 86, 92, 97, 97, 90, 91, 93, 91, 87, 92, 98, 93, 88,
+    94, 89, 83, 84, 85, 83, 94, 97, 96, 97, 96, 93, 87, 83, 87, 85, 88, 81, 73, 80,
+    88, 83, 81, 86, 87, 92, 94, 90, 88, 86, 87, 85, 85, 84, 82, 86, 83, 74, 84, 96,
+    115, 122, 109, 91, 94, 99, 93, 94, 91, 95, 94, 92, 95, 90, 93, 94, 97, 92, 94, 96,
+    90, 89, 91, 93, 87, 91, 86, 83, 87, 96, 94, 88, 93, 95, 87, 86, 87, 93, 90, 89,
+    97, 84, 88, 93, 97, 96, 92, 84, 75, 79, 87, 87, 87, 84, 84, 80, 84, 88, 87, 92,
+    95, 92, 90, 89, 82, 81, 79, 88, 90, 89, 92, 91, 90, 91, 84, 88, 90, 79, 78, 91,
+    115, 121, 107, 95, 89, 89, 87, 84, 87, 90, 91, 86, 89, 84, 91, 92, 87, 91, 91, 93,
+    94, 91, 90, 91, 83, 92, 90, 88, 93, 98, 96, 95, 95, 93, 88, 95, 92, 97, 92, 90,
+    93, 86, 90, 91, 97, 94, 81, 84, 86, 84, 84, 90, 91, 84, 77, 86, 86, 84, 90, 93,
+    89, 67, 84, 91, 89, 88, 90, 89, 94, 97, 94, 91, 89, 95, 95, 94, 91, 91, 91, 92,
+    116, 122, 108, 89, 87, 83, 86, 83, 79, 85, 88, 85, 92, 93, 93, 90, 93, 98, 96, 96,
+    96, 95, 92, 89, 86, 84, 84, 93, 86, 97, 98, 94, 95, 94, 85, 87, 91, 96, 92, 86,
+    95, 95, 90, 95, 96, 91, 94, 87, 86, 88, 81, 85, 88, 86, 87, 96, 98, 94, 95, 96,
+    90, 80, 81, 93, 96, 92, 86, 85, 91, 96, 85, 86, 95, 99, 97, 96, 91, 92, 92, 96,
+    116, 122, 109, 88, 87, 85, 89, 89, 90, 90, 88, 89, 85, 90, 84, 89, 90, 92, 89, 94,
+    94, 95, 89, 92, 91, 87, 91, 91, 88, 97, 97, 89, 91, 91, 90, 90, 91, 98, 90, 92,
+    89, 89, 90, 93, 94, 94, 92, 90, 82, 86, 90, 87, 84, 89, 91, 92, 99, 98, 89, 93,
+    94, 93, 90, 87, 93, 96, 96, 95, 94, 92, 96, 99, 93, 85, 85, 82, 88, 96, 92, 90,
+    115, 122, 108, 88, 90, 93, 85, 87, 89, 82, 79, 82, 86, 84, 82, 84, 88, 90, 90, 91,
+    91, 87, 91, 90, 91, 92, 96, 89, 87, 99, 97, 89, 95, 92, 89, 90, 97, 97, 89, 90,
+    85, 81, 91, 94, 92, 90, 90, 89, 90, 96, 96, 87, 83, 92, 90, 85, 87, 83, 91, 91,
+    85, 87, 91, 92, 93, 93, 91, 84, 86, 95, 96, 92, 87, 88, 79, 85, 87, 91, 95, 93,
+    115, 121, 109, 92, 86, 88, 96, 91, 92, 90, 86, 83, 90, 93, 91, 88, 89, 86, 96, 89,
+    89, 85, 91, 90, 90, 87, 91, 89, 90, 93, 95, 91, 89, 88, 89, 92, 95, 95, 88, 89,
+    78, 87, 89, 88, 91, 88, 86, 78, 72, 87, 91, 83, 85, 90, 86, 85, 85, 82, 82, 77,
+    67, 82, 88, 89, 90, 92, 92, 88, 90, 86, 83, 85, 91, 95, 94, 89, 91, 91, 94, 93,
+    116, 122, 108, 91, 84, 82, 93, 90, 87, 89, 85, 84, 83, 80, 89, 87, 91, 91, 82, 87,
+    87, 86, 91, 92, 92, 86, 90, 95, 91, 101, 99, 92, 89, 85, 90, 93, 89, 94, 94, 91,
+    86, 87, 81, 85, 88, 79, 86, 84, 83, 85, 89, 87, 85, 91, 95, 93, 86, 94, 97, 94,
+    89, 92, 93, 95, 95, 89, 95, 97, 92, 88, 88, 87, 96, 98, 88, 88, 93, 91, 87, 90,
+    117, 122, 108, 86, 80, 92, 92, 95, 89, 85, 86, 91, 86, 88, 90, 94, 88, 93, 87, 93,
+    92, 89, 87, 94, 85, 89, 85, 94, 94, 95, 95, 85, 90, 92, 92, 89, 84, 96, 94, 92,
+    99, 88, 91, 88, 84, 90, 90, 88, 83, 75, 75, 80, 81, 89, 91, 81, 83, 87, 89, 89,
+    93, 93, 90, 86, 83, 87, 89, 87, 89, 84, 83, 76, 87, 87, 88, 91, 95, 94, 87, 96,
+    115, 121, 107, 89, 98, 97, 88, 84, 90, 86, 88, 91, 88, 89, 91, 90, 85, 93, 89, 90,
+    89, 88, 89, 93, 92, 94, 87, 88, 93, 98, 96, 91, 90, 91, 94, 89, 88, 89, 90, 90,
+    93, 94, 94, 88, 80, 81, 71, 66, 78, 81, 78, 77, 87, 94, 93, 87, 86, 86, 86, 87,
+    88, 86, 93, 90, 80, 84, 92, 90, 85, 93, 94, 91, 88, 95, 97, 95, 93, 87, 86, 94,
+    115, 121, 109, 95, 92, 86, 91, 90, 87, 88, 93, 90, 86, 84, 91, 95, 86, 87, 93, 95,
+    90, 91, 90, 90, 89, 91, 93, 95, 91, 98, 96, 88, 93, 91, 90, 89, 93, 96, 92, 88,
+    85, 89, 85, 80, 89, 86, 73, 64, 65, 81, 87, 88, 93, 94, 87, 89, 89, 81, 72, 78,
+    87, 93, 92, 85, 69, 82, 91, 89, 85, 88, 93, 91, 89, 89, 92, 89, 85, 91, 91, 91,
+    115, 121, 107, 89, 87, 91, 88, 91, 94, 94, 89, 90, 90, 88, 95, 91, 91, 94, 95, 102,
+    94, 92, 89, 89, 92, 88, 89, 87, 92, 101, 98, 90, 92, 91, 87, 88, 91, 96, 85, 88,
+    102, 94, 87, 86, 88, 85, 76, 79, 84, 82, 77, 83, 88, 91, 92, 91, 94, 96, 93, 91,
+    85, 81, 82, 80, 87, 92, 91, 91, 95, 94, 83, 79, 82, 89, 96, 93, 84, 87, 97, 98,
+    116, 122, 108, 83, 92, 93, 94, 94, 87, 95, 93, 85, 85, 91, 91, 84, 92, 87, 89, 93,
+    86, 87, 86, 87, 89, 87, 89, 88, 94, 96, 96, 89, 89, 88, 90, 86, 91, 96, 86, 93,
+    100, 84, 73, 80, 82, 79, 73, 75, 80, 80, 89, 90, 91, 91, 89, 90, 92, 92, 89, 92,
+    96, 94, 91, 91, 94, 88, 91, 93, 89, 86, 86, 87, 89, 89, 93, 97, 95, 87, 88, 88,
+    116, 122, 108, 95, 88, 99, 94, 80, 80, 81, 89, 88, 86, 89, 88, 83, 86, 84, 95, 100,
+    91, 89, 86, 90, 88, 89, 88, 91, 91, 97, 94, 88, 87, 90, 92, 86, 89, 95, 89, 89,
+    93, 90, 88, 89, 91, 85, 78, 86, 89, 90, 93, 89, 92, 94, 87, 81, 87, 91, 95, 97,
+    94, 94, 90, 88, 95, 96, 83, 85, 89, 88, 76, 84, 86, 86, 89, 97, 91, 86, 91, 97,
+    115, 121, 108, 89, 92, 94, 96, 88, 92, 91, 92, 89, 84, 88, 90, 89, 90, 91, 94, 98,
+    94, 90, 93, 92, 91, 91, 88, 90, 93, 97, 95, 92, 93, 89, 87, 89, 93, 93, 92, 91,
+    99, 90, 82, 89, 90, 92, 94, 93, 90, 85, 82, 89, 88, 81, 84, 82, 84, 86, 91, 93,
+    94, 85, 70, 79, 85, 88, 86, 86, 84, 79, 78, 76, 67, 80, 91, 95, 94, 96, 87, 88,
+    116, 122, 108, 85, 94, 92, 91, 91, 83, 87, 88, 86, 91, 90, 92, 91, 91, 88, 89, 92,
+    97, 96, 92, 94, 93, 91, 93, 89, 86, 96, 96, 91, 93, 94, 92, 89, 92, 94, 91, 90,
+    91, 76, 84, 82, 74, 74, 71, 72, 75, 84, 89, 88, 88, 87, 79, 76, 79, 86, 91, 92,
+    91, 84, 84, 88, 90, 93, 92, 87, 81, 89, 90, 88, 85, 89, 93, 95, 93, 88, 92, 94,
+    116, 122, 109, 92, 89, 90, 84, 93, 96, 88, 88, 92, 96, 97, 95, 92, 90, 90, 91, 95,
+    90, 86, 89, 90, 90, 92, 85, 91, 90, 94, 92, 94, 95, 91, 89, 92, 91, 94, 91, 88,
+    96, 93, 92, 87, 78, 84, 86, 81, 87, 95, 94, 94, 93, 86, 82, 79, 78, 81, 80, 85,
+    82, 75, 79, 83, 91, 90, 89, 92, 94, 98, 96, 95, 93, 93, 86, 91, 98, 97, 93, 92,
+    115, 122, 109, 91, 94, 89, 81, 87, 90, 87, 87, 89, 91, 96, 96, 89, 90, 92, 95, 99,
+    88, 89, 84, 91, 89, 89, 87, 89, 84, 94, 95, 92, 92, 90, 93, 95, 93, 95, 92, 90,
+    89, 89, 82, 84, 85, 80, 90, 95, 94, 86, 94, 95, 93, 89, 87, 88, 94, 93, 87, 79,
+    82, 78, 74, 82, 78, 89, 94, 92, 90, 89, 88, 88, 87, 96, 93, 89, 88, 93, 96, 99,
+    116, 122, 108, 90, 79, 76, 81, 82, 82, 83, 91, 87, 92, 90, 83, 88, 89, 82, 90, 93,
+    93, 89, 88, 89, 93, 90, 96, 93, 87, 97, 96, 88, 90, 87, 92, 94, 92, 92, 86, 85,
+    97, 91, 87, 89, 90, 90, 87, 87, 92, 89, 87, 91, 89, 90, 96, 90, 90, 94, 91, 91,
+    92, 91, 88, 87, 87, 88, 82, 82, 79, 89, 89, 87, 93, 97, 91, 79, 90, 98, 95, 92,
+    116, 122, 109, 99, 93, 86, 91, 94, 92, 86, 90, 88, 91, 94, 80, 82, 85, 87, 95, 92,
+    85, 84, 94, 94, 89, 86, 89, 89, 89, 96, 96, 89, 90, 90, 84, 87, 89, 93, 89, 91,
+    92, 89, 84, 90, 91, 86, 83, 86, 89, 83, 78, 91, 97, 94, 89, 83, 90, 91, 98, 99,
+    94, 85, 87, 87, 87, 85, 84, 88, 83, 89, 91, 93, 89, 84, 82, 86, 91, 86, 78, 87,
+    115, 122, 108, 89, 93, 88, 91, 94, 94, 87, 89, 90, 85, 96, 91, 88, 91, 88, 84, 93,
+    88, 94, 90, 95, 90, 92, 93, 89, 88, 97, 100, 89, 88, 87, 92, 88, 86, 95, 89, 94,
+    82, 89, 87, 88, 87, 89, 87, 88, 87, 91, 92, 89, 93, 99, 99, 95, 82, 82, 92, 100,
+    100, 96, 94, 90, 80, 92, 95, 88, 93, 95, 91, 86, 90, 87, 96, 94, 87, 85, 73, 91,
+    116, 122, 108, 93, 93, 91, 93, 89, 89, 90, 80, 91, 93, 94, 96, 97, 87, 92, 88, 92,
+    90, 88, 89, 93, 91, 92, 92, 85, 88, 100, 98, 88, 89, 89, 86, 89, 91, 97, 95, 93,
+    85, 77, 87, 95, 98, 92, 79, 87, 94, 96, 89, 91, 90, 91, 90, 88, 94, 92, 88, 86,
+    90, 90, 86, 83, 89, 91, 94, 91, 94, 93, 91, 90, 83, 87, 90, 84, 94, 92, 81, 91,
+    116, 122, 108, 87, 85, 91, 98, 89, 89, 86, 91, 96, 92, 96, 91, 94, 89, 92, 93, 98,
+    93, 90, 93, 91, 97, 93, 90, 89, 90, 96, 94, 92, 91, 88, 89, 91, 92, 93, 90, 91,
+    87, 89, 91, 92, 91, 78, 75, 83, 88, 89, 87, 92, 94, 90, 87, 88, 87, 81, 72, 77,
+    73, 77, 80, 87, 92, 93, 86, 92, 95, 90, 90, 93, 84, 89, 95, 95, 89, 85, 85, 94,
+    116, 122, 108, 89, 86, 95, 93, 88, 89, 90, 95, 96, 93, 93, 90, 94, 94, 93, 95, 96,
+    91, 92, 93, 92, 91, 94, 92, 88, 88, 97, 95, 89, 86, 91, 87, 90, 92, 98, 91, 90,
+    69, 79, 87, 88, 87, 87, 81, 78, 82, 81, 77, 85, 92, 93, 89, 86, 83, 85, 91, 92,
+    89, 88, 86, 80, 92, 96, 88, 87, 89, 83, 92, 98, 93, 92, 92, 85, 88, 93, 92, 91,
+    115, 122, 110, 89, 93, 98, 91, 89, 88, 82, 91, 92, 98, 100, 96, 88, 87, 88, 90, 94,
+    89, 94, 93, 92, 89, 91, 88, 90, 89, 98, 96, 89, 91, 93, 93, 93, 92, 95, 91, 90,
+    78, 79, 88, 91, 90, 84, 86, 93, 91, 81, 84, 93, 92, 87, 87, 88, 88, 91, 96, 98,
+    93, 90, 94, 93, 93, 97, 91, 93, 92, 92, 84, 83, 76, 88, 93, 90, 80, 82, 86, 94,
+    115, 121, 106, 92, 87, 91, 85, 88, 92, 91, 91, 91, 94, 90, 90, 89, 92, 92, 93, 93,
+    93, 94, 94, 95, 91, 90, 88, 90, 89, 100, 98, 90, 92, 89, 90, 87, 90, 96, 91, 87,
+    93, 80, 85, 87, 80, 89, 91, 90, 94, 92, 88, 96, 97, 92, 87, 85, 80, 80, 83, 94,
+    103, 103, 96, 88, 84, 90, 98, 98, 94, 93, 92, 86, 88, 87, 87, 89, 90, 91, 89, 92,
+    116, 122, 109, 87, 91, 92, 95, 89, 84, 88, 89, 96, 91, 88, 86, 89, 86, 87, 92, 91,
+    89, 92, 94, 92, 87, 89, 90, 92, 88, 99, 97, 90, 86, 91, 94, 89, 92, 96, 88, 86,
+    91, 97, 98, 96, 94, 95, 94, 91, 90, 94, 97, 94, 86, 84, 86, 86, 84, 83, 92, 93,
+    86, 90, 88, 83, 79, 89, 85, 85, 91, 95, 97, 93, 79, 82, 82, 90, 95, 90, 76, 86,
+    116, 122, 108, 92, 97, 92, 89, 85, 80, 87, 89, 89, 90, 92, 89, 90, 93, 89, 88, 97,
+    89, 91, 97, 93, 92, 91, 89, 95, 91, 97, 95, 89, 89, 93, 89, 87, 90, 94, 91, 89,
+    87, 84, 86, 85, 84, 90, 88, 82, 91, 98, 97, 94, 91, 79, 82, 87, 81, 90, 97, 97,
+    88, 82, 87, 88, 87, 87, 82, 86, 89, 91, 90, 83, 79, 87, 89, 84, 86, 91, 83, 87,
+    115, 121, 108, 89, 91, 92, 89, 89, 82, 89, 88, 87, 89, 89, 90, 89, 94, 87, 91, 89,
+    89, 88, 90, 86, 94, 92, 88, 87, 90, 97, 96, 89, 90, 91, 90, 92, 92, 95, 91, 93,
+    85, 94, 94, 87, 91, 94, 91, 83, 92, 99, 98, 98, 97, 92, 89, 91, 91, 84, 91, 93,
+    85, 91, 90, 85, 87, 87, 86, 81, 85, 77, 77, 89, 86, 83, 92, 91, 93, 89, 93, 95,
+    115, 121, 107, 87, 87, 87, 89, 95, 88, 89, 91, 87, 89, 90, 94, 94, 89, 91, 88, 91,
+    92, 87, 87, 93, 93, 95, 90, 89, 92, 95, 95, 95, 94, 91, 92, 95, 90, 95, 95, 90,
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+// 2 マイク（L/R 交互）のテスト用の合成音
+//  - 平面波: 帯域内の正弦波の和を、マイクごとの到達時刻で解析的に鳴らす（小数サンプルの遅延も正確）
+//  - 拡散ノイズ: マイクごとに独立な白色雑音（マイク間隔が波長に比べて長い帯域での近似）
+//  - 角度の符号は Beamformer / DoaEstimator と同じ（0 が正面、正は R マイク側）
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace stereo_source
+{
+struct Tone
+{
+  double freq_hz = 0.0;
+  double phase = 0.0;
+  double amp = 0.0;
+};
+
+// [lo_hz, hi_hz] に等間隔で count 本。位相は乱数で、全体の実効値が rms になる
+inline std::vector<Tone> tones(uint32_t seed, size_t count, double lo_hz, double hi_hz, double rms)
+{
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> phase(0.0, 2.0 * M_PI);
+  std::vector<Tone> out(count);
+  for (size_t i = 0; i < count; ++i)
+  {
+    out[i].freq_hz = count > 1 ? lo_hz + (hi_hz - lo_hz) * static_cast<double>(i) / static_cast<double>(count - 1) : lo_hz;
+    out[i].phase = phase(rng);
+    out[i].amp = rms * std::sqrt(2.0 / static_cast<double>(count));
+  }
+  return out;
+}
+
+// 方向 angle_deg の音源で、R が L より先に受ける時間（サンプル）
+inline double tdoaSamples(int sample_rate, double mic_spacing_mm, double angle_deg)
+{
+  return mic_spacing_mm * std::sin(angle_deg * M_PI / 180.0) / 343000.0 * sample_rate;
+}
+
+// lr（L/R 交互、frames = lr.size() / 2）に平面波を足す。L は tdoa / 2 遅れ、R は tdoa / 2 早く受ける
+inline void addPlaneWave(std::vector<double> &lr, const std::vector<Tone> &source, double tdoa_samples, int sample_rate,
+                         size_t start_frame = 0)
+{
+  for (size_t n = start_frame; n < lr.size() / 2; ++n)
+  {
+    for (size_t ch = 0; ch < 2; ++ch)
+    {
+      double t = (static_cast<double>(n) + (ch == 0 ? -0.5 : 0.5) * tdoa_samples) / sample_rate;
+      double v = 0.0;
+      for (const Tone &tone : source)
+      {
+        v += tone.amp * std::sin(2.0 * M_PI * tone.freq_hz * t + tone.phase);
+      }
+      lr[2 * n + ch] += v;
+    }
+  }
+}
+
+inline void addDiffuseNoise(std::vector<double> &lr, double rms, uint32_t seed)
+{
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> noise(0.0, rms);
+  for (double &v : lr)
+  {
+    v += noise(rng);
+  }
+}
+
+inline std::vector<int16_t> toPcm(const std::vector<double> &samples)
+{
+  std::vector<int16_t> out(samples.size());
+  for (size_t i = 0; i < samples.size(); ++i)
+  {
+    out[i] = static_cast<int16_t>(std::clamp(std::lround(samples[i]), -32768L, 32767L));
+  }
+  return out;
+}
+
+// skip 番目以降の平均パワー（stride ごとに 1 サンプル、offset から）
+inline double power(const std::vector<int16_t> &samples, size_t skip = 0, size_t stride = 1, size_t offset = 0)
+{
+  double sum = 0.0;
+  size_t n = 0;
+  for (size_t i = skip * stride + offset; i < samples.size(); i += stride)
+  {
+    sum += static_cast<double>(samples[i]) * samples[i];
+    n++;
+  }
+  return n > 0 ? sum / static_cast<double>(n) : 0.0;
+}
+} // namespace stereo_source
@@ -0,0 +1,149 @@
+// Beamformer（2 マイクの遅延和）のテストと 1 ブロックあたりのコスト
+//  - 正面に向けたときは L/R の平均を 1 サンプル遅らせたものと同じになる
+//  - 狙った方向の平面波は弱めず、マイクごとに独立なノイズは平均で下がる（SNR が約 +3 dB）
+//  - 狙った方向と反対から来る音は、遅延が揃わないので弱まる
+//  - 音は stereo_source.hpp で合成する（CoreS3 のマイク間隔 46 mm、16 kHz）
+
+#include "beamformer.hpp"
+#include "host_test.hpp"
+#include "stereo_source.hpp"
+
+#include <vector>
+
+namespace
+{
+constexpr int kSampleRate = 16000;
+constexpr float kSpacingMm = 46.0f;
+constexpr size_t kFrames = kSampleRate * 2;
+constexpr size_t kWarmup = 32; // 遅延線が埋まるまで
+
+std::vector<int16_t> beamform(float steer_deg, const std::vector<int16_t> &lr)
+{
+  Beamformer bf;
+  bf.configure(kSampleRate, kSpacingMm, steer_deg);
+  std::vector<int16_t> out(lr.size() / 2);
+  // DMA から読む単位（mic_frontend と同じく 1 回 256 フレーム）に分けて入れる
+  for (size_t pos = 0; pos < out.size(); pos += 256)
+  {
+    size_t frames = std::min<size_t>(256, out.size() - pos);
+    bf.process(lr.data() + 2 * pos, frames, out.data() + pos);
+  }
+  return out;
+}
+
+double db(double ratio)
+{
+  return 10.0 * std::log10(ratio);
+}
+
+void testFrontIsDelayedAverage()
+{
+  Beamformer bf;
+  bf.configure(kSampleRate, kSpacingMm, 0.0f);
+  CHECK_NEAR(bf.delaySamples(), 0.0, 1e-6);
+
+  std::vector<double> lr(2 * 4096, 0.0);
+  stereo_source::addDiffuseNoise(lr, 6000.0, 1);
+  std::vector<int16_t> pcm = stereo_source::toPcm(lr);
+  std::vector<int16_t> out = beamform(0.0f, pcm);
+  size_t mismatched = 0;
+  for (size_t n = 1; n < out.size(); ++n)
+  {
+    int32_t expected = (static_cast<int32_t>(pcm[2 * (n - 1)]) + pcm[2 * (n - 1) + 1]) >> 1;
+    mismatched += out[n] != expected ? 1 : 0;
+  }
+  CHECK_EQ(mismatched, 0u);
+}
+
+void testDelaySign()
+{
+  Beamformer bf;
+  bf.configure(kSampleRate, kSpacingMm, 30.0f);
+  CHECK_NEAR(bf.delaySamples(), stereo_source::tdoaSamples(kSampleRate, kSpacingMm, 30.0), 1e-3);
+  CHECK(bf.delaySamples() > 0.0f);
+  bf.configure(kSampleRate, kSpacingMm, -30.0f);
+  CHECK(bf.delaySamples() < 0.0f);
+}
+
+// 狙った方向の音声帯域（300〜3400 Hz）と独立なノイズを別々に通し、SNR の改善を測る
+void testSnrGain()
+{
+  for (float steer : {0.0f, 30.0f, -45.0f, 90.0f})
+  {
+    double tdoa = stereo_source::tdoaSamples(kSampleRate, kSpacingMm, steer);
+    std::vector<double> signal(2 * kFrames, 0.0);
+    stereo_source::addPlaneWave(signal, stereo_source::tones(7, 40, 300.0, 3400.0, 3000.0), tdoa, kSampleRate);
+    std::vector<double> noise(2 * kFrames, 0.0);
+    stereo_source::addDiffuseNoise(noise, 1000.0, 11);
+    std::vector<int16_t> signal_pcm = stereo_source::toPcm(signal);
+    std::vector<int16_t> noise_pcm = stereo_source::toPcm(noise);
+
+    double in_signal = stereo_source::power(signal_pcm, kWarmup, 2, 0);
+    double in_noise = stereo_source::power(noise_pcm, kWarmup, 2, 0);
+    double out_signal = stereo_source::power(beamform(steer, signal_pcm), kWarmup);
+    double out_noise = stereo_source::power(beamform(steer, noise_pcm), kWarmup);
+    double signal_db = db(out_signal / in_signal);
+    double gain_db = db(out_signal / out_noise) - db(in_signal / in_noise);
+    // 小数遅延の補間は高域で少し減衰するが、狙った音はほぼそのまま。
+    // 同じ減衰で音声帯域より上のノイズも削れるので、小数遅延では 3 dB を少し超える
+    CHECK(signal_db > -1.0 && signal_db < 0.2);
+    CHECK(gain_db > 2.5 && gain_db < 4.0);
+    if (host_test::g_verbose)
+    {
+      printf("  steer %+5.1f deg (delay %+.2f samples): signal %+.2f dB, SNR gain %+.2f dB\n", steer, tdoa, signal_db,
+             gain_db);
+    }
+  }
+}
+
+// 右 60 度に向けて、左 60 度から来る 2 kHz 付近の音は大きく下がる（2 マイクの遅延和で最初の零点に近い帯域）
+void testOffAxisRejection()
+{
+  constexpr float kSteer = 60.0f;
+  std::vector<int16_t> on_pcm;
+  std::vector<int16_t> off_pcm;
+  for (float source : {kSteer, -kSteer})
+  {
+    std::vector<double> lr(2 * kFrames, 0.0);
+    stereo_source::addPlaneWave(lr, stereo_source::tones(3, 10, 1900.0, 2300.0, 3000.0),
+                                stereo_source::tdoaSamples(kSampleRate, kSpacingMm, source), kSampleRate);
+    (source == kSteer ? on_pcm : off_pcm) = stereo_source::toPcm(lr);
+  }
+  double on = stereo_source::power(beamform(kSteer, on_pcm), kWarmup);
+  double off = stereo_source::power(beamform(kSteer, off_pcm), kWarmup);
+  double rejection_db = db(on / off);
+  CHECK(rejection_db > 15.0);
+  if (host_test::g_verbose)
+  {
+    printf("  off-axis (-60 deg, 1.9-2.3 kHz) rejection %.1f dB\n", rejection_db);
+  }
+}
+
+void benchmarkProcess()
+{
+  std::vector<double> lr(2 * 256, 0.0);
+  stereo_source::addDiffuseNoise(lr, 3000.0, 5);
+  std::vector<int16_t> pcm = stereo_source::toPcm(lr);
+  std::vector<int16_t> out(256);
+  Beamformer bf;
+  bf.configure(kSampleRate, kSpacingMm, 30.0f);
+  volatile int16_t sink = 0;
+  const double block_ns = host_test::nsPerCall(200000, [&]() {
+    bf.process(pcm.data(), 256, out.data());
+    sink = out[0];
+  });
+  (void)sink;
+  printf("  process: %.0f ns per 256-frame block (16 ms at 16 kHz), %.2f ns per frame\n", block_ns, block_ns / 256.0);
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+  host_test::init(argc, argv);
+  testFrontIsDelayedAverage();
+  testDelaySign();
+  testSnrGain();
+  testOffAxisRejection();
+  benchmarkProcess();
+  return host_test::finish("beamformer");
+}
@@ -0,0 +1,116 @@
+// DoaEstimator（GCC-PHAT の到来方向推定）のテストと 1 ブロックあたりのコスト
+//  - 無音の後に既知の方向から平面波（音声帯域の正弦波の和）を鳴らし、推定した遅延が合成した遅延と合うこと
+//  - 方向の無いノイズ（マイクごとに独立）では確からしさが低く、無音では推定を出さないこと
+//  - 音は stereo_source.hpp で合成する（CoreS3 のマイク間隔 46 mm、16 kHz）
+
+#include "doa_estimator.hpp"
+#include "host_test.hpp"
+#include "stereo_source.hpp"
+
+#include <vector>
+
+namespace
+{
+constexpr int kSampleRate = 16000;
+constexpr float kSpacingMm = 46.0f;
+constexpr size_t kSilenceFrames = kSampleRate / 2;
+constexpr size_t kSourceFrames = kSampleRate;
+
+// mic_frontend と同じく DMA から読んだ単位で入れる。ブロック境界と揃わない長さにする
+bool feed(DoaEstimator &doa, const std::vector<int16_t> &lr, DoaEstimator::Estimate &last, size_t &count)
+{
+  constexpr size_t kChunk = 160;
+  count = 0;
+  for (size_t pos = 0; pos < lr.size() / 2; pos += kChunk)
+  {
+    size_t frames = std::min(kChunk, lr.size() / 2 - pos);
+    doa.process(lr.data() + 2 * pos, frames, static_cast<uint32_t>(pos * 1000 / kSampleRate));
+    DoaEstimator::Estimate e;
+    if (doa.take(e))
+    {
+      last = e;
+      count++;
+    }
+  }
+  return count > 0;
+}
+
+void testKnownDelays()
+{
+  const double max_delay = stereo_source::tdoaSamples(kSampleRate, kSpacingMm, 90.0);
+  for (double angle : {-75.0, -40.0, -12.0, 0.0, 7.0, 25.0, 50.0, 80.0})
+  {
+    std::vector<double> lr(2 * (kSilenceFrames + kSourceFrames), 0.0);
+    stereo_source::addDiffuseNoise(lr, 30.0, 3);
+    stereo_source::addPlaneWave(lr, stereo_source::tones(static_cast<uint32_t>(angle + 100), 48, 300.0, 4000.0, 2000.0),
+                                stereo_source::tdoaSamples(kSampleRate, kSpacingMm, angle), kSampleRate, kSilenceFrames);
+    // マイクごとの独立なノイズ（SNR 20 dB）
+    stereo_source::addDiffuseNoise(lr, 200.0, 5);
+
+    DoaEstimator doa;
+    doa.configure(kSampleRate, kSpacingMm);
+    DoaEstimator::Estimate e;
+    size_t count = 0;
+    CHECK(feed(doa, stereo_source::toPcm(lr), e, count));
+    // 発話が始まってから推定を出している
+    CHECK(e.at_ms >= kSilenceFrames * 1000 / kSampleRate);
+    double expected = stereo_source::tdoaSamples(kSampleRate, kSpacingMm, angle);
+    double estimated = max_delay * std::sin(e.angle_deg * M_PI / 180.0);
+    // 遅延で 0.1 サンプル以内（正面付近では約 3 度）
+    CHECK_NEAR(estimated, expected, 0.1);
+    CHECK(e.confidence > 0.7f);
+    if (host_test::g_verbose)
+    {
+      printf("  %+5.1f deg (delay %+.3f): estimated %+6.1f deg (delay %+.3f), confidence %.2f, %u estimates\n", angle,
+             expected, e.angle_deg, estimated, e.confidence, static_cast<unsigned>(count));
+    }
+  }
+}
+
+// 無音では推定を出さず、方向の無いノイズでは確からしさが低い
+void testNoDirection()
+{
+  DoaEstimator doa;
+  doa.configure(kSampleRate, kSpacingMm);
+  std::vector<double> quiet(2 * kSampleRate, 0.0);
+  stereo_source::addDiffuseNoise(quiet, 30.0, 9);
+  DoaEstimator::Estimate e;
+  size_t count = 0;
+  CHECK(!feed(doa, stereo_source::toPcm(quiet), e, count));
+
+  std::vector<double> noise(2 * (kSilenceFrames + kSourceFrames), 0.0);
+  stereo_source::addDiffuseNoise(noise, 30.0, 13);
+  std::vector<double> loud(2 * kSourceFrames, 0.0);
+  stereo_source::addDiffuseNoise(loud, 2000.0, 17);
+  std::copy(loud.begin(), loud.end(), noise.begin() + 2 * kSilenceFrames);
+  doa.reset();
+  CHECK(feed(doa, stereo_source::toPcm(noise), e, count));
+  CHECK(e.confidence < 0.3f);
+  if (host_test::g_verbose)
+  {
+    printf("  diffuse noise: %+6.1f deg, confidence %.2f\n", e.angle_deg, e.confidence);
+  }
+}
+
+void benchmarkBlock()
+{
+  std::vector<double> lr(2 * DoaEstimator::kFftSize, 0.0);
+  stereo_source::addPlaneWave(lr, stereo_source::tones(1, 48, 300.0, 4000.0, 2000.0), 1.0, kSampleRate);
+  std::vector<int16_t> pcm = stereo_source::toPcm(lr);
+  DoaEstimator doa;
+  doa.configure(kSampleRate, kSpacingMm);
+  // 毎ブロック発話区間として相互スペクトルを更新し、2 ブロックごとに角度を探す
+  const double block_ns = host_test::nsPerCall(20000, [&]() { doa.process(pcm.data(), DoaEstimator::kFftSize, 0); });
+  printf("  process: %.0f ns per %u-frame block (%u ms at 16 kHz)\n", block_ns,
+         static_cast<unsigned>(DoaEstimator::kFftSize), static_cast<unsigned>(DoaEstimator::kFftSize * 1000 / kSampleRate));
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+  host_test::init(argc, argv);
+  testKnownDelays();
+  testNoDirection();
+  benchmarkBlock();
+  return host_test::finish("doa_estimator");
+}
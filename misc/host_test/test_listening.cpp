@@ -0,0 +1,509 @@
+// 送信中に WebSocket が切れてから再接続するまでの Listening のテスト
+//  - main.cpp と同じつなぎ方（切断で Listening を抜けて保留、再接続で guard が通れば Listening）で、
+//    偽のソケットの相手をするサーバーが START/DATA を受け取り、AudioPcmAck を返す
+//  - マイクは misc/replay/host の DMA の模型。loop() が止まって DMA が溢れると、その分のサンプルが欠ける
+//  - 切れている間もマイクを読み続け（DMA もスプールも溢れない）、再接続後は同じセッションとして
+//    欠けも重複も無い PCM が届くことを確かめる
+//  - 無音で止めるときの残りの DATA の送信で切れても、スプールを残して再開で送り直すことを確かめる
+//  - DATA の長さの切り替え（enableAdaptiveChunks）を、ack の flags・電波・ack の遅れ・送信の詰まりを変えて確かめ、
+//    長さごとの DATA/s とオーバーヘッドを計る
+//  - Display の描画タスクが 30 fps で描き続けている間も、loop() は描画を待たずにマイクを読み、取りこぼさない
+
+#include "display.hpp"
+#include "fake_ws_server.hpp"
+#include "host_test.hpp"
+#include "listening.hpp"
+#include "memory_plan.hpp"
+#include "state_machine.hpp"
+#include "ws_client.hpp"
+
+#include <chrono>
+#include <map>
+#include <vector>
+
+namespace
+{
+using replay_host::socket;
+
+constexpr int kSampleRate = 16000;
+constexpr uint32_t kAckIntervalMs = 250;
+
+constexpr memory_plan::Budget kPlan[] = {
+    {memory_plan::Module::WsClient, memory_plan::Region::Psram, memory_plan::padded(WsClient::kRxBufferBytes)},
+    {memory_plan::Module::WsClient, memory_plan::Region::Internal, memory_plan::padded(WsClient::kTxBufferBytes)},
+    {memory_plan::Module::Listening, memory_plan::Region::Psram, Listening::psramBytes(kSampleRate)},
+    {memory_plan::Module::Listening, memory_plan::Region::Internal, Listening::internalBytes(kSampleRate)},
+};
+
+WsClient ws;
+StateMachine sm;
+MicFrontEnd mic;
+Listening listening(ws, sm, mic, kSampleRate);
+Display display(sm);
+bool display_running = false; // true の間は loop() ごとに描画コマンドを渡し、描画タスクを進める
+
+// サーバー側で受け取ったもの
+struct Received
+{
+  std::vector<std::vector<uint8_t>> starts; // START の payload
+  std::vector<uint8_t> start_flags;
+  std::vector<uint16_t> start_seqs;
+  std::map<uint16_t, std::vector<int16_t>> data; // seq ごとの DATA（再送分は同じ中身か確かめて 1 つにする）
+  size_t duplicates = 0;
+  size_t mismatched = 0;
+  size_t data_frames = 0;       // 再送分も含めた DATA の数
+  size_t data_pcm_bytes = 0;
+  size_t data_wire_bytes = 0;   // WebSocket の枠と WsHeader も含めたバイト数
+  uint16_t last_data_bytes = 0; // 最後に届いた DATA の PCM のバイト数
+};
+Received received;
+bool upgraded = false;
+uint32_t session_id = 0;
+uint16_t last_data_seq = 0;
+bool ack_pending = false;
+uint32_t last_ack_ms = 0;
+uint8_t ack_flags = kPcmAckFlagStreaming; // 0 ならストリーミング認識を知らない古いサーバー
+bool acks_held = false;                   // true の間は ack を返さない（サーバーの遅れ）
+
+uint32_t nowMs()
+{
+  return static_cast<uint32_t>(replay_host::now_us / 1000);
+}
+
+void setUp()
+{
+  replay_host::now_us = 1000000;
+  socket = replay_host::FakeSocket{};
+  memory_plan::release();
+  memory_plan::init(kPlan);
+
+  MicFrontEnd::Config cfg;
+  cfg.sample_rate = kSampleRate;
+  mic.init(cfg);
+  listening.init();
+  listening.enableUplinkFrontEnd(false);
+
+  StateMachine::TransitionHooks hooks;
+  hooks.can_resume_listening = []() { return listening.canResume(); };
+  sm.setTransitionHooks(hooks);
+  sm.addStateEntryEvent(StateMachine::Listening, [](StateMachine::State, StateMachine::State) { listening.begin(); });
+  sm.addStateExitEvent(StateMachine::Listening, [](StateMachine::State, StateMachine::State) { listening.end(); });
+  ws.onEvent([](WsClient::Event event) {
+    if (event == WsClient::Event::Connected)
+    {
+      sm.dispatch(StateMachine::Event::Connected);
+    }
+    else if (event == WsClient::Event::Disconnected)
+    {
+      sm.dispatch(StateMachine::Event::Disconnected);
+    }
+  });
+  ws.onMessage([](const WsHeader &hdr, const uint8_t *body, size_t len) {
+    if (hdr.kind == static_cast<uint8_t>(MessageKind::AudioPcmAck))
+    {
+      listening.handleAck(body, len);
+    }
+  });
+  ws.begin("server", 8080, "/ws");
+}
+
+// サーバー: ハンドシェイクに応答し、届いたフレームを記録して、kAckIntervalMs ごとに ack を返す
+void serve()
+{
+  if (!socket.open)
+  {
+    upgraded = false;
+    ack_pending = false;
+    return;
+  }
+  if (!upgraded)
+  {
+    upgraded = fake_ws_server::answerHandshake();
+    return;
+  }
+  for (const fake_ws_server::SentFrame &f : fake_ws_server::takeSent())
+  {
+    if (f.opcode != 0x2 || f.payload.size() < sizeof(WsHeader))
+    {
+      continue;
+    }
+    WsHeader hdr;
+    memcpy(&hdr, f.payload.data(), sizeof(hdr));
+    const uint8_t *body = f.payload.data() + sizeof(hdr);
+    if (hdr.kind != static_cast<uint8_t>(MessageKind::AudioPcm))
+    {
+      continue;
+    }
+    if (hdr.messageType == static_cast<uint8_t>(MessageType::START))
+    {
+      received.starts.emplace_back(body, body + hdr.payloadBytes);
+      received.start_flags.push_back(hdr.reserved);
+      received.start_seqs.push_back(hdr.seq);
+      if (hdr.payloadBytes >= sizeof(session_id))
+      {
+        memcpy(&session_id, body, sizeof(session_id));
+      }
+    }
+    else if (hdr.messageType == static_cast<uint8_t>(MessageType::DATA))
+    {
+      uint16_t seq = hdr.seq;
+      std::vector<int16_t> pcm(hdr.payloadBytes / sizeof(int16_t));
+      memcpy(pcm.data(), body, pcm.size() * sizeof(int16_t));
+      auto it = received.data.find(seq);
+      if (it != received.data.end())
+      {
+        received.duplicates++;
+        received.mismatched += it->second != pcm ? 1 : 0;
+      }
+      else
+      {
+        received.data.emplace(seq, std::move(pcm));
+      }
+      last_data_seq = seq;
+      ack_pending = true;
+      received.data_frames++;
+      received.data_pcm_bytes += hdr.payloadBytes;
+      received.data_wire_bytes += (f.payload.size() < 126 ? 6 : 8) + f.payload.size();
+      received.last_data_bytes = hdr.payloadBytes;
+    }
+  }
+  if (ack_pending && !acks_held && nowMs() - last_ack_ms >= kAckIntervalMs)
+  {
+    std::vector<uint8_t> ack(sizeof(session_id) + sizeof(last_data_seq) + 1);
+    memcpy(ack.data(), &session_id, sizeof(session_id));
+    memcpy(ack.data() + sizeof(session_id), &last_data_seq, sizeof(last_data_seq));
+    ack.back() = ack_flags;
+    fake_ws_server::push(fake_ws_server::frame(0x2, fake_ws_server::message(static_cast<uint8_t>(MessageKind::AudioPcmAck), 0, ack)));
+    ack_pending = false;
+    last_ack_ms = nowMs();
+  }
+}
+
+// main.cpp の loop() のうち、このテストに関わる部分
+void runFor(uint32_t ms)
+{
+  uint64_t until = replay_host::now_us + static_cast<uint64_t>(ms) * 1000;
+  while (replay_host::now_us < until)
+  {
+    uint64_t before = replay_host::now_us;
+    ws.loop();
+    serve();
+    if (sm.isListening() || sm.isDisconnected())
+    {
+      listening.loop();
+    }
+    if (display_running)
+    {
+      display.loop();
+      replay_host::runTasks();
+    }
+    if (replay_host::now_us == before)
+    {
+      replay_host::now_us += 1000; // マイクを読まないステートでは次の loop() まで待つ
+    }
+  }
+}
+
+void testDropAndResume()
+{
+  setUp();
+  runFor(100);
+  CHECK(sm.isIdle());
+  sm.dispatch(StateMachine::Event::RemoteListening);
+  CHECK(sm.isListening());
+  runFor(2000);
+  // 書いた分はサーバーに届いたが、最後の ack はまだ返していないところで落とす
+  serve();
+  CHECK(!received.data.empty());
+  CHECK(ack_pending);
+
+  // 相手が落ち、1.5 秒は接続を受け付けない
+  host_test::g_logs = {};
+  socket.drop();
+  socket.accept = false;
+  runFor(1500);
+  CHECK(sm.isDisconnected());
+  CHECK(listening.canResume());
+  CHECK(socket.connects > 1);
+  socket.accept = true;
+  runFor(3000);
+  CHECK(sm.isListening());
+
+  // 同じセッションを kWsFlagResume で再開している
+  CHECK_EQ(received.starts.size(), 2u);
+  if (received.starts.size() == 2)
+  {
+    CHECK_EQ(received.start_flags[0], 0u);
+    CHECK_EQ(received.start_flags[1], kWsFlagResume);
+    CHECK(received.starts[0] == received.starts[1]);
+  }
+  // 確認の取れていなかった DATA を送り直し、中身は最初に送ったものと同じ
+  CHECK(received.duplicates > 0);
+  CHECK_EQ(received.mismatched, 0u);
+
+  // seq は START（再開の START も seq を 1 つ使う）と DATA で飛ばずに続き、
+  // PCM は録音した順に 1 サンプルも欠けずに並ぶ（マイクの模型は通し番号を返す）
+  CHECK(received.start_seqs.size() == 2 && received.start_seqs[0] == 0);
+  uint16_t expected_seq = 1;
+  size_t samples = 0;
+  size_t gaps = 0;
+  bool first = true;
+  int16_t prev = 0;
+  for (const auto &entry : received.data)
+  {
+    if (received.start_seqs.size() == 2 && expected_seq == received.start_seqs[1])
+    {
+      expected_seq++;
+    }
+    gaps += entry.first != expected_seq ? 1 : 0;
+    expected_seq = static_cast<uint16_t>(entry.first + 1);
+    for (int16_t v : entry.second)
+    {
+      gaps += !first && v != static_cast<int16_t>(prev + 1) ? 1 : 0;
+      prev = v;
+      first = false;
+    }
+    samples += entry.second.size();
+  }
+  CHECK_EQ(gaps, 0u);
+  // 切れていた間の分も含め、録音を始めてからの音がほぼ全部届いている（残りは次の DATA に満たない端数）
+  CHECK(samples + static_cast<size_t>(kSampleRate) * 125 / 1000 >= static_cast<size_t>(kSampleRate) * 6500 / 1000);
+  CHECK_EQ(M5.Mic.overrun_samples, 0u);
+  CHECK_EQ(listening.getOverrunSamples(), 0u);
+  CHECK_EQ(host_test::g_logs.errors, 0u);
+  if (host_test::g_verbose)
+  {
+    printf("  %u DATA (%u resent), %u samples, %u connects\n", static_cast<unsigned>(received.data.size()),
+           static_cast<unsigned>(received.duplicates), static_cast<unsigned>(samples),
+           static_cast<unsigned>(socket.connects));
+  }
+}
+
+// セッションを閉じて（END まで送って）次のセッションを始める。seq は 0 から振り直すので、届いたものも捨てる
+void restartSession()
+{
+  sm.dispatch(StateMachine::Event::RemoteIdle);
+  runFor(100);
+  received = {};
+  sm.dispatch(StateMachine::Event::RemoteListening);
+}
+
+// ms のあいだ 100 ms ごとに DATA の長さを見て、長さごとの回数を返す
+std::map<uint32_t, size_t> chunkMsHistogram(uint32_t ms)
+{
+  std::map<uint32_t, size_t> out;
+  for (uint32_t t = 0; t < ms; t += 100)
+  {
+    runFor(100);
+    out[listening.getChunkMs()]++;
+  }
+  return out;
+}
+
+// 無音で止めるときに残りを送る DATA の write で切れる。保留にしたスプールを捨てず、
+// 再接続後に同じセッションとして送り直してから END を送る
+void testDropDuringFlush()
+{
+  CHECK(sm.isListening());
+  M5.Mic.value_modulo = 61; // 無音に聞こえる小さな値。素数で割り、欠けた数が割り切れて見逃すことを避ける
+  restartSession();
+  host_test::g_logs = {};
+
+  // 最長の DATA（125 ms）より短い write は、止める直前の残りの DATA
+  const size_t kFullDataWrite = 8 + sizeof(WsHeader) + kSampleRate * 125 / 1000 * sizeof(int16_t);
+  const size_t kStartWrite = 6 + sizeof(WsHeader) + sizeof(uint32_t);
+  size_t failed = 0;
+  socket.fail_write = [&](size_t len) {
+    bool fail = failed == 0 && len > kStartWrite && len < kFullDataWrite;
+    failed += fail ? 1 : 0;
+    return fail;
+  };
+  for (int i = 0; i < 4000 && failed == 0; ++i)
+  {
+    runFor(1);
+  }
+  CHECK_EQ(failed, 1u);
+  CHECK(sm.isDisconnected());
+  CHECK(listening.canResume());
+  socket.fail_write = nullptr;
+
+  runFor(3000);
+  CHECK_EQ(received.starts.size(), 2u);
+  CHECK(received.start_flags.size() == 2 && received.start_flags[1] == kWsFlagResume);
+  CHECK(sm.isIdle());
+  CHECK_EQ(received.mismatched, 0u);
+  size_t gaps = 0;
+  size_t samples = 0;
+  bool first = true;
+  int16_t prev = 0;
+  for (const auto &entry : received.data)
+  {
+    for (int16_t v : entry.second)
+    {
+      gaps += !first && v != (prev + 1) % 61 ? 1 : 0;
+      prev = v;
+      first = false;
+    }
+    samples += entry.second.size();
+  }
+  CHECK_EQ(gaps, 0u);
+  // 切れる前の 3 秒の無音と、保留中に録った分
+  CHECK(samples >= static_cast<size_t>(kSampleRate) * 3);
+  CHECK_EQ(M5.Mic.overrun_samples, 0u);
+  CHECK_EQ(host_test::g_logs.errors, 0u);
+
+  M5.Mic.value_modulo = 0;
+  sm.dispatch(StateMachine::Event::RemoteListening);
+  runFor(100);
+}
+
+void testAdaptiveChunks()
+{
+  CHECK(sm.isListening());
+  listening.enableAdaptiveChunks(true);
+  host_test::g_logs = {};
+
+  // flags の無い ack（古いサーバー）には、前のセッションのストリーミング認識に合わせて 20 ms で始めても、
+  // 最初の ack で 125 ms に戻す
+  ack_flags = 0;
+  restartSession();
+  runFor(500);
+  CHECK_EQ(listening.getChunkMs(), 125u);
+  runFor(3000);
+  CHECK_EQ(listening.getChunkMs(), 125u);
+  CHECK_EQ(received.last_data_bytes, kSampleRate * 125 / 1000 * sizeof(int16_t));
+
+  // ストリーミング認識の ack が来て回線が空いていれば、2 秒ごとに 1 段ずつ 20 ms まで縮める
+  ack_flags = kPcmAckFlagStreaming;
+  runFor(1000);
+  CHECK_EQ(listening.getChunkMs(), 80u);
+  runFor(4000);
+  CHECK_EQ(listening.getChunkMs(), 20u);
+  CHECK_EQ(received.last_data_bytes, kSampleRate * 20 / 1000 * sizeof(int16_t));
+  // 次のセッションは最初から 20 ms（ここから最後まで同じセッション）
+  restartSession();
+  runFor(100);
+  CHECK_EQ(listening.getChunkMs(), 20u);
+
+  // 電波が弱くなると 1 秒ごとに伸ばし、-70 dBm より強くなるまで戻さない
+  replay_host::wifi_rssi = -80;
+  runFor(3500);
+  CHECK_EQ(listening.getChunkMs(), 125u);
+  replay_host::wifi_rssi = -72;
+  runFor(3000);
+  CHECK_EQ(listening.getChunkMs(), 125u);
+  replay_host::wifi_rssi = -50;
+  runFor(6500);
+  CHECK_EQ(listening.getChunkMs(), 20u);
+
+  // ack が 600 ms より遅れると 300 ms ごとに伸ばし、届くようになると戻す
+  acks_held = true;
+  runFor(1500);
+  CHECK_EQ(listening.getChunkMs(), 125u);
+  acks_held = false;
+  runFor(6500);
+  CHECK_EQ(listening.getChunkMs(), 20u);
+
+  // 1 回の write が 15 ms 待たされる回線では 20 ms の DATA を続けられない。40 ms を保ち、
+  // 2 秒ごとに 20 ms を試しても、1 段伸ばせる 300 ms 後には戻す
+  socket.write_delay_us = 15000;
+  std::map<uint32_t, size_t> blocked = chunkMsHistogram(8000);
+  CHECK(blocked[20] <= 16);
+  CHECK(blocked[40] >= 64);
+  CHECK_EQ(blocked[80] + blocked[125], 0u);
+  socket.write_delay_us = 0;
+  runFor(2500);
+  CHECK_EQ(listening.getChunkMs(), 20u);
+
+  // どの切り替えでも録音は欠けず、サーバーには途切れずに届いている
+  serve();
+  CHECK_EQ(received.duplicates, 0u);
+  size_t gaps = 0;
+  bool first = true;
+  int16_t prev = 0;
+  for (const auto &entry : received.data)
+  {
+    for (int16_t v : entry.second)
+    {
+      gaps += !first && v != static_cast<int16_t>(prev + 1) ? 1 : 0;
+      prev = v;
+      first = false;
+    }
+  }
+  CHECK_EQ(gaps, 0u);
+  CHECK_EQ(received.mismatched, 0u);
+  CHECK_EQ(M5.Mic.overrun_samples, 0u);
+  CHECK_EQ(listening.getOverrunSamples(), 0u);
+  CHECK_EQ(host_test::g_logs.errors, 0u);
+}
+
+// 固定の 125 ms と、ストリーミング認識向けに縮めた 20 ms で、1 秒あたりの DATA の数・
+// WebSocket の枠と WsHeader の分のオーバーヘッド・ホストでの loop() の時間を比べる
+void benchmarkChunkModes()
+{
+  struct Mode
+  {
+    const char *name;
+    bool adaptive;
+  };
+  for (const Mode &mode : {Mode{"fixed 125 ms", false}, Mode{"adaptive", true}})
+  {
+    listening.enableAdaptiveChunks(mode.adaptive);
+    restartSession();
+    runFor(7000); // adaptive は 20 ms まで縮みきる
+    serve();
+    received.data_frames = received.data_pcm_bytes = received.data_wire_bytes = 0;
+    const uint32_t kMeasureMs = 10000;
+    auto start = std::chrono::steady_clock::now();
+    runFor(kMeasureMs);
+    serve();
+    double host_ns = static_cast<double>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    double frames = static_cast<double>(received.data_frames);
+    double framing = static_cast<double>(received.data_wire_bytes - received.data_pcm_bytes);
+    printf("  %-12s chunk=%3u ms: %5.1f DATA/s, framing %4.2f%% of %u B/s, host %.1f us per DATA (%.0f us per second)\n",
+           mode.name, static_cast<unsigned>(listening.getChunkMs()), frames * 1000.0 / kMeasureMs,
+           framing * 100.0 / static_cast<double>(received.data_wire_bytes),
+           static_cast<unsigned>(received.data_wire_bytes * 1000 / kMeasureMs), host_ns / frames / 1000.0,
+           host_ns / kMeasureMs);
+  }
+}
+
+// 描画タスク（別コア）が顔を描き続ける間、loop() は描画コマンドを渡すだけで、Listening はマイクを取りこぼさない
+void testDisplayWhileListening()
+{
+  constexpr uint32_t kRunMs = 5000;
+  restartSession();
+  display.init();
+  display_running = true;
+  const uint64_t frames_before = M5.Display.dma_waits;
+  M5.Mic.overrun_samples = 0;
+  runFor(kRunMs);
+  CHECK(sm.isListening());
+
+  // 30 fps（33 ms ごと）で描き、ステートは mailbox 越しに描画タスクへ届いている
+  const uint64_t frames = M5.Display.dma_waits - frames_before;
+  CHECK(frames >= kRunMs / 33 - 1);
+  CHECK(replay_host::gfx_text == "Listening");
+  CHECK(M5.Display.dma_bytes > 0); // まばたきで目の矩形を転送している
+  CHECK_EQ(M5.Mic.overrun_samples, 0u);
+  CHECK_EQ(listening.getOverrunSamples(), 0u);
+
+  const double publish_ns = host_test::nsPerCall(1000000, []() { display.loop(); });
+  printf("  display task: %u frames in %u ms, loop() publish %.1f ns per call\n", static_cast<unsigned>(frames),
+         static_cast<unsigned>(kRunMs), publish_ns);
+  display_running = false;
+  replay_host::stopTasks();
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+  host_test::init(argc, argv);
+  testDropAndResume();
+  testDropDuringFlush();
+  testAdaptiveChunks();
+  benchmarkChunkModes();
+  testDisplayWhileListening();
+  return host_test::finish("listening");
+}
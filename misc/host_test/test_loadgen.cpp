@@ -0,0 +1,515 @@
+// misc/loadgen/stackchan_loadgen.cpp（仮想ロボットの負荷ツール）のテスト
+//  - ツールのソースをそのまま取り込み（main は STACKCHAN_LOADGEN_NO_MAIN で外す）、1 台の Robot を
+//    ループバックの偽のサーバーの相手に実時間で動かす
+//  - 偽のサーバーは stackchan_server と同じ順で応える: WakeWordEvt に StateCmd(Listening)、AudioPcm の END に
+//    StateCmd(Thinking)、少し置いて ServoCmd・ClipCmd・1 セグメントの AudioWav
+//  - ターンの遅延の記録・PCM の量と送る速さ・クレジットの返し方・切断の数え方と再接続を確かめる
+
+#define STACKCHAN_LOADGEN_NO_MAIN
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function" // parseOptions など main() だけが使うもの
+#include "../loadgen/stackchan_loadgen.cpp"
+#pragma GCC diagnostic pop
+
+#include "host_test.hpp"
+
+#include <set>
+
+namespace
+{
+constexpr uint32_t kSpeechMs = 300;
+constexpr uint32_t kTailSilenceMs = 100;
+constexpr uint32_t kChunkMs = 20;
+constexpr uint32_t kReplyDelayMs = 80;    // END から応答の音声までのサーバーの処理時間
+constexpr uint32_t kReplyWavBytes = 3200; // 16 kHz モノラルで 100 ms
+
+// 1 台のロボットの相手をする WebSocket サーバー（サーバーからのフレームはマスクしない）
+class FakeServer
+{
+public:
+  FakeServer()
+  {
+    fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (bind(fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || ::listen(fd_, 4) != 0 ||
+        getsockname(fd_, reinterpret_cast<sockaddr *>(&address), &len) != 0)
+    {
+      perror("fake server");
+    }
+  }
+
+  ~FakeServer()
+  {
+    closeClient();
+    close(fd_);
+  }
+
+  // 相手が切ったときと同じく、接続を閉じる
+  void closeClient()
+  {
+    if (client_ >= 0)
+    {
+      close(client_);
+      client_ = -1;
+    }
+  }
+
+  bool connected() const { return client_ >= 0; }
+
+  void poll(uint64_t now)
+  {
+    if (client_ < 0)
+    {
+      socklen_t len = sizeof(peer);
+      client_ = accept4(fd_, reinterpret_cast<sockaddr *>(&peer), &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (client_ < 0)
+      {
+        return;
+      }
+      accepts++;
+      // 小さなフレームを続けて書くので、Nagle で応答の音声が遅れないようにする
+      int one = 1;
+      setsockopt(client_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      upgraded_ = false;
+      in_.clear();
+    }
+    uint8_t buf[4096];
+    ssize_t got = 0;
+    while ((got = recv(client_, buf, sizeof(buf), 0)) > 0)
+    {
+      in_.insert(in_.end(), buf, buf + got);
+    }
+    if (got == 0)
+    {
+      closeClient();
+      return;
+    }
+    if (!upgraded_)
+    {
+      static const char kEnd[] = "\r\n\r\n";
+      auto it = std::search(in_.begin(), in_.end(), kEnd, kEnd + 4);
+      if (it == in_.end())
+      {
+        return;
+      }
+      request.assign(in_.begin(), it);
+      in_.erase(in_.begin(), it + 4);
+      sendRaw("HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+              "Sec-WebSocket-Accept: x\r\n\r\n");
+      upgraded_ = true;
+    }
+    takeFrames(now);
+    if (reply_at_ms_ != 0 && now >= reply_at_ms_)
+    {
+      reply_at_ms_ = 0;
+      sendReply();
+    }
+  }
+
+  sockaddr_in address{};
+  sockaddr_in peer{};
+  std::string request;
+  size_t accepts = 0;
+  size_t unmasked = 0;
+  std::vector<uint8_t> states;          // StateEvt の値
+  std::vector<size_t> turn_samples;     // AudioPcm の START から END までの PCM の数
+  std::vector<uint32_t> uplink_ms;      // AudioPcm の START から END まで
+  std::set<uint16_t> chunk_bytes;       // DATA の長さ
+  uint32_t credit_bytes = 0;
+  size_t wake_words = 0;
+  size_t servo_done = 0;
+  std::vector<uint8_t> clip_status;
+  size_t speak_done = 0;
+
+private:
+  void sendRaw(const std::string &bytes) { send(client_, bytes.data(), bytes.size(), MSG_NOSIGNAL); }
+
+  void sendPacket(MessageKind kind, MessageType type, uint8_t flags, const std::vector<uint8_t> &body)
+  {
+    WsHeader hdr{};
+    hdr.kind = static_cast<uint8_t>(kind);
+    hdr.messageType = static_cast<uint8_t>(type);
+    hdr.reserved = flags;
+    hdr.seq = seq_++;
+    hdr.payloadBytes = static_cast<uint16_t>(body.size());
+    std::string out;
+    size_t len = sizeof(hdr) + body.size();
+    out.push_back(static_cast<char>(0x82));
+    if (len < 126)
+    {
+      out.push_back(static_cast<char>(len));
+    }
+    else
+    {
+      out.push_back(126);
+      out.push_back(static_cast<char>(len >> 8));
+      out.push_back(static_cast<char>(len));
+    }
+    out.append(reinterpret_cast<const char *>(&hdr), sizeof(hdr));
+    out.append(body.begin(), body.end());
+    sendRaw(out);
+  }
+
+  void sendState(RobotState state)
+  {
+    sendPacket(MessageKind::StateCmd, MessageType::DATA, 0, {static_cast<uint8_t>(state)});
+  }
+
+  void sendReply()
+  {
+    // Sleep 30 ms + MoveX 40 ms
+    sendPacket(MessageKind::ServoCmd, MessageType::DATA, 0, {2, 0, 30, 0, 1, 10, 40, 0});
+    sendPacket(MessageKind::ClipCmd, MessageType::DATA, 0, {1, 2, 3, 4});
+    std::vector<uint8_t> format(6);
+    uint32_t rate = kSampleRate;
+    uint16_t channels = 1;
+    memcpy(format.data(), &rate, sizeof(rate));
+    memcpy(format.data() + sizeof(rate), &channels, sizeof(channels));
+    sendPacket(MessageKind::AudioWav, MessageType::START, 0, format);
+    sendPacket(MessageKind::AudioWav, MessageType::DATA, 0, std::vector<uint8_t>(kReplyWavBytes, 0));
+    sendPacket(MessageKind::AudioWav, MessageType::END, kWsFlagEndOfUtterance, {});
+  }
+
+  // クライアントのフレームはマスクされている。マスクを外して 1 メッセージずつ処理する
+  void takeFrames(uint64_t now)
+  {
+    size_t pos = 0;
+    while (in_.size() - pos >= 2)
+    {
+      const uint8_t *p = in_.data() + pos;
+      bool masked = (p[1] & 0x80) != 0;
+      size_t len = p[1] & 0x7F;
+      size_t header = 2;
+      if (len == 126)
+      {
+        if (in_.size() - pos < 4)
+        {
+          break;
+        }
+        len = (static_cast<size_t>(p[2]) << 8) | p[3];
+        header = 4;
+      }
+      size_t mask_len = masked ? 4 : 0;
+      if (in_.size() - pos < header + mask_len + len)
+      {
+        break;
+      }
+      unmasked += masked ? 0 : 1;
+      std::vector<uint8_t> payload(p + header + mask_len, p + header + mask_len + len);
+      for (size_t i = 0; masked && i < len; ++i)
+      {
+        payload[i] ^= p[header + (i & 3)];
+      }
+      pos += header + mask_len + len;
+      if ((p[0] & 0x0F) == 0x2 && payload.size() >= sizeof(WsHeader))
+      {
+        handleMessage(payload, now);
+      }
+    }
+    in_.erase(in_.begin(), in_.begin() + static_cast<std::ptrdiff_t>(pos));
+  }
+
+  void handleMessage(const std::vector<uint8_t> &payload, uint64_t now)
+  {
+    WsHeader hdr{};
+    memcpy(&hdr, payload.data(), sizeof(hdr));
+    const uint8_t *body = payload.data() + sizeof(hdr);
+    switch (static_cast<MessageKind>(hdr.kind))
+    {
+    case MessageKind::StateEvt:
+      states.push_back(body[0]);
+      break;
+    case MessageKind::WakeWordEvt:
+      wake_words++;
+      sendState(RobotState::Listening);
+      break;
+    case MessageKind::AudioPcm:
+      if (hdr.messageType == static_cast<uint8_t>(MessageType::START))
+      {
+        memcpy(&session_id_, body, sizeof(session_id_));
+        samples_ = 0;
+        uplink_started_ms_ = now;
+      }
+      else if (hdr.messageType == static_cast<uint8_t>(MessageType::DATA))
+      {
+        samples_ += hdr.payloadBytes / sizeof(int16_t);
+        chunk_bytes.insert(hdr.payloadBytes);
+        std::vector<uint8_t> ack(sizeof(session_id_) + sizeof(hdr.seq) + 1);
+        memcpy(ack.data(), &session_id_, sizeof(session_id_));
+        memcpy(ack.data() + sizeof(session_id_), &hdr.seq, sizeof(hdr.seq));
+        ack.back() = kPcmAckFlagStreaming;
+        sendPacket(MessageKind::AudioPcmAck, MessageType::DATA, 0, ack);
+      }
+      else if (hdr.messageType == static_cast<uint8_t>(MessageType::END))
+      {
+        turn_samples.push_back(samples_);
+        uplink_ms.push_back(static_cast<uint32_t>(now - uplink_started_ms_));
+        sendState(RobotState::Thinking);
+        reply_at_ms_ = now + kReplyDelayMs;
+      }
+      break;
+    case MessageKind::AudioCreditEvt:
+    {
+      uint32_t bytes = 0;
+      memcpy(&bytes, body, sizeof(bytes));
+      credit_bytes += bytes;
+      break;
+    }
+    case MessageKind::ServoDoneEvt:
+      servo_done++;
+      break;
+    case MessageKind::ClipEvt:
+      clip_status.push_back(body[0]);
+      break;
+    case MessageKind::SpeakDoneEvt:
+      speak_done++;
+      break;
+    default:
+      break;
+    }
+  }
+
+  int fd_ = -1;
+  int client_ = -1;
+  bool upgraded_ = false;
+  std::vector<uint8_t> in_;
+  uint16_t seq_ = 0;
+  uint32_t session_id_ = 0;
+  size_t samples_ = 0;
+  uint64_t uplink_started_ms_ = 0;
+  uint64_t reply_at_ms_ = 0;
+};
+
+Options testOptions(const FakeServer &server)
+{
+  Options opt;
+  opt.port = ntohs(server.address.sin_port);
+  opt.synthetic_ms = kSpeechMs;
+  opt.tail_silence_ms = kTailSilenceMs;
+  opt.chunk_ms = kChunkMs;
+  opt.think_ms = 100;
+  opt.turn_timeout_ms = 5000;
+  return opt;
+}
+
+// main() と同じく epoll で Robot を回し、合間にサーバーを動かす。done() が成り立てば true
+template <typename F>
+bool runUntil(Robot &robot, FakeServer &server, int epfd, uint32_t timeout_ms, F &&done)
+{
+  uint64_t until = nowMs() + timeout_ms;
+  std::array<epoll_event, 8> events{};
+  while (nowMs() < until)
+  {
+    int n = epoll_wait(epfd, events.data(), static_cast<int>(events.size()), 2);
+    uint64_t now = nowMs();
+    for (int i = 0; i < n; ++i)
+    {
+      static_cast<Robot *>(events[i].data.ptr)->onEvent(events[i].events, now, epfd);
+    }
+    robot.tick(now, epfd);
+    server.poll(now);
+    if (done())
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+void testPercentiles()
+{
+  std::vector<uint32_t> values;
+  for (uint32_t v = 100; v >= 1; --v)
+  {
+    values.push_back(v);
+  }
+  Percentiles p = percentiles(values);
+  CHECK_EQ(p.count, 100u);
+  CHECK_EQ(p.p50, 50u);
+  CHECK_EQ(p.p90, 90u);
+  CHECK_EQ(p.p99, 99u);
+  CHECK_EQ(p.max, 100u);
+
+  p = percentiles({7});
+  CHECK(p.count == 1 && p.p50 == 7 && p.p99 == 7 && p.max == 7);
+  CHECK_EQ(percentiles({}).count, 0u);
+}
+
+// 8 kHz ステレオの WAV は左だけを取り、16 kHz に線形補間する
+void testLoadWav()
+{
+  const uint32_t kRate = 8000;
+  const uint16_t kChannels = 2;
+  const size_t kFrames = 800;
+  std::vector<uint8_t> wav;
+  auto put = [&](const void *data, size_t len) {
+    wav.insert(wav.end(), static_cast<const uint8_t *>(data), static_cast<const uint8_t *>(data) + len);
+  };
+  auto put16 = [&](uint16_t v) { put(&v, sizeof(v)); };
+  auto put32 = [&](uint32_t v) { put(&v, sizeof(v)); };
+  put("RIFF", 4);
+  put32(static_cast<uint32_t>(36 + kFrames * kChannels * 2));
+  put("WAVE", 4);
+  put("fmt ", 4);
+  put32(16);
+  put16(1);
+  put16(kChannels);
+  put32(kRate);
+  put32(kRate * kChannels * 2);
+  put16(kChannels * 2);
+  put16(16);
+  put("data", 4);
+  put32(static_cast<uint32_t>(kFrames * kChannels * 2));
+  for (size_t i = 0; i < kFrames; ++i)
+  {
+    put16(static_cast<uint16_t>(static_cast<int16_t>(i * 10)));
+    put16(static_cast<uint16_t>(-1));
+  }
+
+  char path[] = "/tmp/test_loadgen_XXXXXX";
+  int fd = mkstemp(path);
+  CHECK(fd >= 0 && write(fd, wav.data(), wav.size()) == static_cast<ssize_t>(wav.size()));
+  close(fd);
+  Utterance u;
+  CHECK(loadWav(path, u));
+  CHECK_EQ(u.size(), kFrames * 2);
+  size_t wrong = 0;
+  for (size_t i = 0; i + 2 < u.size(); ++i)
+  {
+    wrong += u[i] != static_cast<int16_t>(i * 5) ? 1 : 0;
+  }
+  CHECK_EQ(wrong, 0u);
+
+  // 8 bit の WAV は受け付けない
+  wav[34] = 8;
+  fd = open(path, O_WRONLY | O_TRUNC);
+  CHECK(fd >= 0 && write(fd, wav.data(), wav.size()) == static_cast<ssize_t>(wav.size()));
+  close(fd);
+  // 理由を stderr に出すのは正しい動きなので、--verbose でなければ隠す
+  int saved_stderr = dup(STDERR_FILENO);
+  int null_fd = open("/dev/null", O_WRONLY);
+  if (!host_test::g_verbose)
+  {
+    dup2(null_fd, STDERR_FILENO);
+  }
+  CHECK(!loadWav(path, u));
+  dup2(saved_stderr, STDERR_FILENO);
+  close(saved_stderr);
+  close(null_fd);
+  unlink(path);
+}
+
+// 3 ターン続けて、ファームウェアと同じ順・同じ量で送受信する
+void testTurns()
+{
+  g_stats = {};
+  FakeServer server;
+  Options opt = testOptions(server);
+  std::vector<Utterance> utterances = {syntheticUtterance(opt.synthetic_ms)};
+  int epfd = epoll_create1(EPOLL_CLOEXEC);
+  Robot robot(0, opt, utterances, server.address);
+  robot.start(nowMs());
+  CHECK(runUntil(robot, server, epfd, 10000, [&]() { return server.speak_done >= 3; }));
+
+  // ロボットごとに別の送信元アドレス（サーバーは接続元 IP ごとに 1 台として扱う）
+  CHECK_EQ(ntohl(server.peer.sin_addr.s_addr), 0x7F010001u);
+  CHECK(server.request.compare(0, 27, "GET /ws/stackchan HTTP/1.1\r") == 0);
+  CHECK_EQ(server.accepts, 1u);
+  CHECK_EQ(server.unmasked, 0u);
+
+  // 発話と無音を、chunk_ms ごとの DATA で録音と同じ速さで送る
+  CHECK_EQ(server.wake_words, 3u);
+  CHECK_EQ(server.turn_samples.size(), 3u);
+  for (size_t samples : server.turn_samples)
+  {
+    CHECK_EQ(samples, static_cast<size_t>(kSampleRate) * (kSpeechMs + kTailSilenceMs) / 1000);
+  }
+  CHECK(server.chunk_bytes == std::set<uint16_t>{static_cast<uint16_t>(kSampleRate * kChunkMs / 1000 * sizeof(int16_t))});
+  for (uint32_t ms : server.uplink_ms)
+  {
+    CHECK(ms >= kSpeechMs + kTailSilenceMs - kChunkMs && ms <= kSpeechMs + kTailSilenceMs + 50);
+  }
+
+  // 状態通知はファームウェアの遷移と同じ順（END を送ると Idle に戻ってから Thinking を受ける）
+  const std::vector<uint8_t> kTurn = {1, 0, 2, 3, 0};
+  std::vector<uint8_t> expected = {0};
+  for (int i = 0; i < 3; ++i)
+  {
+    expected.insert(expected.end(), kTurn.begin(), kTurn.end());
+  }
+  CHECK(server.states == expected);
+
+
+  // 最初に再生バッファ分、あとは再生し終えた分のクレジットを返す
+  CHECK_EQ(server.credit_bytes, kInitialCreditBytes + 3 * kReplyWavBytes);
+  CHECK_EQ(server.servo_done, 3u);
+  CHECK(server.clip_status == std::vector<uint8_t>(3, static_cast<uint8_t>(ClipStatus::Miss)));
+  CHECK_EQ(g_stats.rx_frames_by_kind[static_cast<uint8_t>(MessageKind::AudioWav)], 9u);
+
+  // 遅延: END から音声までがサーバーの処理時間、ターンはそれに録音と再生の時間を足したもの
+  CHECK_EQ(robot.response_ms.size(), 3u);
+  for (uint32_t ms : robot.response_ms)
+  {
+    CHECK(ms >= kReplyDelayMs && ms <= kReplyDelayMs + 50);
+  }
+  const uint32_t kPlayMs = kReplyWavBytes * 1000 / (kSampleRate * sizeof(int16_t));
+  CHECK_EQ(robot.turn_ms.size(), 3u);
+  for (uint32_t ms : robot.turn_ms)
+  {
+    uint32_t floor_ms = kSpeechMs + kTailSilenceMs - kChunkMs + kReplyDelayMs + kPlayMs;
+    CHECK(ms >= floor_ms && ms <= floor_ms + 150);
+  }
+  CHECK_EQ(robot.turns_started, 3u);
+  CHECK_EQ(robot.turns_timed_out + robot.turns_without_reply + robot.turns_dropped + robot.dropped_sessions, 0u);
+  if (host_test::g_verbose)
+  {
+    Percentiles turn = percentiles(robot.turn_ms);
+    printf("  turn ms p50=%u max=%u, %llu frames from the server\n", turn.p50, turn.max,
+           static_cast<unsigned long long>(g_stats.rx_frames));
+  }
+  robot.shutdown();
+  close(epfd);
+}
+
+// 送信中に切られたターンを切断として数え、kReconnectMs 後につなぎ直して続ける
+void testDropAndReconnect()
+{
+  FakeServer server;
+  Options opt = testOptions(server);
+  std::vector<Utterance> utterances = {syntheticUtterance(opt.synthetic_ms)};
+  int epfd = epoll_create1(EPOLL_CLOEXEC);
+  Robot robot(1, opt, utterances, server.address);
+  robot.start(nowMs());
+  CHECK(runUntil(robot, server, epfd, 5000, [&]() { return server.chunk_bytes.size() > 0; }));
+  CHECK_EQ(ntohl(server.peer.sin_addr.s_addr), 0x7F010002u);
+  server.closeClient();
+  uint64_t dropped_at = nowMs();
+  CHECK(runUntil(robot, server, epfd, 5000, [&]() { return server.connected(); }));
+  CHECK(nowMs() - dropped_at >= kReconnectMs);
+  CHECK_EQ(robot.dropped_sessions, 1u);
+  CHECK_EQ(robot.turns_dropped, 1u);
+
+  CHECK(runUntil(robot, server, epfd, 5000, [&]() { return server.speak_done >= 1; }));
+  CHECK_EQ(server.accepts, 2u);
+  CHECK_EQ(robot.turn_ms.size(), 1u);
+  CHECK_EQ(robot.turns_started, 2u);
+  robot.shutdown();
+  close(epfd);
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+  host_test::init(argc, argv);
+  signal(SIGPIPE, SIG_IGN);
+  testPercentiles();
+  testLoadWav();
+  testTurns();
+  testDropAndReconnect();
+  return host_test::finish("loadgen");
+}
@@ -0,0 +1,163 @@
+// LogMelExtractor（AudioLogMel の対数メル）とサーバーの参照実装の突き合わせ
+//  - 同じ PCM をサーバーの reference_log_mel（float64）に通した出力（log_mel_golden.hpp）と比べ、
+//    float の丸めで量子化の境目をまたいだ値だけが 1 ずれることを許す
+//  - push の区切り方（DMA の読み出し単位）によらず同じフレームが出る
+//  - 無音は 0、フルスケールでも 255 に収まる
+
+#include "host_test.hpp"
+#include "log_mel.hpp"
+#include "log_mel_golden.hpp"
+
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+constexpr int kSampleRate = 16000;
+constexpr size_t kSilenceSamples = 1600;
+constexpr size_t kToneSamples = 8000;
+constexpr size_t kGoldenFrames = sizeof(kLogMelGolden) / LogMelExtractor::kFrameBytes;
+
+int32_t triangle(uint32_t n, int32_t period, int32_t amplitude)
+{
+  int32_t phase = static_cast<int32_t>(n % static_cast<uint32_t>(period));
+  int32_t half = period / 2;
+  int32_t rising = phase < half ? phase : period - phase;
+  return (4 * amplitude * rising) / period - amplitude;
+}
+
+// gen_log_mel_golden.py の test_pcm() と同じ（両方を同時に直すこと）
+std::vector<int16_t> testPcm()
+{
+  std::vector<int16_t> samples(kSilenceSamples, 0);
+  uint32_t state = 12345;
+  for (uint32_t n = 0; n < 2 * kToneSamples; ++n)
+  {
+    state = (state * 1103515245u + 12345u) & 0x7FFFFFFFu;
+    int32_t noise = static_cast<int32_t>((state >> 16) & 0x7FFF) - 16384;
+    int32_t v = n < kToneSamples ? triangle(n, 36, 6000) + (noise >> 5) : triangle(n, 9, 3000) + (noise >> 3);
+    samples.push_back(static_cast<int16_t>(v));
+  }
+  return samples;
+}
+
+std::vector<uint8_t> extract(const std::vector<int16_t> &pcm, const std::vector<size_t> &chunks)
+{
+  LogMelExtractor mel;
+  mel.init(kSampleRate);
+  mel.reset();
+  std::vector<uint8_t> out;
+  size_t pos = 0;
+  for (size_t i = 0; pos < pcm.size(); ++i)
+  {
+    size_t n = std::min(chunks[i % chunks.size()], pcm.size() - pos);
+    size_t max_frames = n / LogMelExtractor::kHopSamples + 1;
+    std::vector<uint8_t> frames(max_frames * LogMelExtractor::kFrameBytes);
+    size_t got = mel.push(pcm.data() + pos, n, frames.data(), max_frames);
+    out.insert(out.end(), frames.begin(), frames.begin() + got * LogMelExtractor::kFrameBytes);
+    pos += n;
+  }
+  return out;
+}
+
+void testMatchesServerReference()
+{
+  std::vector<int16_t> pcm = testPcm();
+  std::vector<uint8_t> out = extract(pcm, {pcm.size()});
+  CHECK_EQ(out.size(), sizeof(kLogMelGolden));
+  CHECK_EQ(kGoldenFrames, (pcm.size() - LogMelExtractor::kWindowSamples) / LogMelExtractor::kHopSamples + 1);
+
+  size_t off_by_one = 0;
+  int max_diff = 0;
+  for (size_t i = 0; i < std::min(out.size(), sizeof(kLogMelGolden)); ++i)
+  {
+    int diff = std::abs(static_cast<int>(out[i]) - static_cast<int>(kLogMelGolden[i]));
+    max_diff = std::max(max_diff, diff);
+    off_by_one += diff == 1 ? 1 : 0;
+  }
+  CHECK(max_diff <= 1);
+  // 1 ずれるのは 4 * log2 の値が x.5 付近のものだけ
+  CHECK(off_by_one * 100 < sizeof(kLogMelGolden));
+
+  // 無音の区間は 0、音のある区間はどのバンドにも値が入る
+  size_t silent_frames = (kSilenceSamples - LogMelExtractor::kWindowSamples) / LogMelExtractor::kHopSamples + 1;
+  size_t nonzero_in_silence = 0;
+  size_t zero_in_tone = 0;
+  for (size_t f = 0; f < std::min(out.size() / LogMelExtractor::kFrameBytes, kGoldenFrames); ++f)
+  {
+    for (size_t b = 0; b < LogMelExtractor::kBands; ++b)
+    {
+      uint8_t v = out[f * LogMelExtractor::kFrameBytes + b];
+      if (f < silent_frames)
+      {
+        nonzero_in_silence += v != 0 ? 1 : 0;
+      }
+      else if (f * LogMelExtractor::kHopSamples >= kSilenceSamples)
+      {
+        zero_in_tone += v == 0 ? 1 : 0;
+      }
+    }
+  }
+  CHECK_EQ(nonzero_in_silence, 0u);
+  CHECK_EQ(zero_in_tone, 0u);
+  if (host_test::g_verbose)
+  {
+    printf("  %u frames: max diff %d, %u of %u values off by one\n", static_cast<unsigned>(kGoldenFrames), max_diff,
+           static_cast<unsigned>(off_by_one), static_cast<unsigned>(sizeof(kLogMelGolden)));
+  }
+}
+
+// 1 回に入れるサンプル数を変えても、出るフレームは同じ
+void testChunking()
+{
+  std::vector<int16_t> pcm = testPcm();
+  std::vector<uint8_t> whole = extract(pcm, {pcm.size()});
+  for (const std::vector<size_t> &chunks : std::vector<std::vector<size_t>>{{1}, {160}, {256}, {399, 1, 7}, {1024, 3}})
+  {
+    CHECK(extract(pcm, chunks) == whole);
+  }
+}
+
+// フルスケールの矩形波でも 255 で頭打ちにし、折り返さない
+void testFullScale()
+{
+  std::vector<int16_t> pcm(kSampleRate / 4);
+  for (size_t i = 0; i < pcm.size(); ++i)
+  {
+    pcm[i] = (i / 8) % 2 == 0 ? INT16_MAX : INT16_MIN;
+  }
+  std::vector<uint8_t> out = extract(pcm, {256});
+  uint8_t peak = 0;
+  for (uint8_t v : out)
+  {
+    peak = std::max(peak, v);
+  }
+  // 1 kHz のフルスケールのパワーは 4 * log2 で約 4 * 38
+  CHECK(peak > 140);
+  CHECK(peak <= 255);
+}
+
+void benchmarkFrame()
+{
+  std::vector<int16_t> pcm = testPcm();
+  LogMelExtractor mel;
+  mel.init(kSampleRate);
+  uint8_t frame[LogMelExtractor::kFrameBytes];
+  size_t pos = kSilenceSamples;
+  const double hop_ns = host_test::nsPerCall(20000, [&]() {
+    mel.push(pcm.data() + pos, LogMelExtractor::kHopSamples, frame, 1);
+    pos = pos + 2 * LogMelExtractor::kHopSamples < pcm.size() ? pos + LogMelExtractor::kHopSamples : kSilenceSamples;
+  });
+  printf("  push: %.0f ns per frame (10 ms hop)\n", hop_ns);
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+  host_test::init(argc, argv);
+  testMatchesServerReference();
+  testChunking();
+  testFullScale();
+  benchmarkFrame();
+  return host_test::finish("log_mel");
+}
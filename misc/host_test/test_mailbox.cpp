@@ -0,0 +1,147 @@
+// Mailbox（表示タスクへの描画コマンドの受け渡し）のテスト
+//  - 1 スレッド: 新しい値が無ければ受け取らない。溜まったときは最新の 1 件だけを受け取る
+//  - 2 スレッド: 受け取る値は欠けずに（書きかけが混ざらずに）、公開した順に新しくなる
+//  - producer（端末では loop() の音声処理）が consumer の描画の長さに関わらず待たないこと
+
+#include "host_test.hpp"
+#include "mailbox.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace
+{
+// 書きかけの値を見分けられるよう、全フィールドに同じ番号を入れる
+struct Payload
+{
+  uint32_t seq = 0;
+  std::array<uint32_t, 15> copies{};
+
+  static Payload make(uint32_t seq)
+  {
+    Payload p;
+    p.seq = seq;
+    p.copies.fill(seq);
+    return p;
+  }
+  bool consistent() const
+  {
+    return std::all_of(copies.begin(), copies.end(), [&](uint32_t v) { return v == seq; });
+  }
+};
+
+void testLatestValue()
+{
+  Mailbox<Payload> box;
+  Payload out;
+  CHECK(!box.consume(out));
+
+  box.publish(Payload::make(1));
+  CHECK(box.consume(out));
+  CHECK_EQ(out.seq, 1u);
+  CHECK(!box.consume(out));
+  CHECK_EQ(out.seq, 1u); // 受け取らなければ out は変えない
+
+  for (uint32_t seq = 2; seq <= 10; ++seq)
+  {
+    box.publish(Payload::make(seq));
+  }
+  CHECK(box.consume(out));
+  CHECK_EQ(out.seq, 10u);
+  CHECK(out.consistent());
+  CHECK(!box.consume(out));
+
+  // 取り出しと公開が交互でも、スロットを取り違えない
+  for (uint32_t seq = 11; seq <= 1000; ++seq)
+  {
+    box.publish(Payload::make(seq));
+    if (seq % 3 == 0)
+    {
+      box.publish(Payload::make(++seq));
+    }
+    CHECK(box.consume(out));
+    CHECK_EQ(out.seq, seq);
+  }
+}
+
+void testConcurrentOrdering()
+{
+  constexpr uint32_t kCount = 2000000;
+  Mailbox<Payload> box;
+  std::atomic<bool> done{false};
+
+  std::thread producer([&]() {
+    for (uint32_t seq = 1; seq <= kCount; ++seq)
+    {
+      box.publish(Payload::make(seq));
+      if (seq % 64 == 0)
+      {
+        std::this_thread::yield(); // 1 コアのホストでも consumer と入れ違いになるようにする
+      }
+    }
+    done.store(true);
+  });
+
+  uint32_t last = 0;
+  uint32_t received = 0;
+  uint32_t torn = 0;
+  uint32_t out_of_order = 0;
+  Payload out;
+  while (true)
+  {
+    const bool finished = done.load();
+    while (box.consume(out))
+    {
+      received++;
+      torn += out.consistent() ? 0 : 1;
+      out_of_order += out.seq > last ? 0 : 1;
+      last = out.seq;
+    }
+    if (finished)
+    {
+      break;
+    }
+    std::this_thread::yield();
+  }
+  producer.join();
+
+  CHECK_EQ(torn, 0u);
+  CHECK_EQ(out_of_order, 0u);
+  CHECK_EQ(last, kCount); // 最後の値は必ず届く
+  CHECK(received > 0);
+  printf("  concurrent: %u published, %u received in order\n", kCount, received);
+}
+
+// consumer が 1 フレームの描画（ここでは 5 ms 眠る）をしている間も、producer は待たない
+void testProducerNeverWaits()
+{
+  Mailbox<Payload> box;
+  std::atomic<bool> stop{false};
+  std::thread consumer([&]() {
+    Payload out;
+    while (!stop.load())
+    {
+      box.consume(out);
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+  });
+
+  uint32_t seq = 0;
+  const double publish_ns = host_test::nsPerCall(2000000, [&]() { box.publish(Payload::make(++seq)); });
+  stop.store(true);
+  consumer.join();
+  // ロックを取らないので、数 µs もかからない（描画を待てば 5 ms になる）
+  CHECK(publish_ns < 1000.0);
+  printf("  publish while the consumer renders: %.1f ns per call\n", publish_ns);
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+  host_test::init(argc, argv);
+  testLatestValue();
+  testConcurrentOrdering();
+  testProducerNeverWaits();
+  return host_test::finish("mailbox");
+}
@@ -0,0 +1,112 @@
+// PowerManager（Idle 中の省電力）のテスト
+//  - esp_pm のロック・WiFi.setSleep・バックライトは misc/replay/host の模型で見る
+//  - Idle で省電力になり、30 秒で減光する
+//  - ウェイクワードで最大クロックに戻したあとは減光せず、Listening が来なければ 5 秒で省電力に戻る
+//  - Idle の間に省電力でいた割合をログに出す
+
+#include "host_test.hpp"
+#include "power.hpp"
+
+#include <M5Unified.h>
+#include <WiFi.h>
+
+namespace
+{
+constexpr uint8_t kBrightness = 100;
+
+PowerManager power;
+
+void runFor(uint32_t ms)
+{
+  for (uint32_t t = 0; t < ms; t += 10)
+  {
+    replay_host::now_us += 10000;
+    power.loop(millis());
+  }
+}
+
+bool isActive()
+{
+  return getCpuFrequencyMhz() == 240 && replay_host::wifi_sleep == WIFI_PS_NONE;
+}
+
+bool isLowPower()
+{
+  return getCpuFrequencyMhz() == 160 && replay_host::wifi_sleep == WIFI_PS_MIN_MODEM;
+}
+
+void testIdleAndDim()
+{
+  replay_host::now_us = 1000000;
+  M5.Display.setBrightness(kBrightness);
+  power.init();
+  CHECK(isActive());
+
+  power.enterIdle();
+  CHECK(isLowPower());
+  runFor(29000);
+  CHECK_EQ(M5.Display.getBrightness(), kBrightness);
+  runFor(1000);
+  CHECK(M5.Display.getBrightness() < kBrightness);
+
+  power.exitIdle();
+  CHECK(isActive());
+  CHECK_EQ(M5.Display.getBrightness(), kBrightness);
+  CHECK_EQ(replay_host::pm_cpu_lock.held, 1);
+}
+
+// ウェイクワードのあと Listening が来れば、そのまま最大クロックで Idle を出る
+void testWakeThenListening()
+{
+  power.enterIdle();
+  runFor(31000);
+  host_test::g_logs = {};
+  power.resumeFromWakeWord(micros());
+  CHECK(isActive());
+  CHECK_EQ(M5.Display.getBrightness(), kBrightness);
+  // 次の loop() で減光し直さない
+  runFor(1000);
+  CHECK_EQ(M5.Display.getBrightness(), kBrightness);
+  CHECK(isActive());
+
+  power.exitIdle();
+  power.markUplinkStarted();
+  CHECK(isActive());
+  CHECK_EQ(replay_host::pm_cpu_lock.held, 1);
+  CHECK_EQ(host_test::g_logs.warnings, 0u);
+}
+
+// 誤検出などで Listening が来なければ、5 秒で省電力に戻し、減光はそこから 30 秒後
+void testWakeWithoutListening()
+{
+  power.enterIdle();
+  runFor(10000);
+  host_test::g_logs = {};
+  power.resumeFromWakeWord(micros());
+  runFor(4900);
+  CHECK(isActive());
+  runFor(200);
+  CHECK(isLowPower());
+  CHECK_EQ(replay_host::pm_cpu_lock.held, 0);
+  CHECK_EQ(host_test::g_logs.warnings, 1u);
+  runFor(29000);
+  CHECK_EQ(M5.Display.getBrightness(), kBrightness);
+  runFor(1000);
+  CHECK(M5.Display.getBrightness() < kBrightness);
+
+  // 2 回目のウェイクワードでも同じように戻る
+  power.resumeFromWakeWord(micros());
+  CHECK(isActive());
+  power.exitIdle();
+  CHECK_EQ(replay_host::pm_cpu_lock.held, 1);
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+  host_test::init(argc, argv);
+  testIdleAndDim();
+  testWakeThenListening();
+  testWakeWithoutListening();
+  return host_test::finish("power");
+}
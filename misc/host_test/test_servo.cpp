@@ -0,0 +1,91 @@
+// BodyServo のシーケンスと ServoDoneEvt（completion callback）のテスト
+//  - サーバーは ServoCmd 1 つにつき ServoDoneEvt 1 つを数えて待つ
+//  - 最後まで動いたシーケンスも、次の ServoCmd や端末内の首振りで置き換えられたシーケンスも 1 回ずつ通知する
+//  - 端末内の首振り（notify_done=false）は、完了しても置き換えられても通知しない
+
+#include "host_test.hpp"
+#include "servo.hpp"
+
+#include <M5Unified.h>
+
+namespace
+{
+constexpr uint8_t kMoveX = static_cast<uint8_t>(ServoCommandOp::MoveX);
+constexpr uint8_t kSleep = static_cast<uint8_t>(ServoCommandOp::Sleep);
+
+// 200 ms かかる 1 ステップのシーケンス（首の角度によらず同じ長さ）
+constexpr uint8_t kSequence[] = {1, kSleep, 0xC8, 0x00};
+
+BodyServo servo;
+int done = 0;
+
+void runMs(uint32_t ms)
+{
+  for (uint32_t i = 0; i < ms; ++i)
+  {
+    servo.loop();
+    replay_host::now_us += 1000;
+  }
+}
+
+void testCompletion()
+{
+  done = 0;
+  CHECK(servo.enqueueSequence(kSequence, sizeof(kSequence)));
+  CHECK(servo.isBusy());
+  runMs(300);
+  CHECK(!servo.isBusy());
+  CHECK_EQ(done, 1);
+
+  // 空のシーケンスはその場で完了
+  const uint8_t empty[] = {0};
+  CHECK(servo.enqueueSequence(empty, sizeof(empty)));
+  CHECK_EQ(done, 2);
+}
+
+void testReplaced()
+{
+  done = 0;
+  // ServoCmd を ServoCmd で置き換える: 置き換えた時点と、後のシーケンスの完了で 1 回ずつ
+  CHECK(servo.enqueueSequence(kSequence, sizeof(kSequence)));
+  runMs(50);
+  CHECK(servo.enqueueSequence(kSequence, sizeof(kSequence)));
+  CHECK_EQ(done, 1);
+  runMs(300);
+  CHECK_EQ(done, 2);
+
+  // ServoCmd を端末内の首振りで置き換える: 置き換えた ServoCmd の分だけ
+  CHECK(servo.enqueueSequence(kSequence, sizeof(kSequence)));
+  runMs(50);
+  CHECK(servo.enqueueSequence(kSequence, sizeof(kSequence), false));
+  CHECK_EQ(done, 3);
+  runMs(300);
+  CHECK_EQ(done, 3);
+
+  // 端末内の首振りを打ち切っても通知しない
+  CHECK(servo.enqueueSequence(kSequence, sizeof(kSequence), false));
+  runMs(50);
+  servo.resetSequence();
+  CHECK_EQ(done, 3);
+
+  // 形式の誤った ServoCmd は受け付けず、動作中のシーケンスもそのまま
+  CHECK(servo.enqueueSequence(kSequence, sizeof(kSequence)));
+  const uint8_t truncated[] = {2, kMoveX, 90, 0x10};
+  CHECK(!servo.enqueueSequence(truncated, sizeof(truncated)));
+  CHECK(servo.isBusy());
+  CHECK_EQ(done, 3);
+  runMs(300);
+  CHECK_EQ(done, 4);
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+  host_test::init(argc, argv);
+  replay_host::now_us = 1000000;
+  servo.init();
+  servo.setCompletionCallback([]() { done++; });
+  testCompletion();
+  testReplaced();
+  return host_test::finish("servo");
+}
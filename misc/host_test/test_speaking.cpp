@@ -0,0 +1,481 @@
+// Speaking（TTS の受信と再生）のテスト
+//  - サーバー側は speak.py と同じ形（2 秒ごとの START/DATA.../END、DATA は 4096 バイト、最後の END に発話終了フラグ）で送る
+//  - 再生はスピーカーの模型（misc/replay/host の M5Unified.h）が積まれた音と鳴り始めの時刻を残すので、
+//    つなげた出力の継ぎ目の無音（gap）と、元の PCM との違いを調べる
+//  - クレジットで送る場合は、セグメントが途切れずにつながり、完了（SpeakDoneEvt）が最後に 1 回だけ来る
+//  - セグメントが遅れて無音が挟まっても、完了を早まらず、再開の頭はフェードインする
+//  - DATA が欠けても再生位置はずれず（補間で埋める）、継ぎ目に大きな段差（クリック）が出ない。END が欠けても鳴らし切る
+//  - 枠が足りずにセグメントを捨てたら、その前後（続きでない継ぎ目）だけをフェードする
+
+#include "host_test.hpp"
+#include "memory_plan.hpp"
+#include "speaking.hpp"
+#include "state_machine.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+constexpr uint32_t kSampleRate = 24000;
+constexpr size_t kChunkBytes = 4096;
+constexpr size_t kSegmentBytes = kSampleRate * sizeof(int16_t) * 2; // 2 秒
+constexpr uint32_t kDownlinkBudgetBytes = 192 * 1024;                // speaking.cpp の初期クレジット
+
+constexpr memory_plan::Budget kPlan[] = {
+    {memory_plan::Module::Speaking, memory_plan::Region::Psram, Speaking::kPsramBytes},
+};
+
+StateMachine sm;
+Speaking speaking(sm);
+int finished = 0;
+uint64_t finished_us = 0;
+uint64_t credit = 0;
+bool credits_enabled = false;
+
+// 継ぎ目の連続性を測れるよう、なめらかな音（約 440 Hz。セグメントの境目がゼロ交差にならない周波数）
+std::vector<int16_t> tone(size_t samples)
+{
+  std::vector<int16_t> out(samples);
+  for (size_t i = 0; i < samples; ++i)
+  {
+    out[i] = static_cast<int16_t>(8000.0 * std::sin(2.0 * M_PI * 440.1 * static_cast<double>(i) / kSampleRate));
+  }
+  return out;
+}
+
+// サーバーが送る 1 メッセージ
+struct Frame
+{
+  WsHeader hdr{};
+  std::vector<uint8_t> body;
+  size_t segment = 0;
+};
+
+// speak.py の _send_segments / _send_segment と同じ並び
+std::vector<Frame> buildFrames(const std::vector<int16_t> &pcm)
+{
+  std::vector<Frame> frames;
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(pcm.data());
+  const size_t total = pcm.size() * sizeof(int16_t);
+  uint16_t seq = 0;
+  size_t segment = 0;
+  for (size_t offset = 0; offset < total; offset += kSegmentBytes, ++segment)
+  {
+    Frame start;
+    start.hdr.kind = static_cast<uint8_t>(MessageKind::AudioWav);
+    start.hdr.messageType = static_cast<uint8_t>(MessageType::START);
+    start.hdr.seq = seq++;
+    start.body.resize(6);
+    uint32_t rate = kSampleRate;
+    uint16_t channels = 1;
+    memcpy(start.body.data(), &rate, sizeof(rate));
+    memcpy(start.body.data() + sizeof(rate), &channels, sizeof(channels));
+    start.hdr.payloadBytes = static_cast<uint16_t>(start.body.size());
+    start.segment = segment;
+    frames.push_back(start);
+
+    size_t end = std::min(total, offset + kSegmentBytes);
+    for (size_t pos = offset; pos < end; pos += kChunkBytes)
+    {
+      Frame data;
+      data.hdr.kind = static_cast<uint8_t>(MessageKind::AudioWav);
+      data.hdr.messageType = static_cast<uint8_t>(MessageType::DATA);
+      data.hdr.seq = seq++;
+      data.body.assign(bytes + pos, bytes + std::min(end, pos + kChunkBytes));
+      data.hdr.payloadBytes = static_cast<uint16_t>(data.body.size());
+      data.segment = segment;
+      frames.push_back(data);
+    }
+
+    Frame fin;
+    fin.hdr.kind = static_cast<uint8_t>(MessageKind::AudioWav);
+    fin.hdr.messageType = static_cast<uint8_t>(MessageType::END);
+    fin.hdr.seq = seq++;
+    fin.hdr.reserved = end == total ? kWsFlagEndOfUtterance : 0;
+    fin.segment = segment;
+    frames.push_back(fin);
+  }
+  return frames;
+}
+
+// 隣り合うサンプルの差の最大。440 Hz・振幅 8000 の正弦波では約 920
+int maxStep(const std::vector<int16_t> &samples)
+{
+  int step = 0;
+  for (size_t i = 1; i < samples.size(); ++i)
+  {
+    step = std::max(step, std::abs(samples[i] - samples[i - 1]));
+  }
+  return step;
+}
+
+// main.cpp と同じく、受け取れる DATA は reserveWavPayload の領域へ直接読み込む
+void deliver(const Frame &f)
+{
+  uint8_t *dst = speaking.reserveWavPayload(f.hdr);
+  if (dst != nullptr)
+  {
+    memcpy(dst, f.body.data(), f.body.size());
+    speaking.handleWavMessage(f.hdr, dst, f.body.size());
+  }
+  else
+  {
+    speaking.handleWavMessage(f.hdr, f.body.data(), f.body.size());
+  }
+}
+
+// セグメントの領域は最初の init() で切り出したものを使い続ける（memory_plan は main で 1 回だけ初期化する）
+void setUp()
+{
+  replay_host::now_us = 1000000;
+  M5.Speaker.stop();
+  M5.Speaker.record_output = true;
+  M5.Speaker.played.clear();
+  finished = 0;
+  credit = 0;
+  credits_enabled = false;
+
+  speaking.init();
+  speaking.setSpeakFinishedCallback([]() {
+    finished++;
+    finished_us = replay_host::now_us;
+  });
+  speaking.setCreditCallback([](uint32_t bytes) { credit += bytes; });
+  sm = StateMachine{};
+  sm.addStateEntryEvent(StateMachine::Speaking, [](StateMachine::State, StateMachine::State) { speaking.begin(); });
+  sm.addStateExitEvent(StateMachine::Speaking, [](StateMachine::State, StateMachine::State) { speaking.end(); });
+  sm.dispatch(StateMachine::Event::Connected);
+}
+
+// release_ms[segment] までは、そのセグメントを送らない（合成や回線の遅れ）。
+// credits_enabled なら DATA はクレジットの範囲で送る（AudioCreditEvt を受けたサーバー）
+void run(const std::vector<Frame> &frames, const std::vector<uint32_t> &release_ms, uint32_t total_ms)
+{
+  uint64_t base_us = replay_host::now_us;
+  size_t next = 0;
+  for (uint32_t ms = 0; ms < total_ms; ++ms)
+  {
+    while (next < frames.size())
+    {
+      const Frame &f = frames[next];
+      if (f.segment < release_ms.size() && ms < release_ms[f.segment])
+      {
+        break;
+      }
+      if (credits_enabled && f.hdr.messageType == static_cast<uint8_t>(MessageType::DATA))
+      {
+        if (credit < f.body.size())
+        {
+          break;
+        }
+        credit -= f.body.size();
+      }
+      deliver(f);
+      next++;
+    }
+    speaking.loop();
+    replay_host::now_us = base_us + static_cast<uint64_t>(ms + 1) * 1000;
+  }
+  CHECK_EQ(next, frames.size());
+}
+
+// チャンネル 0 に積まれた音をつなげ、継ぎ目の無音（前の音の終わりから次の鳴り始めまで）を数える
+struct Timeline
+{
+  std::vector<int16_t> samples;
+  size_t gaps = 0;
+  uint64_t gap_samples = 0;
+  size_t overlaps = 0;
+  std::vector<size_t> resume_at; // 無音の後に鳴り始めた位置（samples の添字）
+  uint64_t end_us = 0;
+};
+
+Timeline timeline()
+{
+  Timeline t;
+  double prev_end_us = 0;
+  for (const Speaker_Class::Played &p : M5.Speaker.played)
+  {
+    if (p.channel != 0)
+    {
+      continue;
+    }
+    double frames = static_cast<double>(p.samples.size()) / (p.stereo ? 2 : 1);
+    if (!t.samples.empty())
+    {
+      long long gap = std::llround((static_cast<double>(p.start_us) - prev_end_us) * p.sample_rate / 1e6);
+      if (gap > 0)
+      {
+        t.gaps++;
+        t.gap_samples += static_cast<uint64_t>(gap);
+        t.resume_at.push_back(t.samples.size());
+      }
+      t.overlaps += gap < 0 ? 1 : 0;
+    }
+    t.samples.insert(t.samples.end(), p.samples.begin(), p.samples.end());
+    prev_end_us = static_cast<double>(p.start_us) + frames * 1e6 / p.sample_rate;
+  }
+  t.end_us = static_cast<uint64_t>(prev_end_us);
+  return t;
+}
+
+// クレジットで送る（ファームウェアが再生バッファの空きを知らせる）場合、セグメントは途切れずにつながる
+void testCreditPacedGapless()
+{
+  setUp();
+  credits_enabled = true;
+  speaking.grantInitialCredit();
+  CHECK_EQ(credit, static_cast<uint64_t>(kDownlinkBudgetBytes));
+  host_test::g_logs = {};
+
+  // 2 秒のセグメント 2 本と端数 1 本（5.3 秒）
+  std::vector<int16_t> pcm = tone(kSampleRate * 53 / 10);
+  std::vector<Frame> frames = buildFrames(pcm);
+  uint64_t start_us = replay_host::now_us;
+  run(frames, {}, 7000);
+
+  Timeline t = timeline();
+  CHECK(M5.Speaker.played.size() >= 3);
+  CHECK_EQ(t.gaps, 0u);
+  CHECK_EQ(t.overlaps, 0u);
+  CHECK_EQ(t.samples.size(), pcm.size());
+  // 末尾のフェードアウト（speaking.cpp の kSeamRampFrames）以外は送った PCM そのまま
+  constexpr size_t kTailRamp = 48;
+  size_t diff = 0;
+  for (size_t i = 0; i + kTailRamp < std::min(t.samples.size(), pcm.size()); ++i)
+  {
+    diff += t.samples[i] != pcm[i] ? 1 : 0;
+  }
+  CHECK_EQ(diff, 0u);
+
+  // 完了は 1 回だけ、鳴り終わってから kPlaybackPollMs 以内
+  CHECK_EQ(finished, 1);
+  CHECK(finished_us >= t.end_us && finished_us <= t.end_us + 11000);
+  CHECK_NEAR(static_cast<double>(t.end_us - start_us) / 1000.0, 5300.0, 2.0);
+  CHECK(sm.isIdle());
+  // 再生し終えた分のクレジットはすべて返っている
+  CHECK_EQ(credit, static_cast<uint64_t>(kDownlinkBudgetBytes));
+  CHECK_EQ(host_test::g_logs.warnings, 0u);
+}
+
+// クレジットの無いサーバー（壁時計で 1 秒・3 秒後に送る）で、3 本目が遅れて無音が挟まる
+void testLateSegment()
+{
+  setUp();
+  std::vector<int16_t> pcm = tone(kSampleRate * 6);
+  std::vector<Frame> frames = buildFrames(pcm);
+  uint64_t start_us = replay_host::now_us;
+  // 2 本目までで 4 秒鳴る。3 本目は 4.5 秒後
+  run(frames, {0, 1000, 4500}, 8000);
+
+  Timeline t = timeline();
+  CHECK_EQ(t.samples.size(), pcm.size());
+  CHECK_EQ(t.gaps, 1u);
+  CHECK_NEAR(static_cast<double>(t.gap_samples), kSampleRate * 0.5, kSampleRate * 0.002);
+  // 無音の後の鳴り始めはフェードインする（クリックにならない）
+  if (t.resume_at.size() == 1)
+  {
+    size_t at = t.resume_at[0];
+    CHECK_EQ(t.samples[at], 0);
+    CHECK(std::abs(t.samples[at + 1]) < std::abs(pcm[at + 1]) || pcm[at + 1] == 0);
+    CHECK(t.samples[at + 100] == pcm[at + 100]);
+  }
+  // 途切れた時点では終わらず、最後のセグメントを鳴らし終えてから 1 回だけ
+  CHECK_EQ(finished, 1);
+  CHECK(finished_us >= t.end_us);
+  CHECK_NEAR(static_cast<double>(t.end_us - start_us) / 1000.0, 6500.0, 2.0);
+  CHECK(sm.isIdle());
+}
+
+// 発話終了フラグの無いサーバー: セグメントの間が空いても kLegacyUtteranceGapMs までは次を待つ
+void testLegacyServerWaitsForNextSegment()
+{
+  setUp();
+  std::vector<int16_t> pcm = tone(kSampleRate * 4);
+  std::vector<Frame> frames = buildFrames(pcm);
+  for (Frame &f : frames)
+  {
+    f.hdr.reserved = 0;
+  }
+  // 1 本目（2 秒）が鳴り終わった 0.5 秒後に 2 本目
+  run(frames, {0, 2500}, 6000);
+
+  Timeline t = timeline();
+  CHECK_EQ(t.samples.size(), pcm.size());
+  CHECK_EQ(t.gaps, 1u);
+  CHECK_EQ(finished, 1);
+  CHECK(finished_us >= t.end_us + 1000000);
+}
+// 届かなかった DATA（乱数で選ぶ。2 本目の先頭の chunk は必ず落とす）を補間で埋める
+void testConcealDroppedChunks()
+{
+  std::vector<int16_t> pcm = tone(kSampleRate * 6);
+  const std::vector<Frame> all = buildFrames(pcm);
+  for (uint32_t seed : {1u, 7u, 42u, 1234u, 99991u})
+  {
+    setUp();
+    host_test::g_logs = {};
+
+    // セグメントの最後の DATA（端数の長さ）は落とさない。欠けた長さは chunk の長さで見積もるため
+    std::vector<Frame> frames;
+    std::vector<std::pair<size_t, size_t>> dropped; // 欠けたサンプルの範囲 [first, last)
+    size_t offset = 0;
+    uint32_t rng = seed;
+    for (size_t i = 0; i < all.size(); ++i)
+    {
+      const Frame &f = all[i];
+      bool data = f.hdr.messageType == static_cast<uint8_t>(MessageType::DATA);
+      bool last_data = data && all[i + 1].hdr.messageType == static_cast<uint8_t>(MessageType::END);
+      bool first_data = data && all[i - 1].hdr.messageType == static_cast<uint8_t>(MessageType::START);
+      rng = rng * 1664525u + 1013904223u;
+      size_t samples = f.body.size() / sizeof(int16_t);
+      if (data && !last_data && ((first_data && f.segment == 1) || (rng >> 24) < 26)) // 約 10%
+      {
+        dropped.emplace_back(offset, offset + samples);
+      }
+      else
+      {
+        frames.push_back(f);
+      }
+      offset += data ? samples : 0;
+    }
+    CHECK(!dropped.empty());
+    run(frames, {0, 1000, 3000}, 8000);
+
+    Timeline t = timeline();
+    // 欠けた分も同じ長さで埋まり、後続の音の位置はずれない
+    CHECK_EQ(t.samples.size(), pcm.size());
+    CHECK_EQ(t.gaps, 0u);
+    CHECK(maxStep(t.samples) <= 1000);
+    size_t diff = 0;
+    size_t loud = 0;
+    size_t next_drop = 0;
+    for (size_t i = 0; i + 48 < std::min(t.samples.size(), pcm.size()); ++i)
+    {
+      while (next_drop < dropped.size() && i >= dropped[next_drop].second)
+      {
+        next_drop++;
+      }
+      bool concealed = next_drop < dropped.size() && i >= dropped[next_drop].first;
+      if (!concealed)
+      {
+        diff += t.samples[i] != pcm[i] ? 1 : 0;
+      }
+      else if (i >= dropped[next_drop].first + 120 && i + 120 < dropped[next_drop].second)
+      {
+        // フェードの間（5 ms）を除けば無音
+        loud += t.samples[i] != 0 ? 1 : 0;
+      }
+    }
+    CHECK_EQ(diff, 0u);
+    CHECK_EQ(loud, 0u);
+    CHECK_EQ(finished, 1);
+    CHECK(sm.isIdle());
+    CHECK_EQ(host_test::g_logs.errors, 0u);
+    if (host_test::g_verbose)
+    {
+      printf("  seed %u: %u chunks dropped, max step %d\n", static_cast<unsigned>(seed),
+             static_cast<unsigned>(dropped.size()), maxStep(t.samples));
+    }
+  }
+}
+
+// END が届かなくても、kSegmentEndTimeoutMs で区切って全部鳴らす。
+// クレジットが残っているのに DATA が止まったら、鳴っている音に続けて途切れずに鳴らす
+void testMissingEnd()
+{
+  setUp();
+  credits_enabled = true;
+  speaking.grantInitialCredit();
+  host_test::g_logs = {};
+  std::vector<int16_t> pcm = tone(kSampleRate * 6);
+  std::vector<Frame> frames = buildFrames(pcm);
+  // 1 本目と最後の END を落とす（最後の END と一緒に発話終了フラグも届かない）
+  std::vector<Frame> kept;
+  for (size_t i = 0; i < frames.size(); ++i)
+  {
+    bool end = frames[i].hdr.messageType == static_cast<uint8_t>(MessageType::END);
+    if (!(end && (frames[i].segment == 0 || i + 1 == frames.size())))
+    {
+      kept.push_back(frames[i]);
+    }
+  }
+  uint64_t start_us = replay_host::now_us;
+  run(kept, {0, 1000, 3000}, 9000);
+
+  Timeline t = timeline();
+  CHECK_EQ(t.samples.size(), pcm.size());
+  CHECK_EQ(t.gaps, 0u);
+  CHECK(maxStep(t.samples) <= 1000);
+  size_t diff = 0;
+  for (size_t i = 0; i + 48 < std::min(t.samples.size(), pcm.size()); ++i)
+  {
+    diff += t.samples[i] != pcm[i] ? 1 : 0;
+  }
+  CHECK_EQ(diff, 0u);
+  // 1 本目は END を待って 0.5 秒遅れて鳴り始める
+  CHECK_NEAR(static_cast<double>(t.end_us - start_us) / 1000.0, 6500.0, 20.0);
+  CHECK(host_test::g_logs.warnings >= 1);
+  // 発話終了フラグが無いので、鳴り終わってから kLegacyUtteranceGapMs 待って 1 回だけ終わる
+  CHECK_EQ(finished, 1);
+  CHECK(finished_us >= t.end_us + 1000000 && finished_us <= t.end_us + 1100000);
+  CHECK(sm.isIdle());
+}
+
+// 枠が空く前に 5 本目が届いて捨てられ、6 本目が続く。4 本目の末尾と 6 本目の先頭だけをフェードし、
+// 続きどうしの継ぎ目（1-4 本目の間）はそのまま
+void testDroppedSegmentSeam()
+{
+  setUp();
+  host_test::g_logs = {};
+  std::vector<int16_t> pcm = tone(kSampleRate * 12);
+  std::vector<Frame> frames = buildFrames(pcm);
+  run(frames, {0, 0, 0, 0, 0, 2500}, 13000);
+  CHECK(host_test::g_logs.warnings >= 1);
+
+  // 5 本目（8-10 秒）を除いた音が、隙間なく鳴る
+  constexpr size_t kSegment = kSampleRate * 2;
+  constexpr size_t kSeam = kSegment * 4;
+  std::vector<int16_t> expected(pcm.begin(), pcm.begin() + kSeam);
+  expected.insert(expected.end(), pcm.begin() + kSeam + kSegment, pcm.end());
+  Timeline t = timeline();
+  CHECK_EQ(t.samples.size(), expected.size());
+  CHECK_EQ(t.gaps, 0u);
+  if (t.samples.size() != expected.size())
+  {
+    return;
+  }
+
+  // 欠けた継ぎ目の前後 kSeamRampFrames（48）と発話の末尾のほかは送った PCM そのまま
+  constexpr size_t kRamp = 48;
+  size_t diff = 0;
+  for (size_t i = 0; i + kRamp < t.samples.size(); ++i)
+  {
+    if (i + kRamp >= kSeam && i < kSeam + kRamp)
+    {
+      continue;
+    }
+    diff += t.samples[i] != expected[i] ? 1 : 0;
+  }
+  CHECK_EQ(diff, 0u);
+  CHECK(std::abs(t.samples[kSeam - 1]) < 200);
+  CHECK_EQ(t.samples[kSeam], 0);
+  CHECK(maxStep(t.samples) <= 1000);
+  CHECK_EQ(finished, 1);
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+  host_test::init(argc, argv);
+  memory_plan::init(kPlan);
+  testCreditPacedGapless();
+  testLateSegment();
+  testLegacyServerWaitsForNextSegment();
+  testConcealDroppedChunks();
+  testMissingEnd();
+  testDroppedSegmentSeam();
+  return host_test::finish("speaking");
+}
@@ -0,0 +1,351 @@
+// StateMachine の遷移表と遅延イベントキューのテスト、dispatch のコスト
+//  - 全ステート × 全イベントで、遷移先とエントリ/エグジットのハンドラ呼び出しを、ここに書いた期待表と突き合わせる
+//  - guard が断った行は飛ばして次の行を試し、action は exit と entry の間に 1 回だけ呼ぶこと
+//  - ハンドラ内の dispatch が、現在の遷移を終えてから受け付け順に処理されること
+//  - キューが一杯のときは捨てて警告を出し、ハンドラの登録は上限で断ること
+
+#include "host_test.hpp"
+#include "state_machine.hpp"
+
+#include <algorithm>
+#include <array>
+
+namespace
+{
+using State = StateMachine::State;
+using Event = StateMachine::Event;
+
+constexpr uint8_t kNone = 0xFF;
+constexpr uint8_t I = StateMachine::Idle;
+constexpr uint8_t L = StateMachine::Listening;
+constexpr uint8_t T = StateMachine::Thinking;
+constexpr uint8_t S = StateMachine::Speaking;
+constexpr uint8_t D = StateMachine::Disconnected;
+constexpr uint8_t _ = kNone;
+
+// [event][state] の遷移先（guard は未登録）。列は Idle, Listening, Thinking, Speaking, Disconnected
+constexpr uint8_t kExpected[StateMachine::kEventCount][StateMachine::kStateCount] = {
+    {_, _, _, _, I}, // Connected
+    {D, D, D, D, _}, // Disconnected
+    {_, I, I, I, _}, // RemoteIdle
+    {L, _, L, L, _}, // RemoteListening
+    {T, T, _, T, _}, // RemoteThinking
+    {S, S, S, _, _}, // RemoteSpeaking
+    {S, S, S, _, _}, // SpeakStart
+    {_, I, _, _, _}, // ListenFinished
+    {_, _, _, I, _}, // SpeakFinished
+    {_, _, I, I, _}, // CommTimeout
+    {_, _, _, L, _}, // FollowUpListen
+};
+
+// ハンドラの呼び出し記録
+struct Call
+{
+  char kind; // 'x': exit, 'n': entry
+  int tag;
+  State prev;
+  State next;
+};
+std::array<Call, 64> g_calls{};
+size_t g_call_count = 0;
+StateMachine *g_sm = nullptr;
+
+void record(char kind, int tag, State prev, State next)
+{
+  if (g_call_count < g_calls.size())
+  {
+    g_calls[g_call_count++] = Call{kind, tag, prev, next};
+  }
+}
+
+template <int Tag>
+void onEntry(State prev, State next)
+{
+  record('n', Tag, prev, next);
+}
+
+template <int Tag>
+void onExit(State prev, State next)
+{
+  record('x', Tag, prev, next);
+}
+
+void addRecorders(StateMachine &sm)
+{
+  for (size_t s = 0; s < StateMachine::kStateCount; ++s)
+  {
+    sm.addStateEntryEvent(static_cast<State>(s), onEntry<0>);
+    sm.addStateExitEvent(static_cast<State>(s), onExit<0>);
+  }
+}
+
+// 起動直後（Disconnected）から state まで進める
+void driveTo(StateMachine &sm, State state)
+{
+  if (state == StateMachine::Disconnected)
+  {
+    return;
+  }
+  sm.dispatch(Event::Connected);
+  switch (state)
+  {
+  case StateMachine::Listening:
+    sm.dispatch(Event::RemoteListening);
+    break;
+  case StateMachine::Thinking:
+    sm.dispatch(Event::RemoteThinking);
+    break;
+  case StateMachine::Speaking:
+    sm.dispatch(Event::RemoteSpeaking);
+    break;
+  default:
+    break;
+  }
+}
+
+void testExhaustiveTable()
+{
+  for (size_t s = 0; s < StateMachine::kStateCount; ++s)
+  {
+    for (size_t e = 0; e < StateMachine::kEventCount; ++e)
+    {
+      const State from = static_cast<State>(s);
+      const Event event = static_cast<Event>(e);
+      StateMachine sm;
+      addRecorders(sm);
+      driveTo(sm, from);
+      CHECK_EQ(sm.getState(), from);
+
+      State resolved = from;
+      const bool allowed = sm.resolve(from, event, resolved);
+      CHECK_EQ(allowed, kExpected[e][s] != kNone);
+      if (allowed)
+      {
+        CHECK_EQ(resolved, kExpected[e][s]);
+      }
+
+      g_call_count = 0;
+      sm.dispatch(event);
+      if (kExpected[e][s] == kNone)
+      {
+        // 無視したイベントではハンドラを呼ばない
+        CHECK_EQ(sm.getState(), from);
+        CHECK_EQ(g_call_count, 0u);
+        continue;
+      }
+      const State to = static_cast<State>(kExpected[e][s]);
+      CHECK_EQ(sm.getState(), to);
+      // 前のステートの exit、次のステートの entry の順に 1 回ずつ
+      CHECK_EQ(g_call_count, 2u);
+      CHECK(g_calls[0].kind == 'x' && g_calls[0].prev == from && g_calls[0].next == to);
+      CHECK(g_calls[1].kind == 'n' && g_calls[1].prev == from && g_calls[1].next == to);
+    }
+  }
+  // 範囲外は拒否する
+  StateMachine sm;
+  State dummy;
+  CHECK(!sm.resolve(StateMachine::Idle, static_cast<Event>(StateMachine::kEventCount), dummy));
+  CHECK(!sm.resolve(static_cast<State>(StateMachine::kStateCount), Event::Connected, dummy));
+}
+
+bool g_can_resume = false;
+int g_guard_calls = 0;
+
+bool canResume()
+{
+  g_guard_calls++;
+  return g_can_resume;
+}
+
+void armFollowUp()
+{
+  record('a', 0, StateMachine::Speaking, StateMachine::Listening);
+}
+
+// 再接続は guard で Listening（再開）と Idle に分かれ、会話モードの Listening には action が付く
+void testGuardsAndActions()
+{
+  StateMachine::TransitionHooks hooks;
+  hooks.can_resume_listening = canResume;
+  hooks.arm_follow_up = armFollowUp;
+
+  StateMachine sm;
+  sm.setTransitionHooks(hooks);
+  addRecorders(sm);
+
+  // guard が断れば次の行（Idle）へ
+  g_can_resume = false;
+  g_guard_calls = 0;
+  State resolved;
+  CHECK(sm.resolve(StateMachine::Disconnected, Event::Connected, resolved));
+  CHECK_EQ(resolved, StateMachine::Idle);
+  sm.dispatch(Event::Connected);
+  CHECK_EQ(sm.getState(), StateMachine::Idle);
+  CHECK_EQ(g_guard_calls, 2);
+
+  // guard が通れば Idle を経ずに Listening へ
+  sm.dispatch(Event::Disconnected);
+  g_can_resume = true;
+  g_call_count = 0;
+  sm.dispatch(Event::Connected);
+  CHECK_EQ(sm.getState(), StateMachine::Listening);
+  CHECK_EQ(g_call_count, 2u);
+  CHECK(g_calls[1].kind == 'n' && g_calls[1].prev == StateMachine::Disconnected);
+
+  // 接続中は guard を評価しない
+  g_guard_calls = 0;
+  sm.dispatch(Event::Connected);
+  CHECK_EQ(sm.getState(), StateMachine::Listening);
+  CHECK_EQ(g_guard_calls, 0);
+
+  // action は Speaking の exit と Listening の entry の間に呼ぶ。同じ Listening でも RemoteListening には付かない
+  sm.dispatch(Event::RemoteSpeaking);
+  g_call_count = 0;
+  sm.dispatch(Event::FollowUpListen);
+  CHECK_EQ(sm.getState(), StateMachine::Listening);
+  CHECK_EQ(g_call_count, 3u);
+  CHECK(g_calls[0].kind == 'x' && g_calls[1].kind == 'a' && g_calls[2].kind == 'n');
+  sm.dispatch(Event::RemoteSpeaking);
+  g_call_count = 0;
+  sm.dispatch(Event::RemoteListening);
+  CHECK_EQ(g_call_count, 2u);
+
+  // guard 未登録なら再開しない
+  StateMachine bare;
+  bare.dispatch(Event::Connected);
+  CHECK_EQ(bare.getState(), StateMachine::Idle);
+}
+
+// Speaking に入ったハンドラが再生完了と次の Listening を続けて要求する
+bool g_reenter = false;
+void dispatchFromEntry(State, State)
+{
+  record('n', 1, StateMachine::Speaking, StateMachine::Speaking);
+  if (g_reenter)
+  {
+    g_reenter = false;
+    g_sm->dispatch(Event::SpeakFinished);
+    g_sm->dispatch(Event::RemoteListening);
+  }
+}
+
+void testDeferredQueueOrder()
+{
+  StateMachine sm;
+  g_sm = &sm;
+  sm.addStateEntryEvent(StateMachine::Speaking, dispatchFromEntry);
+  addRecorders(sm);
+  driveTo(sm, StateMachine::Thinking);
+
+  g_call_count = 0;
+  g_reenter = true;
+  sm.dispatch(Event::SpeakStart);
+  CHECK_EQ(sm.getState(), StateMachine::Listening);
+
+  // 後から登録した Speaking の entry も、キューのイベントより先に呼ばれる
+  const Call expected[] = {
+      {'x', 0, StateMachine::Thinking, StateMachine::Speaking},
+      {'n', 1, StateMachine::Speaking, StateMachine::Speaking},
+      {'n', 0, StateMachine::Thinking, StateMachine::Speaking},
+      {'x', 0, StateMachine::Speaking, StateMachine::Idle},
+      {'n', 0, StateMachine::Speaking, StateMachine::Idle},
+      {'x', 0, StateMachine::Idle, StateMachine::Listening},
+      {'n', 0, StateMachine::Idle, StateMachine::Listening},
+  };
+  CHECK_EQ(g_call_count, sizeof(expected) / sizeof(expected[0]));
+  for (size_t i = 0; i < std::min(g_call_count, sizeof(expected) / sizeof(expected[0])); ++i)
+  {
+    CHECK(g_calls[i].kind == expected[i].kind && g_calls[i].tag == expected[i].tag &&
+          g_calls[i].prev == expected[i].prev && g_calls[i].next == expected[i].next);
+  }
+  g_sm = nullptr;
+}
+
+// Idle に入ったハンドラが、キューの容量を 1 件超えて要求する
+bool g_flood = false;
+void floodFromEntry(State, State)
+{
+  if (!g_flood)
+  {
+    return;
+  }
+  g_flood = false;
+  for (int i = 0; i < 9; ++i)
+  {
+    g_sm->dispatch(i % 2 == 0 ? Event::RemoteListening : Event::RemoteThinking);
+  }
+}
+
+void testQueueOverflow()
+{
+  StateMachine sm;
+  g_sm = &sm;
+  sm.addStateEntryEvent(StateMachine::Idle, floodFromEntry);
+  host_test::g_logs = {};
+  g_flood = true;
+  sm.dispatch(Event::Connected);
+  // 8 件（L, T, ... T）だけ処理し、9 件目（L）は捨てる
+  CHECK_EQ(sm.getState(), StateMachine::Thinking);
+  CHECK_EQ(host_test::g_logs.warnings, 1u);
+
+  // キューは空に戻り、次の dispatch はそのまま処理される
+  sm.dispatch(Event::CommTimeout);
+  CHECK_EQ(sm.getState(), StateMachine::Idle);
+  g_sm = nullptr;
+}
+
+void testHandlerCapacity()
+{
+  StateMachine sm;
+  host_test::g_logs = {};
+  CHECK(sm.addStateEntryEvent(StateMachine::Idle, onEntry<1>));
+  CHECK(sm.addStateEntryEvent(StateMachine::Idle, onEntry<2>));
+  CHECK(sm.addStateEntryEvent(StateMachine::Idle, onEntry<3>));
+  CHECK(sm.addStateEntryEvent(StateMachine::Idle, onEntry<4>));
+  CHECK(!sm.addStateEntryEvent(StateMachine::Idle, onEntry<5>));
+  CHECK_EQ(host_test::g_logs.errors, 1u);
+
+  // 登録順に呼ぶ
+  g_call_count = 0;
+  sm.dispatch(Event::Connected);
+  CHECK_EQ(g_call_count, 4u);
+  for (size_t i = 0; i < std::min<size_t>(g_call_count, 4); ++i)
+  {
+    CHECK_EQ(g_calls[i].tag, static_cast<int>(i + 1));
+  }
+}
+
+void noop(State, State) {}
+
+void benchmarkDispatch()
+{
+  StateMachine sm;
+  for (size_t s = 0; s < StateMachine::kStateCount; ++s)
+  {
+    sm.addStateEntryEvent(static_cast<State>(s), noop);
+    sm.addStateExitEvent(static_cast<State>(s), noop);
+  }
+  sm.dispatch(Event::Connected);
+
+  // 1 周 4 回の遷移（Idle → Listening → Thinking → Speaking → Idle）
+  const Event cycle[] = {Event::RemoteListening, Event::RemoteThinking, Event::SpeakStart, Event::SpeakFinished};
+  size_t i = 0;
+  const double transition_ns = host_test::nsPerCall(4000000, [&]() { sm.dispatch(cycle[i++ % 4]); });
+  CHECK_EQ(sm.getState(), StateMachine::Idle);
+  // 遷移表に無いイベント（Idle で ListenFinished）
+  const double ignored_ns = host_test::nsPerCall(4000000, [&]() { sm.dispatch(Event::ListenFinished); });
+  printf("  dispatch: %.1f ns per transition (2 handlers), %.1f ns per ignored event\n", transition_ns, ignored_ns);
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+  host_test::init(argc, argv);
+  testExhaustiveTable();
+  testGuardsAndActions();
+  testDeferredQueueOrder();
+  testQueueOverflow();
+  testHandlerCapacity();
+  benchmarkDispatch();
+  return host_test::finish("state_machine");
+}
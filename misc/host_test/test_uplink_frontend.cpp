@@ -0,0 +1,276 @@
+// UplinkFrontEnd（送信前の HPF・雑音抑圧・AGC）の応答のテスト
+//  - bypass では入力をそのまま写す
+//  - HPF: 直流と 30 Hz のハムを落とし、音声帯域は残す
+//  - 雑音抑圧: 定常な白色雑音を十分に下げ、音声帯域の音は弱めない。全体の遅延は 384 サンプル
+//  - AGC: 小さい声を目標のレベルまで上げ、大きい声は先読みで飽和させない
+
+#include "host_test.hpp"
+#include "stereo_source.hpp"
+#include "uplink_frontend.hpp"
+
+#include <vector>
+
+namespace
+{
+constexpr int kSampleRate = 16000;
+constexpr size_t kBlock = UplinkFrontEnd::kBlockSamples;
+constexpr size_t kLatency = 384;
+
+// モノラルの合成音（stereo_source の L チャンネル）
+std::vector<double> mono(const std::vector<double> &lr)
+{
+  std::vector<double> out(lr.size() / 2);
+  for (size_t i = 0; i < out.size(); ++i)
+  {
+    out[i] = lr[2 * i];
+  }
+  return out;
+}
+
+// 音声帯域の正弦波の和を、音節のように 0.25 秒ごとに 0.15 秒だけ鳴らす（鳴っている間の実効値が rms）。
+// 定常な音のままだと、雑音抑圧が雑音として覚えてしまう
+bool syllableOn(size_t i)
+{
+  return i % (kSampleRate / 4) < kSampleRate * 15 / 100;
+}
+
+std::vector<double> speech(size_t samples, double rms, uint32_t seed)
+{
+  std::vector<double> lr(2 * samples, 0.0);
+  stereo_source::addPlaneWave(lr, stereo_source::tones(seed, 32, 300.0, 3400.0, rms), 0.0, kSampleRate);
+  std::vector<double> out = mono(lr);
+  for (size_t i = 0; i < samples; ++i)
+  {
+    out[i] *= syllableOn(i) ? 1.0 : 0.0;
+  }
+  return out;
+}
+
+// [begin, end) のうち、音節が鳴っている（offset だけ遅らせた）サンプルの平均パワー
+double syllablePower(const std::vector<int16_t> &samples, size_t begin, size_t end, size_t offset)
+{
+  double sum = 0.0;
+  size_t n = 0;
+  for (size_t i = begin; i < end; ++i)
+  {
+    // 音節の頭の 1 ブロックは AGC のなじみを除く
+    if (i >= offset && syllableOn(i - offset) && (i - offset) % (kSampleRate / 4) >= kBlock)
+    {
+      sum += static_cast<double>(samples[i]) * samples[i];
+      n++;
+    }
+  }
+  return sum / static_cast<double>(n);
+}
+
+std::vector<double> whiteNoise(size_t samples, double rms, uint32_t seed)
+{
+  std::vector<double> lr(2 * samples, 0.0);
+  stereo_source::addDiffuseNoise(lr, rms, seed);
+  return mono(lr);
+}
+
+std::vector<int16_t> run(UplinkFrontEnd &fe, const std::vector<int16_t> &in)
+{
+  std::vector<int16_t> out(in.size());
+  for (size_t pos = 0; pos + kBlock <= in.size(); pos += kBlock)
+  {
+    fe.process(in.data() + pos, out.data() + pos);
+  }
+  return out;
+}
+
+// [begin, end) の平均パワー
+double power(const std::vector<int16_t> &samples, size_t begin, size_t end)
+{
+  double sum = 0.0;
+  for (size_t i = begin; i < end; ++i)
+  {
+    sum += static_cast<double>(samples[i]) * samples[i];
+  }
+  return sum / static_cast<double>(end - begin);
+}
+
+// [begin, end) の freq_hz 成分の振幅（Goertzel）
+double toneAmplitude(const std::vector<int16_t> &samples, size_t begin, size_t end, double freq_hz)
+{
+  double coeff = 2.0 * std::cos(2.0 * M_PI * freq_hz / kSampleRate);
+  double s1 = 0.0;
+  double s2 = 0.0;
+  for (size_t i = begin; i < end; ++i)
+  {
+    double s = samples[i] + coeff * s1 - s2;
+    s2 = s1;
+    s1 = s;
+  }
+  double mag2 = s1 * s1 + s2 * s2 - coeff * s1 * s2;
+  return 2.0 * std::sqrt(std::max(mag2, 0.0)) / static_cast<double>(end - begin);
+}
+
+double db(double ratio)
+{
+  return 10.0 * std::log10(ratio);
+}
+
+void testBypass()
+{
+  UplinkFrontEnd fe;
+  fe.init();
+  CHECK(fe.isBypassed());
+  std::vector<int16_t> in = stereo_source::toPcm(whiteNoise(kBlock * 8, 3000.0, 1));
+  CHECK(run(fe, in) == in);
+}
+
+void testHighPass()
+{
+  UplinkFrontEnd fe;
+  fe.init();
+  fe.setBypass(false);
+  fe.reset();
+  // 直流 8000 と、同じ振幅（1500）の 30 Hz・1 kHz
+  const size_t samples = kSampleRate * 3 / 2;
+  std::vector<double> x(samples);
+  for (size_t i = 0; i < samples; ++i)
+  {
+    double t = static_cast<double>(i) / kSampleRate;
+    x[i] = 8000.0 + 1500.0 * std::sin(2.0 * M_PI * 30.0 * t) + 1500.0 * std::sin(2.0 * M_PI * 1000.0 * t);
+  }
+  std::vector<int16_t> out = run(fe, stereo_source::toPcm(x));
+
+  // 落ち着いた後の 1 秒（30 Hz の整数周期）
+  const size_t begin = kSampleRate / 2;
+  const size_t end = begin + kSampleRate;
+  double mean = 0.0;
+  for (size_t i = begin; i < end; ++i)
+  {
+    mean += out[i];
+  }
+  mean /= static_cast<double>(end - begin);
+  double hum = toneAmplitude(out, begin, end, 30.0);
+  double voice = toneAmplitude(out, begin, end, 1000.0);
+  // 1 次 HPF（約 50 Hz）で 30 Hz は約 -6 dB。1 kHz はほぼそのまま（AGC のゲインは両方に同じく掛かる）
+  CHECK(std::fabs(mean) < 0.01 * voice);
+  CHECK(voice > 1000.0);
+  CHECK(20.0 * std::log10(hum / voice) < -5.0);
+  if (host_test::g_verbose)
+  {
+    printf("  HPF: dc %.1f, 30 Hz %.0f, 1 kHz %.0f (%.1f dB)\n", mean, hum, voice, 20.0 * std::log10(hum / voice));
+  }
+}
+
+// 雑音だけの 8 秒で雑音を覚えさせた後に話す。
+// 起動直後の雑音の推定は小さく、雑音を声として AGC が持ち上げるので、それが戻るまで待つ
+void testNoiseSuppressionAndLatency()
+{
+  UplinkFrontEnd fe;
+  fe.init();
+  fe.setBypass(false);
+  fe.reset();
+  const size_t learn = kSampleRate * 8;
+  const size_t talk = kSampleRate * 2;
+  const size_t samples = learn + talk;
+  std::vector<double> x = whiteNoise(samples, 300.0, 21);
+  std::vector<double> voice = speech(talk, 3000.0, 22);
+  for (size_t i = 0; i < talk; ++i)
+  {
+    x[learn + i] += voice[i];
+  }
+  std::vector<int16_t> in = stereo_source::toPcm(x);
+  std::vector<int16_t> out = run(fe, in);
+
+  // 雑音だけの区間（最後の 1 秒）
+  double noise_db = db(power(out, learn - kSampleRate + kLatency, learn) / power(in, learn - kSampleRate, learn));
+  CHECK(noise_db < -10.0);
+
+  // 音節は弱めない（SNR 20 dB、AGC の目標と同じレベル）
+  double voice_db = db(syllablePower(out, learn + kLatency, samples, learn + kLatency) /
+                       syllablePower(in, learn, samples - kLatency, learn));
+  CHECK(voice_db > -2.0 && voice_db < 2.0);
+
+  // 出力は入力から kLatency 遅れる（相互相関のピーク）
+  size_t best_lag = 0;
+  double best = 0.0;
+  for (size_t lag = 0; lag < 2 * kBlock + kLatency; ++lag)
+  {
+    double c = 0.0;
+    for (size_t i = learn; i + lag < samples; ++i)
+    {
+      c += static_cast<double>(in[i]) * out[i + lag];
+    }
+    if (c > best)
+    {
+      best = c;
+      best_lag = lag;
+    }
+  }
+  CHECK_EQ(best_lag, kLatency);
+  if (host_test::g_verbose)
+  {
+    printf("  noise suppression: noise %.1f dB, voice %+.1f dB, latency %u samples\n", noise_db, voice_db,
+           static_cast<unsigned>(best_lag));
+  }
+}
+
+// 小さい声（実効値 500）は約 3000 まで上がり、いきなり大きい声（実効値 5000）が来ても飽和しない。
+// どちらも AGC のゲインの範囲（-6〜+18 dB）で目標に届くレベル
+void testAgc()
+{
+  UplinkFrontEnd fe;
+  fe.init();
+  fe.setBypass(false);
+  fe.reset();
+  const size_t quiet = kSampleRate * 4;
+  const size_t loud = kSampleRate;
+  std::vector<double> x = speech(quiet + loud, 500.0, 31);
+  std::vector<double> shout = speech(quiet + loud, 5000.0, 32);
+  for (size_t i = quiet; i < quiet + loud; ++i)
+  {
+    x[i] = shout[i];
+  }
+  std::vector<int16_t> in = stereo_source::toPcm(x);
+  std::vector<int16_t> out = run(fe, in);
+
+  double quiet_rms = std::sqrt(syllablePower(out, quiet - kSampleRate, quiet, kLatency));
+  CHECK(quiet_rms > 3000.0 * 0.8 && quiet_rms < 3000.0 * 1.25);
+
+  int32_t peak = 0;
+  size_t clipped = 0;
+  for (int16_t v : out)
+  {
+    peak = std::max(peak, std::abs(static_cast<int32_t>(v)));
+    clipped += (v == INT16_MAX || v == INT16_MIN) ? 1 : 0;
+  }
+  CHECK(peak <= 32000 + 64);
+  CHECK_EQ(clipped, 0u);
+  // 大きい声は下げたゲインで目標のレベル付近へ
+  double loud_rms = std::sqrt(syllablePower(out, quiet + loud / 2, quiet + loud, kLatency));
+  CHECK(loud_rms > 3000.0 * 0.8 && loud_rms < 3000.0 * 1.25);
+  if (host_test::g_verbose)
+  {
+    printf("  AGC: quiet 500 -> %.0f, loud 5000 -> %.0f, peak %d\n", quiet_rms, loud_rms, static_cast<int>(peak));
+  }
+}
+
+void benchmarkBlock()
+{
+  UplinkFrontEnd fe;
+  fe.init();
+  fe.setBypass(false);
+  fe.reset();
+  std::vector<int16_t> in = stereo_source::toPcm(speech(kBlock, 3000.0, 41));
+  std::vector<int16_t> out(kBlock);
+  const double block_ns = host_test::nsPerCall(20000, [&]() { fe.process(in.data(), out.data()); });
+  printf("  process: %.0f ns per %u-sample block (16 ms at 16 kHz)\n", block_ns, static_cast<unsigned>(kBlock));
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+  host_test::init(argc, argv);
+  testBypass();
+  testHighPass();
+  testNoiseSuppressionAndLatency();
+  testAgc();
+  benchmarkBlock();
+  return host_test::finish("uplink_frontend");
+}
@@ -0,0 +1,221 @@
+// WsClient（RFC 6455 の使う範囲だけの WebSocket クライアント）のテスト
+//  - 偽のソケット（misc/replay/host/WiFi.h）の上でハンドシェイクを通し、サーバー側のフレームを積んで loop() を回す
+//  - payload の無い制御フレーム（8A 00 の pong など）は、後続のバイトを待たずにその loop() で処理する
+//  - バイナリメッセージはフレームが何回に分かれて届いても、1 回で全部届いても同じに組み立てる
+//  - 送信はマスクを外すと元のデータに戻る。送信バッファに収まるフレームは 1 回の write で書く
+
+#include "fake_ws_server.hpp"
+#include "host_test.hpp"
+#include "memory_plan.hpp"
+#include "ws_client.hpp"
+
+#include <string>
+#include <vector>
+
+namespace
+{
+using fake_ws_server::acceptFor;
+using fake_ws_server::frame;
+using fake_ws_server::message;
+using fake_ws_server::SentFrame;
+using replay_host::socket;
+
+constexpr memory_plan::Budget kPlan[] = {
+    {memory_plan::Module::WsClient, memory_plan::Region::Psram, memory_plan::padded(WsClient::kRxBufferBytes)},
+    {memory_plan::Module::WsClient, memory_plan::Region::Internal, memory_plan::padded(WsClient::kTxBufferBytes)},
+};
+
+struct ReceivedMessage
+{
+  WsHeader hdr{};
+  std::vector<uint8_t> body;
+};
+
+std::vector<uint8_t> pattern(size_t len, uint8_t seed)
+{
+  std::vector<uint8_t> out(len);
+  for (size_t i = 0; i < len; ++i)
+  {
+    out[i] = static_cast<uint8_t>(seed + i * 7);
+  }
+  return out;
+}
+
+// 1 台の WsClient と、その相手をするサーバー側の操作
+class Link
+{
+public:
+  Link()
+  {
+    replay_host::now_us = 1000000;
+    socket = replay_host::FakeSocket{};
+    memory_plan::release();
+    memory_plan::init(kPlan);
+    ws.onEvent([this](WsClient::Event event) { events.push_back(event); });
+    ws.onMessage([this](const WsHeader &hdr, const uint8_t *body, size_t len) {
+      messages.push_back({hdr, std::vector<uint8_t>(body, body + len)});
+    });
+    ws.begin("server", 8080, "/ws");
+  }
+
+  // TCP の接続からハンドシェイクの応答までを通す
+  bool open()
+  {
+    ws.loop();
+    if (!fake_ws_server::answerHandshake())
+    {
+      return false;
+    }
+    ws.loop();
+    return ws.isConnected();
+  }
+
+  void push(const std::vector<uint8_t> &bytes) { fake_ws_server::push(bytes); }
+
+  void advanceMs(uint32_t ms) { replay_host::now_us += static_cast<uint64_t>(ms) * 1000; }
+
+  std::vector<SentFrame> takeSent() { return fake_ws_server::takeSent(); }
+
+  WsClient ws;
+  std::vector<WsClient::Event> events;
+  std::vector<ReceivedMessage> messages;
+};
+
+void testHandshakeDigest()
+{
+  // RFC 6455 1.3 の例
+  CHECK(acceptFor("dGhlIHNhbXBsZSBub25jZQ==") == "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+
+  Link link;
+  CHECK(link.open());
+  CHECK_EQ(link.events.size(), 1u);
+  CHECK(link.events.size() == 1 && link.events[0] == WsClient::Event::Connected);
+  CHECK_EQ(socket.connects, 1u);
+}
+
+// ping に payload の無い pong だけが返る相手でも、ハートビートで切らない
+void testBarePong()
+{
+  Link link;
+  link.ws.enableHeartbeat(15000, 3000, 2);
+  CHECK(link.open());
+  host_test::g_logs = {};
+
+  for (int round = 0; round < 20; ++round)
+  {
+    link.advanceMs(15000);
+    link.ws.loop();
+    std::vector<SentFrame> sent = link.takeSent();
+    CHECK_EQ(sent.size(), 1u);
+    CHECK(!sent.empty() && sent[0].opcode == 0x9 && sent[0].masked && sent[0].payload.empty());
+
+    link.push({0x8A, 0x00});
+    link.ws.loop();
+    CHECK_EQ(socket.rx.size(), 0u);
+  }
+  link.advanceMs(3000);
+  link.ws.loop();
+  CHECK(link.ws.isConnected());
+  CHECK_EQ(host_test::g_logs.warnings, 0u);
+  CHECK_EQ(link.events.size(), 1u);
+}
+
+// payload の無い ping・close も、そのフレームだけで処理する
+void testBareControlFrames()
+{
+  Link link;
+  CHECK(link.open());
+
+  link.push({0x89, 0x00});
+  link.ws.loop();
+  std::vector<SentFrame> sent = link.takeSent();
+  CHECK_EQ(sent.size(), 1u);
+  CHECK(!sent.empty() && sent[0].opcode == 0xA && sent[0].payload.empty());
+
+  link.push({0x88, 0x00});
+  link.ws.loop();
+  CHECK(!link.ws.isConnected());
+  CHECK(link.events.size() == 2 && link.events[1] == WsClient::Event::Disconnected);
+}
+
+// 同じメッセージの並びを、1 バイトずつ・まとめての 2 通りで流して同じ結果になる
+void testBinaryMessages()
+{
+  std::vector<uint8_t> stream;
+  std::vector<std::vector<uint8_t>> bodies = {pattern(0, 1), pattern(3, 2), pattern(200, 3), pattern(4000, 4)};
+  for (size_t i = 0; i < bodies.size(); ++i)
+  {
+    std::vector<uint8_t> f = frame(0x2, message(static_cast<uint8_t>(MessageKind::StateCmd), static_cast<uint16_t>(i), bodies[i]));
+    stream.insert(stream.end(), f.begin(), f.end());
+    // 間に payload の無い pong を挟む
+    stream.push_back(0x8A);
+    stream.push_back(0x00);
+  }
+  // 2 フレームに分けたメッセージ
+  std::vector<uint8_t> split = message(static_cast<uint8_t>(MessageKind::StateCmd), 9, pattern(300, 5));
+  std::vector<uint8_t> first(split.begin(), split.begin() + 100);
+  std::vector<uint8_t> rest(split.begin() + 100, split.end());
+  for (const std::vector<uint8_t> &f : {frame(0x2, first, false), frame(0x0, rest)})
+  {
+    stream.insert(stream.end(), f.begin(), f.end());
+  }
+  bodies.push_back(pattern(300, 5));
+
+  for (bool bytewise : {true, false})
+  {
+    Link link;
+    CHECK(link.open());
+    host_test::g_logs = {};
+    if (bytewise)
+    {
+      for (uint8_t b : stream)
+      {
+        link.push({b});
+        link.ws.loop();
+      }
+    }
+    else
+    {
+      link.push(stream);
+      link.ws.loop();
+    }
+    CHECK_EQ(link.messages.size(), bodies.size());
+    for (size_t i = 0; i < std::min(link.messages.size(), bodies.size()); ++i)
+    {
+      CHECK_EQ(link.messages[i].hdr.payloadBytes, bodies[i].size());
+      CHECK(link.messages[i].body == bodies[i]);
+    }
+    CHECK_EQ(socket.rx.size(), 0u);
+    CHECK_EQ(host_test::g_logs.warnings, 0u);
+  }
+}
+
+// 送信バッファに収まるフレームは 1 回の write（setNoDelay では 1 回ごとに TCP のセグメントが出る）
+void testSendMasking()
+{
+  Link link;
+  CHECK(link.open());
+  for (size_t len : {size_t{0}, size_t{7}, size_t{125}, size_t{126}, size_t{4008}, size_t{4103}, size_t{70000}})
+  {
+    std::vector<uint8_t> data = pattern(len, static_cast<uint8_t>(len));
+    socket.writes = 0;
+    CHECK(link.ws.sendBIN(data.data(), data.size()));
+    size_t header = len < 126 ? 6 : len <= 0xFFFF ? 8 : 14;
+    CHECK_EQ(socket.writes, (header + len + WsClient::kTxBufferBytes - 1) / WsClient::kTxBufferBytes);
+    std::vector<SentFrame> sent = link.takeSent();
+    CHECK_EQ(sent.size(), 1u);
+    CHECK(!sent.empty() && sent[0].opcode == 0x2 && sent[0].fin && sent[0].masked && sent[0].payload == data);
+  }
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+  host_test::init(argc, argv);
+  testHandshakeDigest();
+  testBarePong();
+  testBareControlFrames();
+  testBinaryMessages();
+  testSendMasking();
+  return host_test::finish("ws_client");
+}
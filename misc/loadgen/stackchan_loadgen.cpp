@@ -0,0 +1,1304 @@
+// StackChan の仮想ロボットで stackchan_server に負荷をかけるツール
+//  - firmware/include/protocols.hpp と同じフレーミングで、N 台のロボットを 1 スレッドの epoll で並行に動かす
+//  - 各ロボットはファームウェアと同じ順で動く: WakeWordEvt → サーバーの StateCmd(Listening) を待つ
+//    → AudioPcm（WAV を録音と同じ速さで送る）
+//    → 無音 → END → 応答の AudioWav を再生速度で消費（AudioCreditEvt を返す）→ SpeakDoneEvt
+//  - StateCmd / ServoCmd / AudioPcmAck / ClipCmd にもファームウェアと同じように応える
+//  - 終了時に、ターンの遅延の分位点（ロボットごとと全体）・サーバーのフレームのスループット・切断数を出す
+//
+// ビルド（Linux）:
+//   g++ -O2 -std=c++17 -o stackchan_loadgen misc/loadgen/stackchan_loadgen.cpp
+// 実行例（スタブの ASR/TTS で動かすサーバーに対して）:
+//   uv run python -m example_apps.loadtest
+//   ./stackchan_loadgen --robots 50 --duration 120 --wav hello.wav
+//
+// サーバーは接続元 IP ごとに 1 台として扱うので、ループバックの宛先にはロボットごとに
+// 127.1.x.y の別の送信元アドレスから接続する（--no-bind で無効）
+
+#include "../../firmware/include/protocols.hpp"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace
+{
+constexpr int kSampleRate = 16000;             // ファームウェアの録音と同じ
+constexpr uint32_t kInitialCreditBytes = 192 * 1024; // ファームウェアの再生バッファ
+constexpr uint32_t kReconnectMs = 1000;
+constexpr size_t kMaxWsFrameBytes = 1 << 20;
+
+// StateEvt / StateCmd の値（ファームウェアの StateMachine::State と同じ）
+enum class RobotState : uint8_t
+{
+  Idle = 0,
+  Listening = 1,
+  Thinking = 2,
+  Speaking = 3,
+  Disconnected = 0xFF,
+};
+
+const char *kindName(uint8_t kind)
+{
+  switch (static_cast<MessageKind>(kind))
+  {
+  case MessageKind::AudioWav:
+    return "AudioWav";
+  case MessageKind::StateCmd:
+    return "StateCmd";
+  case MessageKind::ServoCmd:
+    return "ServoCmd";
+  case MessageKind::AudioPcmAck:
+    return "AudioPcmAck";
+  case MessageKind::ClipCmd:
+    return "ClipCmd";
+  case MessageKind::ClipData:
+    return "ClipData";
+  default:
+    return "other";
+  }
+}
+
+uint64_t nowMs()
+{
+  using namespace std::chrono;
+  return static_cast<uint64_t>(duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+// 乱数（マスクキー・セッション ID・待ち時間のばらつき）
+uint32_t g_rng = 0x9E3779B9u;
+uint32_t nextRandom()
+{
+  g_rng ^= g_rng << 13;
+  g_rng ^= g_rng >> 17;
+  g_rng ^= g_rng << 5;
+  return g_rng;
+}
+
+struct Options
+{
+  std::string host = "127.0.0.1";
+  int port = 8000;
+  std::string path = "/ws/stackchan";
+  int robots = 10;
+  uint32_t duration_s = 60;
+  std::vector<std::string> wavs{};
+  uint32_t synthetic_ms = 1500;   // WAV を渡さないときの合成音声の長さ
+  uint32_t tail_silence_ms = 3000; // 発話後、ファームウェアが無音で END を送るまでの時間
+  uint32_t chunk_ms = 125;        // 1 DATA の長さ
+  uint32_t think_ms = 4000;       // ターンの間隔（0.5〜1.5 倍でばらつかせる）
+  uint32_t ramp_ms = 5000;        // 全台の接続をこの時間に分散させる
+  uint32_t turn_timeout_ms = 30000;
+  bool bind_loopback = true;
+  bool verbose = false;
+};
+
+// ---- 音声 ----
+
+using Utterance = std::vector<int16_t>;
+
+bool loadWav(const std::string &path, Utterance &out)
+{
+  FILE *f = fopen(path.c_str(), "rb");
+  if (f == nullptr)
+  {
+    fprintf(stderr, "cannot open %s\n", path.c_str());
+    return false;
+  }
+  std::vector<uint8_t> bytes;
+  uint8_t buf[65536];
+  size_t got = 0;
+  while ((got = fread(buf, 1, sizeof(buf), f)) > 0)
+  {
+    bytes.insert(bytes.end(), buf, buf + got);
+  }
+  fclose(f);
+
+  auto u16 = [&](size_t pos) { return static_cast<uint32_t>(bytes[pos] | (bytes[pos + 1] << 8)); };
+  auto u32 = [&](size_t pos) { return u16(pos) | (u16(pos + 2) << 16); };
+  if (bytes.size() < 12 || memcmp(bytes.data(), "RIFF", 4) != 0 || memcmp(bytes.data() + 8, "WAVE", 4) != 0)
+  {
+    fprintf(stderr, "%s: not a WAV file\n", path.c_str());
+    return false;
+  }
+  uint32_t rate = 0, channels = 0, bits = 0, format = 0;
+  size_t data_pos = 0, data_len = 0;
+  for (size_t pos = 12; pos + 8 <= bytes.size();)
+  {
+    uint32_t len = u32(pos + 4);
+    if (memcmp(bytes.data() + pos, "fmt ", 4) == 0 && pos + 8 + 16 <= bytes.size())
+    {
+      format = u16(pos + 8);
+      channels = u16(pos + 10);
+      rate = u32(pos + 12);
+      bits = u16(pos + 22);
+    }
+    else if (memcmp(bytes.data() + pos, "data", 4) == 0)
+    {
+      data_pos = pos + 8;
+      data_len = std::min<size_t>(len, bytes.size() - data_pos);
+    }
+    pos += 8 + len + (len & 1);
+  }
+  if (format != 1 || bits != 16 || channels == 0 || rate == 0 || data_pos == 0)
+  {
+    fprintf(stderr, "%s: need PCM16 WAV (format=%u bits=%u)\n", path.c_str(), format, bits);
+    return false;
+  }
+
+  // 1ch 目だけを取り、16 kHz でなければ線形補間で合わせる
+  size_t frames = data_len / (2 * channels);
+  std::vector<int16_t> mono(frames);
+  for (size_t i = 0; i < frames; ++i)
+  {
+    mono[i] = static_cast<int16_t>(u16(data_pos + i * 2 * channels));
+  }
+  if (rate == static_cast<uint32_t>(kSampleRate))
+  {
+    out = std::move(mono);
+    return true;
+  }
+  size_t out_frames = frames * kSampleRate / rate;
+  out.resize(out_frames);
+  for (size_t i = 0; i < out_frames; ++i)
+  {
+    double src = static_cast<double>(i) * rate / kSampleRate;
+    size_t i0 = std::min(static_cast<size_t>(src), frames - 1);
+    size_t i1 = std::min(i0 + 1, frames - 1);
+    double frac = src - static_cast<double>(i0);
+    out[i] = static_cast<int16_t>(mono[i0] * (1.0 - frac) + mono[i1] * frac);
+  }
+  return true;
+}
+
+// WAV が無いときの発話の代わり。声帯音に近い倍音列を音節ごとに区切ったもの
+Utterance syntheticUtterance(uint32_t ms)
+{
+  Utterance out(static_cast<size_t>(kSampleRate) * ms / 1000);
+  double phase = 0.0;
+  for (size_t n = 0; n < out.size(); ++n)
+  {
+    double t = static_cast<double>(n) / kSampleRate;
+    double f0 = 140.0 + 30.0 * std::sin(2.0 * M_PI * 0.7 * t);
+    phase += 2.0 * M_PI * f0 / kSampleRate;
+    double s = 0.0;
+    for (int h = 1; h <= 12; ++h)
+    {
+      s += std::sin(h * phase) / h;
+    }
+    double syllable = 0.5 - 0.5 * std::cos(2.0 * M_PI * std::fmod(t, 0.25) / 0.25);
+    out[n] = static_cast<int16_t>(5000.0 * syllable * s);
+  }
+  return out;
+}
+
+// ---- 統計 ----
+
+struct Percentiles
+{
+  uint32_t p50 = 0, p90 = 0, p99 = 0, max = 0;
+  size_t count = 0;
+};
+
+Percentiles percentiles(std::vector<uint32_t> values)
+{
+  Percentiles p;
+  p.count = values.size();
+  if (values.empty())
+  {
+    return p;
+  }
+  std::sort(values.begin(), values.end());
+  auto rank = [&](double q) {
+    size_t i = static_cast<size_t>(std::ceil(q * values.size()));
+    return values[std::min(values.size() - 1, i == 0 ? 0 : i - 1)];
+  };
+  p.p50 = rank(0.50);
+  p.p90 = rank(0.90);
+  p.p99 = rank(0.99);
+  p.max = values.back();
+  return p;
+}
+
+struct GlobalStats
+{
+  std::array<uint64_t, 256> rx_frames_by_kind{};
+  uint64_t rx_frames = 0;
+  uint64_t rx_bytes = 0;
+  uint64_t rx_text_frames = 0;
+  uint64_t tx_frames = 0;
+  uint64_t tx_bytes = 0;
+};
+
+GlobalStats g_stats;
+
+// ---- ロボット ----
+
+class Robot
+{
+public:
+  Robot(int id, const Options &opt, const std::vector<Utterance> &utterances, const sockaddr_in &server)
+      : id_(id), opt_(opt), utterances_(utterances), server_(server)
+  {
+  }
+
+  void start(uint64_t at_ms) { reconnect_at_ms_ = at_ms; }
+
+  int fd() const { return fd_; }
+
+  void tick(uint64_t now, int epfd);
+  void onEvent(uint32_t events, uint64_t now, int epfd);
+  void shutdown();
+
+  // 結果
+  std::vector<uint32_t> response_ms{}; // END → 最初の AudioWav DATA
+  std::vector<uint32_t> turn_ms{};     // ウェイクワード → SpeakDoneEvt
+  uint32_t turns_started = 0;
+  uint32_t turns_timed_out = 0;
+  uint32_t turns_without_reply = 0;
+  uint32_t turns_dropped = 0;
+  uint32_t dropped_sessions = 0;
+  uint32_t connect_failures = 0;
+
+private:
+  enum class Phase
+  {
+    Closed,
+    Connecting,
+    Handshake,
+    Open,
+  };
+
+  struct PlayedSegment
+  {
+    uint64_t done_ms;
+    uint32_t bytes;
+  };
+
+  void connect(uint64_t now, int epfd);
+  void drop(uint64_t now, int epfd, const char *reason);
+  void onReadable(uint64_t now, int epfd);
+  bool flush(int epfd);
+  void sendFrame(uint8_t opcode, const uint8_t *payload, size_t len);
+  void sendPacket(MessageKind kind, MessageType type, uint8_t flags, uint16_t seq, const void *payload, size_t len);
+  void sendEvent(MessageKind kind, const void *payload, size_t len);
+  void handleMessage(const uint8_t *data, size_t len, uint64_t now);
+  void handleStateCmd(RobotState target, uint64_t now);
+  void handleAudioWav(const WsHeader &hdr, const uint8_t *body, size_t len, uint64_t now);
+  void handleServoCmd(const uint8_t *body, size_t len, uint64_t now);
+  void setState(RobotState state);
+  void beginUplink(const Utterance *speech, uint64_t now);
+  void pumpUplink(uint64_t now);
+  void endUplink(uint64_t now);
+  void stopPlayback();
+  void pumpPlayback(uint64_t now);
+  void scheduleNextTurn(uint64_t now);
+  void finishTurn(uint64_t now);
+
+  const int id_;
+  const Options &opt_;
+  const std::vector<Utterance> &utterances_;
+  const sockaddr_in server_;
+
+  int fd_ = -1;
+  Phase phase_ = Phase::Closed;
+  bool want_write_ = false;
+  uint64_t reconnect_at_ms_ = 0;
+  std::string out_{};
+  size_t out_pos_ = 0;
+  std::vector<uint8_t> in_{};
+  std::vector<uint8_t> message_{};
+  uint8_t message_opcode_ = 0;
+
+  RobotState state_ = RobotState::Disconnected;
+  uint16_t event_seq_ = 0;
+
+  // uplink（Listening）
+  bool uplinking_ = false;
+  const Utterance *speech_ = nullptr;
+  size_t uplink_total_samples_ = 0; // 発話 + 無音
+  size_t uplink_sent_samples_ = 0;
+  uint64_t uplink_started_ms_ = 0;
+  uint32_t session_id_ = 0;
+  uint16_t uplink_seq_ = 0;
+  std::vector<int16_t> chunk_buf_{};
+
+  // ターン
+  uint64_t next_turn_ms_ = 0;
+  bool turn_active_ = false;  // ウェイクワードから SpeakDoneEvt まで
+  const Utterance *wake_utterance_ = nullptr; // WakeWordEvt を送り、Listening を待っている発話
+  bool awaiting_reply_ = false;
+  bool got_audio_ = false;
+  uint64_t turn_started_ms_ = 0;
+  uint64_t end_sent_ms_ = 0;
+
+  // 再生（AudioWav）
+  uint32_t play_rate_ = 24000;
+  uint16_t play_channels_ = 1;
+  bool segment_open_ = false;
+  uint32_t segment_bytes_ = 0;
+  bool end_of_utterance_ = false;
+  uint64_t play_clock_ms_ = 0;
+  std::deque<PlayedSegment> playing_{};
+
+  uint64_t servo_done_ms_ = 0;
+};
+
+void Robot::connect(uint64_t now, int epfd)
+{
+  fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd_ < 0)
+  {
+    perror("socket");
+    reconnect_at_ms_ = now + kReconnectMs;
+    return;
+  }
+  int one = 1;
+  setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  if (opt_.bind_loopback && (ntohl(server_.sin_addr.s_addr) >> 24) == 127)
+  {
+    sockaddr_in local{};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(0x7F010000u + static_cast<uint32_t>(id_) + 1);
+    if (bind(fd_, reinterpret_cast<sockaddr *>(&local), sizeof(local)) != 0)
+    {
+      perror("bind");
+    }
+  }
+  int rc = ::connect(fd_, reinterpret_cast<const sockaddr *>(&server_), sizeof(server_));
+  if (rc != 0 && errno != EINPROGRESS)
+  {
+    connect_failures++;
+    close(fd_);
+    fd_ = -1;
+    reconnect_at_ms_ = now + kReconnectMs;
+    return;
+  }
+  phase_ = Phase::Connecting;
+  out_.clear();
+  out_pos_ = 0;
+  in_.clear();
+  message_.clear();
+  epoll_event ev{};
+  ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP;
+  ev.data.ptr = this;
+  want_write_ = true;
+  epoll_ctl(epfd, EPOLL_CTL_ADD, fd_, &ev);
+}
+
+void Robot::drop(uint64_t now, int epfd, const char *reason)
+{
+  if (fd_ >= 0)
+  {
+    epoll_ctl(epfd, EPOLL_CTL_DEL, fd_, nullptr);
+    close(fd_);
+    fd_ = -1;
+  }
+  if (phase_ == Phase::Open)
+  {
+    dropped_sessions++;
+    if (turn_active_)
+    {
+      turns_dropped++;
+    }
+    if (opt_.verbose)
+    {
+      fprintf(stderr, "robot %d: dropped (%s)\n", id_, reason);
+    }
+  }
+  else
+  {
+    connect_failures++;
+    if (opt_.verbose)
+    {
+      fprintf(stderr, "robot %d: connect failed (%s)\n", id_, reason);
+    }
+  }
+  phase_ = Phase::Closed;
+  state_ = RobotState::Disconnected;
+  uplinking_ = false;
+  turn_active_ = awaiting_reply_ = false;
+  wake_utterance_ = nullptr;
+  segment_open_ = false;
+  playing_.clear();
+  servo_done_ms_ = 0;
+  reconnect_at_ms_ = now + kReconnectMs;
+}
+
+void Robot::shutdown()
+{
+  if (fd_ >= 0)
+  {
+    close(fd_);
+    fd_ = -1;
+  }
+  phase_ = Phase::Closed;
+}
+
+void Robot::onEvent(uint32_t events, uint64_t now, int epfd)
+{
+  if (phase_ == Phase::Connecting && (events & (EPOLLOUT | EPOLLERR | EPOLLHUP)))
+  {
+    int err = 0;
+    socklen_t len = sizeof(err);
+    getsockopt(fd_, SOL_SOCKET, SO_ERROR, &err, &len);
+    if (err != 0)
+    {
+      drop(now, epfd, strerror(err));
+      return;
+    }
+    char host[64];
+    snprintf(host, sizeof(host), "%s:%d", opt_.host.c_str(), opt_.port);
+    char request[512];
+    snprintf(request, sizeof(request),
+             "GET %s HTTP/1.1\r\nHost: %s\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+             "Sec-WebSocket-Key: c3RhY2tjaGFuLWxvYWRnZW4=\r\nSec-WebSocket-Version: 13\r\n\r\n",
+             opt_.path.c_str(), host);
+    out_.append(request);
+    phase_ = Phase::Handshake;
+  }
+  if (events & EPOLLIN)
+  {
+    onReadable(now, epfd);
+    if (fd_ < 0)
+    {
+      return;
+    }
+  }
+  if ((events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) && fd_ >= 0)
+  {
+    drop(now, epfd, "connection closed");
+    return;
+  }
+  if (events & EPOLLOUT)
+  {
+    flush(epfd);
+  }
+}
+
+void Robot::onReadable(uint64_t now, int epfd)
+{
+  uint8_t buf[65536];
+  while (true)
+  {
+    ssize_t got = recv(fd_, buf, sizeof(buf), 0);
+    if (got > 0)
+    {
+      in_.insert(in_.end(), buf, buf + got);
+      continue;
+    }
+    if (got == 0)
+    {
+      drop(now, epfd, "EOF");
+      return;
+    }
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+    {
+      break;
+    }
+    drop(now, epfd, strerror(errno));
+    return;
+  }
+
+  size_t pos = 0;
+  if (phase_ == Phase::Handshake)
+  {
+    static const char kEnd[] = "\r\n\r\n";
+    auto it = std::search(in_.begin(), in_.end(), kEnd, kEnd + 4);
+    if (it == in_.end())
+    {
+      return;
+    }
+    std::string head(in_.begin(), it);
+    if (head.compare(0, 12, "HTTP/1.1 101") != 0)
+    {
+      drop(now, epfd, "handshake rejected");
+      return;
+    }
+    pos = static_cast<size_t>(it - in_.begin()) + 4;
+    phase_ = Phase::Open;
+
+    // ファームウェアの enterConnected() と同じ: 状態通知と再生バッファのクレジット
+    setState(RobotState::Idle);
+    uint32_t credit = kInitialCreditBytes;
+    sendEvent(MessageKind::AudioCreditEvt, &credit, sizeof(credit));
+    scheduleNextTurn(now);
+  }
+
+  // サーバーからのフレームはマスクされない
+  while (phase_ == Phase::Open && in_.size() - pos >= 2)
+  {
+    const uint8_t *p = in_.data() + pos;
+    bool fin = (p[0] & 0x80) != 0;
+    uint8_t opcode = p[0] & 0x0F;
+    uint64_t len = p[1] & 0x7F;
+    size_t header = 2;
+    if (len == 126)
+    {
+      if (in_.size() - pos < 4)
+      {
+        break;
+      }
+      len = (static_cast<uint64_t>(p[2]) << 8) | p[3];
+      header = 4;
+    }
+    else if (len == 127)
+    {
+      if (in_.size() - pos < 10)
+      {
+        break;
+      }
+      len = 0;
+      for (int i = 0; i < 8; ++i)
+      {
+        len = (len << 8) | p[2 + i];
+      }
+      header = 10;
+    }
+    if (len > kMaxWsFrameBytes)
+    {
+      drop(now, epfd, "frame too large");
+      return;
+    }
+    if (in_.size() - pos < header + len)
+    {
+      break;
+    }
+    const uint8_t *payload = p + header;
+    pos += header + static_cast<size_t>(len);
+
+    if (opcode == 0x8)
+    {
+      sendFrame(0x8, payload, std::min<size_t>(len, 2));
+      flush(epfd);
+      // サーバーが閉じた理由（1003 など）をそのまま出す
+      std::string reason = "close frame";
+      if (len >= 2)
+      {
+        reason += " " + std::to_string((payload[0] << 8) | payload[1]) + ": ";
+        reason.append(reinterpret_cast<const char *>(payload + 2), static_cast<size_t>(len) - 2);
+      }
+      drop(now, epfd, reason.c_str());
+      return;
+    }
+    if (opcode == 0x9)
+    {
+      sendFrame(0xA, payload, static_cast<size_t>(len));
+      continue;
+    }
+    if (opcode == 0xA)
+    {
+      continue;
+    }
+    if (opcode != 0x0)
+    {
+      message_opcode_ = opcode;
+      message_.clear();
+    }
+    message_.insert(message_.end(), payload, payload + len);
+    if (!fin)
+    {
+      continue;
+    }
+    if (message_opcode_ == 0x2)
+    {
+      handleMessage(message_.data(), message_.size(), now);
+    }
+    else if (message_opcode_ == 0x1)
+    {
+      g_stats.rx_text_frames++; // 認識結果などの JSON
+    }
+    message_.clear();
+  }
+  in_.erase(in_.begin(), in_.begin() + static_cast<std::ptrdiff_t>(pos));
+  flush(epfd);
+}
+
+bool Robot::flush(int epfd)
+{
+  while (fd_ >= 0 && out_pos_ < out_.size())
+  {
+    ssize_t sent = send(fd_, out_.data() + out_pos_, out_.size() - out_pos_, MSG_NOSIGNAL);
+    if (sent > 0)
+    {
+      out_pos_ += static_cast<size_t>(sent);
+      continue;
+    }
+    if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    {
+      break;
+    }
+    return false; // 読み込み側で切断を検知する
+  }
+  if (out_pos_ == out_.size())
+  {
+    out_.clear();
+    out_pos_ = 0;
+  }
+  bool need_write = phase_ == Phase::Connecting || !out_.empty();
+  if (fd_ >= 0 && need_write != want_write_)
+  {
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLRDHUP | (need_write ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    ev.data.ptr = this;
+    epoll_ctl(epfd, EPOLL_CTL_MOD, fd_, &ev);
+    want_write_ = need_write;
+  }
+  return true;
+}
+
+void Robot::sendFrame(uint8_t opcode, const uint8_t *payload, size_t len)
+{
+  // クライアントからのフレームはマスクする
+  uint8_t header[14];
+  size_t n = 0;
+  header[n++] = static_cast<uint8_t>(0x80 | opcode);
+  if (len < 126)
+  {
+    header[n++] = static_cast<uint8_t>(0x80 | len);
+  }
+  else
+  {
+    header[n++] = 0x80 | 126;
+    header[n++] = static_cast<uint8_t>(len >> 8);
+    header[n++] = static_cast<uint8_t>(len);
+  }
+  uint32_t key = nextRandom();
+  uint8_t mask[4];
+  memcpy(mask, &key, sizeof(mask));
+  memcpy(header + n, mask, sizeof(mask));
+  n += sizeof(mask);
+  out_.append(reinterpret_cast<const char *>(header), n);
+  size_t base = out_.size();
+  out_.append(reinterpret_cast<const char *>(payload), len);
+  for (size_t i = 0; i < len; ++i)
+  {
+    out_[base + i] = static_cast<char>(out_[base + i] ^ mask[i & 3]);
+  }
+  g_stats.tx_frames++;
+  g_stats.tx_bytes += n + len;
+}
+
+void Robot::sendPacket(MessageKind kind, MessageType type, uint8_t flags, uint16_t seq, const void *payload,
+                       size_t len)
+{
+  std::vector<uint8_t> packet(sizeof(WsHeader) + len);
+  WsHeader header{};
+  header.kind = static_cast<uint8_t>(kind);
+  header.messageType = static_cast<uint8_t>(type);
+  header.reserved = flags;
+  header.seq = seq;
+  header.payloadBytes = static_cast<uint16_t>(len);
+  memcpy(packet.data(), &header, sizeof(header));
+  if (len > 0)
+  {
+    memcpy(packet.data() + sizeof(header), payload, len);
+  }
+  sendFrame(0x2, packet.data(), packet.size());
+}
+
+void Robot::sendEvent(MessageKind kind, const void *payload, size_t len)
+{
+  sendPacket(kind, MessageType::DATA, 0, event_seq_++, payload, len);
+}
+
+void Robot::setState(RobotState state)
+{
+  if (state == state_)
+  {
+    return;
+  }
+  state_ = state;
+  uint8_t value = static_cast<uint8_t>(state);
+  sendEvent(MessageKind::StateEvt, &value, sizeof(value));
+}
+
+void Robot::handleMessage(const uint8_t *data, size_t len, uint64_t now)
+{
+  if (len < sizeof(WsHeader))
+  {
+    return;
+  }
+  WsHeader hdr{};
+  memcpy(&hdr, data, sizeof(hdr));
+  const uint8_t *body = data + sizeof(WsHeader);
+  size_t body_len = std::min<size_t>(hdr.payloadBytes, len - sizeof(WsHeader));
+  g_stats.rx_frames++;
+  g_stats.rx_bytes += len;
+  g_stats.rx_frames_by_kind[hdr.kind]++;
+
+  switch (static_cast<MessageKind>(hdr.kind))
+  {
+  case MessageKind::AudioWav:
+    handleAudioWav(hdr, body, body_len, now);
+    break;
+  case MessageKind::StateCmd:
+    if (body_len >= 1)
+    {
+      handleStateCmd(static_cast<RobotState>(body[0]), now);
+    }
+    break;
+  case MessageKind::ServoCmd:
+    handleServoCmd(body, body_len, now);
+    break;
+  case MessageKind::ClipCmd:
+    if (body_len >= 4)
+    {
+      // フレーズキャッシュは持たない。Miss を返せばサーバーは AudioWav で流す
+      uint8_t payload[5] = {static_cast<uint8_t>(ClipStatus::Miss)};
+      memcpy(payload + 1, body, 4);
+      sendEvent(MessageKind::ClipEvt, payload, sizeof(payload));
+    }
+    break;
+  default:
+    break; // AudioPcmAck は数えるだけ（再開は模擬しない）
+  }
+}
+
+void Robot::handleStateCmd(RobotState target, uint64_t now)
+{
+  // ファームウェアの遷移表（state_machine.cpp）と同じ組み合わせだけ受け付ける
+  switch (target)
+  {
+  case RobotState::Idle:
+    if (state_ == RobotState::Listening || state_ == RobotState::Thinking || state_ == RobotState::Speaking)
+    {
+      if (uplinking_)
+      {
+        endUplink(now);
+      }
+      stopPlayback();
+      if (awaiting_reply_)
+      {
+        // 応答の音声なしでターンが終わった（空の認識結果など）
+        awaiting_reply_ = false;
+        turn_active_ = false;
+        turns_without_reply++;
+        scheduleNextTurn(now);
+      }
+      setState(RobotState::Idle);
+    }
+    break;
+  case RobotState::Listening:
+    if (state_ == RobotState::Idle || state_ == RobotState::Thinking || state_ == RobotState::Speaking)
+    {
+      stopPlayback();
+      setState(RobotState::Listening);
+      // ウェイクワードの後なら発話を送る。話しかけられていなければ無音を送って無音判定の END で終わる
+      beginUplink(wake_utterance_, now);
+      wake_utterance_ = nullptr;
+    }
+    break;
+  case RobotState::Thinking:
+    if (state_ == RobotState::Idle || state_ == RobotState::Listening || state_ == RobotState::Speaking)
+    {
+      if (uplinking_)
+      {
+        endUplink(now);
+      }
+      setState(RobotState::Thinking);
+    }
+    break;
+  case RobotState::Speaking:
+    if (state_ == RobotState::Idle || state_ == RobotState::Listening || state_ == RobotState::Thinking)
+    {
+      if (uplinking_)
+      {
+        endUplink(now);
+      }
+      setState(RobotState::Speaking);
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+void Robot::handleAudioWav(const WsHeader &hdr, const uint8_t *body, size_t len, uint64_t now)
+{
+  switch (static_cast<MessageType>(hdr.messageType))
+  {
+  case MessageType::START:
+    if (len >= 6)
+    {
+      memcpy(&play_rate_, body, sizeof(play_rate_));
+      memcpy(&play_channels_, body + 4, sizeof(play_channels_));
+      play_rate_ = std::max<uint32_t>(play_rate_, 1);
+      play_channels_ = std::max<uint16_t>(play_channels_, 1);
+    }
+    segment_open_ = true;
+    segment_bytes_ = 0;
+    break;
+  case MessageType::DATA:
+    if (awaiting_reply_ && !got_audio_)
+    {
+      got_audio_ = true;
+      response_ms.push_back(static_cast<uint32_t>(now - end_sent_ms_));
+    }
+    segment_bytes_ += static_cast<uint32_t>(len);
+    break;
+  case MessageType::END:
+  {
+    // ファームウェアはセグメントの END を受けてから再生に回す
+    segment_open_ = false;
+    uint64_t bytes_per_second = static_cast<uint64_t>(play_rate_) * play_channels_ * sizeof(int16_t);
+    uint64_t start = std::max(now, play_clock_ms_);
+    play_clock_ms_ = start + segment_bytes_ * 1000ULL / bytes_per_second;
+    playing_.push_back(PlayedSegment{play_clock_ms_, segment_bytes_});
+    segment_bytes_ = 0;
+    if ((hdr.reserved & kWsFlagEndOfUtterance) != 0)
+    {
+      end_of_utterance_ = true;
+    }
+    if (state_ != RobotState::Speaking)
+    {
+      setState(RobotState::Speaking);
+    }
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+void Robot::handleServoCmd(const uint8_t *body, size_t len, uint64_t now)
+{
+  // <uint8 count> に続く Sleep(3 byte) / MoveX・MoveY(4 byte)。所要時間の合計で ServoDoneEvt を返す
+  if (len < 1)
+  {
+    return;
+  }
+  uint32_t total_ms = 0;
+  size_t pos = 1;
+  for (uint8_t i = 0; i < body[0] && pos < len; ++i)
+  {
+    uint8_t op = body[pos];
+    size_t size = op == 0 ? 3 : 4;
+    if (pos + size > len)
+    {
+      break;
+    }
+    int16_t duration = 0;
+    memcpy(&duration, body + pos + size - 2, sizeof(duration));
+    total_ms += static_cast<uint32_t>(std::max<int16_t>(duration, 0));
+    pos += size;
+  }
+  servo_done_ms_ = now + total_ms + 1; // 新しいシーケンスは実行中のものを置き換える
+}
+
+void Robot::beginUplink(const Utterance *speech, uint64_t now)
+{
+  speech_ = speech;
+  uplink_total_samples_ = (speech ? speech->size() : 0) + static_cast<size_t>(kSampleRate) * opt_.tail_silence_ms / 1000;
+  uplink_sent_samples_ = 0;
+  uplink_started_ms_ = now;
+  uplinking_ = true;
+  uplink_seq_ = 0;
+  session_id_ = nextRandom() | 1;
+  sendPacket(MessageKind::AudioPcm, MessageType::START, 0, uplink_seq_++, &session_id_, sizeof(session_id_));
+}
+
+void Robot::pumpUplink(uint64_t now)
+{
+  // 録音した分だけ、chunk_ms ごとに送る（ファームウェアと同じく実時間より先には送れない）
+  size_t chunk = static_cast<size_t>(kSampleRate) * opt_.chunk_ms / 1000;
+  size_t recorded = static_cast<size_t>((now - uplink_started_ms_) * kSampleRate / 1000);
+  recorded = std::min(recorded, uplink_total_samples_);
+  while (uplinking_ && (recorded - uplink_sent_samples_ >= chunk ||
+                        (recorded == uplink_total_samples_ && recorded > uplink_sent_samples_)))
+  {
+    size_t n = std::min(chunk, recorded - uplink_sent_samples_);
+    chunk_buf_.assign(n, 0);
+    if (speech_ != nullptr && uplink_sent_samples_ < speech_->size())
+    {
+      size_t from_speech = std::min(n, speech_->size() - uplink_sent_samples_);
+      memcpy(chunk_buf_.data(), speech_->data() + uplink_sent_samples_, from_speech * sizeof(int16_t));
+    }
+    sendPacket(MessageKind::AudioPcm, MessageType::DATA, 0, uplink_seq_++, chunk_buf_.data(), n * sizeof(int16_t));
+    uplink_sent_samples_ += n;
+  }
+  if (uplinking_ && uplink_sent_samples_ >= uplink_total_samples_)
+  {
+    // 無音判定で止まった。ファームウェアは END の後 Idle に戻り、サーバーの Thinking を待つ
+    endUplink(now);
+    setState(RobotState::Idle);
+    if (!turn_active_)
+    {
+      // サーバーからの Listening に誰も話さなかった。その応答が済む前に次のウェイクワードを出さない
+      scheduleNextTurn(now);
+    }
+  }
+}
+
+void Robot::endUplink(uint64_t now)
+{
+  uplinking_ = false;
+  sendPacket(MessageKind::AudioPcm, MessageType::END, 0, uplink_seq_++, nullptr, 0);
+  if (turn_active_ && speech_ != nullptr)
+  {
+    awaiting_reply_ = true;
+    got_audio_ = false;
+    end_sent_ms_ = now;
+  }
+}
+
+void Robot::stopPlayback()
+{
+  // 捨てた分もクレジットとして返す
+  uint32_t bytes = segment_bytes_;
+  for (const PlayedSegment &seg : playing_)
+  {
+    bytes += seg.bytes;
+  }
+  playing_.clear();
+  segment_open_ = false;
+  segment_bytes_ = 0;
+  end_of_utterance_ = false;
+  if (bytes > 0)
+  {
+    sendEvent(MessageKind::AudioCreditEvt, &bytes, sizeof(bytes));
+  }
+}
+
+void Robot::pumpPlayback(uint64_t now)
+{
+  while (!playing_.empty() && playing_.front().done_ms <= now)
+  {
+    uint32_t bytes = playing_.front().bytes;
+    playing_.pop_front();
+    sendEvent(MessageKind::AudioCreditEvt, &bytes, sizeof(bytes));
+  }
+  if (state_ == RobotState::Speaking && end_of_utterance_ && playing_.empty() && !segment_open_)
+  {
+    end_of_utterance_ = false;
+    uint8_t done = kSpeakDone;
+    sendEvent(MessageKind::SpeakDoneEvt, &done, sizeof(done));
+    setState(RobotState::Idle);
+    finishTurn(now);
+  }
+}
+
+void Robot::scheduleNextTurn(uint64_t now)
+{
+  uint32_t jitter = opt_.think_ms / 2 + (opt_.think_ms > 0 ? nextRandom() % (opt_.think_ms + 1) : 0);
+  next_turn_ms_ = now + jitter;
+}
+
+void Robot::finishTurn(uint64_t now)
+{
+  if (!turn_active_)
+  {
+    return;
+  }
+  turn_active_ = false;
+  awaiting_reply_ = false;
+  turn_ms.push_back(static_cast<uint32_t>(now - turn_started_ms_));
+  scheduleNextTurn(now);
+}
+
+void Robot::tick(uint64_t now, int epfd)
+{
+  if (phase_ == Phase::Closed)
+  {
+    if (reconnect_at_ms_ != 0 && now >= reconnect_at_ms_)
+    {
+      connect(now, epfd);
+    }
+    return;
+  }
+  if (phase_ != Phase::Open)
+  {
+    return;
+  }
+
+  if (servo_done_ms_ != 0 && now >= servo_done_ms_)
+  {
+    servo_done_ms_ = 0;
+    uint8_t done = 1;
+    sendEvent(MessageKind::ServoDoneEvt, &done, sizeof(done));
+  }
+  if (uplinking_)
+  {
+    pumpUplink(now);
+  }
+  pumpPlayback(now);
+
+  if (awaiting_reply_ && !got_audio_ && now - end_sent_ms_ >= opt_.turn_timeout_ms)
+  {
+    // ファームウェアの通信タイムアウトと同じく Idle に戻って次のターンへ
+    turns_timed_out++;
+    turn_active_ = awaiting_reply_ = false;
+    setState(RobotState::Idle);
+    scheduleNextTurn(now);
+  }
+  if (wake_utterance_ != nullptr && now - turn_started_ms_ >= opt_.turn_timeout_ms)
+  {
+    // WakeWordEvt に Listening が返ってこなかった
+    turns_timed_out++;
+    turn_active_ = false;
+    wake_utterance_ = nullptr;
+    scheduleNextTurn(now);
+  }
+
+  if (state_ == RobotState::Idle && !turn_active_ && !uplinking_ && now >= next_turn_ms_ && !utterances_.empty())
+  {
+    // ウェイクワード検出。ファームウェアは通知するだけで、サーバーの StateCmd(Listening) で録音を始める
+    turn_active_ = true;
+    turns_started++;
+    turn_started_ms_ = now;
+    uint8_t detected = 1;
+    sendEvent(MessageKind::WakeWordEvt, &detected, sizeof(detected));
+    wake_utterance_ = &utterances_[nextRandom() % utterances_.size()];
+  }
+  flush(epfd);
+}
+
+// ---- main ----
+
+void usage()
+{
+  fprintf(stderr,
+          "usage: stackchan_loadgen [options]\n"
+          "  --host H            server host (default 127.0.0.1)\n"
+          "  --port P            server port (default 8000)\n"
+          "  --path P            WebSocket path (default /ws/stackchan)\n"
+          "  --robots N          number of virtual robots (default 10)\n"
+          "  --duration S        test length in seconds (default 60)\n"
+          "  --wav FILE          utterance to replay (PCM16; repeatable, picked at random)\n"
+          "  --synthetic-ms MS   synthetic utterance length when no --wav (default 1500)\n"
+          "  --tail-silence-ms MS silence after the utterance before END (default 3000)\n"
+          "  --chunk-ms MS       AudioPcm DATA duration (default 125)\n"
+          "  --think-ms MS       mean pause between turns (default 4000)\n"
+          "  --ramp-ms MS        spread the initial connects over MS (default 5000)\n"
+          "  --turn-timeout-ms MS give up on a reply after MS (default 30000)\n"
+          "  --no-bind           do not bind each robot to its own 127.1.x.y address\n"
+          "  --verbose           log drops and connect failures\n");
+}
+
+bool parseOptions(int argc, char **argv, Options &opt)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string arg = argv[i];
+    auto value = [&]() -> const char * { return i + 1 < argc ? argv[++i] : nullptr; };
+    auto number = [&](auto &dst) {
+      const char *v = value();
+      if (v == nullptr)
+      {
+        return false;
+      }
+      dst = static_cast<std::remove_reference_t<decltype(dst)>>(strtol(v, nullptr, 10));
+      return true;
+    };
+    bool ok = true;
+    if (arg == "--host")
+    {
+      const char *v = value();
+      ok = v != nullptr;
+      if (ok)
+      {
+        opt.host = v;
+      }
+    }
+    else if (arg == "--path")
+    {
+      const char *v = value();
+      ok = v != nullptr;
+      if (ok)
+      {
+        opt.path = v;
+      }
+    }
+    else if (arg == "--wav")
+    {
+      const char *v = value();
+      ok = v != nullptr;
+      if (ok)
+      {
+        opt.wavs.emplace_back(v);
+      }
+    }
+    else if (arg == "--port")
+      ok = number(opt.port);
+    else if (arg == "--robots")
+      ok = number(opt.robots);
+    else if (arg == "--duration")
+      ok = number(opt.duration_s);
+    else if (arg == "--synthetic-ms")
+      ok = number(opt.synthetic_ms);
+    else if (arg == "--tail-silence-ms")
+      ok = number(opt.tail_silence_ms);
+    else if (arg == "--chunk-ms")
+      ok = number(opt.chunk_ms);
+    else if (arg == "--think-ms")
+      ok = number(opt.think_ms);
+    else if (arg == "--ramp-ms")
+      ok = number(opt.ramp_ms);
+    else if (arg == "--turn-timeout-ms")
+      ok = number(opt.turn_timeout_ms);
+    else if (arg == "--no-bind")
+      opt.bind_loopback = false;
+    else if (arg == "--verbose")
+      opt.verbose = true;
+    else
+      ok = false;
+    if (!ok)
+    {
+      usage();
+      return false;
+    }
+  }
+  opt.chunk_ms = std::max<uint32_t>(opt.chunk_ms, 10);
+  return opt.robots > 0 && opt.robots < 65000;
+}
+
+volatile sig_atomic_t g_stop = 0;
+
+void printPercentiles(const char *label, const Percentiles &p)
+{
+  printf("%-34s n=%-6zu p50=%-6u p90=%-6u p99=%-6u max=%u\n", label, p.count, p.p50, p.p90, p.p99, p.max);
+}
+} // namespace
+
+// misc/host_test/test_loadgen.cpp はこのファイルを取り込み、main の代わりに偽のサーバーと Robot を回す
+#ifndef STACKCHAN_LOADGEN_NO_MAIN
+int main(int argc, char **argv)
+{
+  Options opt;
+  if (!parseOptions(argc, argv, opt))
+  {
+    return 2;
+  }
+
+  std::vector<Utterance> utterances;
+  for (const std::string &path : opt.wavs)
+  {
+    Utterance u;
+    if (!loadWav(path, u))
+    {
+      return 1;
+    }
+    utterances.push_back(std::move(u));
+  }
+  if (utterances.empty())
+  {
+    utterances.push_back(syntheticUtterance(opt.synthetic_ms));
+  }
+
+  addrinfo hints{};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo *resolved = nullptr;
+  if (getaddrinfo(opt.host.c_str(), nullptr, &hints, &resolved) != 0 || resolved == nullptr)
+  {
+    fprintf(stderr, "cannot resolve %s\n", opt.host.c_str());
+    return 1;
+  }
+  sockaddr_in server{};
+  memcpy(&server, resolved->ai_addr, sizeof(server));
+  server.sin_port = htons(static_cast<uint16_t>(opt.port));
+  freeaddrinfo(resolved);
+
+  signal(SIGINT, [](int) { g_stop = 1; });
+  signal(SIGPIPE, SIG_IGN);
+  g_rng ^= static_cast<uint32_t>(nowMs()) * 2654435761u;
+
+  int epfd = epoll_create1(EPOLL_CLOEXEC);
+  std::vector<std::unique_ptr<Robot>> robots;
+  uint64_t start = nowMs();
+  for (int i = 0; i < opt.robots; ++i)
+  {
+    robots.emplace_back(new Robot(i, opt, utterances, server));
+    robots.back()->start(start + static_cast<uint64_t>(opt.ramp_ms) * i / opt.robots);
+  }
+  printf("stackchan_loadgen: %d robots -> %s:%d%s for %u s\n", opt.robots, opt.host.c_str(), opt.port,
+         opt.path.c_str(), opt.duration_s);
+
+  // 1 台あたりの処理は軽いので、期限の管理はせずに数 ms ごとに全台を回す
+  uint64_t end = start + static_cast<uint64_t>(opt.duration_s) * 1000;
+  std::array<epoll_event, 256> events{};
+  uint64_t now = start;
+  while (!g_stop && now < end)
+  {
+    int n = epoll_wait(epfd, events.data(), static_cast<int>(events.size()), 5);
+    now = nowMs();
+    for (int i = 0; i < n; ++i)
+    {
+      auto *robot = static_cast<Robot *>(events[i].data.ptr);
+      robot->onEvent(events[i].events, now, epfd);
+    }
+    for (auto &robot : robots)
+    {
+      robot->tick(now, epfd);
+    }
+  }
+  double elapsed_s = static_cast<double>(nowMs() - start) / 1000.0;
+  for (auto &robot : robots)
+  {
+    robot->shutdown();
+  }
+  close(epfd);
+
+  // ---- 結果 ----
+  std::vector<uint32_t> all_response, all_turn;
+  uint32_t started = 0, timed_out = 0, no_reply = 0, turns_dropped = 0, dropped = 0, connect_failures = 0;
+  printf("\nper robot (ms)                     turns  response p50/p90/p99     turn p50/p90/p99        drops\n");
+  for (size_t i = 0; i < robots.size(); ++i)
+  {
+    const Robot &r = *robots[i];
+    Percentiles resp = percentiles(r.response_ms);
+    Percentiles turn = percentiles(r.turn_ms);
+    printf("  robot %-5zu %24u  %6u/%6u/%6u   %6u/%6u/%6u   %u\n", i, static_cast<unsigned>(r.turn_ms.size()),
+           resp.p50, resp.p90, resp.p99, turn.p50, turn.p90, turn.p99, r.dropped_sessions);
+    all_response.insert(all_response.end(), r.response_ms.begin(), r.response_ms.end());
+    all_turn.insert(all_turn.end(), r.turn_ms.begin(), r.turn_ms.end());
+    started += r.turns_started;
+    timed_out += r.turns_timed_out;
+    no_reply += r.turns_without_reply;
+    turns_dropped += r.turns_dropped;
+    dropped += r.dropped_sessions;
+    connect_failures += r.connect_failures;
+  }
+
+  printf("\nsummary (%.1f s, %d robots)\n", elapsed_s, opt.robots);
+  printPercentiles("response ms (END -> first audio)", percentiles(all_response));
+  printPercentiles("turn ms (wake word -> speak done)", percentiles(all_turn));
+  printf("turns: started=%u completed=%zu no_reply=%u timed_out=%u dropped=%u\n", started, all_turn.size(), no_reply,
+         timed_out, turns_dropped);
+  printf("sessions: dropped=%u connect_failures=%u\n", dropped, connect_failures);
+  printf("server -> robots: %llu frames (%.1f/s) %.1f kbit/s, %llu text\n",
+         static_cast<unsigned long long>(g_stats.rx_frames), g_stats.rx_frames / elapsed_s,
+         g_stats.rx_bytes * 8.0 / 1000.0 / elapsed_s, static_cast<unsigned long long>(g_stats.rx_text_frames));
+  for (size_t kind = 0; kind < g_stats.rx_frames_by_kind.size(); ++kind)
+  {
+    if (g_stats.rx_frames_by_kind[kind] > 0)
+    {
+      printf("  kind %-3zu %-12s %llu\n", kind, kindName(static_cast<uint8_t>(kind)),
+             static_cast<unsigned long long>(g_stats.rx_frames_by_kind[kind]));
+    }
+  }
+  printf("robots -> server: %llu frames (%.1f/s) %.1f kbit/s\n", static_cast<unsigned long long>(g_stats.tx_frames),
+         g_stats.tx_frames / elapsed_s, g_stats.tx_bytes * 8.0 / 1000.0 / elapsed_s);
+  return dropped > 0 || timed_out > 0 ? 1 : 0;
+}
+#endif
@@ -0,0 +1,27 @@
+#pragma once
+
+// ws_replay 用の ESP32Servo の代わり。最後に書いた角度と書き込み回数だけを持つ
+
+class Servo
+{
+public:
+  void setPeriodHertz(int hz) { (void)hz; }
+  int attach(int pin, int min_us, int max_us)
+  {
+    (void)min_us;
+    (void)max_us;
+    return pin + 1;
+  }
+  void write(int degree)
+  {
+    degree_ = degree;
+    writes_++;
+  }
+
+  int degree() const { return degree_; }
+  unsigned long writes() const { return writes_; }
+
+private:
+  int degree_ = 90;
+  unsigned long writes_ = 0;
+};
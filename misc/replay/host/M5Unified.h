@@ -0,0 +1,380 @@
+#pragma once
+
+// ws_replay と misc/host_test 用の M5Unified の代わり。ファームウェアの部品が使う分だけを
+// 仮想時計（replay_host::now_us）の上で実装する
+//  - millis() / micros() は仮想時計を返し、delay() は仮想時計を進める
+//  - Speaker はチャンネルごとに「再生中」と「次」の 2 本まで積め、再生時間が経つと終わる。
+//    record_output を立てると、積んだ音と鳴り始める時刻を played に残す（再生の継ぎ目を調べる）
+//  - Display と M5Canvas は描画せず、バックライトの明るさ、最後に書いた文字列（gfx_text）、DMA の転送量だけを残す
+//  - Arduino.h と同じく FreeRTOS のタスク（freertos/task.h の模型）と random() も見せる
+//  - log_* はリプレイの集計（警告の件数）と --verbose の出力に回す
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <chrono>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace replay_host
+{
+extern uint64_t now_us;
+
+// level は 'E' / 'W' / 'I' / 'D'。fmt は件数の集計キーにも使う
+void log(char level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+} // namespace replay_host
+
+inline uint32_t millis()
+{
+  return static_cast<uint32_t>(replay_host::now_us / 1000);
+}
+
+inline uint32_t micros()
+{
+  return static_cast<uint32_t>(replay_host::now_us);
+}
+
+inline void delay(uint32_t ms)
+{
+  replay_host::now_us += static_cast<uint64_t>(ms) * 1000;
+}
+
+inline long random(long min, long max)
+{
+  return max > min ? min + std::rand() % (max - min) : min;
+}
+
+#define log_e(fmt, ...) replay_host::log('E', fmt, ##__VA_ARGS__)
+#define log_w(fmt, ...) replay_host::log('W', fmt, ##__VA_ARGS__)
+#define log_i(fmt, ...) replay_host::log('I', fmt, ##__VA_ARGS__)
+#define log_d(fmt, ...) replay_host::log('D', fmt, ##__VA_ARGS__)
+
+// マイクは I2S の DMA を模す。サンプルは仮想時計に沿って sample_rate で溜まり、
+// record() は len サンプル揃うまで仮想時計を進めて待つ。kDmaSamples より古い分は上書きされて失われる
+// （loop() が長く止まったときのオーバーラン）。値はサンプルの通し番号の下位 16 bit（欠けや重複を見分けられる）。
+// value_modulo を 0 以外にすると通し番号をその値で割った余りになる（小さくすれば無音として扱われる）
+class Mic_Class
+{
+public:
+  static constexpr size_t kDmaSamples = 8 * 256; // dma_buf_count 8 x dma_buf_len 256
+
+  bool begin()
+  {
+    enabled_ = true;
+    started_ = false;
+    return true;
+  }
+  void end() { enabled_ = false; }
+  bool isEnabled() const { return enabled_; }
+
+  bool record(int16_t *data, size_t len, uint32_t sample_rate, bool stereo = false)
+  {
+    if (!enabled_ || sample_rate == 0)
+    {
+      return false;
+    }
+    size_t frames = stereo ? len / 2 : len;
+    uint64_t produced = replay_host::now_us * sample_rate / 1000000;
+    if (!started_)
+    {
+      next_ = produced; // begin() の後に最初に読んだ時点から録る
+      started_ = true;
+    }
+    if (produced > next_ + kDmaSamples)
+    {
+      overrun_samples += produced - kDmaSamples - next_;
+      next_ = produced - kDmaSamples;
+    }
+    if (next_ + frames > produced)
+    {
+      replay_host::now_us = ((next_ + frames) * 1000000 + sample_rate - 1) / sample_rate;
+    }
+    for (size_t i = 0; i < frames; ++i)
+    {
+      uint64_t n = value_modulo != 0 ? (next_ + i) % value_modulo : next_ + i;
+      int16_t v = static_cast<int16_t>(static_cast<uint16_t>(n));
+      if (stereo)
+      {
+        data[2 * i] = v;
+        data[2 * i + 1] = v;
+      }
+      else
+      {
+        data[i] = v;
+      }
+    }
+    next_ += frames;
+    return true;
+  }
+
+  // 上書きされて読めなかったサンプル数（begin() をまたいで数える）
+  uint64_t overrun_samples = 0;
+  uint16_t value_modulo = 0;
+
+private:
+  bool enabled_ = false;
+  bool started_ = false;
+  uint64_t next_ = 0; // 次に読むサンプルの通し番号
+};
+
+class Speaker_Class
+{
+public:
+  static constexpr size_t kChannels = 8;
+  static constexpr size_t kQueueDepth = 2; // 再生中 + 次
+
+  // 積んだ 1 本。start_us はその音が鳴り始める時刻
+  struct Played
+  {
+    int channel = 0;
+    uint64_t start_us = 0;
+    uint32_t sample_rate = 0;
+    bool stereo = false;
+    std::vector<int16_t> samples;
+  };
+
+  // stop_current=false なら前の音の直後から鳴らす。積めなければ false
+  bool playRaw(const int16_t *data, size_t len, uint32_t sample_rate, bool stereo = false, uint32_t repeat = 1,
+               int channel = -1, bool stop_current = false)
+  {
+    if (channel < 0 || static_cast<size_t>(channel) >= kChannels || sample_rate == 0)
+    {
+      return false;
+    }
+    Channel &ch = channels_[channel];
+    prune(ch);
+    if (stop_current)
+    {
+      ch.count = 0;
+    }
+    if (ch.count >= kQueueDepth)
+    {
+      return false;
+    }
+    uint64_t frames = static_cast<uint64_t>(len) / (stereo ? 2 : 1) * repeat;
+    uint64_t start = ch.count == 0 ? replay_host::now_us : ch.end_us[ch.count - 1];
+    ch.end_us[ch.count++] = start + frames * 1000000 / sample_rate;
+    if (record_output)
+    {
+      Played p{channel, start, sample_rate, stereo, {}};
+      for (uint32_t r = 0; r < repeat; ++r)
+      {
+        p.samples.insert(p.samples.end(), data, data + len);
+      }
+      played.push_back(std::move(p));
+    }
+    return true;
+  }
+
+  // 0: 無音, 1: 再生中, 2: 再生中で次も積まれている
+  size_t isPlaying(uint8_t channel) const
+  {
+    if (channel >= kChannels)
+    {
+      return 0;
+    }
+    prune(channels_[channel]);
+    return channels_[channel].count;
+  }
+
+  bool isPlaying() const
+  {
+    for (uint8_t ch = 0; ch < kChannels; ++ch)
+    {
+      if (isPlaying(ch) != 0)
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void stop()
+  {
+    for (Channel &ch : channels_)
+    {
+      ch.count = 0;
+    }
+  }
+
+  void end() { stop(); }
+
+  bool record_output = false;
+  std::vector<Played> played;
+
+private:
+  // 積まれた音の再生が終わる時刻（仮想時計）
+  struct Channel
+  {
+    uint64_t end_us[kQueueDepth] = {};
+    size_t count = 0;
+  };
+
+  static void prune(Channel &ch)
+  {
+    while (ch.count > 0 && ch.end_us[0] <= replay_host::now_us)
+    {
+      ch.end_us[0] = ch.end_us[1];
+      ch.count--;
+    }
+  }
+
+  mutable Channel channels_[kChannels];
+};
+
+// ESP.getCycleCount() はホストの経過時間を 240 MHz のサイクルに換算して返す
+struct EspClass
+{
+  uint32_t getCycleCount() const
+  {
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch());
+    return static_cast<uint32_t>(static_cast<uint64_t>(ns.count()) * 240 / 1000);
+  }
+};
+
+inline EspClass ESP;
+
+namespace lgfx
+{
+struct IFont
+{
+};
+
+struct swap565_t
+{
+  uint16_t raw = 0;
+};
+} // namespace lgfx
+
+namespace fonts
+{
+inline const lgfx::IFont Font2{};
+} // namespace fonts
+
+constexpr uint16_t TFT_BLACK = 0x0000;
+constexpr uint16_t TFT_BLUE = 0x001F;
+constexpr uint16_t TFT_RED = 0xF800;
+constexpr uint16_t TFT_GREEN = 0x07E0;
+constexpr uint16_t TFT_ORANGE = 0xFDA0;
+constexpr uint16_t TFT_DARKGRAY = 0x7BEF;
+constexpr uint16_t TFT_WHITE = 0xFFFF;
+
+namespace replay_host
+{
+inline std::string gfx_text; // Display か M5Canvas に最後に printf() した文字列
+} // namespace replay_host
+
+// 図形は描かない
+class LovyanGFX
+{
+public:
+  virtual ~LovyanGFX() = default;
+
+  void fillScreen(uint16_t color) { (void)color; }
+  void fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t color)
+  {
+    (void)x;
+    (void)y;
+    (void)w;
+    (void)h;
+    (void)color;
+  }
+  void fillEllipse(int32_t x, int32_t y, int32_t rx, int32_t ry, uint16_t color)
+  {
+    (void)x;
+    (void)y;
+    (void)rx;
+    (void)ry;
+    (void)color;
+  }
+  void setFont(const lgfx::IFont *font) { (void)font; }
+  void setTextSize(float size) { (void)size; }
+  void setTextColor(uint16_t fg, uint16_t bg)
+  {
+    (void)fg;
+    (void)bg;
+  }
+  void setCursor(int32_t x, int32_t y)
+  {
+    (void)x;
+    (void)y;
+  }
+  size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)))
+  {
+    char line[64];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    replay_host::gfx_text = line;
+    return n > 0 ? static_cast<size_t>(n) : 0;
+  }
+};
+
+// pushImageDMA() はクリップ矩形の分だけ転送したとみなして数える。waitDMA() は描画したフレームの数になる
+class Display_Class : public LovyanGFX
+{
+public:
+  uint8_t getBrightness() const { return brightness_; }
+  void setBrightness(uint8_t brightness) { brightness_ = brightness; }
+
+  void clear() {}
+  void startWrite() {}
+  void endWrite() {}
+  void waitDMA() { dma_waits++; }
+  void setClipRect(int32_t x, int32_t y, int32_t w, int32_t h)
+  {
+    (void)x;
+    (void)y;
+    clip_pixels_ = static_cast<uint64_t>(w) * static_cast<uint64_t>(h);
+  }
+  void clearClipRect() { clip_pixels_ = 0; }
+  void pushImageDMA(int32_t x, int32_t y, int32_t w, int32_t h, const lgfx::swap565_t *data)
+  {
+    (void)x;
+    (void)y;
+    (void)data;
+    uint64_t pixels = static_cast<uint64_t>(w) * static_cast<uint64_t>(h);
+    dma_bytes += (clip_pixels_ != 0 && clip_pixels_ < pixels ? clip_pixels_ : pixels) * sizeof(uint16_t);
+  }
+
+  uint64_t dma_waits = 0;
+  uint64_t dma_bytes = 0;
+
+private:
+  uint8_t brightness_ = 128;
+  uint64_t clip_pixels_ = 0;
+};
+
+// ホストのメモリにバックバッファを取るだけのスプライト
+class M5Canvas : public LovyanGFX
+{
+public:
+  explicit M5Canvas(LovyanGFX *parent) { (void)parent; }
+
+  void setColorDepth(int bits) { (void)bits; }
+  void setPsram(bool enabled) { (void)enabled; }
+  void *createSprite(int32_t w, int32_t h)
+  {
+    buffer_.assign(static_cast<size_t>(w) * static_cast<size_t>(h), lgfx::swap565_t{});
+    return buffer_.data();
+  }
+  void *getBuffer() { return buffer_.data(); }
+
+private:
+  std::vector<lgfx::swap565_t> buffer_;
+};
+
+struct M5Unified
+{
+  Display_Class Display;
+  Mic_Class Mic;
+  Speaker_Class Speaker;
+};
+
+extern M5Unified M5;
@@ -0,0 +1,138 @@
+#pragma once
+
+// ホストテスト用の WiFi.h の代わり。ws_client.cpp と listening.cpp が使う分だけを、テストから操作できる偽のソケットで実装する
+//  - WiFi.status() は replay_host::wifi_status、WiFi.RSSI() は replay_host::wifi_rssi を返し、
+//    WiFi.setSleep() は replay_host::wifi_sleep に残す
+//  - WiFiClient はどれも replay_host::socket を共有する。rx に積んだバイトが届いたことになり、
+//    write() したバイトは tx に溜まる
+//  - connect() は connect_delay_ms だけ仮想時計を進めてから accept を返す（同期の connect のブロックを模す）
+//  - write() は 1 回ごとに write_delay_us だけ仮想時計を進める（TCP の送信窓が埋まって待たされるのを模す）
+//  - fail_write が長さを見て true を返した write() は失敗し、相手が落ちたことになる（送信途中の切断を模す）
+
+#include <M5Unified.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+enum wifi_ps_type_t
+{
+  WIFI_PS_NONE,
+  WIFI_PS_MIN_MODEM,
+  WIFI_PS_MAX_MODEM,
+};
+
+enum wl_status_t
+{
+  WL_IDLE_STATUS = 0,
+  WL_CONNECTED = 3,
+  WL_DISCONNECTED = 6,
+};
+
+namespace replay_host
+{
+struct FakeSocket
+{
+  bool accept = true;
+  uint32_t connect_delay_ms = 0;
+  uint32_t write_delay_us = 0;
+  std::function<bool(size_t)> fail_write;
+  bool open = false;
+  std::deque<uint8_t> rx;
+  std::vector<uint8_t> tx;
+  size_t connects = 0;
+  size_t writes = 0;
+
+  void push(const uint8_t *data, size_t len) { rx.insert(rx.end(), data, data + len); }
+  // 相手が切ったときと同じく、次の connected() から 0 を返す
+  void drop()
+  {
+    open = false;
+    rx.clear();
+  }
+};
+
+inline FakeSocket socket;
+inline wl_status_t wifi_status = WL_CONNECTED;
+inline int8_t wifi_rssi = -50;
+inline wifi_ps_type_t wifi_sleep = WIFI_PS_NONE;
+} // namespace replay_host
+
+class WiFiClass
+{
+public:
+  wl_status_t status() { return replay_host::wifi_status; }
+  int8_t RSSI() { return replay_host::wifi_rssi; }
+  bool setSleep(wifi_ps_type_t type)
+  {
+    replay_host::wifi_sleep = type;
+    return true;
+  }
+};
+
+inline WiFiClass WiFi;
+
+class WiFiClient
+{
+public:
+  int connect(const char *host, uint16_t port, int32_t timeout_ms)
+  {
+    (void)host;
+    (void)port;
+    replay_host::FakeSocket &s = replay_host::socket;
+    s.connects++;
+    delay(std::min<uint32_t>(s.connect_delay_ms, static_cast<uint32_t>(timeout_ms)));
+    s.open = s.accept;
+    s.rx.clear();
+    return s.open ? 1 : 0;
+  }
+
+  void stop() { replay_host::socket.open = false; }
+  uint8_t connected() { return replay_host::socket.open ? 1 : 0; }
+  int available() { return replay_host::socket.open ? static_cast<int>(replay_host::socket.rx.size()) : 0; }
+
+  int read()
+  {
+    uint8_t c = 0;
+    return read(&c, 1) == 1 ? c : -1;
+  }
+
+  int read(uint8_t *buf, size_t size)
+  {
+    replay_host::FakeSocket &s = replay_host::socket;
+    size_t n = s.open ? std::min(size, s.rx.size()) : 0;
+    std::copy_n(s.rx.begin(), n, buf);
+    s.rx.erase(s.rx.begin(), s.rx.begin() + static_cast<std::ptrdiff_t>(n));
+    return n > 0 ? static_cast<int>(n) : -1;
+  }
+
+  size_t write(const uint8_t *buf, size_t size)
+  {
+    replay_host::FakeSocket &s = replay_host::socket;
+    if (!s.open)
+    {
+      return 0;
+    }
+    if (s.fail_write && s.fail_write(size))
+    {
+      s.drop();
+      return 0;
+    }
+    s.writes++;
+    replay_host::now_us += s.write_delay_us;
+    s.tx.insert(s.tx.end(), buf, buf + size);
+    return size;
+  }
+
+  // select() で待てるソケットは無い
+  int fd() const { return -1; }
+
+  int setNoDelay(bool nodelay)
+  {
+    (void)nodelay;
+    return 0;
+  }
+};
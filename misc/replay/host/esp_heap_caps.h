@@ -0,0 +1,17 @@
+#pragma once
+
+// ws_replay 用の esp_heap_caps.h の代わり。空き容量は ESP32-S3 の内部 RAM を模した固定の大きさから
+// リプレイ中に確保されている量（operator new と heap_caps_malloc の合計）を引いたもの
+
+#include <cstddef>
+#include <cstdint>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_DEFAULT (1 << 12)
+
+void *heap_caps_malloc(size_t size, uint32_t caps);
+void heap_caps_free(void *ptr);
+size_t heap_caps_get_free_size(uint32_t caps);
+size_t heap_caps_get_largest_free_block(uint32_t caps);
@@ -0,0 +1,79 @@
+#pragma once
+
+// ホストテスト用の esp_pm.h の代わり。power.cpp が使う CPU 周波数のロックだけを数える
+//  - CONFIG_PM_ENABLE を立て、esp_pm_configure() の max/min とロックの数から周波数が決まる
+//  - Arduino では esp32-hal-cpu.h にある getCpuFrequencyMhz() も、ここでその周波数を返す
+
+#include <cstdint>
+
+#ifndef CONFIG_PM_ENABLE
+#define CONFIG_PM_ENABLE 1
+#endif
+
+typedef int esp_err_t;
+#define ESP_OK 0
+
+typedef enum
+{
+  ESP_PM_CPU_FREQ_MAX,
+  ESP_PM_APB_FREQ_MAX,
+  ESP_PM_NO_LIGHT_SLEEP,
+} esp_pm_lock_type_t;
+
+typedef struct
+{
+  int max_freq_mhz;
+  int min_freq_mhz;
+  bool light_sleep_enable;
+} esp_pm_config_t;
+
+struct esp_pm_lock
+{
+  int held = 0;
+};
+typedef esp_pm_lock *esp_pm_lock_handle_t;
+
+namespace replay_host
+{
+inline esp_pm_config_t pm_config{240, 240, false};
+inline esp_pm_lock pm_cpu_lock;
+} // namespace replay_host
+
+inline esp_err_t esp_pm_configure(const void *config)
+{
+  replay_host::pm_config = *static_cast<const esp_pm_config_t *>(config);
+  return ESP_OK;
+}
+
+inline esp_err_t esp_pm_lock_create(esp_pm_lock_type_t type, int arg, const char *name, esp_pm_lock_handle_t *out)
+{
+  (void)type;
+  (void)arg;
+  (void)name;
+  replay_host::pm_cpu_lock = {};
+  *out = &replay_host::pm_cpu_lock;
+  return ESP_OK;
+}
+
+inline esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t lock)
+{
+  lock->held++;
+  return ESP_OK;
+}
+
+inline esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t lock)
+{
+  lock->held--;
+  return ESP_OK;
+}
+
+inline const char *esp_err_to_name(esp_err_t err)
+{
+  return err == ESP_OK ? "ESP_OK" : "ESP_FAIL";
+}
+
+inline uint32_t getCpuFrequencyMhz()
+{
+  const esp_pm_config_t &cfg = replay_host::pm_config;
+  return static_cast<uint32_t>(replay_host::pm_cpu_lock.held > 0 ? cfg.max_freq_mhz : cfg.min_freq_mhz);
+}
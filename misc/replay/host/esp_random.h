@@ -0,0 +1,29 @@
+#pragma once
+
+// ホストテスト用の esp_random.h の代わり。結果を再現できるよう固定の種の xorshift を返す
+
+#include <cstddef>
+#include <cstdint>
+
+namespace replay_host
+{
+inline uint32_t random_state = 0x12345678;
+} // namespace replay_host
+
+inline uint32_t esp_random()
+{
+  uint32_t &x = replay_host::random_state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return x;
+}
+
+inline void esp_fill_random(void *buf, size_t len)
+{
+  uint8_t *out = static_cast<uint8_t *>(buf);
+  for (size_t i = 0; i < len; ++i)
+  {
+    out[i] = static_cast<uint8_t>(esp_random());
+  }
+}
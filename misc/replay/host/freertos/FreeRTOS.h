@@ -0,0 +1,16 @@
+#pragma once
+
+// ws_replay と misc/host_test 用の FreeRTOS の代わり（型と定数）。タスクは freertos/task.h
+// ティックは 1 ms（portTICK_PERIOD_MS）で、仮想時計（replay_host::now_us）から数える
+
+#include <cstdint>
+
+using BaseType_t = int;
+using UBaseType_t = unsigned int;
+using TickType_t = uint32_t;
+
+constexpr BaseType_t pdFAIL = 0;
+constexpr BaseType_t pdPASS = 1;
+constexpr TickType_t portTICK_PERIOD_MS = 1;
+
+#define pdMS_TO_TICKS(ms) (static_cast<TickType_t>(ms) / portTICK_PERIOD_MS)
@@ -0,0 +1,164 @@
+#pragma once
+
+// ws_replay と misc/host_test 用の FreeRTOS のタスクの代わり
+//  - xTaskCreatePinnedToCore() のタスクはスレッドで動かすが、loop() 側と同時には走らせない。
+//    replay_host::runTasks() を呼ぶと、起床時刻（仮想時計）を過ぎたタスクに実行権を渡し、
+//    次の vTaskDelayUntil() まで進めてから戻る
+//  - タスクは別のコアで動くものとみなし、タスクの中では仮想時計を進めない（loop() 側の時間を奪わない）
+//  - replay_host::stopTasks() は、待っているタスクを vTaskDelayUntil() から抜けさせて終わらせ、スレッドを回収する
+
+#include "FreeRTOS.h"
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace replay_host
+{
+extern uint64_t now_us;
+
+struct Task
+{
+  void (*entry)(void *) = nullptr;
+  void *arg = nullptr;
+  uint64_t wake_us = 0;  // 次に実行権を渡す仮想時刻
+  bool running = false;  // 実行権を持っている
+  bool stopping = false;
+  bool finished = false;
+  std::thread thread;
+};
+
+// 止めるときに vTaskDelayUntil() から投げて、タスクの関数を抜ける
+struct TaskStopped
+{
+};
+
+struct TaskScheduler
+{
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::vector<std::unique_ptr<Task>> tasks;
+};
+
+inline TaskScheduler scheduler;
+inline thread_local Task *current_task = nullptr;
+inline bool fail_task_create = false; // true にすると xTaskCreatePinnedToCore() が失敗する
+
+inline void waitForTurn(std::unique_lock<std::mutex> &lock, Task &task)
+{
+  scheduler.cv.wait(lock, [&]() { return task.running || task.stopping; });
+  if (task.stopping)
+  {
+    throw TaskStopped{};
+  }
+}
+
+inline void taskThread(Task *task)
+{
+  current_task = task;
+  try
+  {
+    {
+      std::unique_lock<std::mutex> lock(scheduler.mutex);
+      waitForTurn(lock, *task);
+    }
+    task->entry(task->arg);
+  }
+  catch (const TaskStopped &)
+  {
+  }
+  std::lock_guard<std::mutex> lock(scheduler.mutex);
+  task->running = false;
+  task->finished = true;
+  scheduler.cv.notify_all();
+}
+
+// loop() の 1 周ごとに呼ぶ
+inline void runTasks()
+{
+  std::unique_lock<std::mutex> lock(scheduler.mutex);
+  for (auto &task : scheduler.tasks)
+  {
+    while (!task->finished && task->wake_us <= now_us)
+    {
+      task->running = true;
+      scheduler.cv.notify_all();
+      scheduler.cv.wait(lock, [&]() { return !task->running; });
+    }
+  }
+}
+
+inline void stopTasks()
+{
+  std::vector<std::unique_ptr<Task>> tasks;
+  {
+    std::lock_guard<std::mutex> lock(scheduler.mutex);
+    for (auto &task : scheduler.tasks)
+    {
+      task->stopping = true;
+    }
+    tasks.swap(scheduler.tasks);
+    scheduler.cv.notify_all();
+  }
+  for (auto &task : tasks)
+  {
+    task->thread.join();
+  }
+}
+} // namespace replay_host
+
+using TaskHandle_t = replay_host::Task *;
+using TaskFunction_t = void (*)(void *);
+
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t entry, const char *name, uint32_t stack_depth, void *arg,
+                                          UBaseType_t priority, TaskHandle_t *handle, BaseType_t core)
+{
+  (void)name;
+  (void)stack_depth;
+  (void)priority;
+  (void)core;
+  if (replay_host::fail_task_create)
+  {
+    return pdFAIL;
+  }
+  auto task = std::make_unique<replay_host::Task>();
+  task->entry = entry;
+  task->arg = arg;
+  task->wake_us = replay_host::now_us;
+  task->thread = std::thread(replay_host::taskThread, task.get());
+  if (handle != nullptr)
+  {
+    *handle = task.get();
+  }
+  std::lock_guard<std::mutex> lock(replay_host::scheduler.mutex);
+  replay_host::scheduler.tasks.push_back(std::move(task));
+  return pdPASS;
+}
+
+inline TickType_t xTaskGetTickCount()
+{
+  return static_cast<TickType_t>(replay_host::now_us / 1000 / portTICK_PERIOD_MS);
+}
+
+inline void vTaskDelayUntil(TickType_t *previous_wake, TickType_t increment)
+{
+  *previous_wake += increment;
+  uint64_t wake_us = static_cast<uint64_t>(*previous_wake) * portTICK_PERIOD_MS * 1000;
+  replay_host::Task *task = replay_host::current_task;
+  if (task == nullptr)
+  {
+    // loop() 側から呼ばれたら、仮想時計を進めて待つ
+    if (wake_us > replay_host::now_us)
+    {
+      replay_host::now_us = wake_us;
+    }
+    return;
+  }
+  std::unique_lock<std::mutex> lock(replay_host::scheduler.mutex);
+  task->wake_us = wake_us;
+  task->running = false;
+  replay_host::scheduler.cv.notify_all();
+  replay_host::waitForTurn(lock, *task);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+// ホストテスト用の mbedtls/base64.h の代わり（エンコードのみ。戻り値と olen は mbedtls と同じ意味）
+
+#include <cstddef>
+
+#define MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL -0x002A
+
+inline int mbedtls_base64_encode(unsigned char *dst, size_t dlen, size_t *olen, const unsigned char *src, size_t slen)
+{
+  static const char kTable[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  size_t need = (slen + 2) / 3 * 4;
+  if (dlen < need + 1)
+  {
+    *olen = need + 1;
+    return MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL;
+  }
+  size_t o = 0;
+  for (size_t i = 0; i < slen; i += 3)
+  {
+    unsigned v = static_cast<unsigned>(src[i]) << 16;
+    v |= i + 1 < slen ? static_cast<unsigned>(src[i + 1]) << 8 : 0;
+    v |= i + 2 < slen ? src[i + 2] : 0;
+    dst[o++] = kTable[(v >> 18) & 0x3F];
+    dst[o++] = kTable[(v >> 12) & 0x3F];
+    dst[o++] = i + 1 < slen ? kTable[(v >> 6) & 0x3F] : '=';
+    dst[o++] = i + 2 < slen ? kTable[v & 0x3F] : '=';
+  }
+  dst[o] = '\0';
+  *olen = o;
+  return 0;
+}
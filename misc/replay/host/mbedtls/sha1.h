@@ -0,0 +1,97 @@
+#pragma once
+
+// ホストテスト用の mbedtls/sha1.h の代わり（一括計算の mbedtls_sha1 のみ）
+
+#include <cstddef>
+#include <cstdint>
+
+inline int mbedtls_sha1(const unsigned char *input, size_t ilen, unsigned char output[20])
+{
+  uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+  auto rol = [](uint32_t x, int n) { return (x << n) | (x >> (32 - n)); };
+
+  // 末尾に 0x80・0 埋め・ビット長（big endian 64 bit）を付けて 64 バイト単位で処理する
+  size_t total = (ilen + 8) / 64 * 64 + 64;
+  uint64_t bits = static_cast<uint64_t>(ilen) * 8;
+  for (size_t block = 0; block < total; block += 64)
+  {
+    uint8_t buf[64];
+    for (size_t i = 0; i < 64; ++i)
+    {
+      size_t pos = block + i;
+      if (pos < ilen)
+      {
+        buf[i] = input[pos];
+      }
+      else if (pos == ilen)
+      {
+        buf[i] = 0x80;
+      }
+      else if (pos >= total - 8)
+      {
+        buf[i] = static_cast<uint8_t>(bits >> (8 * (total - 1 - pos)));
+      }
+      else
+      {
+        buf[i] = 0;
+      }
+    }
+
+    uint32_t w[80];
+    for (int t = 0; t < 16; ++t)
+    {
+      w[t] = (static_cast<uint32_t>(buf[4 * t]) << 24) | (static_cast<uint32_t>(buf[4 * t + 1]) << 16) |
+             (static_cast<uint32_t>(buf[4 * t + 2]) << 8) | buf[4 * t + 3];
+    }
+    for (int t = 16; t < 80; ++t)
+    {
+      w[t] = rol(w[t - 3] ^ w[t - 8] ^ w[t - 14] ^ w[t - 16], 1);
+    }
+
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int t = 0; t < 80; ++t)
+    {
+      uint32_t f, k;
+      if (t < 20)
+      {
+        f = (b & c) | (~b & d);
+        k = 0x5A827999;
+      }
+      else if (t < 40)
+      {
+        f = b ^ c ^ d;
+        k = 0x6ED9EBA1;
+      }
+      else if (t < 60)
+      {
+        f = (b & c) | (b & d) | (c & d);
+        k = 0x8F1BBCDC;
+      }
+      else
+      {
+        f = b ^ c ^ d;
+        k = 0xCA62C1D6;
+      }
+      uint32_t temp = rol(a, 5) + f + e + k + w[t];
+      e = d;
+      d = c;
+      c = rol(b, 30);
+      b = a;
+      a = temp;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+  }
+
+  for (int i = 0; i < 5; ++i)
+  {
+    output[4 * i] = static_cast<unsigned char>(h[i] >> 24);
+    output[4 * i + 1] = static_cast<unsigned char>(h[i] >> 16);
+    output[4 * i + 2] = static_cast<unsigned char>(h[i] >> 8);
+    output[4 * i + 3] = static_cast<unsigned char>(h[i]);
+  }
+  return 0;
+}
@@ -0,0 +1,1247 @@
+// StackChan の WebSocket の記録（.wscap）をファームウェアの処理に流し直し、時間とメモリを測るツール
+//  - 記録は端末（config.h の WS_CAPTURE_KB_H）かサーバー（StackChanApp の capture_dir）で取る。形式は protocols.hpp
+//  - 受信したメッセージを記録の時刻どおり、main.cpp の handleWsEvent / handleWsMessage と同じ順で
+//    StateMachine・Speaking・BodyServo に渡す。時計は仮想時計で、loop() の間隔も main.cpp の loopWaitMs に合わせる
+//  - 録音（Listening）とウェイクワードは動かさない。記録にある端末の AudioPcm END を無音検知として扱う
+//  - 結果: 記録の内訳、ターンごとの時間、記録との送信タイミングの差、ハンドラごとのホスト CPU 時間、
+//    ヒープの最大使用量、ファームウェアの警告
+//  - --soak では記録を何度も続けて流し、起動後（memory_plan::seal() 後）のヒープが増えないことを確かめる
+//
+// ビルド（Linux）:
+//   g++ -O2 -std=c++17 -I misc/replay/host -I firmware/include -o ws_replay misc/replay/ws_replay.cpp
+//       firmware/src/speaking.cpp firmware/src/servo.cpp firmware/src/state_machine.cpp firmware/src/memory_plan.cpp
+// 実行例:
+//   ./ws_replay captures/127.0.0.1-20261018-101500-123456-server.wscap
+//   ./ws_replay --repeat 20 field-device.wscap   # ホスト CPU 時間を何度か測り、結果が毎回同じかも確かめる
+//   ./ws_replay --soak 24 field-device.wscap      # 仮想時間で 24 時間流し続け、1 時間ごとのヒープを出す
+
+#include "memory_plan.hpp"
+#include "protocols.hpp"
+#include "servo.hpp"
+#include "speaking.hpp"
+#include "state_machine.hpp"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+// ---- ファームウェアから見えるホスト側の実装（host/*.h） ----
+
+uint64_t replay_host::now_us = 0;
+M5Unified M5;
+
+namespace
+{
+// ESP32-S3（PSRAM 8 MB + 内部 RAM）で使える量の目安。heap_caps_get_free_size はここから引いて返す
+constexpr size_t kHostHeapBytes = (8 * 1024 + 320) * 1024;
+constexpr size_t kAllocHeaderBytes = alignof(std::max_align_t);
+
+// ファームウェアのコードを実行している間の確保だけを数える（ツール自身の確保は除く）
+struct HeapStats
+{
+  bool tracking = false;
+  size_t in_use = 0;
+  size_t peak = 0;
+  uint64_t allocations = 0;
+};
+HeapStats g_heap;
+
+// ツール側の記録（送信の記録・ログの集計）をファームウェアの確保に数えない
+class UntrackedScope
+{
+public:
+  UntrackedScope() : saved_(g_heap.tracking) { g_heap.tracking = false; }
+  ~UntrackedScope() { g_heap.tracking = saved_; }
+
+private:
+  bool saved_;
+};
+
+struct AllocHeader
+{
+  size_t bytes;
+  bool tracked;
+};
+static_assert(sizeof(AllocHeader) <= kAllocHeaderBytes, "allocation header does not fit");
+
+// operator new / delete から malloc / free を呼ぶので、インライン展開させない（-Wmismatched-new-delete の誤検知）
+__attribute__((noinline)) void *trackedAlloc(size_t bytes, bool force_track)
+{
+  auto *raw = static_cast<uint8_t *>(malloc(bytes + kAllocHeaderBytes));
+  if (raw == nullptr)
+  {
+    return nullptr;
+  }
+  auto *header = reinterpret_cast<AllocHeader *>(raw);
+  header->bytes = bytes;
+  header->tracked = g_heap.tracking || force_track;
+  if (header->tracked)
+  {
+    g_heap.in_use += bytes;
+    g_heap.peak = std::max(g_heap.peak, g_heap.in_use);
+    g_heap.allocations++;
+  }
+  return raw + kAllocHeaderBytes;
+}
+
+__attribute__((noinline)) void trackedFree(void *ptr)
+{
+  if (ptr == nullptr)
+  {
+    return;
+  }
+  auto *raw = static_cast<uint8_t *>(ptr) - kAllocHeaderBytes;
+  auto *header = reinterpret_cast<AllocHeader *>(raw);
+  if (header->tracked)
+  {
+    g_heap.in_use -= std::min(g_heap.in_use, header->bytes);
+  }
+  free(raw);
+}
+
+// ファームウェアのログ。警告とエラーは書式ごとに数える
+struct LogCount
+{
+  char level;
+  uint32_t count;
+};
+std::map<std::string, LogCount> g_log_counts;
+bool g_verbose = false;
+} // namespace
+
+void *operator new(size_t bytes)
+{
+  void *ptr = trackedAlloc(bytes, false);
+  if (ptr == nullptr)
+  {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void *operator new[](size_t bytes)
+{
+  return operator new(bytes);
+}
+
+void operator delete(void *ptr) noexcept
+{
+  trackedFree(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+  trackedFree(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+  trackedFree(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept
+{
+  trackedFree(ptr);
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+  (void)caps;
+  return trackedAlloc(size, true);
+}
+
+void heap_caps_free(void *ptr)
+{
+  trackedFree(ptr);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+  (void)caps;
+  return kHostHeapBytes - std::min(kHostHeapBytes, g_heap.in_use);
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+  return heap_caps_get_free_size(caps); // ホストでは断片化しない
+}
+
+void replay_host::log(char level, const char *fmt, ...)
+{
+  UntrackedScope untracked;
+  if (level == 'W' || level == 'E')
+  {
+    LogCount &entry = g_log_counts[fmt];
+    entry.level = level;
+    entry.count++;
+  }
+  if (!g_verbose)
+  {
+    return;
+  }
+  char line[256];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+  printf("  [%10.3f] %c %s\n", static_cast<double>(now_us) / 1e6, level, line);
+}
+
+namespace
+{
+// main.cpp と同じ定数
+constexpr uint32_t kCommTimeoutMs = 60000;
+constexpr uint32_t kMaxLoopWaitMs = 1000;
+// Idle / Listening の loop() は M5.Mic.record が DMA を待つ間（dma_buf_len 256 @16 kHz）止まる
+constexpr uint32_t kMicReadMs = 16;
+// 記録が尽きた後、再生やサーボの動作が終わるまで回す上限
+constexpr uint64_t kDrainLimitUs = 30ull * 1000 * 1000;
+// --soak: 記録を流し終えてから次に流し始めるまでの間（Idle で待つ時間）と、ヒープを出す間隔
+constexpr uint64_t kSoakGapUs = 5ull * 1000 * 1000;
+constexpr uint64_t kSoakReportUs = 3600ull * 1000 * 1000;
+
+const char *kindName(uint8_t kind)
+{
+  switch (static_cast<MessageKind>(kind))
+  {
+  case MessageKind::AudioPcm:
+    return "AudioPcm";
+  case MessageKind::AudioWav:
+    return "AudioWav";
+  case MessageKind::StateCmd:
+    return "StateCmd";
+  case MessageKind::WakeWordEvt:
+    return "WakeWordEvt";
+  case MessageKind::StateEvt:
+    return "StateEvt";
+  case MessageKind::SpeakDoneEvt:
+    return "SpeakDoneEvt";
+  case MessageKind::ServoCmd:
+    return "ServoCmd";
+  case MessageKind::ServoDoneEvt:
+    return "ServoDoneEvt";
+  case MessageKind::AudioCreditEvt:
+    return "AudioCreditEvt";
+  case MessageKind::AudioPcmAck:
+    return "AudioPcmAck";
+  case MessageKind::LocalCommandEvt:
+    return "LocalCommandEvt";
+  case MessageKind::ClipCmd:
+    return "ClipCmd";
+  case MessageKind::ClipData:
+    return "ClipData";
+  case MessageKind::ClipEvt:
+    return "ClipEvt";
+  case MessageKind::AudioLogMel:
+    return "AudioLogMel";
+  case MessageKind::CaptureData:
+    return "CaptureData";
+  default:
+    return "other";
+  }
+}
+
+struct Options
+{
+  std::string path{};
+  uint32_t repeat = 1;
+  uint32_t soak_hours = 0;
+  bool verbose = false;
+};
+
+void usage()
+{
+  fprintf(stderr,
+          "usage: ws_replay [options] CAPTURE.wscap\n"
+          "  --repeat N          replay N times (host CPU time over all runs, checks the output is identical)\n"
+          "  --soak HOURS        replay back to back for HOURS of virtual time; fails if the heap grows after boot\n"
+          "  --verbose           print firmware logs with the virtual time\n");
+}
+
+// ---- 記録の読み込み ----
+
+struct Record
+{
+  WsCaptureRecord type;
+  uint64_t at_us; // ファイルの先頭からの時刻
+  std::vector<uint8_t> body;
+};
+
+struct Capture
+{
+  WsCaptureOrigin origin = WsCaptureOrigin::Device;
+  uint64_t start_us = 0;
+  std::vector<Record> records{};
+  uint32_t dropped_records = 0;
+  uint32_t dropped_bytes = 0;
+  bool truncated = false;
+};
+
+bool loadCapture(const std::string &path, Capture &out)
+{
+  FILE *f = fopen(path.c_str(), "rb");
+  if (f == nullptr)
+  {
+    fprintf(stderr, "cannot open %s\n", path.c_str());
+    return false;
+  }
+  std::vector<uint8_t> bytes;
+  uint8_t buf[65536];
+  size_t got = 0;
+  while ((got = fread(buf, 1, sizeof(buf), f)) > 0)
+  {
+    bytes.insert(bytes.end(), buf, buf + got);
+  }
+  fclose(f);
+
+  WsCaptureFileHeader file{};
+  if (bytes.size() < sizeof(file))
+  {
+    fprintf(stderr, "%s: too short for a capture\n", path.c_str());
+    return false;
+  }
+  memcpy(&file, bytes.data(), sizeof(file));
+  if (file.magic != kWsCaptureMagic || file.version != kWsCaptureVersion)
+  {
+    fprintf(stderr, "%s: not a capture (magic=%08x version=%u)\n", path.c_str(), file.magic, file.version);
+    return false;
+  }
+  out.origin = static_cast<WsCaptureOrigin>(file.origin);
+  out.start_us = file.start_us;
+
+  uint64_t at_us = 0;
+  size_t pos = sizeof(file);
+  while (pos < bytes.size())
+  {
+    WsCaptureRecordHeader header{};
+    if (bytes.size() - pos < sizeof(header))
+    {
+      out.truncated = true;
+      break;
+    }
+    memcpy(&header, bytes.data() + pos, sizeof(header));
+    pos += sizeof(header);
+    if (bytes.size() - pos < header.bytes)
+    {
+      // 送信途中で切れた端末の記録など。最後のレコードは捨てる
+      out.truncated = true;
+      break;
+    }
+    at_us += header.delta_us;
+    Record record{static_cast<WsCaptureRecord>(header.type), at_us,
+                  std::vector<uint8_t>(bytes.begin() + pos, bytes.begin() + pos + header.bytes)};
+    pos += header.bytes;
+    if (record.type == WsCaptureRecord::Dropped && record.body.size() >= 2 * sizeof(uint32_t))
+    {
+      uint32_t records = 0, lost = 0;
+      memcpy(&records, record.body.data(), sizeof(records));
+      memcpy(&lost, record.body.data() + sizeof(records), sizeof(lost));
+      out.dropped_records += records;
+      out.dropped_bytes += lost;
+    }
+    out.records.push_back(std::move(record));
+  }
+  return true;
+}
+
+bool parseHeader(const Record &record, WsHeader &hdr)
+{
+  if (record.body.size() < sizeof(WsHeader))
+  {
+    return false;
+  }
+  memcpy(&hdr, record.body.data(), sizeof(hdr));
+  return true;
+}
+
+// ---- 統計 ----
+
+struct Percentiles
+{
+  double p50 = 0, p90 = 0, max = 0;
+  size_t count = 0;
+};
+
+Percentiles percentiles(std::vector<double> values)
+{
+  Percentiles p;
+  p.count = values.size();
+  if (values.empty())
+  {
+    return p;
+  }
+  std::sort(values.begin(), values.end());
+  auto rank = [&](double q) {
+    size_t i = static_cast<size_t>(std::ceil(q * values.size()));
+    return values[std::min(values.size() - 1, i == 0 ? 0 : i - 1)];
+  };
+  p.p50 = rank(0.50);
+  p.p90 = rank(0.90);
+  p.max = values.back();
+  return p;
+}
+
+double toMs(uint64_t us)
+{
+  return static_cast<double>(us) / 1000.0;
+}
+
+// ---- 流し直すファームウェア ----
+
+// ホスト CPU 時間を測る処理
+enum class Handler : uint8_t
+{
+  Connect,
+  AudioWav,
+  StateCmd,
+  ServoCmd,
+  ListenFinished,
+  SpeakingLoop,
+  ServoLoop,
+};
+constexpr size_t kHandlerCount = 7;
+constexpr const char *kHandlerNames[kHandlerCount] = {
+    "connect/disconnect", "AudioWav", "StateCmd", "ServoCmd", "ListenFinished", "Speaking::loop", "BodyServo::loop",
+};
+
+struct HandlerTime
+{
+  uint64_t calls = 0;
+  uint64_t total_ns = 0;
+  uint64_t max_ns = 0;
+};
+
+// ファームウェアが送ったメッセージ（記録の Tx と比べる）
+struct SentMessage
+{
+  uint64_t at_us;
+  uint8_t kind;
+  uint8_t type;
+  std::vector<uint8_t> payload;
+
+  bool operator==(const SentMessage &other) const
+  {
+    return at_us == other.at_us && kind == other.kind && type == other.type && payload == other.payload;
+  }
+};
+
+// main.cpp のグローバルのうち、流し直す分。ステートのハンドラはキャプチャなしのラムダなので static で持つ
+struct Firmware
+{
+  StateMachine state_machine;
+  Speaking speaking{state_machine};
+  BodyServo servo;
+  bool connected = false;
+  uint16_t uplink_seq = 0;
+  uint64_t last_comm_us = 0;
+  std::vector<SentMessage> sent{};
+  uint32_t unsent = 0; // 切断中で送れなかった
+};
+Firmware *g_fw = nullptr;
+
+struct RunResult
+{
+  std::vector<SentMessage> sent{};
+  std::array<HandlerTime, kHandlerCount> handlers{};
+  std::map<uint8_t, uint32_t> rx_ignored{}; // 流さなかった受信（kind ごと）
+  uint32_t unsent = 0;
+  uint32_t connects = 0;
+  uint64_t end_us = 0;
+  uint64_t host_ns = 0;
+  size_t heap_after_init = 0;
+  size_t heap_peak = 0;
+  size_t heap_at_end = 0;
+  size_t heap_after_teardown = 0;
+  uint64_t allocations = 0;
+  uint64_t allocations_after_init = 0; // memory_plan::seal() の後
+  uint32_t passes = 0;                 // 記録を流した回数（--soak）
+};
+RunResult *g_run = nullptr;
+
+template <typename F>
+void timed(Handler handler, F &&fn)
+{
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  uint64_t ns = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+  HandlerTime &t = g_run->handlers[static_cast<size_t>(handler)];
+  t.calls++;
+  t.total_ns += ns;
+  t.max_ns = std::max(t.max_ns, ns);
+}
+
+bool sendUplinkPacket(MessageKind kind, const uint8_t *payload, size_t payload_len)
+{
+  if (!g_fw->connected)
+  {
+    g_fw->unsent++;
+    return false;
+  }
+  UntrackedScope untracked;
+  g_fw->uplink_seq++;
+  g_fw->sent.push_back(SentMessage{replay_host::now_us, static_cast<uint8_t>(kind), static_cast<uint8_t>(MessageType::DATA),
+                                   std::vector<uint8_t>(payload, payload + payload_len)});
+  g_fw->last_comm_us = replay_host::now_us;
+  return true;
+}
+
+void notifyCurrentState(StateMachine::State state)
+{
+  const uint8_t payload = static_cast<uint8_t>(state);
+  sendUplinkPacket(MessageKind::StateEvt, &payload, sizeof(payload));
+}
+
+// main.cpp の kMemoryPlan のうち、流し直すモジュールの分
+constexpr memory_plan::Budget kMemoryPlan[] = {
+    {memory_plan::Module::Speaking, memory_plan::Region::Psram, Speaking::kPsramBytes},
+};
+
+void setupFirmware()
+{
+  memory_plan::init(kMemoryPlan);
+  Speaking &speaking = g_fw->speaking;
+  speaking.init();
+  speaking.setSpeakFinishedCallback([]() {
+    const uint8_t payload = kSpeakDone;
+    sendUplinkPacket(MessageKind::SpeakDoneEvt, &payload, sizeof(payload));
+  });
+  speaking.setCreditCallback([](uint32_t bytes) {
+    uint8_t payload[sizeof(uint32_t)];
+    memcpy(payload, &bytes, sizeof(payload));
+    sendUplinkPacket(MessageKind::AudioCreditEvt, payload, sizeof(payload));
+  });
+  g_fw->servo.init();
+  g_fw->servo.setCompletionCallback([]() {
+    const uint8_t payload = 1;
+    sendUplinkPacket(MessageKind::ServoDoneEvt, &payload, sizeof(payload));
+  });
+
+  StateMachine &sm = g_fw->state_machine;
+  sm.addStateEntryEvent(StateMachine::Idle, [](StateMachine::State, StateMachine::State) {
+    notifyCurrentState(StateMachine::Idle);
+  });
+  sm.addStateEntryEvent(StateMachine::Listening, [](StateMachine::State, StateMachine::State) {
+    notifyCurrentState(StateMachine::Listening);
+  });
+  sm.addStateEntryEvent(StateMachine::Speaking, [](StateMachine::State, StateMachine::State) {
+    notifyCurrentState(StateMachine::Speaking);
+    g_fw->speaking.begin();
+  });
+  sm.addStateExitEvent(StateMachine::Speaking, [](StateMachine::State, StateMachine::State) {
+    g_fw->speaking.end();
+  });
+  sm.addStateEntryEvent(StateMachine::Thinking, [](StateMachine::State, StateMachine::State) {
+    notifyCurrentState(StateMachine::Thinking);
+  });
+  // 端末では非同期の起動フェーズを待ってから（最初の enterConnected で）封をする
+  memory_plan::seal();
+}
+
+// main.cpp の enterConnected（起動は済んでいるものとする）
+void enterConnected()
+{
+  g_fw->connected = true;
+  g_run->connects++;
+  g_fw->state_machine.dispatch(StateMachine::Event::Connected);
+  g_fw->last_comm_us = replay_host::now_us;
+  notifyCurrentState(g_fw->state_machine.getState());
+  g_fw->speaking.grantInitialCredit();
+}
+
+void applyRemoteStateCommand(const uint8_t *body, size_t len)
+{
+  if (len < 1)
+  {
+    log_w("StateCmd payload too short: %u", static_cast<unsigned>(len));
+    return;
+  }
+  StateMachine &sm = g_fw->state_machine;
+  switch (static_cast<RemoteState>(body[0]))
+  {
+  case RemoteState::Idle:
+    sm.dispatch(StateMachine::Event::RemoteIdle);
+    break;
+  case RemoteState::Listening:
+    sm.dispatch(StateMachine::Event::RemoteListening);
+    break;
+  case RemoteState::Thinking:
+    sm.dispatch(StateMachine::Event::RemoteThinking);
+    break;
+  case RemoteState::Speaking:
+    sm.dispatch(StateMachine::Event::RemoteSpeaking);
+    break;
+  default:
+    log_w("Unknown remote state: %u", static_cast<unsigned>(body[0]));
+    break;
+  }
+}
+
+// main.cpp の selectWsPayloadSink + handleWsMessage
+void handleRx(const WsHeader &hdr, const uint8_t *body, size_t len)
+{
+  g_fw->last_comm_us = replay_host::now_us;
+  auto type = static_cast<MessageType>(hdr.messageType);
+  switch (static_cast<MessageKind>(hdr.kind))
+  {
+  case MessageKind::AudioWav:
+    timed(Handler::AudioWav, [&]() {
+      // WsClient はシンクがあればソケットから直接そこへ読む
+      uint8_t *sink = g_fw->speaking.reserveWavPayload(hdr);
+      if (sink != nullptr)
+      {
+        size_t n = std::min<size_t>(len, hdr.payloadBytes);
+        memcpy(sink, body, n);
+        g_fw->speaking.handleWavMessage(hdr, sink, n);
+      }
+      else
+      {
+        g_fw->speaking.handleWavMessage(hdr, body, len);
+      }
+    });
+    break;
+  case MessageKind::StateCmd:
+    if (type == MessageType::DATA)
+    {
+      timed(Handler::StateCmd, [&]() { applyRemoteStateCommand(body, len); });
+    }
+    break;
+  case MessageKind::ServoCmd:
+    if (type == MessageType::DATA)
+    {
+      timed(Handler::ServoCmd, [&]() {
+        if (!g_fw->servo.enqueueSequence(body, len))
+        {
+          log_w("Failed to apply servo command");
+        }
+      });
+    }
+    break;
+  default:
+    // AudioPcmAck（録音を動かさない）と ClipCmd / ClipData（flash のキャッシュが無い）は数えるだけ
+    {
+      UntrackedScope untracked;
+      g_run->rx_ignored[hdr.kind]++;
+    }
+    break;
+  }
+}
+
+void handleRecord(const Record &record)
+{
+  switch (record.type)
+  {
+  case WsCaptureRecord::Event:
+    if (record.body.empty())
+    {
+      break;
+    }
+    timed(Handler::Connect, [&]() {
+      if (static_cast<WsCaptureEvent>(record.body[0]) == WsCaptureEvent::Connected)
+      {
+        enterConnected();
+      }
+      else if (static_cast<WsCaptureEvent>(record.body[0]) == WsCaptureEvent::Disconnected)
+      {
+        g_fw->connected = false;
+        g_fw->state_machine.dispatch(StateMachine::Event::Disconnected);
+      }
+    });
+    break;
+  case WsCaptureRecord::Rx:
+  {
+    WsHeader hdr{};
+    if (!parseHeader(record, hdr))
+    {
+      break;
+    }
+    if (!g_fw->connected)
+    {
+      // 接続の記録が欠けている（先頭が溢れた端末の記録など）。受信できている以上は接続中
+      timed(Handler::Connect, []() { enterConnected(); });
+    }
+    handleRx(hdr, record.body.data() + sizeof(WsHeader), record.body.size() - sizeof(WsHeader));
+    break;
+  }
+  case WsCaptureRecord::Tx:
+  {
+    // 端末が実際に送ったもの。録音は動かさないので、uplink の END を無音検知の代わりにする
+    WsHeader hdr{};
+    if (!parseHeader(record, hdr))
+    {
+      break;
+    }
+    auto kind = static_cast<MessageKind>(hdr.kind);
+    if ((kind == MessageKind::AudioPcm || kind == MessageKind::AudioLogMel) &&
+        static_cast<MessageType>(hdr.messageType) == MessageType::END && g_fw->state_machine.isListening())
+    {
+      timed(Handler::ListenFinished, []() { g_fw->state_machine.dispatch(StateMachine::Event::ListenFinished); });
+    }
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+// main.cpp の handleCommunicationTimeout
+void handleCommunicationTimeout()
+{
+  StateMachine::State current = g_fw->state_machine.getState();
+  if (replay_host::now_us - g_fw->last_comm_us >= static_cast<uint64_t>(kCommTimeoutMs) * 1000 &&
+      (current == StateMachine::Thinking || current == StateMachine::Speaking))
+  {
+    log_w("Communication timeout in state=%u; forcing Idle", static_cast<unsigned>(current));
+    g_fw->state_machine.dispatch(StateMachine::Event::CommTimeout);
+    g_fw->last_comm_us = replay_host::now_us;
+  }
+}
+
+// main.cpp の loopWaitMs と loop_wake::wait。次の受信（next_rx_us）が届くと待機が打ち切られる。
+// 仮想時計を進めるため最低 1 ms は待つ
+uint32_t loopWaitMs(StateMachine::State state, uint32_t now, uint64_t next_rx_us)
+{
+  if (state == StateMachine::Idle || state == StateMachine::Listening)
+  {
+    return kMicReadMs;
+  }
+  uint32_t wait = kMaxLoopWaitMs;
+  wait = std::min(wait, g_fw->servo.msUntilNextUpdate(now));
+  if (state == StateMachine::Speaking)
+  {
+    wait = std::min(wait, g_fw->speaking.msUntilNextUpdate());
+  }
+  if (state == StateMachine::Thinking || state == StateMachine::Speaking)
+  {
+    uint64_t elapsed_us = replay_host::now_us - g_fw->last_comm_us;
+    uint64_t limit_us = static_cast<uint64_t>(kCommTimeoutMs) * 1000;
+    wait = std::min<uint64_t>(wait, elapsed_us >= limit_us ? 0 : (limit_us - elapsed_us + 999) / 1000);
+  }
+  if (next_rx_us > replay_host::now_us)
+  {
+    wait = std::min<uint64_t>(wait, (next_rx_us - replay_host::now_us + 999) / 1000);
+  }
+  return std::max<uint32_t>(wait, 1);
+}
+
+// soak_hours > 0 なら、その仮想時間が経つまで記録を続けて流す（時刻は流すたびにずらす）
+RunResult replayOnce(const Capture &capture, uint32_t soak_hours = 0)
+{
+  RunResult result;
+  g_run = &result;
+  g_log_counts.clear();
+  replay_host::now_us = capture.records.empty() ? 0 : capture.records.front().at_us;
+  M5.Speaker.stop();
+
+  auto host_start = std::chrono::steady_clock::now();
+  g_heap.tracking = true;
+  g_heap.in_use = 0;
+  g_heap.peak = 0;
+  g_heap.allocations = 0;
+  g_fw = new Firmware();
+  setupFirmware();
+  result.heap_after_init = g_heap.in_use;
+  const uint64_t allocations_at_init = g_heap.allocations;
+
+  // main.cpp の loop() を仮想時計で回す。届いている受信は wsClient.loop() でまとめて処理される
+  const std::vector<Record> &records = capture.records;
+  const uint64_t first_us = records.empty() ? 0 : records.front().at_us;
+  const uint64_t last_us = records.empty() ? 0 : records.back().at_us;
+  const uint64_t start_us = replay_host::now_us;
+  const uint64_t soak_end_us = start_us + soak_hours * kSoakReportUs;
+  uint64_t next_report_us = replay_host::now_us + kSoakReportUs;
+  uint64_t offset_us = 0; // この回の記録の時刻に足す分
+  size_t next = 0;
+  result.passes = 1;
+  if (soak_hours > 0)
+  {
+    printf("\nsoak (virtual time)        in use        peak   allocations after boot   passes\n");
+  }
+  while (true)
+  {
+    while (next < records.size() && records[next].at_us + offset_us <= replay_host::now_us)
+    {
+      handleRecord(records[next]);
+      next++;
+    }
+    handleCommunicationTimeout();
+    timed(Handler::ServoLoop, []() { g_fw->servo.loop(); });
+    StateMachine::State current = g_fw->state_machine.getState();
+    if (current == StateMachine::Speaking)
+    {
+      timed(Handler::SpeakingLoop, []() { g_fw->speaking.loop(); });
+    }
+
+    if (soak_hours > 0 && replay_host::now_us >= next_report_us)
+    {
+      printf("  %3llu h              %10zu B  %10zu B  %23llu  %7u\n",
+             static_cast<unsigned long long>((next_report_us - start_us) / kSoakReportUs),
+             g_heap.in_use, g_heap.peak, static_cast<unsigned long long>(g_heap.allocations - allocations_at_init),
+             result.passes);
+      next_report_us += kSoakReportUs;
+      UntrackedScope untracked;
+      g_fw->sent.clear(); // 長く流すと送信の記録だけでホストのメモリが伸びる
+      g_fw->sent.shrink_to_fit();
+    }
+
+    current = g_fw->state_machine.getState();
+    bool busy = current == StateMachine::Speaking || g_fw->servo.isBusy();
+    if (next >= records.size() && (!busy || replay_host::now_us >= last_us + offset_us + kDrainLimitUs))
+    {
+      if (replay_host::now_us >= soak_end_us)
+      {
+        break;
+      }
+      offset_us = replay_host::now_us + kSoakGapUs - first_us;
+      next = 0;
+      result.passes++;
+    }
+    uint64_t next_rx_us = next < records.size() ? records[next].at_us + offset_us : UINT64_MAX;
+    replay_host::now_us += static_cast<uint64_t>(loopWaitMs(current, millis(), next_rx_us)) * 1000;
+  }
+
+  result.end_us = replay_host::now_us;
+  result.heap_at_end = g_heap.in_use;
+  result.heap_peak = g_heap.peak;
+  result.sent = std::move(g_fw->sent);
+  result.unsent = g_fw->unsent;
+  result.allocations_after_init = g_heap.allocations - allocations_at_init;
+  delete g_fw;
+  g_fw = nullptr;
+  memory_plan::release();
+  result.heap_after_teardown = g_heap.in_use;
+  result.allocations = g_heap.allocations;
+  g_heap.tracking = false;
+  result.host_ns = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - host_start).count());
+  g_run = nullptr;
+  return result;
+}
+
+// ---- 結果 ----
+
+void printSummary(const Capture &capture, const std::string &path)
+{
+  const uint64_t duration_us = capture.records.empty() ? 0 : capture.records.back().at_us;
+  printf("capture: %s\n", path.c_str());
+  if (capture.origin == WsCaptureOrigin::Server)
+  {
+    time_t start = static_cast<time_t>(capture.start_us / 1000000);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", localtime(&start));
+    printf("  recorded by the server at %s (Rx = sent by the server, Tx = received by the server)\n", stamp);
+  }
+  else
+  {
+    printf("  recorded by the device at %.3f s after boot\n", static_cast<double>(capture.start_us) / 1e6);
+  }
+
+  std::map<uint8_t, std::pair<uint32_t, uint64_t>> rx, tx;
+  uint32_t connects = 0, disconnects = 0;
+  for (const Record &record : capture.records)
+  {
+    WsHeader hdr{};
+    if (record.type == WsCaptureRecord::Event && !record.body.empty())
+    {
+      connects += record.body[0] == static_cast<uint8_t>(WsCaptureEvent::Connected);
+      disconnects += record.body[0] == static_cast<uint8_t>(WsCaptureEvent::Disconnected);
+    }
+    else if ((record.type == WsCaptureRecord::Rx || record.type == WsCaptureRecord::Tx) && parseHeader(record, hdr))
+    {
+      auto &entry = (record.type == WsCaptureRecord::Rx ? rx : tx)[hdr.kind];
+      entry.first++;
+      entry.second += record.body.size();
+    }
+  }
+  printf("  %zu records over %.3f s, connects=%u disconnects=%u\n", capture.records.size(),
+         static_cast<double>(duration_us) / 1e6, connects, disconnects);
+  if (capture.dropped_records > 0 || capture.truncated)
+  {
+    printf("  WARNING: %u records (%u bytes) lost by the recorder%s; the replay may diverge\n", capture.dropped_records,
+           capture.dropped_bytes, capture.truncated ? ", last record truncated" : "");
+  }
+  auto printKinds = [](const char *label, const std::map<uint8_t, std::pair<uint32_t, uint64_t>> &kinds) {
+    printf("  %s\n", label);
+    for (const auto &entry : kinds)
+    {
+      printf("    kind %-3u %-16s %6u msgs %10llu bytes\n", entry.first, kindName(entry.first), entry.second.first,
+             static_cast<unsigned long long>(entry.second.second));
+    }
+  };
+  printKinds("server -> device", rx);
+  printKinds("device -> server", tx);
+}
+
+// 記録から読み取ったターン（ウェイクワードまたはサーバーの Listening から SpeakDoneEvt まで）
+struct Turn
+{
+  uint64_t start_us = 0;
+  uint64_t listen_us = 0;
+  uint64_t end_us = 0;         // uplink の END
+  uint64_t first_audio_us = 0; // 応答の最初の AudioWav START
+  uint64_t done_us = 0;        // 記録の SpeakDoneEvt
+  size_t done_index = SIZE_MAX; // 何番目の SpeakDoneEvt か（リプレイの同じ番号と比べる）
+};
+
+std::vector<Turn> findTurns(const Capture &capture)
+{
+  std::vector<Turn> turns;
+  Turn *open = nullptr;
+  size_t speak_done = 0;
+  for (const Record &record : capture.records)
+  {
+    WsHeader hdr{};
+    if (!parseHeader(record, hdr) || (record.type != WsCaptureRecord::Rx && record.type != WsCaptureRecord::Tx))
+    {
+      continue;
+    }
+    const bool rx = record.type == WsCaptureRecord::Rx;
+    auto kind = static_cast<MessageKind>(hdr.kind);
+    auto type = static_cast<MessageType>(hdr.messageType);
+    const uint8_t first = record.body.size() > sizeof(WsHeader) ? record.body[sizeof(WsHeader)] : 0xFF;
+
+    const bool wake = !rx && kind == MessageKind::WakeWordEvt;
+    const bool listen = rx && kind == MessageKind::StateCmd && first == static_cast<uint8_t>(RemoteState::Listening);
+    if (wake || (listen && open == nullptr))
+    {
+      turns.push_back(Turn{});
+      open = &turns.back();
+      open->start_us = record.at_us;
+    }
+    if (!rx && kind == MessageKind::SpeakDoneEvt)
+    {
+      if (open != nullptr && open->first_audio_us != 0 && open->done_us == 0)
+      {
+        open->done_us = record.at_us;
+        open->done_index = speak_done;
+        open = nullptr;
+      }
+      speak_done++;
+      continue;
+    }
+    if (open == nullptr)
+    {
+      continue;
+    }
+    if (listen && open->listen_us == 0)
+    {
+      open->listen_us = record.at_us;
+    }
+    else if (!rx && (kind == MessageKind::AudioPcm || kind == MessageKind::AudioLogMel) && type == MessageType::END &&
+             open->listen_us != 0 && open->end_us == 0)
+    {
+      open->end_us = record.at_us;
+    }
+    else if (rx && ((kind == MessageKind::AudioWav && type == MessageType::START) || kind == MessageKind::ClipCmd) &&
+             open->first_audio_us == 0)
+    {
+      open->first_audio_us = record.at_us;
+    }
+  }
+  return turns;
+}
+
+std::vector<const SentMessage *> sentOfKind(const std::vector<SentMessage> &sent, MessageKind kind)
+{
+  std::vector<const SentMessage *> out;
+  for (const SentMessage &m : sent)
+  {
+    if (m.kind == static_cast<uint8_t>(kind))
+    {
+      out.push_back(&m);
+    }
+  }
+  return out;
+}
+
+std::vector<const Record *> capturedOfKind(const Capture &capture, MessageKind kind)
+{
+  std::vector<const Record *> out;
+  for (const Record &record : capture.records)
+  {
+    WsHeader hdr{};
+    if (record.type == WsCaptureRecord::Tx && parseHeader(record, hdr) && hdr.kind == static_cast<uint8_t>(kind))
+    {
+      out.push_back(&record);
+    }
+  }
+  return out;
+}
+
+void printTurns(const Capture &capture, const RunResult &run)
+{
+  std::vector<Turn> turns = findTurns(capture);
+  std::vector<const SentMessage *> replay_done = sentOfKind(run.sent, MessageKind::SpeakDoneEvt);
+  printf("\nturns (ms)   start_s  wake->listen   uplink  END->audio  audio->done  replay audio->done    diff\n");
+  auto span = [](uint64_t from, uint64_t to) { return from != 0 && to >= from ? toMs(to - from) : NAN; };
+  for (size_t i = 0; i < turns.size(); ++i)
+  {
+    const Turn &t = turns[i];
+    double replay = NAN;
+    if (t.done_index < replay_done.size() && t.first_audio_us != 0)
+    {
+      replay = span(t.first_audio_us, replay_done[t.done_index]->at_us);
+    }
+    double captured = span(t.first_audio_us, t.done_us);
+    printf("  turn %-4zu %9.3f %13.1f %8.1f %11.1f %12.1f %19.1f %7.1f\n", i, static_cast<double>(t.start_us) / 1e6,
+           span(t.start_us, t.listen_us), span(t.listen_us, t.end_us), span(t.end_us, t.first_audio_us), captured,
+           replay, replay - captured);
+  }
+  if (turns.empty())
+  {
+    printf("  (no wake word or Listening in the capture)\n");
+  }
+}
+
+// 記録の Tx とリプレイで送ったものを、種類ごとに順番で対応させて比べる
+bool printEventTiming(const Capture &capture, const RunResult &run)
+{
+  printf("\nreplay vs capture (device -> server, ms; + = replay later)\n");
+  bool consistent = true;
+  const MessageKind kinds[] = {MessageKind::StateEvt, MessageKind::SpeakDoneEvt, MessageKind::ServoDoneEvt,
+                               MessageKind::AudioCreditEvt};
+  for (MessageKind kind : kinds)
+  {
+    std::vector<const Record *> captured = capturedOfKind(capture, kind);
+    std::vector<const SentMessage *> replayed = sentOfKind(run.sent, kind);
+    if (kind == MessageKind::StateEvt)
+    {
+      // 同じステートの通知が続くのは接続時など（enterConnected と Idle のエントリの両方が送る）。先頭だけで比べる
+      auto state_of = [](const uint8_t *payload, size_t len) { return len > 0 ? payload[0] : 0xFF; };
+      captured.erase(std::unique(captured.begin(), captured.end(),
+                                 [&](const Record *a, const Record *b) {
+                                   return state_of(a->body.data() + sizeof(WsHeader), a->body.size() - sizeof(WsHeader)) ==
+                                          state_of(b->body.data() + sizeof(WsHeader), b->body.size() - sizeof(WsHeader));
+                                 }),
+                     captured.end());
+      replayed.erase(std::unique(replayed.begin(), replayed.end(),
+                                 [&](const SentMessage *a, const SentMessage *b) {
+                                   return state_of(a->payload.data(), a->payload.size()) ==
+                                          state_of(b->payload.data(), b->payload.size());
+                                 }),
+                     replayed.end());
+    }
+    size_t pairs = std::min(captured.size(), replayed.size());
+    std::vector<double> abs_delta;
+    double signed_sum = 0;
+    uint64_t captured_bytes = 0, replayed_bytes = 0;
+    size_t mismatches = 0;
+    for (size_t i = 0; i < pairs; ++i)
+    {
+      double delta = (static_cast<double>(replayed[i]->at_us) - static_cast<double>(captured[i]->at_us)) / 1000.0;
+      abs_delta.push_back(std::fabs(delta));
+      signed_sum += delta;
+      const uint8_t *captured_payload = captured[i]->body.data() + sizeof(WsHeader);
+      size_t captured_len = captured[i]->body.size() - sizeof(WsHeader);
+      if (kind == MessageKind::AudioCreditEvt && captured_len >= sizeof(uint32_t) &&
+          replayed[i]->payload.size() >= sizeof(uint32_t))
+      {
+        uint32_t a = 0, b = 0;
+        memcpy(&a, captured_payload, sizeof(a));
+        memcpy(&b, replayed[i]->payload.data(), sizeof(b));
+        captured_bytes += a;
+        replayed_bytes += b;
+      }
+      else if (kind == MessageKind::StateEvt && captured_len >= 1 && !replayed[i]->payload.empty() &&
+               captured_payload[0] != replayed[i]->payload[0])
+      {
+        if (mismatches == 0)
+        {
+          printf("  first state mismatch #%zu at %.3f s: captured %s, replayed %s\n", i,
+                 static_cast<double>(captured[i]->at_us) / 1e6,
+                 stateToString(static_cast<StateMachine::State>(captured_payload[0])),
+                 stateToString(static_cast<StateMachine::State>(replayed[i]->payload[0])));
+        }
+        mismatches++;
+      }
+    }
+    Percentiles p = percentiles(abs_delta);
+    printf("  %-15s captured=%-5zu replayed=%-5zu |delta| p50=%-8.1f p90=%-8.1f max=%-8.1f mean=%+.1f\n",
+           kindName(static_cast<uint8_t>(kind)), captured.size(), replayed.size(), p.p50, p.p90, p.max,
+           pairs > 0 ? signed_sum / static_cast<double>(pairs) : 0.0);
+    if (kind == MessageKind::AudioCreditEvt && pairs > 0)
+    {
+      printf("  %-15s credit bytes captured=%llu replayed=%llu\n", "",
+             static_cast<unsigned long long>(captured_bytes), static_cast<unsigned long long>(replayed_bytes));
+    }
+    if (kind == MessageKind::StateEvt)
+    {
+      printf("  %-15s state mismatches=%zu\n", "", mismatches);
+      consistent = consistent && mismatches == 0 && captured.size() == replayed.size();
+    }
+  }
+  if (run.unsent > 0)
+  {
+    printf("  %u messages not sent while disconnected\n", run.unsent);
+  }
+  for (const auto &entry : run.rx_ignored)
+  {
+    printf("  not replayed: %u x %s\n", entry.second, kindName(entry.first));
+  }
+  return consistent;
+}
+
+void printHostTime(const std::vector<RunResult> &runs)
+{
+  printf("\nhost CPU per call (us, %zu run%s)      calls      mean       max      total\n", runs.size(),
+         runs.size() == 1 ? "" : "s");
+  for (size_t h = 0; h < kHandlerCount; ++h)
+  {
+    HandlerTime sum;
+    for (const RunResult &run : runs)
+    {
+      const HandlerTime &t = run.handlers[h];
+      sum.calls += t.calls;
+      sum.total_ns += t.total_ns;
+      sum.max_ns = std::max(sum.max_ns, t.max_ns);
+    }
+    if (sum.calls == 0)
+    {
+      continue;
+    }
+    printf("  %-34s %9llu %9.2f %9.2f %10.1f\n", kHandlerNames[h], static_cast<unsigned long long>(sum.calls),
+           static_cast<double>(sum.total_ns) / 1000.0 / static_cast<double>(sum.calls),
+           static_cast<double>(sum.max_ns) / 1000.0, static_cast<double>(sum.total_ns) / 1000.0);
+  }
+  std::vector<double> host_ms;
+  for (const RunResult &run : runs)
+  {
+    host_ms.push_back(static_cast<double>(run.host_ns) / 1e6);
+  }
+  Percentiles p = percentiles(host_ms);
+  const RunResult &first = runs.front();
+  printf("  replayed %.3f s of virtual time in %.1f ms (p50 of runs, max %.1f ms)\n",
+         static_cast<double>(first.end_us) / 1e6, p.p50, p.max);
+}
+
+void printMemory(const RunResult &run)
+{
+  printf("\nheap (firmware allocations)\n");
+  printf("  after init         %10zu B\n", run.heap_after_init);
+  printf("  peak               %10zu B (+%zu over init)\n", run.heap_peak, run.heap_peak - run.heap_after_init);
+  printf("  at end             %10zu B\n", run.heap_at_end);
+  printf("  after teardown     %10zu B%s\n", run.heap_after_teardown, run.heap_after_teardown > 0 ? "  <- leaked" : "");
+  printf("  allocations        %10llu (%llu after boot)\n", static_cast<unsigned long long>(run.allocations),
+         static_cast<unsigned long long>(run.allocations_after_init));
+}
+
+void printWarnings()
+{
+  printf("\nfirmware warnings\n");
+  if (g_log_counts.empty())
+  {
+    printf("  none\n");
+    return;
+  }
+  std::vector<std::pair<std::string, LogCount>> entries(g_log_counts.begin(), g_log_counts.end());
+  std::sort(entries.begin(), entries.end(),
+            [](const auto &a, const auto &b) { return a.second.count > b.second.count; });
+  for (const auto &entry : entries)
+  {
+    printf("  %c %6u  %s\n", entry.second.level, entry.second.count, entry.first.c_str());
+  }
+}
+
+bool parseOptions(int argc, char **argv, Options &opt)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string arg = argv[i];
+    if (arg == "--repeat" && i + 1 < argc)
+    {
+      opt.repeat = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+    }
+    else if (arg == "--soak" && i + 1 < argc)
+    {
+      opt.soak_hours = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+    }
+    else if (arg == "--verbose")
+    {
+      opt.verbose = true;
+    }
+    else if (!arg.empty() && arg[0] != '-' && opt.path.empty())
+    {
+      opt.path = arg;
+    }
+    else
+    {
+      usage();
+      return false;
+    }
+  }
+  if (opt.path.empty() || opt.repeat == 0)
+  {
+    usage();
+    return false;
+  }
+  return true;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+  Options opt;
+  if (!parseOptions(argc, argv, opt))
+  {
+    return 2;
+  }
+  Capture capture;
+  if (!loadCapture(opt.path, capture))
+  {
+    return 1;
+  }
+  printSummary(capture, opt.path);
+
+  if (opt.soak_hours > 0)
+  {
+    // 起動後に 1 回でも確保すれば、長く動かすうちに断片化する。使用量が同じでも失敗にする
+    g_verbose = opt.verbose;
+    RunResult run = replayOnce(capture, opt.soak_hours);
+    printMemory(run);
+    printWarnings();
+    const bool flat = run.allocations_after_init == 0 && run.heap_at_end == run.heap_after_init &&
+                      run.heap_after_teardown == 0;
+    printf("\nheap after boot is %s over %u passes\n", flat ? "flat" : "NOT flat", run.passes);
+    return flat ? 0 : 1;
+  }
+
+  // ログは最初の 1 回だけ出す。警告の件数も最初の 1 回のもの
+  std::vector<RunResult> runs;
+  g_verbose = opt.verbose;
+  if (g_verbose)
+  {
+    printf("\nfirmware log (virtual time)\n");
+  }
+  runs.push_back(replayOnce(capture));
+  std::map<std::string, LogCount> first_warnings = g_log_counts;
+  g_verbose = false;
+  bool deterministic = true;
+  for (uint32_t i = 1; i < opt.repeat; ++i)
+  {
+    runs.push_back(replayOnce(capture));
+    deterministic = deterministic && runs.back().sent == runs.front().sent;
+  }
+  g_log_counts = first_warnings;
+
+  printTurns(capture, runs.front());
+  bool consistent = printEventTiming(capture, runs.front());
+  printHostTime(runs);
+  printMemory(runs.front());
+  printWarnings();
+  if (opt.repeat > 1)
+  {
+    printf("\nruns produced %s output\n", deterministic ? "identical" : "DIFFERENT");
+  }
+  return consistent && deterministic ? 0 : 1;
+}
@@ -1,16 +1,21 @@
 from __future__ import annotations
 
 import asyncio
+import os
 from logging import getLogger
-from typing import Awaitable, Callable, Optional
+from pathlib import Path
+from typing import Awaitable, Callable, Literal, Optional, cast
 
-from fastapi import FastAPI, HTTPException, WebSocket, WebSocketDisconnect
+from fastapi import FastAPI, HTTPException, Response, WebSocket, WebSocketDisconnect
 from pydantic import BaseModel
 
+from .capture import CapturingWebSocket, WsCaptureWriter
+from .listen import UplinkSessionStore
 from .speech_recognition import create_speech_recognizer
 from .speech_synthesis import create_speech_synthesizer
+from .trace import parse_trace_dump, to_chrome_trace
 from .types import SpeechRecognizer, SpeechSynthesizer
-from .ws_proxy import WsProxy
+from .ws_proxy import LocalCommand, TimeoutError, WsProxy
 
 logger = getLogger(__name__)
 
@@ -29,14 +34,24 @@ class StackChanApp:
         self,
         speech_recognizer: SpeechRecognizer | None = None,
         speech_synthesizer: SpeechSynthesizer | None = None,
+        capture_dir: str | Path | None = None,
     ) -> None:
+        """capture_dir（または環境変数 STACKCHAN_WS_CAPTURE_DIR）を指定すると、接続ごとの送受信と
+        端末から届いた記録（ファームウェアの WS_CAPTURE_KB_H）をそこに保存する。misc/replay で再生できる。"""
         self.speech_recognizer = speech_recognizer or create_speech_recognizer()
         self.speech_synthesizer = speech_synthesizer or create_speech_synthesizer()
+        capture_dir = capture_dir or os.getenv("STACKCHAN_WS_CAPTURE_DIR")
+        self._capture_dir: Optional[Path] = Path(capture_dir) if capture_dir else None
         self.fastapi = FastAPI(title="StackChan WebSocket Server")
         self._setup_fn: Optional[Callable[[WsProxy], Awaitable[None]]] = None
         self._talk_session_fn: Optional[Callable[[WsProxy], Awaitable[None]]] = None
+        self._local_command_fn: Optional[
+            Callable[[WsProxy, LocalCommand], Awaitable[None]]
+        ] = None
         self._proxies: dict[str, WsProxy] = {}
         self._proxies_lock = asyncio.Lock()
+        # 接続をまたいで uplink の認識途中のセッションを引き継ぐ
+        self._uplink_sessions = UplinkSessionStore()
 
         @self.fastapi.get("/health")
         async def _health() -> dict[str, str]:
@@ -71,6 +86,29 @@ class StackChanApp:
                 raise HTTPException(status_code=404, detail="stackchan not connected")
             await proxy.speak(body.text)
 
+        @self.fastapi.get("/v1/stackchan/{stackchan_ip}/trace")
+        async def _dump_trace(
+            stackchan_ip: str,
+            clear: bool = False,
+            format: Literal["json", "raw"] = "json",
+        ):
+            proxy = await self._get_proxy(stackchan_ip)
+            if proxy is None:
+                raise HTTPException(status_code=404, detail="stackchan not connected")
+            try:
+                dump = await proxy.dump_trace(clear=clear)
+            except TimeoutError:
+                raise HTTPException(
+                    status_code=504, detail="trace dump timed out"
+                ) from None
+            except WebSocketDisconnect:
+                raise HTTPException(
+                    status_code=404, detail="stackchan not connected"
+                ) from None
+            if format == "raw":
+                return Response(content=dump, media_type="application/octet-stream")
+            return to_chrome_trace(parse_trace_dump(dump))
+
     def setup(self, fn: Callable[["WsProxy"], Awaitable[None]]):
         self._setup_fn = fn
         return fn
@@ -79,14 +117,25 @@ class StackChanApp:
         self._talk_session_fn = fn
         return fn
 
+    def local_command(self, fn: Callable[["WsProxy", LocalCommand], Awaitable[None]]):
+        """ファームウェアが端末内で処理したコマンド（止めて・音量など）の通知を受け取る。"""
+        self._local_command_fn = fn
+        return fn
+
     async def _handle_ws(self, websocket: WebSocket) -> None:
         await websocket.accept()
         client_ip = websocket.client.host if websocket.client else "unknown"
+        capture: Optional[CapturingWebSocket] = None
+        if self._capture_dir is not None:
+            capture = CapturingWebSocket(websocket, WsCaptureWriter.for_connection(self._capture_dir, client_ip))
 
         proxy = WsProxy(
-            websocket,
+            cast(WebSocket, capture) if capture is not None else websocket,
             speech_recognizer=self.speech_recognizer,
             speech_synthesizer=self.speech_synthesizer,
+            uplink_session_store=self._uplink_sessions,
+            local_command_handler=self._local_command_fn,
+            capture_dir=self._capture_dir,
         )
         existing = await self._register_proxy(client_ip, proxy)
         await proxy.start()
@@ -113,7 +162,12 @@ class StackChanApp:
                     except Exception:
                         logger.exception("talk_session failed")
                     finally:
-                        if not disconnected and not proxy.closed:
+                        # 会話モードで続きの発話を待っている間は Idle に戻さない
+                        if (
+                            not disconnected
+                            and not proxy.closed
+                            and not proxy.follow_up_armed
+                        ):
                             try:
                                 await proxy.reset_state()
                             except WebSocketDisconnect:
@@ -128,6 +182,8 @@ class StackChanApp:
         finally:
             await proxy.close()
             await self._unregister_proxy(client_ip, proxy)
+            if capture is not None:
+                capture.close_capture()
 
     async def _list_stackchan_infos(self) -> list[StackChanInfo]:
         async with self._proxies_lock:
@@ -0,0 +1,172 @@
+from __future__ import annotations
+
+import struct
+import time
+from datetime import datetime
+from enum import IntEnum
+from logging import getLogger
+from pathlib import Path
+from typing import Any, BinaryIO, Optional
+
+from fastapi import WebSocket
+
+logger = getLogger(__name__)
+
+# firmware/include/protocols.hpp の WsCaptureFileHeader / WsCaptureRecordHeader と同じ形式
+_FILE_HEADER_FMT = "<IHBBQ"  # magic, version, origin, reserved, start_us
+_RECORD_HEADER_FMT = "<BII"  # type, delta_us, bytes
+_CAPTURE_MAGIC = 0x43574353  # "SCWC"
+_CAPTURE_VERSION = 1
+_MAX_DELTA_US = 0xFFFFFFFF
+_FILE_SUFFIX = ".wscap"
+
+
+class CaptureOrigin(IntEnum):
+    DEVICE = 1
+    SERVER = 2
+
+
+class CaptureRecord(IntEnum):
+    """向きは記録した側によらず端末から見たもの。"""
+
+    RX = 1  # サーバー → 端末
+    TX = 2  # 端末 → サーバー
+    EVENT = 3
+    DROPPED = 4
+
+
+class CaptureEvent(IntEnum):
+    CONNECTED = 1
+    DISCONNECTED = 2
+
+
+def _capture_path(capture_dir: Path, client: str, role: str) -> Path:
+    stamp = datetime.now().strftime("%Y%m%d-%H%M%S-%f")
+    safe_client = client.replace(":", "_")
+    return capture_dir / f"{safe_client}-{stamp}-{role}{_FILE_SUFFIX}"
+
+
+class WsCaptureWriter:
+    """サーバー側で見た送受信を、端末の記録と同じ形式のファイルに書く。"""
+
+    def __init__(self, path: Path) -> None:
+        path.parent.mkdir(parents=True, exist_ok=True)
+        self.path = path
+        self._file: Optional[BinaryIO] = path.open("wb")
+        self._file.write(
+            struct.pack(
+                _FILE_HEADER_FMT,
+                _CAPTURE_MAGIC,
+                _CAPTURE_VERSION,
+                CaptureOrigin.SERVER,
+                0,
+                time.time_ns() // 1000,
+            )
+        )
+        # 差分は時計の調整の影響を受けない monotonic で求める
+        self._last_ns = time.monotonic_ns()
+        self._records = 0
+
+    @classmethod
+    def for_connection(cls, capture_dir: Path, client: str) -> WsCaptureWriter:
+        return cls(_capture_path(capture_dir, client, "server"))
+
+    def record(self, record_type: CaptureRecord, body: bytes) -> None:
+        if self._file is None:
+            return
+        now_ns = time.monotonic_ns()
+        delta_us = min((now_ns - self._last_ns) // 1000, _MAX_DELTA_US)
+        # 切り捨てた端数を次の差分に持ち越し、長い記録でも時刻がずれないようにする
+        self._last_ns += delta_us * 1000
+        self._file.write(struct.pack(_RECORD_HEADER_FMT, record_type, delta_us, len(body)))
+        self._file.write(body)
+        self._records += 1
+
+    def record_event(self, event: CaptureEvent) -> None:
+        self.record(CaptureRecord.EVENT, struct.pack("<B", event))
+
+    def close(self) -> None:
+        if self._file is None:
+            return
+        self._file.close()
+        self._file = None
+        logger.info("Saved WebSocket capture %s records=%d", self.path, self._records)
+
+
+class CapturingWebSocket:
+    """WebSocket の送受信を WsCaptureWriter に写す。WsProxy からは元の WebSocket と同じに見える。"""
+
+    def __init__(self, websocket: WebSocket, writer: WsCaptureWriter) -> None:
+        self._ws = websocket
+        self._writer = writer
+        writer.record_event(CaptureEvent.CONNECTED)
+
+    async def receive_bytes(self) -> bytes:
+        data = await self._ws.receive_bytes()
+        self._writer.record(CaptureRecord.TX, data)
+        return data
+
+    async def send_bytes(self, data: bytes) -> None:
+        await self._ws.send_bytes(data)
+        self._writer.record(CaptureRecord.RX, data)
+
+    def close_capture(self) -> None:
+        self._writer.record_event(CaptureEvent.DISCONNECTED)
+        self._writer.close()
+
+    def __getattr__(self, name: str) -> Any:
+        return getattr(self._ws, name)
+
+
+class DeviceCaptureReceiver:
+    """端末が CaptureData で送ってくる記録をファイルに書く。capture_dir が無ければ捨てる。"""
+
+    def __init__(self, capture_dir: Optional[Path], client: str) -> None:
+        self._capture_dir = capture_dir
+        self._client = client
+        self._file: Optional[BinaryIO] = None
+        self._path: Optional[Path] = None
+        self._bytes = 0
+        self._ignored_logged = False
+
+    def handle(self, msg_type: int, payload: bytes, *, start_msg_type: int, data_msg_type: int) -> None:
+        if self._capture_dir is None:
+            if not self._ignored_logged:
+                logger.info("Ignoring device capture upload (capture_dir is not set)")
+                self._ignored_logged = True
+            return
+        if msg_type == start_msg_type:
+            self.close()
+            if len(payload) < struct.calcsize(_FILE_HEADER_FMT):
+                logger.warning("Device capture START too short: %d", len(payload))
+                return
+            magic, version, *_ = struct.unpack_from(_FILE_HEADER_FMT, payload)
+            if magic != _CAPTURE_MAGIC or version != _CAPTURE_VERSION:
+                logger.warning("Unsupported device capture magic=%08x version=%d", magic, version)
+                return
+            self._path = _capture_path(self._capture_dir, self._client, "device")
+            self._path.parent.mkdir(parents=True, exist_ok=True)
+            self._file = self._path.open("wb")
+            self._file.write(payload)
+            self._bytes = len(payload)
+            return
+        if msg_type == data_msg_type and self._file is not None:
+            self._file.write(payload)
+            self._bytes += len(payload)
+
+    def close(self) -> None:
+        if self._file is None:
+            return
+        self._file.close()
+        self._file = None
+        logger.info("Saved device capture %s bytes=%d", self._path, self._bytes)
+
+
+__all__ = [
+    "CaptureEvent",
+    "CaptureOrigin",
+    "CaptureRecord",
+    "CapturingWebSocket",
+    "DeviceCaptureReceiver",
+    "WsCaptureWriter",
+]
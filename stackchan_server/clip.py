@@ -0,0 +1,216 @@
+from __future__ import annotations
+
+import asyncio
+import hashlib
+import struct
+from collections import deque
+from contextlib import suppress
+from dataclasses import dataclass
+from enum import IntEnum
+from logging import getLogger
+from typing import Awaitable, Callable, Optional
+
+from .types import SpeechSynthesizer
+
+logger = getLogger(__name__)
+
+_CLIP_RESULT_TIMEOUT_SECONDS = 1.0
+_CLIP_STORE_TIMEOUT_SECONDS = 30.0
+_CLIP_MAX_BYTES = 480_000  # ファームウェアの 1 クリップの上限（約 10 秒 @24kHz mono）
+_CLIP_CHUNK_BYTES = 4096
+# 端末は Idle の loop() で flash に書き込むので、ウェイクワード検出を妨げないよう 2 倍速程度に抑える
+_CLIP_SEND_BYTES_PER_SECOND = 96_000
+_CLIP_STORE_ATTEMPTS = 3
+
+
+class ClipStatus(IntEnum):
+    MISS = 0
+    HIT = 1
+    STORED = 2
+    STORE_FAILED = 3
+    INVENTORY = 4
+    EVICTED = 5
+
+
+@dataclass
+class _PendingClip:
+    text: str
+    pcm: Optional[bytes] = None
+    sample_rate: int = 0
+    channels: int = 1
+    attempts: int = 0
+
+
+def clip_id_for(text: str, speech_synthesizer: SpeechSynthesizer) -> int:
+    """フレーズと音声合成の実装から、端末のキャッシュのキー（uint32）を求める。"""
+    synth = type(speech_synthesizer)
+    key = f"{synth.__module__}.{synth.__qualname__}\0{text}"
+    return int.from_bytes(hashlib.sha256(key.encode("utf-8")).digest()[:4], "little")
+
+
+class ClipHandler:
+    """端末の flash に置いたフレーズ音声（クリップ）の再生とプリフェッチ。"""
+
+    def __init__(
+        self,
+        *,
+        send_packet: Callable[[int, int, bytes], Awaitable[None]],
+        clip_cmd_kind: int,
+        clip_data_kind: int,
+        start_msg_type: int,
+        data_msg_type: int,
+        end_msg_type: int,
+        speech_synthesizer: SpeechSynthesizer,
+        synthesize_pcm: Callable[[str], Awaitable[tuple[bytes, int, int]]],
+    ) -> None:
+        self._send_packet = send_packet
+        self.clip_cmd_kind = clip_cmd_kind
+        self.clip_data_kind = clip_data_kind
+        self.start_msg_type = start_msg_type
+        self.data_msg_type = data_msg_type
+        self.end_msg_type = end_msg_type
+        self.speech_synthesizer = speech_synthesizer
+        self._synthesize_pcm = synthesize_pcm
+
+        # 接続時の Inventory を受け取るまでは、キャッシュ非対応のファームウェアとして扱う
+        self._supported = False
+        self._cached: set[int] = set()
+        self._results: dict[int, ClipStatus] = {}
+        self._pending: deque[_PendingClip] = deque()
+        self._prefetch_task: Optional[asyncio.Task] = None
+
+    @property
+    def supported(self) -> bool:
+        return self._supported
+
+    def clip_id(self, text: str) -> int:
+        return clip_id_for(text, self.speech_synthesizer)
+
+    def is_cached(self, text: str) -> bool:
+        return self.clip_id(text) in self._cached
+
+    def handle_clip_event(self, payload: bytes) -> None:
+        if len(payload) < 1:
+            return
+        try:
+            status = ClipStatus(payload[0])
+        except ValueError:
+            logger.info("Received unknown clip status=%d", payload[0])
+            return
+        count = (len(payload) - 1) // 4
+        clip_ids = struct.unpack(f"<{count}I", payload[1 : 1 + count * 4])
+
+        if status == ClipStatus.INVENTORY:
+            self._supported = True
+            self._cached = set(clip_ids)
+            logger.info("Device clip cache holds %d clips", len(self._cached))
+            return
+        for clip_id in clip_ids:
+            if status in (ClipStatus.HIT, ClipStatus.STORED):
+                self._cached.add(clip_id)
+            elif status in (ClipStatus.MISS, ClipStatus.EVICTED):
+                self._cached.discard(clip_id)
+            if status != ClipStatus.EVICTED:
+                self._results[clip_id] = status
+        logger.info("Received clip event status=%s ids=%s", status.name, [f"{i:08x}" for i in clip_ids])
+
+    def queue_prefetch(
+        self,
+        text: str,
+        pcm: Optional[bytes] = None,
+        sample_rate: int = 0,
+        channels: int = 1,
+    ) -> None:
+        """次に端末が Idle になったときに保存させる。合成済みの PCM があれば再合成しない。"""
+        if not self._supported or self.is_cached(text):
+            return
+        if pcm is not None and len(pcm) > _CLIP_MAX_BYTES:
+            logger.info("Clip too long to cache: bytes=%d text=%r", len(pcm), text)
+            return
+        for pending in self._pending:
+            if pending.text == text:
+                if pcm is not None and pending.pcm is None:
+                    pending.pcm, pending.sample_rate, pending.channels = pcm, sample_rate, channels
+                return
+        self._pending.append(_PendingClip(text, pcm, sample_rate, channels))
+
+    async def play(self, text: str) -> bool:
+        """キャッシュから再生させる。Miss（または応答なし）なら False。"""
+        clip_id = self.clip_id(text)
+        self._results.pop(clip_id, None)
+        await self._send_packet(self.clip_cmd_kind, self.data_msg_type, struct.pack("<I", clip_id))
+        status = await self._wait_result(clip_id, _CLIP_RESULT_TIMEOUT_SECONDS)
+        if status != ClipStatus.HIT:
+            logger.info("Clip %08x not played (%s); streaming instead", clip_id, status)
+            self._cached.discard(clip_id)
+            self.queue_prefetch(text)
+            return False
+        return True
+
+    def start_prefetch(self, is_idle: Callable[[], bool]) -> None:
+        """端末が Idle に入ったときに呼ぶ。保存待ちのクリップを順に送る。"""
+        if not self._pending or (self._prefetch_task is not None and not self._prefetch_task.done()):
+            return
+        self._prefetch_task = asyncio.create_task(self._run_prefetch(is_idle))
+
+    async def close(self) -> None:
+        task = self._prefetch_task
+        self._prefetch_task = None
+        if task is not None and not task.done():
+            task.cancel()
+            with suppress(asyncio.CancelledError):
+                await task
+
+    async def _run_prefetch(self, is_idle: Callable[[], bool]) -> None:
+        while self._pending and is_idle():
+            pending = self._pending.popleft()
+            try:
+                stored = await self._store(pending, is_idle)
+            except Exception:
+                logger.exception("Clip prefetch failed text=%r", pending.text)
+                continue
+            if not stored and pending.attempts < _CLIP_STORE_ATTEMPTS:
+                # Idle を抜けて中断された。次の Idle でやり直す
+                self._pending.appendleft(pending)
+                return
+
+    async def _store(self, pending: _PendingClip, is_idle: Callable[[], bool]) -> bool:
+        pending.attempts += 1
+        if pending.pcm is None:
+            pending.pcm, pending.sample_rate, pending.channels = await self._synthesize_pcm(pending.text)
+        pcm = pending.pcm
+        if len(pcm) == 0 or len(pcm) > _CLIP_MAX_BYTES:
+            logger.info("Clip not cacheable: bytes=%d text=%r", len(pcm), pending.text)
+            return True
+        clip_id = self.clip_id(pending.text)
+        self._results.pop(clip_id, None)
+        logger.info("Prefetching clip %08x bytes=%d text=%r", clip_id, len(pcm), pending.text)
+
+        start_payload = struct.pack("<IIHI", clip_id, pending.sample_rate, pending.channels, len(pcm))
+        await self._send_packet(self.clip_data_kind, self.start_msg_type, start_payload)
+        loop = asyncio.get_running_loop()
+        base_time = loop.time()
+        for offset in range(0, len(pcm), _CLIP_CHUNK_BYTES):
+            if not is_idle() or clip_id in self._results:
+                # 端末が Idle を抜けた（StoreFailed が返る）
+                return False
+            target_time = base_time + offset / _CLIP_SEND_BYTES_PER_SECOND
+            if target_time > loop.time():
+                await asyncio.sleep(target_time - loop.time())
+            chunk = pcm[offset : offset + _CLIP_CHUNK_BYTES]
+            await self._send_packet(self.clip_data_kind, self.data_msg_type, chunk)
+        await self._send_packet(self.clip_data_kind, self.end_msg_type, b"")
+        return await self._wait_result(clip_id, _CLIP_STORE_TIMEOUT_SECONDS) == ClipStatus.STORED
+
+    async def _wait_result(self, clip_id: int, timeout_seconds: float) -> Optional[ClipStatus]:
+        loop = asyncio.get_running_loop()
+        deadline = loop.time() + timeout_seconds
+        while loop.time() < deadline:
+            status = self._results.pop(clip_id, None)
+            if status is not None:
+                return status
+            await asyncio.sleep(0.01)
+        return None
+
+
+__all__ = ["ClipHandler", "ClipStatus", "clip_id_for"]
@@ -1,7 +1,9 @@
 from __future__ import annotations
 
 import asyncio
+import struct
 import wave
+from dataclasses import dataclass
 from datetime import UTC, datetime
 from logging import getLogger
 from pathlib import Path
@@ -9,8 +11,14 @@ from typing import Awaitable, Callable, Optional
 
 from fastapi import WebSocket, WebSocketDisconnect
 
+from .log_mel import LOG_MEL_FRAME_BYTES, LOG_MEL_HOP_SAMPLES, LogMelFeatures
 from .static import LISTEN_AUDIO_FORMAT
-from .types import SpeechRecognizer, StreamingSpeechRecognizer, StreamingSpeechSession
+from .types import (
+    LogMelSpeechRecognizer,
+    SpeechRecognizer,
+    StreamingSpeechRecognizer,
+    StreamingSpeechSession,
+)
 
 logger = getLogger(__name__)
 
@@ -23,6 +31,73 @@ class EmptyTranscriptError(Exception):
     pass
 
 
+class ListenCancelledError(EmptyTranscriptError):
+    """ファームウェアがローカルコマンドでターンを処理し、発話を取り消した。"""
+
+
+_RESUME_GRACE_SECONDS = 10.0
+_RESUME_LOOKUP_SECONDS = 2.0
+
+
+@dataclass
+class _ParkedSession:
+    session_id: int
+    pcm_buffer: bytearray
+    speech_stream: Optional[StreamingSpeechSession]
+    last_seq: Optional[int]
+    log_mel: bool
+    expires_at: float
+
+
+class UplinkSessionStore:
+    """WebSocket が切れた時点で受信途中だった uplink を、再接続まで預かる。"""
+
+    def __init__(self, *, grace_seconds: float = _RESUME_GRACE_SECONDS) -> None:
+        self.grace_seconds = grace_seconds
+        self._sessions: dict[int, _ParkedSession] = {}
+
+    async def park(
+        self,
+        *,
+        session_id: int,
+        pcm_buffer: bytearray,
+        speech_stream: Optional[StreamingSpeechSession],
+        last_seq: Optional[int],
+        log_mel: bool = False,
+    ) -> None:
+        await self._drop_expired()
+        loop = asyncio.get_running_loop()
+        self._sessions[session_id] = _ParkedSession(
+            session_id=session_id,
+            pcm_buffer=pcm_buffer,
+            speech_stream=speech_stream,
+            last_seq=last_seq,
+            log_mel=log_mel,
+            expires_at=loop.time() + self.grace_seconds,
+        )
+        logger.info("Parked uplink session=%08x bytes=%d", session_id, len(pcm_buffer))
+
+    async def take(self, session_id: int, *, wait_seconds: float) -> Optional[_ParkedSession]:
+        # 旧接続の切断処理が新接続の START より後に走ることがあるので、少し待つ
+        loop = asyncio.get_running_loop()
+        deadline = loop.time() + wait_seconds
+        while True:
+            await self._drop_expired()
+            session = self._sessions.pop(session_id, None)
+            if session is not None or loop.time() >= deadline:
+                return session
+            await asyncio.sleep(0.05)
+
+    async def _drop_expired(self) -> None:
+        now = asyncio.get_running_loop().time()
+        expired = [sid for sid, session in self._sessions.items() if session.expires_at <= now]
+        for sid in expired:
+            session = self._sessions.pop(sid)
+            logger.info("Dropped expired uplink session=%08x", sid)
+            if session.speech_stream is not None:
+                await session.speech_stream.abort()
+
+
 class ListenHandler:
     def __init__(
         self,
@@ -31,8 +106,10 @@ class ListenHandler:
         recordings_dir: Path,
         debug_recording: bool,
         listen_audio_timeout_seconds: float,
+        session_store: Optional[UplinkSessionStore] = None,
     ) -> None:
         self.speech_recognizer = speech_recognizer
+        self.session_store = session_store
         self.recordings_dir = recordings_dir
         self.debug_recording = debug_recording
         self.audio_format = LISTEN_AUDIO_FORMAT
@@ -45,8 +122,47 @@ class ListenHandler:
         self._message_error: Optional[Exception] = None
         self._transcript: Optional[str] = None
         self._speech_stream: Optional[StreamingSpeechSession] = None
+        self._session_id: Optional[int] = None
+        self._last_seq: Optional[int] = None
+        self._listen_active = False
+        self._follow_up_pending = False
+        # 受信中のセッションが AudioLogMel（対数メル特徴量）か。_pcm_buffer にはフレームがそのまま入る
+        self._log_mel = False
+        # 受信した DATA の長さ（ms）ごとの個数。ファームウェアは回線の状態で長さを変える
+        self._chunk_ms_counts: dict[int, int] = {}
+
+    @property
+    def session_id(self) -> Optional[int]:
+        return self._session_id
+
+    @property
+    def follow_up_pending(self) -> bool:
+        """listen() の外でファームウェアが会話モードの発話を送り始めたか。"""
+        return self._follow_up_pending
+
+    @property
+    def last_seq(self) -> Optional[int]:
+        return self._last_seq
+
+    @property
+    def streaming_recognition(self) -> bool:
+        """受信中の音声をストリーミング認識に流しているか（短い DATA ほど認識が早く進む）。"""
+        return self._speech_stream is not None
 
     async def close(self) -> None:
+        if self._streaming and self._session_id is not None and self.session_store is not None:
+            # 受信途中の切断。再接続後の START(resume) で続きを受けられるよう預ける
+            await self.session_store.park(
+                session_id=self._session_id,
+                pcm_buffer=self._pcm_buffer,
+                speech_stream=self._speech_stream,
+                last_seq=self._last_seq,
+                log_mel=self._log_mel,
+            )
+            self._speech_stream = None
+            self._streaming = False
+            self._session_id = None
+            return
         await self._abort_speech_stream()
 
     async def listen(
@@ -57,7 +173,30 @@ class ListenHandler:
         idle_state: int,
         listening_state: int,
     ) -> str:
-        await send_state_command(listening_state)
+        self._listen_active = True
+        try:
+            return await self._wait_transcript(
+                send_state_command=send_state_command,
+                is_closed=is_closed,
+                idle_state=idle_state,
+                listening_state=listening_state,
+            )
+        finally:
+            self._listen_active = False
+
+    async def _wait_transcript(
+        self,
+        *,
+        send_state_command: Callable[[int], Awaitable[None]],
+        is_closed: Callable[[], bool],
+        idle_state: int,
+        listening_state: int,
+    ) -> str:
+        # 会話モードで既に届いている発話は、Listening を指示し直さずにそのまま受け取る
+        follow_up = self._follow_up_pending
+        self._follow_up_pending = False
+        if not follow_up:
+            await send_state_command(listening_state)
         loop = asyncio.get_running_loop()
         last_counter = self._pcm_data_counter
         last_data_time = loop.time()
@@ -82,13 +221,52 @@ class ListenHandler:
                 raise TimeoutError("Timed out after audio data inactivity from firmware")
             await asyncio.sleep(0.05)
 
-    async def handle_start(self, websocket: WebSocket) -> bool:
-        logger.info("Received START")
+    async def handle_start(
+        self,
+        websocket: WebSocket,
+        payload: bytes = b"",
+        *,
+        resume: bool = False,
+        follow_up: bool = False,
+        log_mel: bool = False,
+    ) -> bool:
+        logger.info("Received START resume=%s follow_up=%s log_mel=%s", resume, follow_up, log_mel)
+        session_id = struct.unpack("<I", payload[:4])[0] if len(payload) >= 4 else None
         await self._abort_speech_stream()
+        self._message_error = None
+        if resume and session_id is not None and self.session_store is not None:
+            parked = await self.session_store.take(session_id, wait_seconds=_RESUME_LOOKUP_SECONDS)
+            if parked is not None and parked.log_mel == log_mel:
+                self._pcm_buffer = parked.pcm_buffer
+                self._speech_stream = parked.speech_stream
+                self._last_seq = parked.last_seq
+                self._session_id = session_id
+                self._streaming = True
+                logger.info(
+                    "Resumed uplink session=%08x bytes=%d last_seq=%s",
+                    session_id,
+                    len(self._pcm_buffer),
+                    self._last_seq,
+                )
+                return True
+            # 預かりが無い（期限切れ・サーバー再起動）。以降の音声だけで新しく始める
+            logger.info("Uplink session=%08x not found; starting fresh", session_id)
+        if log_mel and not isinstance(self.speech_recognizer, LogMelSpeechRecognizer):
+            logger.error(
+                "Firmware sends log-mel features but %s cannot transcribe them; set UPLINK_LOG_MEL_H 0",
+                type(self.speech_recognizer).__name__,
+            )
+            asyncio.create_task(websocket.close(code=1003, reason="log-mel uplink not supported"))
+            return False
         self._pcm_buffer = bytearray()
         self._streaming = True
-        self._message_error = None
-        if isinstance(self.speech_recognizer, StreamingSpeechRecognizer):
+        self._session_id = session_id
+        self._last_seq = None
+        self._log_mel = log_mel
+        self._chunk_ms_counts = {}
+        # listen() を待たずに始まった発話は、次の talk_session で受け取る
+        self._follow_up_pending = follow_up and not self._listen_active
+        if not log_mel and isinstance(self.speech_recognizer, StreamingSpeechRecognizer):
             try:
                 self._speech_stream = await self.speech_recognizer.start_stream()
             except Exception:
@@ -96,13 +274,23 @@ class ListenHandler:
                 return False
         return True
 
-    async def handle_data(self, websocket: WebSocket, payload_bytes: int, payload: bytes) -> bool:
+    async def handle_data(
+        self, websocket: WebSocket, payload_bytes: int, payload: bytes, seq: Optional[int] = None
+    ) -> bool:
         logger.info("Received DATA payload_bytes=%d", payload_bytes)
+        if self._streaming and seq is not None and self._session_id is not None:
+            # 再開時に送り直された DATA のうち、受信済みのものは捨てる
+            if self._last_seq is not None:
+                delta = (seq - self._last_seq) & 0xFFFF
+                if delta == 0 or delta >= 0x8000:
+                    logger.info("Dropped duplicate DATA seq=%d", seq)
+                    return True
+            self._last_seq = seq
         if not self._streaming:
             await self._abort_speech_stream()
             asyncio.create_task(websocket.close(code=1003, reason="data received before start"))
             return False
-        if payload_bytes % (self.audio_format.sample_width * self.audio_format.channels) != 0:
+        if payload_bytes % self._unit_bytes() != 0:
             await self._abort_speech_stream()
             asyncio.create_task(websocket.close(code=1003, reason="invalid pcm chunk length"))
             return False
@@ -115,6 +303,8 @@ class ListenHandler:
                 asyncio.create_task(websocket.close(code=1011, reason="speech streaming failed"))
                 return False
             self._pcm_data_counter += 1
+            chunk_ms = self._chunk_ms(payload_bytes)
+            self._chunk_ms_counts[chunk_ms] = self._chunk_ms_counts.get(chunk_ms, 0) + 1
         return True
 
     async def handle_end(
@@ -127,11 +317,16 @@ class ListenHandler:
         thinking_state: int,
     ) -> None:
         logger.info("Received END payload_bytes=%d", payload_bytes)
+        if self._chunk_ms_counts:
+            logger.info(
+                "Uplink DATA sizes: %s",
+                ", ".join(f"{ms}ms x{count}" for ms, count in sorted(self._chunk_ms_counts.items())),
+            )
         if not self._streaming:
             await self._abort_speech_stream()
             await websocket.close(code=1003, reason="end received before start")
             return
-        if payload_bytes % (self.audio_format.sample_width * self.audio_format.channels) != 0:
+        if payload_bytes % self._unit_bytes() != 0:
             await self._abort_speech_stream()
             await websocket.close(code=1003, reason="invalid pcm tail length")
             return
@@ -144,15 +339,17 @@ class ListenHandler:
                 await websocket.close(code=1011, reason="speech streaming failed")
                 return
 
-        if len(self._pcm_buffer) == 0 or len(self._pcm_buffer) % (
-            self.audio_format.sample_width * self.audio_format.channels
-        ) != 0:
+        if len(self._pcm_buffer) == 0 or len(self._pcm_buffer) % self._unit_bytes() != 0:
             await self._abort_speech_stream()
             await websocket.close(code=1003, reason="invalid accumulated pcm length")
             return
 
         await send_state_command(thinking_state)
 
+        if self._log_mel:
+            await self._finish_log_mel(websocket)
+            return
+
         frames = len(self._pcm_buffer) // (self.audio_format.sample_width * self.audio_format.channels)
         duration_seconds = frames / float(self.audio_format.sample_rate_hz)
         ws_meta = {
@@ -174,6 +371,8 @@ class ListenHandler:
 
         self._streaming = False
         self._pcm_buffer = bytearray()
+        self._session_id = None
+        self._last_seq = None
 
         if transcript.strip() == "":
             self._message_error = EmptyTranscriptError("Speech recognition result is empty")
@@ -182,6 +381,60 @@ class ListenHandler:
         self._transcript = transcript
         self._message_ready.set()
 
+    async def _finish_log_mel(self, websocket: WebSocket) -> None:
+        features = LogMelFeatures(bytes(self._pcm_buffer))
+        pcm_bytes = features.frames * LOG_MEL_HOP_SAMPLES * LISTEN_AUDIO_FORMAT.sample_width
+        await websocket.send_json(
+            {
+                "log_mel_frames": features.frames,
+                "duration_seconds": round(features.duration_seconds, 3),
+                "uplink_bytes": len(features.data),
+                "pcm_equivalent_bytes": pcm_bytes,
+                "text": "Recording skipped (log-mel uplink)",
+            }
+        )
+        recognizer = self.speech_recognizer
+        if not isinstance(recognizer, LogMelSpeechRecognizer):  # handle_start で確認済み
+            raise TypeError("speech recognizer cannot transcribe log-mel features")
+        transcript = await recognizer.transcribe_log_mel(features)
+        if transcript:
+            logger.info("Transcript: %s", transcript)
+
+        self._streaming = False
+        self._pcm_buffer = bytearray()
+        self._session_id = None
+        self._last_seq = None
+        self._log_mel = False
+
+        if transcript.strip() == "":
+            self._message_error = EmptyTranscriptError("Speech recognition result is empty")
+            return
+
+        self._transcript = transcript
+        self._message_ready.set()
+
+    async def handle_cancel(self) -> None:
+        """END(cancel): 受信中の発話を認識せずに捨てる。"""
+        logger.info("Received END (cancel) session=%s", self._session_id)
+        await self._abort_speech_stream()
+        self._streaming = False
+        self._pcm_buffer = bytearray()
+        self._session_id = None
+        self._last_seq = None
+        self._follow_up_pending = False
+        if self._listen_active:
+            self._message_error = ListenCancelledError("Listening was cancelled by a local command")
+
+    def _unit_bytes(self) -> int:
+        if self._log_mel:
+            return LOG_MEL_FRAME_BYTES
+        return self.audio_format.sample_width * self.audio_format.channels
+
+    def _chunk_ms(self, payload_bytes: int) -> int:
+        units = payload_bytes // self._unit_bytes()
+        samples = units * LOG_MEL_HOP_SAMPLES if self._log_mel else units
+        return round(samples * 1000 / self.audio_format.sample_rate_hz)
+
     def _save_wav(self, pcm_bytes: bytes) -> tuple[Path, str]:
         timestamp = datetime.now(UTC).strftime("%Y%m%d_%H%M%S_%f")
         filename = f"rec_ws_{timestamp}.wav"
@@ -228,4 +481,10 @@ class ListenHandler:
             await speech_stream.abort()
 
 
-__all__ = ["ListenHandler", "TimeoutError", "EmptyTranscriptError"]
+__all__ = [
+    "ListenHandler",
+    "TimeoutError",
+    "EmptyTranscriptError",
+    "ListenCancelledError",
+    "UplinkSessionStore",
+]
@@ -0,0 +1,144 @@
+from __future__ import annotations
+
+import cmath
+import math
+from dataclasses import dataclass
+from functools import lru_cache
+
+from .static import LISTEN_AUDIO_FORMAT
+
+# ファームウェアの LogMelExtractor（firmware/include/log_mel.hpp）と同じ定義
+LOG_MEL_BANDS = 80
+LOG_MEL_WINDOW_SAMPLES = 400  # 25 ms @16kHz
+LOG_MEL_HOP_SAMPLES = 160  # 10 ms @16kHz
+LOG_MEL_FFT_SIZE = 512
+LOG_MEL_FRAME_BYTES = LOG_MEL_BANDS
+
+# 量子化: q = round(4 * log2(メルパワー))（int16 の振幅のまま）
+_Q_PER_OCTAVE = 4.0
+# 振幅を -1〜1 に正規化したときのパワーは 2^-30 倍
+_INT16_POWER_OCTAVES = 30.0
+_LOG10_2 = math.log10(2.0)
+
+_WHISPER_N_FRAMES = 3000  # 30 秒
+
+
+@dataclass(frozen=True)
+class LogMelFeatures:
+    """端末から届いた対数メル特徴量。data はフレームごとに LOG_MEL_BANDS バイト。"""
+
+    data: bytes
+
+    @property
+    def frames(self) -> int:
+        return len(self.data) // LOG_MEL_FRAME_BYTES
+
+    @property
+    def duration_seconds(self) -> float:
+        return self.frames * LOG_MEL_HOP_SAMPLES / float(LISTEN_AUDIO_FORMAT.sample_rate_hz)
+
+    def log10_mel(self) -> list[list[float]]:
+        """Whisper の log10 メル（振幅 -1〜1 の尺度）。[band][frame] の順。"""
+        frames = self.frames
+        return [
+            [
+                (self.data[frame * LOG_MEL_FRAME_BYTES + band] / _Q_PER_OCTAVE - _INT16_POWER_OCTAVES) * _LOG10_2
+                for frame in range(frames)
+            ]
+            for band in range(LOG_MEL_BANDS)
+        ]
+
+    def whisper_input(self, n_frames: int = _WHISPER_N_FRAMES) -> list[list[float]]:
+        """whisper.log_mel_spectrogram + pad_or_trim と同じ正規化をした [80][n_frames]。"""
+        log_spec = self.log10_mel()
+        peak = max((value for row in log_spec for value in row), default=0.0)
+        floor = peak - 8.0
+        normalized = [[(max(value, floor) + 4.0) / 4.0 for value in row[:n_frames]] for row in log_spec]
+        # 無音のゼロ詰めは log10 の下限に張り付くので、正規化後の最小値で埋める
+        pad_value = (floor + 4.0) / 4.0
+        for row in normalized:
+            row.extend([pad_value] * (n_frames - len(row)))
+        return normalized
+
+
+@lru_cache(maxsize=4)
+def mel_filters(sample_rate: int = LISTEN_AUDIO_FORMAT.sample_rate_hz) -> tuple[tuple[int, tuple[float, ...]], ...]:
+    """Slaney 型のメルフィルタ（librosa.filters.mel と同じ）。バンドごとに (先頭ビン, 重み)。"""
+    bins = LOG_MEL_FFT_SIZE // 2 + 1
+    bin_hz = sample_rate / LOG_MEL_FFT_SIZE
+    max_mel = _hz_to_mel(sample_rate / 2.0)
+    points = [_mel_to_hz(max_mel * i / (LOG_MEL_BANDS + 1)) for i in range(LOG_MEL_BANDS + 2)]
+    filters = []
+    for band in range(LOG_MEL_BANDS):
+        lower, center, upper = points[band], points[band + 1], points[band + 2]
+        norm = 2.0 / (upper - lower)
+        first = 0
+        weights: list[float] = []
+        for k in range(bins):
+            hz = k * bin_hz
+            weight = max(0.0, min((hz - lower) / (center - lower), (upper - hz) / (upper - center)))
+            if weight <= 0.0:
+                if weights:
+                    break
+                continue
+            if not weights:
+                first = k
+            weights.append(weight * norm)
+        filters.append((first, tuple(weights)))
+    return tuple(filters)
+
+
+def reference_log_mel(pcm_bytes: bytes) -> LogMelFeatures:
+    """PCM16LE から端末と同じ特徴量を求める参照実装（float64、適合試験用）。"""
+    count = len(pcm_bytes) // 2
+    samples = [int.from_bytes(pcm_bytes[i * 2 : i * 2 + 2], "little", signed=True) for i in range(count)]
+    window = [0.5 - 0.5 * math.cos(2.0 * math.pi * i / LOG_MEL_WINDOW_SAMPLES) for i in range(LOG_MEL_WINDOW_SAMPLES)]
+    filters = mel_filters()
+    out = bytearray()
+    for start in range(0, count - LOG_MEL_WINDOW_SAMPLES + 1, LOG_MEL_HOP_SAMPLES):
+        frame = [complex(samples[start + i] * window[i]) for i in range(LOG_MEL_WINDOW_SAMPLES)]
+        frame.extend([0j] * (LOG_MEL_FFT_SIZE - LOG_MEL_WINDOW_SAMPLES))
+        spectrum = _fft(frame)
+        power = [abs(spectrum[k]) ** 2 for k in range(LOG_MEL_FFT_SIZE // 2 + 1)]
+        for first, weights in filters:
+            mel = sum(power[first + i] * weight for i, weight in enumerate(weights))
+            q = round(_Q_PER_OCTAVE * math.log2(mel)) if mel > 1.0 else 0
+            out.append(min(255, q))
+    return LogMelFeatures(bytes(out))
+
+
+def _fft(values: list[complex]) -> list[complex]:
+    size = len(values)
+    if size == 1:
+        return values
+    even = _fft(values[0::2])
+    odd = _fft(values[1::2])
+    result = [0j] * size
+    for k in range(size // 2):
+        twiddled = cmath.exp(-2j * math.pi * k / size) * odd[k]
+        result[k] = even[k] + twiddled
+        result[k + size // 2] = even[k] - twiddled
+    return result
+
+
+def _hz_to_mel(hz: float) -> float:
+    if hz < 1000.0:
+        return hz * 3.0 / 200.0
+    return 15.0 + math.log(hz / 1000.0) / (math.log(6.4) / 27.0)
+
+
+def _mel_to_hz(mel: float) -> float:
+    if mel < 15.0:
+        return mel * 200.0 / 3.0
+    return 1000.0 * math.exp(math.log(6.4) / 27.0 * (mel - 15.0))
+
+
+__all__ = [
+    "LOG_MEL_BANDS",
+    "LOG_MEL_FRAME_BYTES",
+    "LOG_MEL_HOP_SAMPLES",
+    "LOG_MEL_WINDOW_SAMPLES",
+    "LogMelFeatures",
+    "mel_filters",
+    "reference_log_mel",
+]
@@ -7,7 +7,7 @@ import wave
 from datetime import UTC, datetime
 from logging import getLogger
 from pathlib import Path
-from typing import Awaitable, Callable
+from typing import Awaitable, Callable, Optional
 
 from fastapi import WebSocket, WebSocketDisconnect
 
@@ -16,6 +16,8 @@ from .types import AudioFormat, SpeechSynthesizer, StreamingSpeechSynthesizer
 
 logger = getLogger(__name__)
 
+_CREDIT_WAIT_TIMEOUT_SECONDS = 30.0
+
 
 class SpeakHandler:
     def __init__(
@@ -27,6 +29,7 @@ class SpeakHandler:
         start_msg_type: int,
         data_msg_type: int,
         end_msg_type: int,
+        end_of_utterance_flag: int,
         down_wav_chunk: int,
         down_segment_millis: int,
         down_segment_stagger_millis: int,
@@ -41,6 +44,7 @@ class SpeakHandler:
         self.start_msg_type = start_msg_type
         self.data_msg_type = data_msg_type
         self.end_msg_type = end_msg_type
+        self.end_of_utterance_flag = end_of_utterance_flag
         self.down_wav_chunk = down_wav_chunk
         self.down_segment_millis = down_segment_millis
         self.down_segment_stagger_millis = down_segment_stagger_millis
@@ -52,10 +56,24 @@ class SpeakHandler:
         self._speaking = False
         self._speak_finished_counter = 0
 
+        # ファームウェアが AudioCreditEvt を送ってきたら、壁時計ペーシングの代わりに
+        # クレジット（再生バッファの空きバイト数）の範囲で DATA を送る
+        self._credits_enabled = False
+        self._credit_bytes = 0
+
     @property
     def speaking(self) -> bool:
         return self._speaking
 
+    @property
+    def credits_enabled(self) -> bool:
+        return self._credits_enabled
+
+    def handle_credit(self, credit_bytes: int) -> None:
+        self._credits_enabled = True
+        self._credit_bytes += credit_bytes
+        logger.debug("Received audio credit=%d available=%d", credit_bytes, self._credit_bytes)
+
     def handle_speak_done_event(self) -> None:
         self._speak_finished_counter += 1
         self._speaking = False
@@ -69,9 +87,14 @@ class SpeakHandler:
         send_state_command: Callable[[int], Awaitable[None]],
         idle_state: int,
         is_closed: Callable[[], bool],
+        play_cached: Optional[Callable[[], Awaitable[bool]]] = None,
+        capture_pcm: Optional[Callable[[bytes, int, int], None]] = None,
     ) -> None:
         start_counter = self._speak_finished_counter
-        await self._start_talking_stream(text, next_seq=next_seq)
+        # 端末のキャッシュにあればそこから再生させ、無ければ（Miss）合成して流す
+        self._speaking = True
+        if play_cached is None or not await play_cached():
+            await self._start_talking_stream(text, next_seq=next_seq, capture_pcm=capture_pcm)
         if not self._speaking:
             return
         await self._wait_for_speaking_finished(
@@ -100,7 +123,30 @@ class SpeakHandler:
                 raise TimeoutError("Timed out waiting for speaking finished event")
             await asyncio.sleep(0.05)
 
-    async def _start_talking_stream(self, text: str, *, next_seq: Callable[[], int]) -> None:
+    async def synthesize_pcm(self, text: str) -> tuple[bytes, int, int]:
+        """発話全体の PCM を合成する（端末のキャッシュへの保存用）。(pcm, sample_rate, channels)"""
+        if isinstance(self.speech_synthesizer, StreamingSpeechSynthesizer):
+            output_format = self.speech_synthesizer.output_format
+            pcm = bytearray()
+            async for chunk in self.speech_synthesizer.synthesize_stream(text):
+                pcm.extend(chunk)
+            sample_rate = output_format.sample_rate_hz
+            channels = output_format.channels
+            sample_width = output_format.sample_width
+        else:
+            wav_bytes = await self.speech_synthesizer.synthesize(text)
+            pcm, sample_rate, channels, sample_width = self._extract_pcm(wav_bytes)
+        if sample_width != self.sample_width:
+            raise ValueError(f"unsupported sample width {sample_width}")
+        return bytes(pcm), sample_rate, channels
+
+    async def _start_talking_stream(
+        self,
+        text: str,
+        *,
+        next_seq: Callable[[], int],
+        capture_pcm: Optional[Callable[[bytes, int, int], None]] = None,
+    ) -> None:
         self._speaking = True
         try:
             if isinstance(self.speech_synthesizer, StreamingSpeechSynthesizer):
@@ -108,6 +154,7 @@ class SpeakHandler:
                     text,
                     self.speech_synthesizer,
                     next_seq=next_seq,
+                    capture_pcm=capture_pcm,
                 )
                 return
             wav_bytes = await self.speech_synthesizer.synthesize(text)
@@ -150,6 +197,8 @@ class SpeakHandler:
                 segment_bytes,
                 next_seq=next_seq,
             )
+            if capture_pcm is not None:
+                capture_pcm(pcm_bytes, tts_sample_rate, tts_channels)
         except Exception as exc:  # pragma: no cover
             self._speaking = False
             logger.exception("Speech synthesis failed")
@@ -161,6 +210,7 @@ class SpeakHandler:
         speech_synthesizer: StreamingSpeechSynthesizer,
         *,
         next_seq: Callable[[], int],
+        capture_pcm: Optional[Callable[[bytes, int, int], None]] = None,
     ) -> None:
         output_format = speech_synthesizer.output_format
         logger.info(
@@ -189,9 +239,10 @@ class SpeakHandler:
         base_time: float | None = None
         async for chunk in speech_synthesizer.synthesize_stream(text):
             pending.extend(chunk)
-            if self.debug_recording:
+            if self.debug_recording or capture_pcm is not None:
                 saved_pcm.extend(chunk)
-            while len(pending) >= segment_bytes:
+            # 最終セグメントに発話終了フラグを付けるため、常に 1 バイト以上を手元に残す
+            while len(pending) > segment_bytes:
                 segment = bytes(pending[:segment_bytes])
                 del pending[:segment_bytes]
                 base_time = await self._wait_for_segment_slot(segment_count, base_time=base_time)
@@ -209,9 +260,12 @@ class SpeakHandler:
                 output_format.sample_rate_hz,
                 output_format.channels,
                 next_seq=next_seq,
+                last=True,
             )
             segment_count += 1
         logger.info("Prepared %d playback segments from streaming TTS", segment_count)
+        if capture_pcm is not None and saved_pcm:
+            capture_pcm(bytes(saved_pcm), output_format.sample_rate_hz, output_format.channels)
 
         if self.debug_recording and saved_pcm:
             wav_bytes = self._wrap_pcm_as_wav(bytes(saved_pcm), output_format)
@@ -247,10 +301,21 @@ class SpeakHandler:
                 wav_fp.writeframes(pcm_bytes)
             return buffer.getvalue()
 
+    async def _acquire_credit(self, nbytes: int) -> None:
+        if not self._credits_enabled:
+            return
+        loop = asyncio.get_running_loop()
+        deadline = loop.time() + _CREDIT_WAIT_TIMEOUT_SECONDS
+        while self._credit_bytes < nbytes:
+            if loop.time() >= deadline:
+                raise TimeoutError("Timed out waiting for audio credit")
+            await asyncio.sleep(0.01)
+        self._credit_bytes -= nbytes
+
     async def _wait_for_segment_slot(self, segment_index: int, *, base_time: float | None) -> float:
         loop = asyncio.get_running_loop()
-        if base_time is None:
-            return loop.time()
+        if base_time is None or self._credits_enabled:
+            return base_time if base_time is not None else loop.time()
 
         if segment_index == 0:
             target_ms = 0
@@ -286,7 +351,7 @@ class SpeakHandler:
         base_time = loop.time()
 
         for idx, segment in enumerate(segments):
-            if idx == 0:
+            if self._credits_enabled or idx == 0:
                 target_ms = 0
             elif idx == 1:
                 target_ms = self.down_segment_stagger_millis
@@ -298,7 +363,13 @@ class SpeakHandler:
             if target_time > now:
                 await asyncio.sleep(target_time - now)
 
-            await self._send_segment(segment, tts_sample_rate, tts_channels, next_seq=next_seq)
+            await self._send_segment(
+                segment,
+                tts_sample_rate,
+                tts_channels,
+                next_seq=next_seq,
+                last=idx == len(segments) - 1,
+            )
 
     async def _send_segment(
         self,
@@ -307,8 +378,9 @@ class SpeakHandler:
         tts_channels: int,
         *,
         next_seq: Callable[[], int],
+        last: bool = False,
     ) -> None:
-        logger.info("Sending segment bytes=%d", len(segment_pcm))
+        logger.info("Sending segment bytes=%d last=%s", len(segment_pcm), last)
         start_payload = struct.pack("<IH", tts_sample_rate, tts_channels)
         start_hdr = struct.pack(
             self.ws_header_fmt,
@@ -324,6 +396,7 @@ class SpeakHandler:
         seg_total = len(segment_pcm)
         while seg_offset < seg_total:
             chunk = segment_pcm[seg_offset : seg_offset + self.down_wav_chunk]
+            await self._acquire_credit(len(chunk))
             data_hdr = struct.pack(
                 self.ws_header_fmt,
                 self.wav_kind,
@@ -339,7 +412,7 @@ class SpeakHandler:
             self.ws_header_fmt,
             self.wav_kind,
             self.end_msg_type,
-            0,
+            self.end_of_utterance_flag if last else 0,
             next_seq(),
             0,
         )
@@ -3,6 +3,7 @@ from __future__ import annotations
 from ..types import SpeechRecognizer
 from .google_cloud import GoogleCloudSpeechToText
 from .whisper_cpp import WhisperCppSpeechToText
+from .whisper_log_mel import WhisperLogMelSpeechToText
 from .whisper_server import WhisperServerSpeechToText
 
 
@@ -13,6 +14,7 @@ def create_speech_recognizer() -> SpeechRecognizer:
 __all__ = [
     "GoogleCloudSpeechToText",
     "WhisperCppSpeechToText",
+    "WhisperLogMelSpeechToText",
     "WhisperServerSpeechToText",
     "create_speech_recognizer",
 ]
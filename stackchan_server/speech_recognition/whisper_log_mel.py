@@ -0,0 +1,93 @@
+from __future__ import annotations
+
+import asyncio
+import os
+from logging import getLogger
+from typing import Any
+
+from ..log_mel import LOG_MEL_BANDS, LogMelFeatures
+from ..static import LISTEN_AUDIO_FORMAT, LISTEN_LANGUAGE_CODE
+from ..types import LogMelSpeechRecognizer, SpeechRecognizer
+
+logger = getLogger(__name__)
+
+_DEFAULT_MODEL_NAME = "small"
+# 量子化後の log2 パワーの平均がこれ未満なら無音とみなす（PCM の実効値でおよそ 75 相当）
+_DEFAULT_SILENCE_LEVEL = 60.0
+
+
+class WhisperLogMelSpeechToText(SpeechRecognizer, LogMelSpeechRecognizer):
+    """openai-whisper のモデルに、端末が送った対数メル特徴量をそのまま入れて認識する。
+
+    AudioLogMel で受けた発話は PCM に戻さずにデコードする。AudioPcm の発話は whisper 自身で特徴量を求める。
+    80 バンドのモデル（large-v3 以外）が必要。`pip install openai-whisper` で入る whisper と torch を使う。
+    """
+
+    def __init__(
+        self,
+        *,
+        model_name: str | None = None,
+        device: str | None = None,
+        language: str | None = None,
+        silence_level: float = _DEFAULT_SILENCE_LEVEL,
+    ) -> None:
+        self._model_name = model_name or os.getenv("STACKCHAN_WHISPER_LOG_MEL_MODEL") or _DEFAULT_MODEL_NAME
+        self._device = device
+        self._language = language or LISTEN_LANGUAGE_CODE.split("-", 1)[0].lower()
+        self._silence_level = silence_level
+        self._model: Any = None
+        self._load_lock = asyncio.Lock()
+
+    async def transcribe(self, pcm_bytes: bytes) -> str:
+        model = await self._ensure_model()
+        return await asyncio.to_thread(self._decode_pcm, model, pcm_bytes)
+
+    async def transcribe_log_mel(self, features: LogMelFeatures) -> str:
+        if features.frames == 0:
+            return ""
+        level = sum(features.data) / len(features.data)
+        if level < self._silence_level:
+            logger.info("Skipping log-mel transcription because level %.1f is below %.1f", level, self._silence_level)
+            return ""
+        model = await self._ensure_model()
+        transcript = await asyncio.to_thread(self._decode_features, model, features)
+        if transcript:
+            logger.info("whisper log-mel transcript: %s", transcript)
+        return transcript
+
+    async def _ensure_model(self) -> Any:
+        async with self._load_lock:
+            if self._model is None:
+                import whisper
+
+                self._model = await asyncio.to_thread(whisper.load_model, self._model_name, self._device)
+                n_mels = self._model.dims.n_mels
+                if n_mels != LOG_MEL_BANDS:
+                    raise ValueError(f"whisper model {self._model_name} expects {n_mels} mel bands, not {LOG_MEL_BANDS}")
+            return self._model
+
+    def _decode_features(self, model: Any, features: LogMelFeatures) -> str:
+        import torch
+
+        mel = torch.tensor(features.whisper_input(), dtype=torch.float32, device=model.device)
+        return self._decode(model, mel)
+
+    def _decode_pcm(self, model: Any, pcm_bytes: bytes) -> str:
+        import numpy as np
+        import whisper
+
+        if LISTEN_AUDIO_FORMAT.sample_rate_hz != whisper.audio.SAMPLE_RATE:
+            raise ValueError(f"whisper expects {whisper.audio.SAMPLE_RATE} Hz audio")
+        audio = np.frombuffer(pcm_bytes, dtype="<i2").astype(np.float32) / 32768.0
+        mel = whisper.log_mel_spectrogram(whisper.pad_or_trim(audio), n_mels=LOG_MEL_BANDS).to(model.device)
+        return self._decode(model, mel)
+
+    def _decode(self, model: Any, mel: Any) -> str:
+        import whisper
+
+        options = whisper.DecodingOptions(language=self._language, without_timestamps=True, fp16=False)
+        result = whisper.decode(model, mel, options)
+        return result.text.strip()
+
+
+__all__ = ["WhisperLogMelSpeechToText"]
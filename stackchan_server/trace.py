@@ -0,0 +1,372 @@
+"""ファームウェアのトレース（STACKCHAN_TRACE）を Chrome / Perfetto の trace JSON にする。
+
+`GET /v1/stackchan/{ip}/trace` がこの変換を使う。保存した生のダンプ（`?format=raw`）は
+`python -m stackchan_server.trace dump.sctr -o trace.json` で変換でき、https://ui.perfetto.dev で開ける。
+"""
+
+from __future__ import annotations
+
+import argparse
+import json
+import struct
+from dataclasses import dataclass, field
+from enum import IntEnum
+from logging import getLogger
+from pathlib import Path
+from typing import Any, Optional
+
+logger = getLogger(__name__)
+
+# firmware/include/protocols.hpp の TraceDumpHeader / TraceRecord と同じ形式
+_DUMP_HEADER_FMT = "<IHBBIIQ"  # magic, version, cores, reserved, records, lost, now_us
+_DUMP_HEADER_SIZE = struct.calcsize(_DUMP_HEADER_FMT)
+_RECORD_FMT = "<IHBBII"  # time_us, point, phase, core, arg0, arg1
+_RECORD_SIZE = struct.calcsize(_RECORD_FMT)
+_TRACE_MAGIC = 0x52544353  # "SCTR"
+_TRACE_VERSION = 1
+
+# Chrome trace の pid / tid。コアの tid はコア番号そのもの
+_PID = 1
+_STATE_TID = 100
+_SPEAKER_TID = 101
+
+_STATE_NAMES = ("Idle", "Listening", "Thinking", "Speaking", "Disconnected")
+_WS_EVENT_NAMES = ("Connected", "Disconnected", "Text")
+_SERVO_OP_NAMES = ("Sleep", "MoveX", "MoveY")
+_MESSAGE_KIND_NAMES = {
+    1: "AudioPcm",
+    2: "AudioWav",
+    3: "StateCmd",
+    4: "WakeWordEvt",
+    5: "StateEvt",
+    6: "SpeakDoneEvt",
+    7: "ServoCmd",
+    8: "ServoDoneEvt",
+    9: "AudioCreditEvt",
+    10: "AudioPcmAck",
+    11: "LocalCommandEvt",
+    12: "ClipCmd",
+    13: "ClipData",
+    14: "ClipEvt",
+    15: "AudioLogMel",
+    16: "CaptureData",
+    17: "TraceCmd",
+    18: "TraceData",
+}
+
+
+class TracePoint(IntEnum):
+    STATE = 1
+    MIC_RECORD = 2
+    WS_SEND = 3
+    WS_MESSAGE = 4
+    WS_EVENT = 5
+    SPEAKER_PLAY = 6
+    SPEAKER_DONE = 7
+    SPEAKER_STOP = 8
+    SERVO_STEP = 9
+    LOOP = 10
+
+
+class TracePhase(IntEnum):
+    BEGIN = 1
+    END = 2
+    INSTANT = 3
+
+
+@dataclass
+class TraceEvent:
+    time_us: int  # esp_timer（起動からの µs）。32 bit の記録をダンプ時刻で 64 bit に戻したもの
+    point: int
+    phase: int
+    core: int
+    arg0: int
+    arg1: int
+
+
+@dataclass
+class TraceDump:
+    cores: int
+    lost: int  # リングが一周して上書きされた記録の数
+    now_us: int
+    events: list[TraceEvent] = field(default_factory=list)
+
+
+class TraceFormatError(ValueError):
+    pass
+
+
+def parse_trace_dump(data: bytes) -> TraceDump:
+    """TraceData の START payload と DATA payload を連結したものを読む。"""
+    if len(data) < _DUMP_HEADER_SIZE:
+        raise TraceFormatError(f"trace dump too short: {len(data)} bytes")
+    magic, version, cores, _, records, lost, now_us = struct.unpack_from(
+        _DUMP_HEADER_FMT, data
+    )
+    if magic != _TRACE_MAGIC or version != _TRACE_VERSION:
+        raise TraceFormatError(
+            f"unsupported trace dump magic={magic:08x} version={version}"
+        )
+    body = data[_DUMP_HEADER_SIZE:]
+    if len(body) != records * _RECORD_SIZE:
+        raise TraceFormatError(
+            f"trace dump has {len(body)} bytes for {records} records"
+        )
+
+    now_lo = now_us & 0xFFFFFFFF
+    events = []
+    for time_lo, point, phase, core, arg0, arg1 in struct.iter_unpack(
+        _RECORD_FMT, body
+    ):
+        # 記録はすべてダンプ時刻より前で、32 bit の時刻は約 71 分で一周する
+        time_us = now_us - ((now_lo - time_lo) & 0xFFFFFFFF)
+        events.append(TraceEvent(time_us, point, phase, core, arg0, arg1))
+    # コアごとに古い順で入っているので、安定ソートで時刻順にまとめる
+    events.sort(key=lambda event: event.time_us)
+    return TraceDump(cores=cores, lost=lost, now_us=now_us, events=events)
+
+
+def _name(names: tuple[str, ...], index: int) -> str:
+    return names[index] if 0 <= index < len(names) else str(index)
+
+
+def _kind_name(kind: int) -> str:
+    return _MESSAGE_KIND_NAMES.get(kind, f"kind {kind}")
+
+
+def _signed8(value: int) -> int:
+    value &= 0xFF
+    return value - 0x100 if value >= 0x80 else value
+
+
+def _describe(event: TraceEvent) -> tuple[str, dict[str, Any]]:
+    point = event.point
+    if point == TracePoint.STATE:
+        return (
+            f"{_name(_STATE_NAMES, event.arg0)} -> {_name(_STATE_NAMES, event.arg1)}",
+            {},
+        )
+    if point == TracePoint.MIC_RECORD:
+        return "Mic.record", {"samples": event.arg0, "stereo": bool(event.arg1)}
+    if point == TracePoint.WS_SEND:
+        return f"send {_kind_name(event.arg0)}", {"bytes": event.arg1}
+    if point == TracePoint.WS_MESSAGE:
+        return f"recv {_kind_name(event.arg0)}", {"payload_bytes": event.arg1}
+    if point == TracePoint.WS_EVENT:
+        return f"ws {_name(_WS_EVENT_NAMES, event.arg0)}", {}
+    if point == TracePoint.SPEAKER_PLAY:
+        return "playRaw", {"frames": event.arg0, "sample_rate": event.arg1}
+    if point == TracePoint.SPEAKER_DONE:
+        return "segment played", {"in_speaker": event.arg0}
+    if point == TracePoint.SPEAKER_STOP:
+        return "Speaker.stop", {}
+    if point == TracePoint.SERVO_STEP:
+        return (
+            f"servo {_name(_SERVO_OP_NAMES, event.arg0)}",
+            {"angle": _signed8(event.arg1)},
+        )
+    if point == TracePoint.LOOP:
+        return f"loop {_name(_STATE_NAMES, event.arg0)}", {}
+    return f"point {point}", {"arg0": event.arg0, "arg1": event.arg1}
+
+
+def _metadata(tid: int, name: str, sort_index: int) -> list[dict[str, Any]]:
+    return [
+        {
+            "name": "thread_name",
+            "ph": "M",
+            "pid": _PID,
+            "tid": tid,
+            "args": {"name": name},
+        },
+        {
+            "name": "thread_sort_index",
+            "ph": "M",
+            "pid": _PID,
+            "tid": tid,
+            "args": {"sort_index": sort_index},
+        },
+    ]
+
+
+def _span(
+    tid: int,
+    name: str,
+    start_us: int,
+    end_us: int,
+    args: Optional[dict[str, Any]] = None,
+) -> dict[str, Any]:
+    return {
+        "name": name,
+        "ph": "X",
+        "ts": start_us,
+        "dur": max(end_us - start_us, 0),
+        "pid": _PID,
+        "tid": tid,
+        "args": args or {},
+    }
+
+
+def to_chrome_trace(dump: TraceDump) -> dict[str, Any]:
+    """Chrome の trace event 形式（JSON Object Format）にする。Perfetto UI でもそのまま開ける。
+
+    コアごとの span / instant に加え、ステートの区間（state）と再生中の音声（speaker）を別トラックに組み立てる。
+    """
+    trace_events: list[dict[str, Any]] = [
+        {"name": "process_name", "ph": "M", "pid": _PID, "args": {"name": "stackchan"}},
+        *_metadata(_STATE_TID, "state", 0),
+        *_metadata(_SPEAKER_TID, "speaker", 1),
+    ]
+    for core in range(dump.cores):
+        trace_events.extend(_metadata(core, f"core {core}", 2 + core))
+
+    depth: dict[int, int] = {}
+    state: Optional[tuple[int, int]] = None  # (state id, 入った時刻)
+    speaker_end_us = 0  # 積まれた音声が鳴り終わる時刻
+    speaker_spans: list[dict[str, Any]] = []
+    for event in dump.events:
+        name, args = _describe(event)
+        if event.phase == TracePhase.BEGIN:
+            depth[event.core] = depth.get(event.core, 0) + 1
+            trace_events.append(
+                {
+                    "name": name,
+                    "ph": "B",
+                    "ts": event.time_us,
+                    "pid": _PID,
+                    "tid": event.core,
+                    "args": args,
+                }
+            )
+        elif event.phase == TracePhase.END:
+            # 始まりがリングから押し出された span は閉じない
+            if depth.get(event.core, 0) == 0:
+                continue
+            depth[event.core] -= 1
+            trace_events.append(
+                {"ph": "E", "ts": event.time_us, "pid": _PID, "tid": event.core}
+            )
+        else:
+            trace_events.append(
+                {
+                    "name": name,
+                    "ph": "i",
+                    "s": "t",
+                    "ts": event.time_us,
+                    "pid": _PID,
+                    "tid": event.core,
+                    "args": args,
+                }
+            )
+
+        if event.point == TracePoint.STATE:
+            if state is not None:
+                trace_events.append(
+                    _span(
+                        _STATE_TID,
+                        _name(_STATE_NAMES, state[0]),
+                        state[1],
+                        event.time_us,
+                    )
+                )
+            state = (event.arg1, event.time_us)
+        elif event.point == TracePoint.SPEAKER_PLAY and event.arg1 > 0:
+            # 同じチャンネルに積んだ音は前の音の直後から鳴る
+            start_us = max(event.time_us, speaker_end_us)
+            speaker_end_us = start_us + event.arg0 * 1_000_000 // event.arg1
+            speaker_spans.append(
+                _span(
+                    _SPEAKER_TID,
+                    "audio",
+                    start_us,
+                    speaker_end_us,
+                    {"frames": event.arg0, "sample_rate": event.arg1},
+                )
+            )
+        elif event.point == TracePoint.SPEAKER_STOP:
+            for span in speaker_spans:
+                span["dur"] = max(
+                    min(span["ts"] + span["dur"], event.time_us) - span["ts"], 0
+                )
+            speaker_end_us = event.time_us
+
+    if state is not None:
+        trace_events.append(
+            _span(_STATE_TID, _name(_STATE_NAMES, state[0]), state[1], dump.now_us)
+        )
+    trace_events.extend(speaker_spans)
+    return {
+        "traceEvents": trace_events,
+        "displayTimeUnit": "ms",
+        "otherData": {
+            "cores": dump.cores,
+            "lost_records": dump.lost,
+            "dump_time_us": dump.now_us,
+        },
+    }
+
+
+class TraceDumpReceiver:
+    """端末が TraceData で送ってくるダンプを START から END まで組み立てる。"""
+
+    def __init__(self) -> None:
+        self._buffer: Optional[bytearray] = None
+        self.completed = 0  # 受け取り終えたダンプの数
+        self.last_dump: Optional[bytes] = None
+
+    def handle(
+        self,
+        msg_type: int,
+        payload: bytes,
+        *,
+        start_msg_type: int,
+        data_msg_type: int,
+        end_msg_type: int,
+    ) -> None:
+        if msg_type == start_msg_type:
+            self._buffer = bytearray(payload)
+            return
+        if self._buffer is None:
+            return
+        if msg_type == data_msg_type:
+            self._buffer.extend(payload)
+            return
+        if msg_type == end_msg_type:
+            self.last_dump = bytes(self._buffer)
+            self._buffer = None
+            self.completed += 1
+            logger.info("Received trace dump bytes=%d", len(self.last_dump))
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(
+        description="Convert a firmware trace dump to Chrome/Perfetto trace JSON"
+    )
+    parser.add_argument(
+        "dump", type=Path, help="raw dump from GET /v1/stackchan/{ip}/trace?format=raw"
+    )
+    parser.add_argument(
+        "-o", "--output", type=Path, help="output JSON (default: <dump>.json)"
+    )
+    args = parser.parse_args()
+
+    dump = parse_trace_dump(args.dump.read_bytes())
+    output = args.output or args.dump.with_suffix(".json")
+    output.write_text(json.dumps(to_chrome_trace(dump)))
+    print(f"{len(dump.events)} records ({dump.lost} lost) -> {output}")
+
+
+__all__ = [
+    "TraceDump",
+    "TraceDumpReceiver",
+    "TraceEvent",
+    "TraceFormatError",
+    "TracePhase",
+    "TracePoint",
+    "parse_trace_dump",
+    "to_chrome_trace",
+]
+
+
+if __name__ == "__main__":
+    main()
@@ -1,7 +1,10 @@
 from __future__ import annotations
 
 from dataclasses import dataclass
-from typing import AsyncIterator, Protocol, runtime_checkable
+from typing import TYPE_CHECKING, AsyncIterator, Protocol, runtime_checkable
+
+if TYPE_CHECKING:
+    from .log_mel import LogMelFeatures
 
 
 @runtime_checkable
@@ -9,6 +12,13 @@ class SpeechRecognizer(Protocol):
     async def transcribe(self, pcm_bytes: bytes) -> str: ...
 
 
+@runtime_checkable
+class LogMelSpeechRecognizer(Protocol):
+    """端末が送る対数メル特徴量（AudioLogMel）から直接認識できる recognizer。"""
+
+    async def transcribe_log_mel(self, features: LogMelFeatures) -> str: ...
+
+
 @runtime_checkable
 class StreamingSpeechSession(Protocol):
     async def push_audio(self, pcm_bytes: bytes) -> None: ...
@@ -45,6 +55,7 @@ class StreamingSpeechSynthesizer(SpeechSynthesizer, Protocol):
 
 __all__ = [
     "AudioFormat",
+    "LogMelSpeechRecognizer",
     "SpeechRecognizer",
     "StreamingSpeechRecognizer",
     "StreamingSpeechSession",
@@ -8,13 +8,22 @@ from contextlib import suppress
 from enum import IntEnum, StrEnum
 from logging import getLogger
 from pathlib import Path
-from typing import Literal, Optional, Sequence, TypeAlias, cast
+from typing import Awaitable, Callable, Literal, Optional, Sequence, TypeAlias, cast
 
 from fastapi import WebSocket, WebSocketDisconnect
 
-from .listen import EmptyTranscriptError, ListenHandler, TimeoutError
+from .capture import DeviceCaptureReceiver
+from .clip import ClipHandler
+from .listen import (
+    EmptyTranscriptError,
+    ListenCancelledError,
+    ListenHandler,
+    TimeoutError,
+    UplinkSessionStore,
+)
 from .speak import SpeakHandler
 from .static import LISTEN_AUDIO_FORMAT
+from .trace import TraceDumpReceiver
 from .types import SpeechRecognizer, SpeechSynthesizer
 
 logger = getLogger(__name__)
@@ -24,6 +33,13 @@ _RECORDINGS_DIR = _BASE_DIR / "recordings"
 
 _WS_HEADER_FMT = "<BBBHH"  # kind, msg_type, reserved, seq, payload_bytes
 _WS_HEADER_SIZE = struct.calcsize(_WS_HEADER_FMT)
+_WS_FLAG_END_OF_UTTERANCE = 0x01  # reserved flag on the last AudioWav END of an utterance
+_WS_FLAG_RESUME = 0x02  # reserved flag on AudioPcm START resuming a session after reconnect
+_WS_FLAG_FOLLOW_UP = 0x04  # reserved flag on AudioPcm START of a follow-up utterance (no wake word)
+_WS_FLAG_CANCEL = 0x08  # reserved flag on AudioPcm END discarding the uplink (local command)
+_PCM_ACK_FLAG_STREAMING = 0x01  # AudioPcmAck flags: audio feeds a streaming recognizer (short DATA helps)
+_SPEAK_DONE_FOLLOW_UP = 2  # SpeakDoneEvt payload: firmware waits for a follow-up utterance
+_TRACE_CMD_FLAG_CLEAR = 0x01  # TraceCmd flags: empty the device trace ring after the dump
 
 _DOWN_WAV_CHUNK = 4096  # bytes per WebSocket frame for synthesized audio (raw PCM)
 _DOWN_SEGMENT_MILLIS = (
@@ -52,6 +68,27 @@ class _WsKind(IntEnum):
     SPEAK_DONE_EVT = 6
     SERVO_CMD = 7
     SERVO_DONE_EVT = 8
+    AUDIO_CREDIT_EVT = 9
+    AUDIO_PCM_ACK = 10
+    LOCAL_COMMAND_EVT = 11
+    CLIP_CMD = 12
+    CLIP_DATA = 13
+    CLIP_EVT = 14
+    LOG_MEL = 15
+    CAPTURE_DATA = 16
+    TRACE_CMD = 17
+    TRACE_DATA = 18
+
+
+class LocalCommand(IntEnum):
+    """ファームウェアがウェイクワード直後に認識し、端末内で処理したコマンド。
+
+    0 は欠番（コマンドは Idle でしか認識しないため、止める再生が無い）。"""
+
+    VOLUME_UP = 1
+    VOLUME_DOWN = 2
+    LOOK_AT_ME = 3
+    NOD = 4
 
 
 class _WsMsgType(IntEnum):
@@ -146,6 +183,11 @@ class WsProxy:
         websocket: WebSocket,
         speech_recognizer: SpeechRecognizer,
         speech_synthesizer: SpeechSynthesizer,
+        uplink_session_store: Optional[UplinkSessionStore] = None,
+        local_command_handler: Optional[
+            Callable[[WsProxy, LocalCommand], Awaitable[None]]
+        ] = None,
+        capture_dir: Optional[Path] = None,
     ):
         self.ws = websocket
         self.speech_recognizer = speech_recognizer
@@ -161,6 +203,7 @@ class WsProxy:
             recordings_dir=self.recordings_dir,
             debug_recording=self._debug_recording,
             listen_audio_timeout_seconds=_LISTEN_AUDIO_TIMEOUT_SECONDS,
+            session_store=uplink_session_store,
         )
         self._speaker = SpeakHandler(
             websocket=self.ws,
@@ -169,6 +212,7 @@ class WsProxy:
             start_msg_type=_WsMsgType.START.value,
             data_msg_type=_WsMsgType.DATA.value,
             end_msg_type=_WsMsgType.END.value,
+            end_of_utterance_flag=_WS_FLAG_END_OF_UTTERANCE,
             down_wav_chunk=_DOWN_WAV_CHUNK,
             down_segment_millis=_DOWN_SEGMENT_MILLIS,
             down_segment_stagger_millis=_DOWN_SEGMENT_STAGGER_MILLIS,
@@ -178,6 +222,17 @@ class WsProxy:
             debug_recording=self._debug_recording,
         )
 
+        self._clips = ClipHandler(
+            send_packet=self._send_packet,
+            clip_cmd_kind=_WsKind.CLIP_CMD.value,
+            clip_data_kind=_WsKind.CLIP_DATA.value,
+            start_msg_type=_WsMsgType.START.value,
+            data_msg_type=_WsMsgType.DATA.value,
+            end_msg_type=_WsMsgType.END.value,
+            speech_synthesizer=self.speech_synthesizer,
+            synthesize_pcm=self._speaker.synthesize_pcm,
+        )
+
         self._receiving_task: Optional[asyncio.Task] = None
         self._closed = False
 
@@ -186,11 +241,21 @@ class WsProxy:
         self._servo_done_counter = 0
         self._servo_sent_counter = 0
         self._pending_servo_wait_targets: deque[int] = deque()
+        self._follow_up_armed = False
+        self._local_command_handler = local_command_handler
+        client = websocket.client.host if websocket.client else "unknown"
+        self._device_capture = DeviceCaptureReceiver(capture_dir, client)
+        self._trace_dumps = TraceDumpReceiver()
 
     @property
     def closed(self) -> bool:
         return self._closed
 
+    @property
+    def follow_up_armed(self) -> bool:
+        """再生後のファームウェアが Listening で続きの発話を待っているか。"""
+        return self._follow_up_armed
+
     @property
     def current_state(self) -> FirmwareState:
         return self._current_firmware_state
@@ -209,6 +274,9 @@ class WsProxy:
             if self._wakeword_event.is_set():
                 self._wakeword_event.clear()
                 return
+            if self._listener.follow_up_pending:
+                logger.info("Follow-up utterance started without wake word")
+                return
             if self._closed:
                 raise WebSocketDisconnect()
             await asyncio.sleep(0.05)
@@ -221,15 +289,39 @@ class WsProxy:
             listening_state=FirmwareState.LISTENING,
         )
 
-    async def speak(self, text: str) -> None:
+    async def speak(self, text: str, *, cache: bool = False) -> None:
+        """cache=True はあいさつ・相づちなど繰り返すフレーズ向け。
+        端末の flash にあればそこから再生し、無ければ流したうえで次の Idle 中に保存させる。"""
+        play_cached = None
+        capture_pcm = None
+        if cache and self._clips.supported:
+            if self._clips.is_cached(text):
+
+                async def play_cached() -> bool:
+                    return await self._clips.play(text)
+
+            else:
+
+                def capture_pcm(pcm: bytes, sample_rate: int, channels: int) -> None:
+                    self._clips.queue_prefetch(text, pcm, sample_rate, channels)
+
         await self._speaker.speak(
             text,
             next_seq=self._next_down_seq,
             send_state_command=self.send_state_command,
             idle_state=FirmwareState.IDLE,
             is_closed=lambda: self._closed,
+            play_cached=play_cached,
+            capture_pcm=capture_pcm,
         )
 
+    def prefetch(self, texts: Sequence[str]) -> None:
+        """フレーズを合成して、端末が Idle の間に flash のキャッシュへ保存させる。"""
+        for text in texts:
+            self._clips.queue_prefetch(text)
+        if self._current_firmware_state == FirmwareState.IDLE:
+            self._clips.start_prefetch(self._is_idle)
+
     async def send_state_command(self, state_id: int | FirmwareState) -> None:
         await self._send_state_command(state_id)
 
@@ -267,6 +359,27 @@ class WsProxy:
             label="servo completed event",
         )
 
+    async def dump_trace(
+        self, *, clear: bool = False, timeout_seconds: float = 10.0
+    ) -> bytes:
+        """ファームウェアのトレース（STACKCHAN_TRACE）を取り寄せ、TraceData の START から END までを連結して返す。
+
+        trace.parse_trace_dump / to_chrome_trace で Perfetto の JSON にできる。
+        トレースを外したビルドでも空のダンプが返る。"""
+        target_counter = self._trace_dumps.completed + 1
+        flags = _TRACE_CMD_FLAG_CLEAR if clear else 0
+        await self._send_packet(
+            _WsKind.TRACE_CMD, _WsMsgType.DATA, struct.pack("<B", flags)
+        )
+        await self._wait_for_counter(
+            current=lambda: self._trace_dumps.completed,
+            min_counter=target_counter,
+            timeout_seconds=timeout_seconds,
+            is_closed=lambda: self._closed,
+            label="trace dump",
+        )
+        return cast(bytes, self._trace_dumps.last_dump)
+
     async def start(self) -> None:
         if self._receiving_task is None:
             self._receiving_task = asyncio.create_task(self._receive_loop())
@@ -277,7 +390,9 @@ class WsProxy:
             self._receiving_task.cancel()
             with suppress(asyncio.CancelledError):
                 await self._receiving_task
+        await self._clips.close()
         await self._listener.close()
+        self._device_capture.close()
 
     async def start_talking(self, text: str) -> None:
         await self.speak(text)
@@ -290,7 +405,7 @@ class WsProxy:
                     await self.ws.close(code=1003, reason="header too short")
                     break
 
-                kind, msg_type, _reserved, _seq, payload_bytes = struct.unpack(
+                kind, msg_type, reserved, seq, payload_bytes = struct.unpack(
                     _WS_HEADER_FMT, message[:_WS_HEADER_SIZE]
                 )
 
@@ -299,20 +414,37 @@ class WsProxy:
                     await self.ws.close(code=1003, reason="payload length mismatch")
                     break
 
-                if kind == _WsKind.PCM:
+                # AudioLogMel は AudioPcm と同じ START/DATA/END・ack で、DATA が対数メルのフレームになる
+                if kind in (_WsKind.PCM, _WsKind.LOG_MEL):
                     if msg_type == _WsMsgType.START:
-                        if not await self._listener.handle_start(self.ws):
+                        resume = bool(reserved & _WS_FLAG_RESUME)
+                        follow_up = bool(reserved & _WS_FLAG_FOLLOW_UP)
+                        if not await self._listener.handle_start(
+                            self.ws,
+                            payload,
+                            resume=resume,
+                            follow_up=follow_up,
+                            log_mel=kind == _WsKind.LOG_MEL,
+                        ):
                             break
+                        if resume:
+                            await self._send_pcm_ack()
+                            # 切断で終わった talk_session の続きとして、新しいセッションで認識結果を受け取る
+                            self._wakeword_event.set()
                         continue
 
                     if msg_type == _WsMsgType.DATA:
                         if not await self._listener.handle_data(
-                            self.ws, payload_bytes, payload
+                            self.ws, payload_bytes, payload, seq
                         ):
                             break
+                        await self._send_pcm_ack()
                         continue
 
                     if msg_type == _WsMsgType.END:
+                        if reserved & _WS_FLAG_CANCEL:
+                            await self._listener.handle_cancel()
+                            continue
                         await self._listener.handle_end(
                             self.ws,
                             payload_bytes=payload_bytes,
@@ -341,6 +473,38 @@ class WsProxy:
                     self._handle_servo_done_event(msg_type, payload)
                     continue
 
+                if kind == _WsKind.AUDIO_CREDIT_EVT:
+                    self._handle_audio_credit_event(msg_type, payload)
+                    continue
+
+                if kind == _WsKind.CLIP_EVT:
+                    if msg_type == _WsMsgType.DATA:
+                        self._clips.handle_clip_event(payload)
+                    continue
+
+                if kind == _WsKind.LOCAL_COMMAND_EVT:
+                    self._handle_local_command_event(msg_type, payload)
+                    continue
+
+                if kind == _WsKind.CAPTURE_DATA:
+                    self._device_capture.handle(
+                        msg_type,
+                        payload,
+                        start_msg_type=_WsMsgType.START,
+                        data_msg_type=_WsMsgType.DATA,
+                    )
+                    continue
+
+                if kind == _WsKind.TRACE_DATA:
+                    self._trace_dumps.handle(
+                        msg_type,
+                        payload,
+                        start_msg_type=_WsMsgType.START,
+                        data_msg_type=_WsMsgType.DATA,
+                        end_msg_type=_WsMsgType.END,
+                    )
+                    continue
+
                 await self.ws.close(code=1003, reason="unsupported kind")
                 break
         except WebSocketDisconnect:
@@ -365,6 +529,10 @@ class WsProxy:
         try:
             state = FirmwareState(raw_state)
             self._current_firmware_state = state
+            if state != FirmwareState.LISTENING:
+                self._follow_up_armed = False
+            if state == FirmwareState.IDLE:
+                self._clips.start_prefetch(self._is_idle)
             logger.info("Received firmware state=%s(%d)", state.name, raw_state)
         except ValueError:
             logger.info("Received firmware state=%d", raw_state)
@@ -374,6 +542,7 @@ class WsProxy:
             return
         if len(payload) < 1:
             return
+        self._follow_up_armed = payload[0] == _SPEAK_DONE_FOLLOW_UP
         self._speaker.handle_speak_done_event()
 
     def _handle_servo_done_event(self, msg_type: int, payload: bytes) -> None:
@@ -384,6 +553,43 @@ class WsProxy:
         self._servo_done_counter += 1
         logger.info("Received servo done event")
 
+    def _handle_audio_credit_event(self, msg_type: int, payload: bytes) -> None:
+        if msg_type != _WsMsgType.DATA:
+            return
+        if len(payload) < 4:
+            return
+        (credit_bytes,) = struct.unpack("<I", payload[:4])
+        self._speaker.handle_credit(credit_bytes)
+
+    def _handle_local_command_event(self, msg_type: int, payload: bytes) -> None:
+        if msg_type != _WsMsgType.DATA:
+            return
+        if len(payload) < 1:
+            return
+        try:
+            command = LocalCommand(payload[0])
+        except ValueError:
+            logger.info("Received unknown local command=%d", payload[0])
+            return
+        logger.info("Received local command=%s", command.name)
+        # ターンは端末内で完結したので、直前のウェイクワードで talk_session を始めない
+        self._wakeword_event.clear()
+        if self._local_command_handler is not None:
+            asyncio.create_task(self._local_command_handler(self, command))
+
+    def _is_idle(self) -> bool:
+        return not self._closed and self._current_firmware_state == FirmwareState.IDLE
+
+    async def _send_pcm_ack(self) -> None:
+        # セッション ID を送ってこないファームウェアには ack しない
+        session_id = self._listener.session_id
+        last_seq = self._listener.last_seq
+        if session_id is None or last_seq is None:
+            return
+        flags = _PCM_ACK_FLAG_STREAMING if self._listener.streaming_recognition else 0
+        payload = struct.pack("<IHB", session_id, last_seq, flags)
+        await self._send_packet(_WsKind.AUDIO_PCM_ACK, _WsMsgType.DATA, payload)
+
     async def _send_state_command(self, state_id: int | FirmwareState) -> None:
         payload = struct.pack("<B", int(state_id))
         await self._send_packet(_WsKind.STATE_CMD, _WsMsgType.DATA, payload)
@@ -433,6 +639,8 @@ __all__ = [
     "FirmwareState",
     "TimeoutError",
     "EmptyTranscriptError",
+    "ListenCancelledError",
+    "LocalCommand",
     "ServoCommand",
     "ServoMoveType",
     "ServoWaitType",
@@ -0,0 +1,184 @@
+"""SpeakHandler の送信ペーシングのテスト（make server-test）。
+
+- AudioCreditEvt を受けた接続では、DATA をクレジットの範囲でしか送らず、足りなければ付与を待つ
+- クレジットの無いファームウェアには、2 本目を stagger 後、以降を segment 間隔で送る
+- どの経路でも START/DATA.../END の seq は連番で、発話終了フラグは最後の END だけに付く
+"""
+
+from __future__ import annotations
+
+import asyncio
+import struct
+import unittest
+from pathlib import Path
+from typing import AsyncIterator
+
+from stackchan_server import speak
+from stackchan_server.listen import TimeoutError
+from stackchan_server.speak import SpeakHandler
+from stackchan_server.types import AudioFormat
+
+_HEADER_FMT = "<BBBHH"
+_HEADER_BYTES = struct.calcsize(_HEADER_FMT)
+_WAV_KIND = 2
+_START, _DATA, _END = 1, 2, 3
+_END_OF_UTTERANCE = 0x01
+_CHUNK = 4096
+_SAMPLE_RATE = 24000
+
+
+class _FakeWebSocket:
+    def __init__(self) -> None:
+        self.frames: list[tuple[float, int, int, int, bytes]] = []
+
+    async def send_bytes(self, data: bytes) -> None:
+        _kind, msg_type, flags, seq, length = struct.unpack(_HEADER_FMT, data[:_HEADER_BYTES])
+        payload = data[_HEADER_BYTES:]
+        assert len(payload) == length
+        self.frames.append((asyncio.get_running_loop().time(), msg_type, flags, seq, payload))
+
+    async def send_json(self, data: object) -> None:
+        raise AssertionError(f"unexpected error report: {data}")
+
+    def data_bytes(self) -> int:
+        return sum(len(f[4]) for f in self.frames if f[1] == _DATA)
+
+
+class _FakeStreamingSynthesizer:
+    def __init__(self, chunks: list[bytes]) -> None:
+        self._chunks = chunks
+
+    @property
+    def output_format(self) -> AudioFormat:
+        return AudioFormat(sample_rate_hz=_SAMPLE_RATE, channels=1, sample_width=2)
+
+    async def synthesize(self, text: str) -> bytes:
+        raise AssertionError("streaming synthesizer expected")
+
+    async def synthesize_stream(self, text: str) -> AsyncIterator[bytes]:
+        for chunk in self._chunks:
+            await asyncio.sleep(0)
+            yield chunk
+
+
+def _handler(
+    ws: _FakeWebSocket,
+    *,
+    segment_millis: int = 100,
+    stagger_millis: int = 50,
+    synthesizer: object | None = None,
+) -> SpeakHandler:
+    return SpeakHandler(
+        websocket=ws,  # type: ignore[arg-type]
+        ws_header_fmt=_HEADER_FMT,
+        wav_kind=_WAV_KIND,
+        start_msg_type=_START,
+        data_msg_type=_DATA,
+        end_msg_type=_END,
+        end_of_utterance_flag=_END_OF_UTTERANCE,
+        down_wav_chunk=_CHUNK,
+        down_segment_millis=segment_millis,
+        down_segment_stagger_millis=stagger_millis,
+        sample_width=2,
+        speech_synthesizer=synthesizer,  # type: ignore[arg-type]
+        recordings_dir=Path("."),
+        debug_recording=False,
+    )
+
+
+def _seq_counter():
+    seq = -1
+
+    def next_seq() -> int:
+        nonlocal seq
+        seq += 1
+        return seq
+
+    return next_seq
+
+
+class SpeakHandlerTest(unittest.IsolatedAsyncioTestCase):
+    def assert_well_formed(self, ws: _FakeWebSocket, total_bytes: int) -> None:
+        seqs = [f[3] for f in ws.frames]
+        self.assertEqual(seqs, list(range(len(seqs))))
+        types = [f[1] for f in ws.frames]
+        self.assertEqual(types[0], _START)
+        self.assertEqual(types[-1], _END)
+        ends = [f for f in ws.frames if f[1] == _END]
+        self.assertEqual([f[2] & _END_OF_UTTERANCE for f in ends], [0] * (len(ends) - 1) + [_END_OF_UTTERANCE])
+        self.assertEqual(ws.data_bytes(), total_bytes)
+        self.assertTrue(all(len(f[4]) <= _CHUNK for f in ws.frames if f[1] == _DATA))
+
+    async def test_credit_limits_data(self) -> None:
+        ws = _FakeWebSocket()
+        handler = _handler(ws)
+        handler.handle_credit(10000)
+        pcm = bytes(range(256)) * 94  # 24064 bytes, 0.5 s
+        segment_bytes = _SAMPLE_RATE * 2 // 10
+        task = asyncio.create_task(
+            handler._send_segments(pcm, _SAMPLE_RATE, 1, segment_bytes, next_seq=_seq_counter())
+        )
+        await asyncio.sleep(0.05)
+        # 2 セグメント（4800 bytes x 2）まではクレジット内。3 本目の DATA は付与を待つ
+        self.assertFalse(task.done())
+        self.assertEqual(ws.data_bytes(), 2 * segment_bytes)
+
+        handler.handle_credit(len(pcm) - 10000)
+        await asyncio.wait_for(task, timeout=1.0)
+        self.assert_well_formed(ws, len(pcm))
+        self.assertEqual(b"".join(f[4] for f in ws.frames if f[1] == _DATA), pcm)
+        # 使い切ったクレジットは残らない
+        self.assertEqual(handler._credit_bytes, 0)
+
+    async def test_credit_sends_segments_without_wall_clock_pacing(self) -> None:
+        ws = _FakeWebSocket()
+        handler = _handler(ws, segment_millis=200, stagger_millis=100)
+        handler.handle_credit(1 << 20)
+        pcm = bytes(_SAMPLE_RATE * 2)  # 1 秒 = 5 セグメント
+        start = asyncio.get_running_loop().time()
+        await handler._send_segments(pcm, _SAMPLE_RATE, 1, _SAMPLE_RATE * 2 // 5, next_seq=_seq_counter())
+        self.assert_well_formed(ws, len(pcm))
+        self.assertLess(ws.frames[-1][0] - start, 0.1)
+
+    async def test_credit_timeout(self) -> None:
+        ws = _FakeWebSocket()
+        handler = _handler(ws)
+        handler.handle_credit(0)
+        original = speak._CREDIT_WAIT_TIMEOUT_SECONDS
+        speak._CREDIT_WAIT_TIMEOUT_SECONDS = 0.05
+        try:
+            with self.assertRaises(TimeoutError):
+                await handler._send_segments(bytes(1000), _SAMPLE_RATE, 1, 4800, next_seq=_seq_counter())
+        finally:
+            speak._CREDIT_WAIT_TIMEOUT_SECONDS = original
+        # START だけが出て、DATA は送っていない
+        self.assertEqual([f[1] for f in ws.frames], [_START])
+
+    async def test_wall_clock_pacing_without_credits(self) -> None:
+        ws = _FakeWebSocket()
+        handler = _handler(ws, segment_millis=100, stagger_millis=50)
+        self.assertFalse(handler.credits_enabled)
+        pcm = bytes(_SAMPLE_RATE * 2 * 3 // 10)  # 0.3 秒 = 3 セグメント
+        start = asyncio.get_running_loop().time()
+        await handler._send_segments(pcm, _SAMPLE_RATE, 1, _SAMPLE_RATE * 2 // 10, next_seq=_seq_counter())
+        self.assert_well_formed(ws, len(pcm))
+        starts = [f[0] - start for f in ws.frames if f[1] == _START]
+        self.assertEqual(len(starts), 3)
+        for actual, expected in zip(starts, [0.0, 0.05, 0.15]):
+            self.assertGreaterEqual(actual, expected - 0.005)
+            self.assertLess(actual, expected + 0.04)
+
+    async def test_streaming_synthesizer_marks_last_segment(self) -> None:
+        chunks = [bytes([i]) * 3000 for i in range(7)]  # 21000 bytes, セグメントは 9600 bytes
+        ws = _FakeWebSocket()
+        synthesizer = _FakeStreamingSynthesizer(chunks)
+        handler = _handler(ws, segment_millis=200, synthesizer=synthesizer)
+        handler.handle_credit(1 << 20)
+        await handler._start_talking_stream("text", next_seq=_seq_counter())
+        self.assert_well_formed(ws, sum(len(c) for c in chunks))
+        self.assertEqual(len([f for f in ws.frames if f[1] == _START]), 3)
+        self.assertEqual(b"".join(f[4] for f in ws.frames if f[1] == _DATA), b"".join(chunks))
+
+
+if __name__ == "__main__":
+    unittest.main()